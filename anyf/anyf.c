@@ -2,6 +2,37 @@
 
 #include <stdlib.h>
 
+// 本线程出错中止的拦截点，为NULL时出错直接退出程序
+static OSTHREAD_LOCAL ABORTHOOK_T *ABORT_HOOK = NULL;
+
+// 设置本线程出错中止的拦截点，参数为NULL时取消
+// 设置者应用 setjmp 初始化 Hook->jump，中止后关闭 Hook->anyf 或 Hook->handle
+void AnyfSetAbortHook(ABORTHOOK_T *Hook) {
+    if (Hook) {
+        Hook->code = EXIT_CODE_SUCCESS;
+        Hook->anyf = NULL;
+        Hook->handle = NULL;
+    }
+    ABORT_HOOK = Hook;
+}
+
+// 出错中止：设置了拦截点时跳回拦截点，否则以 Code 为状态码退出程序
+void AnyfAbort(int Code) {
+    if (ABORT_HOOK) {
+        ABORT_HOOK->code = Code;
+        longjmp(ABORT_HOOK->jump, 1);
+    }
+    exit(Code);
+}
+
+// 向拦截点登记本线程打开的 ANYF 文件，出错中止后由拦截点的设置者关闭
+static void TrackOpened(ANYF_T *AnyfType, FILE *Handle) {
+    if (ABORT_HOOK) {
+        ABORT_HOOK->anyf = AnyfType;
+        ABORT_HOOK->handle = Handle;
+    }
+}
+
 // 扩充子文件信息表容量
 static bool ExpandBOM(ANYF_T *AnyfType, size_t Capacity) {
     INFO_T *InfoTemp;
@@ -33,80 +64,2104 @@ static bool ExpandBOM(ANYF_T *AnyfType, size_t Capacity) {
     return true;
 }
 
-// 扩充文件读写缓冲区内存空间
-static bool ExpandBUF(BUFFER_T **ppBuffer, int64_t Size) {
-    BUFFER_T *BufferTemp;
-    if (!ppBuffer || !*ppBuffer)
+// 从流 From 的当前位置复制 Size 字节到流 To 的当前位置
+// 每次最多读写一个缓冲块大小，内存占用与文件大小无关
+// Throttle 不为NULL时每次读写前按限速领取令牌，pCrc 不为NULL时把复制的数据累加到 *pCrc 的 CRC32C 上
+static bool CopyStream(FILE *From, FILE *To, int64_t Size, BUFFER_T *Chunk, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    size_t SizeOnce; // 每次读写的大小
+    while (Size > 0LL) {
+        SizeOnce = (size_t)(Size < Chunk->size ? Size : Chunk->size);
+        AnyfThrottle(Throttle, (int64_t)SizeOnce, 1LL);
+        if (fread(Chunk->fdata, SizeOnce, 1, From) != 1)
+            return false;
+        if (pCrc)
+            *pCrc = AnyfCrc32c(*pCrc, Chunk->fdata, SizeOnce);
+        if (fwrite(Chunk->fdata, SizeOnce, 1, To) != 1)
+            return false;
+        Size -= (int64_t)SizeOnce;
+    }
+    return true;
+}
+
+// 从流 From 的 Offset 偏移量处复制 Size 字节到流 To 的当前位置
+// 按偏移量读取，不使用也不改变流 From 的文件指针，多个线程可同时从同一个流读取
+// pCrc 不为NULL时把复制的数据累加到 *pCrc 的 CRC32C 上，To 为NULL时只读取不写入(只校验)
+static bool CopyStreamAt(FILE *From, int64_t Offset, FILE *To, int64_t Size, BUFFER_T *Chunk, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    size_t SizeOnce; // 每次读写的大小
+    while (Size > 0LL) {
+        SizeOnce = (size_t)(Size < Chunk->size ? Size : Chunk->size);
+        AnyfThrottle(Throttle, (int64_t)SizeOnce, 1LL);
+        if (OsFilePRead(From, Chunk->fdata, SizeOnce, Offset))
+            return false;
+        if (pCrc)
+            *pCrc = AnyfCrc32c(*pCrc, Chunk->fdata, SizeOnce);
+        if (To && fwrite(Chunk->fdata, SizeOnce, 1, To) != 1)
+            return false;
+        Offset += (int64_t)SizeOnce;
+        Size -= (int64_t)SizeOnce;
+    }
+    return true;
+}
+
+// 子文件数据块在 ANYF 文件中的起始偏移量
+static inline int64_t DataOffsetOf(const INFO_T *Info) {
+    return Info->offset + FSIZE_FNLEN_SIZE + Info->fnlen + Info->extra.xsize;
+}
+
+// 压缩的子文件按 CODEC_BLOCK_SIZE 字节分块，返回分块数量
+static inline int64_t ChunkCountOf(const INFO_T *Info) {
+    return Info->fsize > 0 ? (Info->fsize + CODEC_BLOCK_SIZE - 1) / CODEC_BLOCK_SIZE : 0LL;
+}
+
+// 返回压缩或解压子文件使用的字典，没有使用字典的子文件返回NULL
+static inline const CODECDICT_T *DictOf(const ANYF_T *AnyfType, const INFO_T *Info) {
+    return (Info->extra.flags & ENTRY_DICT) ? &AnyfType->dict : NULL;
+}
+
+// 按 ANYF 文件特性初始化子文件扩展属性，数据块按原样保存
+static void InitExtra(const ANYF_T *AnyfType, INFO_T *Info) {
+    Info->extra.xsize = (AnyfType->head.feat & FEAT_EXTRA) ? (int16_t)EXTRA_BASE_SIZE : 0;
+    Info->extra.flags = 0;
+    Info->extra.stored = Info->fsize > 0 ? Info->fsize : 0LL;
+    Info->extra.codec = CODEC_NONE;
+    Info->extra.block = 0LL;
+    Info->extra.slot = 0;
+    Info->extra.crc = CRC32C_INIT;
+    Info->extra.mtime = 0LL;
+}
+
+// 读取子文件扩展属性，文件指针应位于文件名之后
+static bool ReadExtra(FILE *AnyfFileStream, EXTRA_T *Extra) {
+    int16_t ExtraSize; // 写入文件的扩展属性字节数
+    size_t SizeKnown;  // 其中本程序认识的字节数
+    memset(Extra, 0, EXTRA_SIZE);
+    if (fread(&ExtraSize, sizeof(int16_t), 1, AnyfFileStream) != 1)
+        return false;
+    if (ExtraSize < (int16_t)sizeof(int16_t))
+        return false;
+    SizeKnown = (size_t)ExtraSize < EXTRA_SIZE ? (size_t)ExtraSize : EXTRA_SIZE;
+    if (SizeKnown > sizeof(int16_t) && fread((char *)Extra + sizeof(int16_t), SizeKnown - sizeof(int16_t), 1, AnyfFileStream) != 1)
+        return false;
+    if ((size_t)ExtraSize > SizeKnown && AnyfSeek(AnyfFileStream, (size_t)ExtraSize - SizeKnown, SEEK_CUR))
+        return false;
+    Extra->xsize = ExtraSize;
+    return true;
+}
+
+// 按 WriteEntryHead 写入的格式把子文件信息编码到 Buffer 中，返回编码后的字节数
+// Buffer 至少应有 ENTRY_HEAD_MAX 字节
+static size_t EncodeEntryHead(const INFO_T *Info, char *Buffer) {
+    size_t HeadSize = FSIZE_FNLEN_SIZE + Info->fnlen;
+    memcpy(Buffer, &Info->fsize, HeadSize);
+    if (Info->extra.xsize > 0) {
+        memcpy(Buffer + HeadSize, &Info->extra, Info->extra.xsize);
+        HeadSize += Info->extra.xsize;
+    }
+    return HeadSize;
+}
+
+// 在 ANYF 文件当前位置写入子文件信息，ANYF 文件有 FEAT_EXTRA 特性时连同扩展属性一起写入
+static bool WriteEntryHead(ANYF_T *AnyfType, const INFO_T *Info) {
+    // 将 INFO_T 结构体从成员 fsize 开始写入文件，成员 offset 不需要保存到文件
+    if (fwrite(&Info->fsize, FSIZE_FNLEN_SIZE + Info->fnlen, 1, AnyfType->handle) != 1)
+        return false;
+    if (Info->extra.xsize > 0 && fwrite(&Info->extra, Info->extra.xsize, 1, AnyfType->handle) != 1)
+        return false;
+    return true;
+}
+
+// 读取 Offset 处的子文件信息，填写 Info 中除文件名以外的成员
+// 不使用也不改变流的文件指针，多个线程可同时读取
+static bool ReadHeadAt(FILE *AnyfFileStream, int32_t Feat, int64_t Offset, INFO_T *Info) {
+    size_t SizeKnown;
+    Info->offset = Offset;
+    if (OsFilePRead(AnyfFileStream, &Info->fsize, FSIZE_FNLEN_SIZE, Offset))
+        return false;
+    if (Info->fnlen <= 0 || Info->fnlen > PATH_MAX_SIZE)
+        return false;
+    Offset += FSIZE_FNLEN_SIZE + Info->fnlen;
+    // 与 ReadExtra 相同，缺少的成员视为零
+    memset(&Info->extra, 0, EXTRA_SIZE);
+    if (!(Feat & FEAT_EXTRA)) {
+        Info->extra.stored = Info->fsize > 0 ? Info->fsize : 0LL;
+        return true;
+    }
+    if (OsFilePRead(AnyfFileStream, &Info->extra.xsize, sizeof(int16_t), Offset) || Info->extra.xsize < (int16_t)sizeof(int16_t))
+        return false;
+    SizeKnown = (size_t)Info->extra.xsize < EXTRA_SIZE ? (size_t)Info->extra.xsize : EXTRA_SIZE;
+    if (SizeKnown > sizeof(int16_t) && OsFilePRead(AnyfFileStream, (char *)&Info->extra + sizeof(int16_t), SizeKnown - sizeof(int16_t), Offset + sizeof(int16_t)))
+        return false;
+    return true;
+}
+
+// 读取 Offset 处的子文件信息，返回该子文件(含数据块)在 ANYF 文件中的结束位置，即下一个子文件信息的起始位置
+// 不使用也不改变流的文件指针，读取失败返回-1
+static int64_t EntryEndAt(FILE *AnyfFileStream, int32_t Feat, int64_t Offset) {
+    INFO_T Info;
+    if (!ReadHeadAt(AnyfFileStream, Feat, Offset, &Info))
+        return -1LL;
+    return DataOffsetOf(&Info) + Info.extra.stored;
+}
+
+// 返回子文件在 Merkle 树中的叶子值：大小、文件名和内容的 CRC32C(有校验值时)依次计算的 CRC32C
+// 文件名应为写入 ANYF 文件的UTF8编码，使叶子值与平台和打开方式无关
+static uint32_t MerkleLeaf(const INFO_T *Info) {
+    uint32_t Leaf = AnyfCrc32c(CRC32C_INIT, &Info->fsize, sizeof(int64_t));
+    Leaf = AnyfCrc32c(Leaf, Info->fname, (size_t)Info->fnlen);
+    if (Info->extra.flags & ENTRY_CRC)
+        Leaf = AnyfCrc32c(Leaf, &Info->extra.crc, sizeof(uint32_t));
+    return Leaf;
+}
+
+// 按信息表顺序以读取时不跳过的子文件为叶子计算 Merkle 根，写入 *pRoot
+// 每层相邻两个结点拼接后的 CRC32C 为上一层的结点，落单的结点直接升到上一层
+// 只读取信息表，不读取数据块：信息表相同则根相同，单个子文件的数据可只按其 crc 校验，再由根确认 crc 未被改动
+// 打开时读入的子文件使用读入时计算的叶子值，本次打包加入的子文件的文件名仍是UTF8编码，直接计算
+// 返回叶子数量，没有叶子时 *pRoot 为0，分配内存失败返回-1
+int64_t AnyfMerkleRoot(const ANYF_T *AnyfType, uint32_t *pRoot) {
+    uint32_t *Nodes, Pair[2];
+    int64_t Leaves = 0LL, Width;
+    *pRoot = 0U;
+    if (!(Nodes = malloc((size_t)(AnyfType->head.count > 0 ? AnyfType->head.count : 1) * sizeof(uint32_t))))
+        return -1LL;
+    for (int64_t i = 0; i < AnyfType->head.count; ++i) {
+        if (!(AnyfType->sheet[i].extra.flags & ENTRY_SKIP))
+            Nodes[Leaves++] = i < AnyfType->loaded ? AnyfType->sheet[i].leaf : MerkleLeaf(&AnyfType->sheet[i]);
+    }
+    for (Width = Leaves; Width > 1LL; Width = (Width + 1) / 2) {
+        for (int64_t i = 0; i < Width / 2; ++i) {
+            Pair[0] = Nodes[2 * i];
+            Pair[1] = Nodes[2 * i + 1];
+            Nodes[i] = AnyfCrc32c(CRC32C_INIT, Pair, sizeof(Pair));
+        }
+        if (Width % 2)
+            Nodes[Width / 2] = Nodes[Width - 1];
+    }
+    if (Leaves > 0LL)
+        *pRoot = Nodes[0];
+    free(Nodes);
+    return Leaves;
+}
+
+// 独占锁定 ANYF 文件头，其他写入者正在更新文件头或读取者正在读取文件头时等待
+// 加锁前先把缓冲的数据写入文件，读取者看到更新后的文件头时，其指向的数据已在文件中
+static bool LockHead(ANYF_T *AnyfType) {
+    if (fflush(AnyfType->handle))
+        return false;
+    return !OsFileLock(AnyfType->handle, HEAD_LOCK_OFFSET, LOCK_SIZE, true);
+}
+
+static void UnlockHead(ANYF_T *AnyfType) {
+    OsFileUnlock(AnyfType->handle, HEAD_LOCK_OFFSET, LOCK_SIZE);
+}
+
+// 独占锁定追加位置，其他写入者正在独占追加时等待
+static bool LockAppend(ANYF_T *AnyfType) {
+    return !OsFileLock(AnyfType->handle, APPEND_LOCK_OFFSET, LOCK_SIZE, true);
+}
+
+static void UnlockAppend(ANYF_T *AnyfType) {
+    OsFileUnlock(AnyfType->handle, APPEND_LOCK_OFFSET, LOCK_SIZE);
+}
+
+// 锁定文件头后调用：读取文件中的文件头到 *pDisk，并确定子文件信息链当前的结束位置
+// 有 FEAT_SHARED 特性时直接使用文件头记录的位置，否则从上次得知的结束位置起跳过其他写入者追加的子文件
+// 成功后 AnyfType->tail 和 AnyfType->known 与文件一致
+static bool LocateTail(ANYF_T *AnyfType, HEAD_T *pDisk) {
+    if (OsFilePRead(AnyfType->handle, pDisk, sizeof(HEAD_T), AnyfType->start))
+        return false;
+    if (pDisk->feat & FEAT_SHARED) {
+        AnyfType->tail = pDisk->tail;
+    } else {
+        // 子文件数量变少说明文件已被改写，不能继续追加
+        if (pDisk->count < AnyfType->known)
+            return false;
+        for (int64_t i = AnyfType->known; i < pDisk->count; ++i) {
+            if ((AnyfType->tail = EntryEndAt(AnyfType->handle, pDisk->feat, AnyfType->tail)) < 0LL)
+                return false;
+        }
+    }
+    AnyfType->known = pDisk->count;
+    return true;
+}
+
+// 锁定文件头后调用：把 *pDisk 从特性标志到子文件数量的部分写回文件头
+static bool StoreHead(ANYF_T *AnyfType, const HEAD_T *pDisk) {
+    return !OsFilePWrite(AnyfType->handle, (const char *)pDisk + FEAT_OFFSET, SUBDATA_OFFSET - FEAT_OFFSET, AnyfType->start + FEAT_OFFSET);
+}
+
+// 共享追加时在子文件信息链末尾预留 Bytes 字节的区域，锁内只写入一个占位子文件信息并更新文件头
+// 占位子文件信息的数据块覆盖整个区域，区域写完并发布前，读取者和其他写入者都把整个区域当作一个跳过的子文件
+// 成功返回区域起始偏移量，失败返回-1
+static int64_t ReserveRegion(ANYF_T *AnyfType, int64_t Bytes) {
+    HEAD_T Disk;
+    INFO_T Pending;
+    char EntryHead[ENTRY_HEAD_MAX];
+    int64_t Offset = -1LL;
+    // 独占追加的写入者正在子文件信息链末尾写入时不能预留
+    if (!LockAppend(AnyfType))
+        return -1LL;
+    if (!LockHead(AnyfType)) {
+        UnlockAppend(AnyfType);
+        return -1LL;
+    }
+    if (LocateTail(AnyfType, &Disk)) {
+        Pending.fsize = 0LL;
+        Pending.fnlen = 1;
+        Pending.fname[0] = EMPTY_CHAR;
+        Pending.extra.xsize = (int16_t)EXTRA_BASE_SIZE;
+        Pending.extra.flags = ENTRY_PENDING;
+        Pending.extra.stored = Bytes - PENDING_HEAD;
+        Disk.feat |= FEAT_SHARED;
+        Disk.tail = AnyfType->tail + Bytes;
+        ++Disk.count;
+        // 持久化模式下占位子文件信息先于文件头落盘，文件头不会指向未写入的占位信息
+        if (!OsFilePWrite(AnyfType->handle, EntryHead, EncodeEntryHead(&Pending, EntryHead), AnyfType->tail) && !(AnyfType->durable && OsFileSyncData(AnyfType->handle)) && StoreHead(AnyfType, &Disk)) {
+            Offset = AnyfType->tail;
+            AnyfType->tail = Disk.tail;
+            AnyfType->known = Disk.count;
+            AnyfType->head.feat |= Disk.feat;
+        }
+    }
+    UnlockHead(AnyfType);
+    UnlockAppend(AnyfType);
+    return Offset;
+}
+
+// 预留区域写完后加锁发布：用区域中第一个子文件信息替换占位子文件信息，子文件总数加上区域中其余的子文件数量
+// First 为区域中的第一个子文件，Entries 为区域中的子文件数量(含作废的)，Feat 为写入区域时新增的特性标志
+// 持久化模式下先同步区域中的数据再发布
+static bool PublishRegion(ANYF_T *AnyfType, const INFO_T *First, int64_t Entries, int32_t Feat) {
+    HEAD_T Disk;
+    char EntryHead[ENTRY_HEAD_MAX];
+    bool Published = false;
+    if (AnyfType->durable && OsFileSyncData(AnyfType->handle))
         return false;
-    if ((*ppBuffer)->size >= Size)
+    if (!LockHead(AnyfType))
+        return false;
+    if (!OsFilePRead(AnyfType->handle, &Disk, sizeof(HEAD_T), AnyfType->start)) {
+        Disk.feat |= Feat;
+        Disk.count += Entries - 1LL;
+        // 共享追加的写入者只知道自己的子文件，不再记录 Merkle 根
+        Disk.root = 0U;
+        Disk.leaves = 0LL;
+        if (!OsFilePWrite(AnyfType->handle, EntryHead, EncodeEntryHead(First, EntryHead), First->offset) && StoreHead(AnyfType, &Disk))
+            Published = !(AnyfType->durable && OsFileSyncData(AnyfType->handle));
+    }
+    UnlockHead(AnyfType);
+    return Published;
+}
+
+// 从尚未读取的子文件中均匀采样估计熵，判断是否值得压缩，采样失败时交给后续的读取报错
+// 采样后子文件的文件指针移回开头，调用者可直接 fread 读取内容
+static bool WorthCoding(FILE *SubStream, int64_t Size) {
+    unsigned char Sample[CODEC_SAMPLE_COUNT * CODEC_SAMPLE_SIZE];
+    int64_t Offset;
+    bool Sampled = true;
+    if (Size <= (int64_t)sizeof(Sample))
+        return true;
+    for (int i = 0; i < CODEC_SAMPLE_COUNT && Sampled; ++i) {
+        Offset = (Size - CODEC_SAMPLE_SIZE) / (CODEC_SAMPLE_COUNT + 1) * (i + 1);
+        Sampled = !OsFilePRead(SubStream, Sample + i * CODEC_SAMPLE_SIZE, CODEC_SAMPLE_SIZE, Offset);
+    }
+    rewind(SubStream);
+    return !Sampled || AnyfCodecEntropy(Sample, sizeof(Sample)) <= CODEC_ENTROPY_LIMIT;
+}
+
+// 填写已打开子文件的扩展属性并确定其数据块的保存方式
+// Info 的 fsize 应已填好，ANYF 文件有 FEAT_EXTRA 特性且子文件含有空洞时标记为稀疏文件
+// 指定了压缩方式时不含空洞且采样判断可压缩的子文件标记为压缩，其 stored 在写入数据块后才能确定
+// 非空子文件都带有内容的 CRC32C，其 crc 在读完源文件后才能确定
+// 所有子文件都记录源文件的修改时间，提取后恢复，也用于跳过已是最新的目标文件
+// 成功后 *ppExtents 为子文件中有数据的区域(由调用者 free)，*pCount 为区域数量
+static bool PlanFileEntry(ANYF_T *AnyfType, FILE *SubStream, INFO_T *Info, EXTENT_T **ppExtents, size_t *pCount) {
+    int64_t ExtentTotal = 0LL; // 有数据的区域总字节数
+    *ppExtents = NULL;
+    *pCount = 0ULL;
+    InitExtra(AnyfType, Info);
+    if (!(AnyfType->head.feat & FEAT_EXTRA))
         return true;
-    BufferTemp = realloc(*ppBuffer, sizeof(BUFFER_T) + Size);
-    if (!BufferTemp)
+    Info->extra.xsize = (int16_t)EXTRA_SIZE;
+    if (!OsFileMtime(SubStream, &Info->extra.mtime))
+        Info->extra.flags |= ENTRY_MTIME;
+    if (Info->fsize <= 0)
+        return true;
+    Info->extra.flags |= ENTRY_CRC;
+    if (OsFileDataExtents(SubStream, Info->fsize, ppExtents, pCount))
         return false;
-    BufferTemp->size = Size, *ppBuffer = BufferTemp;
+    if (*pCount == 1 && (*ppExtents)[0].offset == 0LL && (*ppExtents)[0].length == Info->fsize) {
+        if (AnyfType->codec != CODEC_NONE && !WorthCoding(SubStream, Info->fsize)) {
+            AnyfType->stats.skipped += Info->fsize;
+        } else if (AnyfType->codec != CODEC_NONE) {
+            Info->extra.codec = (int16_t)AnyfType->codec;
+            Info->extra.stored = 0LL;
+            // 多于一个分块的子文件带有分块表，提取时可按分块并行解压
+            if (ChunkCountOf(Info) > 1LL)
+                Info->extra.flags |= ENTRY_CHUNKED;
+            // 有共享字典时小文件用字典压缩
+            if (AnyfType->dict.size > 0ULL && Info->fsize <= DICT_ENTRY_MAX)
+                Info->extra.flags |= ENTRY_DICT;
+            AnyfType->head.feat |= FEAT_CODEC;
+        }
+        return true;
+    }
+    for (size_t i = 0; i < *pCount; ++i)
+        ExtentTotal += (*ppExtents)[i].length;
+    Info->extra.flags |= ENTRY_SPARSE;
+    // 全是空洞的文件不保存任何数据
+    if (*pCount > 0)
+        Info->extra.stored = sizeof(int64_t) + *pCount * sizeof(EXTENT_T) + ExtentTotal;
+    else
+        Info->extra.stored = 0LL;
     return true;
 }
 
-// 大文件复制，从子文件流复制到 ANYF 文件流
-static bool SubCopyToMain(FILE *SubStream, FILE *AnyfFileStream, BUFFER_T **BufferRW) {
-    size_t SizeRead; // 每次fread的大小
-    if (!ExpandBUF(BufferRW, BUF_SIZE_U))
+// 压缩或解压一段需要 CODEC_WORK_SIZE 字节的工作区，缓冲块足够大时直接使用缓冲块
+// 否则从缓冲块所属的缓冲池另取，计入 --max-mem 的上限，*ppOwned 为另取的工作区(由调用者 GiveWorkArea)
+// 缓冲池已达上限或分配失败返回NULL
+static char *CodecWorkArea(BUFFER_T *Chunk, BUFFER_T **ppOwned) {
+    *ppOwned = NULL;
+    if (Chunk->size >= (int64_t)CODEC_WORK_SIZE)
+        return Chunk->fdata;
+    if (Chunk->pool) {
+        *ppOwned = AnyfPoolTakeSized(Chunk->pool, CODEC_WORK_SIZE);
+    } else if (*ppOwned = malloc(sizeof(BUFFER_T) + CODEC_WORK_SIZE)) {
+        (*ppOwned)->size = CODEC_WORK_SIZE;
+        (*ppOwned)->pool = NULL;
+    }
+    return *ppOwned ? (*ppOwned)->fdata : NULL;
+}
+
+// 归还 CodecWorkArea 另取的工作区，Owned 为NULL时什么也不做
+static void GiveWorkArea(BUFFER_T *Owned) {
+    if (Owned && Owned->pool)
+        AnyfPoolGive(Owned->pool, Owned);
+    else
+        free(Owned);
+}
+
+// 分块并行压缩的线程函数，逐个领取分块读取并压缩，轮到该分块时写入 ANYF 文件
+static void PackChunkWorker(void *Argument) {
+    CHUNKWORKER_T *Worker = Argument;
+    CHUNKSHARE_T *Share = Worker->share;
+    ANYF_T *AnyfType = Share->anyf;
+    BUFFER_T *Owned;
+    char *Work;
+    int64_t Index;
+    size_t RawSize, FrameSize = 0ULL;
+    uint32_t Crc = CRC32C_INIT; // 分块原始内容的 CRC32C
+    bool Success;
+    // 分配不到工作区的线程不参与，其余线程照常完成
+    if (!(Work = CodecWorkArea(Worker->chunk, &Owned)))
+        return;
+    for (;;) {
+        OsMutexLock(&Share->lock);
+        Index = Share->failed ? Share->count : Share->next++;
+        OsMutexUnlock(&Share->lock);
+        if (Index >= Share->count)
+            break;
+        RawSize = (size_t)(Share->size - Index * CODEC_BLOCK_SIZE < CODEC_BLOCK_SIZE ? Share->size - Index * CODEC_BLOCK_SIZE : CODEC_BLOCK_SIZE);
+        AnyfThrottle(AnyfType->throttle, (int64_t)RawSize, 1LL);
+        Success = !OsFilePRead(Share->source, Work, RawSize, Index * CODEC_BLOCK_SIZE);
+        if (Success) {
+            Crc = AnyfCrc32c(CRC32C_INIT, Work, RawSize);
+            FrameSize = AnyfCodecEncode(Share->codec, AnyfType->level, Share->dict, Work, RawSize, Work + CODEC_BLOCK_SIZE);
+        }
+        OsMutexLock(&Share->lock);
+        while (Share->turn != Index && !Share->failed)
+            OsCondWait(&Share->turned, &Share->lock);
+        if (Success && !Share->failed && fwrite(Work + CODEC_BLOCK_SIZE, FrameSize, 1, AnyfType->handle) == 1) {
+            Share->table[Index] = Share->stored;
+            Share->stored += (int64_t)FrameSize;
+            // 分块按顺序写入，校验值也按顺序拼接
+            Share->crc = AnyfCrc32cCombine(Share->crc, Crc, (int64_t)RawSize);
+        } else {
+            Share->failed = true;
+        }
+        ++Share->turn;
+        OsCondBroadcast(&Share->turned);
+        OsMutexUnlock(&Share->lock);
+    }
+    GiveWorkArea(Owned);
+}
+
+// 将已打开的子文件按 AnyfType->codec 逐段压缩，写入 ANYF 文件当前位置
+// 多个分块的子文件由最多 AnyfType->jobs 个线程同时压缩，第0个线程由当前线程担任并使用 Chunk，其余线程各从缓冲池取一个缓冲块
+// 标记为 ENTRY_CHUNKED 的子文件在各段之后写入分块表，成功后 Info->extra.stored 为写入的字节数，Info->extra.crc 为原始内容的 CRC32C
+static bool PackCoded(ANYF_T *AnyfType, FILE *SubStream, INFO_T *Info, BUFFER_T *Chunk, BUFPOOL_T *Pool) {
+    CHUNKSHARE_T Share;
+    CHUNKWORKER_T *Workers;
+    size_t WorkerCount, Started;
+    bool Success = false;
+    Share.anyf = AnyfType;
+    Share.source = SubStream;
+    Share.codec = AnyfCodecOf(AnyfType->codec);
+    Share.dict = DictOf(AnyfType, Info);
+    Share.size = Info->fsize;
+    Share.count = ChunkCountOf(Info);
+    Share.next = Share.turn = Share.stored = 0LL;
+    Share.crc = CRC32C_INIT;
+    Share.failed = false;
+    WorkerCount = AnyfType->jobs > 1 ? (size_t)AnyfType->jobs : 1ULL;
+    if ((int64_t)WorkerCount > Share.count)
+        WorkerCount = Share.count > 0LL ? (size_t)Share.count : 1ULL;
+    if (!(Share.table = malloc((size_t)(Share.count > 0LL ? Share.count : 1LL) * sizeof(int64_t))))
+        return false;
+    if (!(Workers = malloc(WorkerCount * sizeof(CHUNKWORKER_T)))) {
+        free(Share.table);
+        return false;
+    }
+    if (OsMutexInit(&Share.lock)) {
+        PRINT_ERROR_AND_ABORT("初始化互斥锁失败");
+    }
+    if (OsCondInit(&Share.turned)) {
+        PRINT_ERROR_AND_ABORT("初始化条件变量失败");
+    }
+    Workers[0].share = &Share;
+    Workers[0].chunk = Chunk;
+    for (Started = 1ULL; Started < WorkerCount; ++Started) {
+        Workers[Started].share = &Share;
+        if (!(Workers[Started].chunk = AnyfPoolTake(Pool)))
+            break;
+        if (OsThreadCreate(&Workers[Started].thread, PackChunkWorker, &Workers[Started])) {
+            AnyfPoolGive(Pool, Workers[Started].chunk);
+            break;
+        }
+    }
+    PackChunkWorker(&Workers[0]);
+    for (size_t i = 1; i < Started; ++i) {
+        OsThreadJoin(Workers[i].thread);
+        AnyfPoolGive(Pool, Workers[i].chunk);
+    }
+    OsCondDestroy(&Share.turned);
+    OsMutexDestroy(&Share.lock);
+    Info->extra.stored = Share.stored;
+    Info->extra.crc = Share.crc;
+    if (!Share.failed && Share.turn == Share.count) {
+        Success = true;
+        if (Info->extra.flags & ENTRY_CHUNKED) {
+            Success = fwrite(Share.table, sizeof(int64_t), (size_t)Share.count, AnyfType->handle) == (size_t)Share.count;
+            Info->extra.stored += Share.count * (int64_t)sizeof(int64_t);
+        }
+    }
+    free(Workers);
+    free(Share.table);
+    return Success;
+}
+
+// 数据块写完后回到子文件信息处重写扩展属性(写入实际的 stored)，再把 ANYF 文件指针移到数据块之后
+static bool RewriteExtra(ANYF_T *AnyfType, const INFO_T *Info) {
+    if (AnyfSeek(AnyfType->handle, Info->offset + FSIZE_FNLEN_SIZE + Info->fnlen, SEEK_SET))
+        return false;
+    if (fwrite(&Info->extra, (size_t)Info->extra.xsize, 1, AnyfType->handle) != 1)
+        return false;
+    return !AnyfSeek(AnyfType->handle, DataOffsetOf(Info) + Info->extra.stored, SEEK_SET);
+}
+
+// 将已打开的子文件写入 ANYF 文件当前位置，包括子文件信息和数据块
+// Info 的 fsize、fnlen、fname 应已填好，扩展属性由此函数填写
+// ANYF 文件有 FEAT_EXTRA 特性且子文件含有空洞时，只保存区域表和有数据的区域
+// 压缩或带校验值的子文件先写入子文件信息和数据块，再回到子文件信息处写入实际的 stored 和 crc
+static bool PackFileEntry(ANYF_T *AnyfType, FILE *SubStream, INFO_T *Info, BUFFER_T *Chunk, BUFPOOL_T *Pool) {
+    EXTENT_T *Extents;      // 子文件中有数据的区域
+    size_t ExtentCount;     // 有数据的区域数量
+    int64_t ExtentCount64;  // 写入文件的区域数量
+    int64_t Covered = 0LL;  // 已计入校验值的子文件字节数，空洞按0计入
+    uint32_t *pCrc;         // 带校验值的子文件累加到 Info->extra.crc 上
+    bool FinalReturnCode = false;
+    if (!PlanFileEntry(AnyfType, SubStream, Info, &Extents, &ExtentCount))
         return false;
-    while (!feof(SubStream)) {
-        SizeRead = fread((*BufferRW)->fdata, 1, BUF_SIZE_U, SubStream);
-        if (SizeRead == 0ULL) {
+    pCrc = (Info->extra.flags & ENTRY_CRC) ? &Info->extra.crc : NULL;
+    if (!WriteEntryHead(AnyfType, Info))
+        goto FreeAndReturn;
+    if (Info->extra.codec != CODEC_NONE) {
+        if (!PackCoded(AnyfType, SubStream, Info, Chunk, Pool))
+            goto FreeAndReturn;
+    } else if (!(Info->extra.flags & ENTRY_SPARSE)) {
+        // 大小等于0的文件无需读写
+        if (Info->fsize > 0 && !AnyfCopyWithPlan(SubStream, AnyfType->handle, Info->fsize, Chunk, AnyfProfilePlan(AnyfType->profile, Info->fsize), AnyfType->throttle, pCrc))
+            goto FreeAndReturn;
+    } else if (ExtentCount > 0) {
+        ExtentCount64 = (int64_t)ExtentCount;
+        if (fwrite(&ExtentCount64, sizeof(int64_t), 1, AnyfType->handle) != 1)
+            goto FreeAndReturn;
+        if (fwrite(Extents, sizeof(EXTENT_T), ExtentCount, AnyfType->handle) != ExtentCount)
+            goto FreeAndReturn;
+        for (size_t i = 0; i < ExtentCount; ++i) {
+            if (AnyfSeek(SubStream, Extents[i].offset, SEEK_SET))
+                goto FreeAndReturn;
+            if (pCrc)
+                *pCrc = AnyfCrc32cZeros(*pCrc, Extents[i].offset - Covered);
+            if (!CopyStream(SubStream, AnyfType->handle, Extents[i].length, Chunk, AnyfType->throttle, pCrc))
+                goto FreeAndReturn;
+            Covered = Extents[i].offset + Extents[i].length;
+        }
+    }
+    // 稀疏文件末尾的空洞
+    if (pCrc && (Info->extra.flags & ENTRY_SPARSE))
+        *pCrc = AnyfCrc32cZeros(*pCrc, Info->fsize - Covered);
+    if ((Info->extra.codec != CODEC_NONE || pCrc) && !RewriteExtra(AnyfType, Info))
+        goto FreeAndReturn;
+    FinalReturnCode = true;
+FreeAndReturn:
+    if (Extents)
+        free(Extents);
+    return FinalReturnCode;
+}
+
+// 清空合并写入批次，下一次加入内容时重新确定批次起始偏移量
+static void BatchReset(BATCH_T *Batch) {
+    Batch->vecs = 0;
+    Batch->entries = 0LL;
+    Batch->base = -1LL;
+    Batch->bytes = 0LL;
+    Batch->staged = 0LL;
+    Batch->headed = 0ULL;
+}
+
+// 将批次一次性写入 ANYF 文件当前位置
+// 失败时丢弃批次中的子文件：从子文件信息表末尾删除这些子文件并将 ANYF 文件指针移回批次起始处
+static bool BatchFlush(ANYF_T *AnyfType, BATCH_T *Batch) {
+    if (Batch->vecs == 0)
+        return true;
+    AnyfThrottle(AnyfType->throttle, Batch->bytes, 1LL);
+    if (OsFileWriteV(AnyfType->handle, Batch->iov, Batch->vecs)) {
+        printf(MESSAGE_WARN "跳过：合并写入%" I64_SPECIFIER "个子文件失败\n", Batch->entries);
+        AnyfType->head.count -= Batch->entries;
+        AnyfSeek(AnyfType->handle, Batch->base, SEEK_SET);
+        BatchReset(Batch);
+        return false;
+    }
+    BatchReset(Batch);
+    return true;
+}
+
+// 判断批次能否再容纳一个子文件信息和 DataSize 字节的数据块，不能容纳时先写入已有的批次
+static void BatchMakeRoom(ANYF_T *AnyfType, BATCH_T *Batch, const INFO_T *Info, int64_t DataSize) {
+    if (Batch->vecs + 2 > OSFILE_IOV_MAX || Batch->headed + FSIZE_FNLEN_SIZE + Info->fnlen + EXTRA_SIZE > BATCH_HEAD_SIZE || Batch->staged + DataSize > Batch->stage->size)
+        BatchFlush(AnyfType, Batch);
+}
+
+// 将子文件信息加入批次，并把 Info->offset 设为该子文件信息在 ANYF 文件中的偏移量
+// 调用前应已调用 BatchMakeRoom 确保批次有足够空间
+static bool BatchPushHead(ANYF_T *AnyfType, BATCH_T *Batch, INFO_T *Info) {
+    char *HeadStart = Batch->heads + Batch->headed;
+    size_t HeadSize;
+    // 空批次的起始偏移量即 ANYF 文件指针当前位置
+    if (Batch->vecs == 0 && (Batch->base = AnyfTell(AnyfType->handle)) < 0LL)
+        return false;
+    Info->offset = Batch->base + Batch->bytes;
+    // 与 WriteEntryHead 写入的字节相同
+    HeadSize = EncodeEntryHead(Info, HeadStart);
+    Batch->iov[Batch->vecs].base = HeadStart;
+    Batch->iov[Batch->vecs++].length = HeadSize;
+    Batch->headed += HeadSize;
+    Batch->bytes += (int64_t)HeadSize;
+    ++Batch->entries;
+    return true;
+}
+
+// 尝试将已打开的子文件加入批次，子文件数据块读入批次的暂存缓冲块
+// 返回 BATCH_QUEUED 表示已加入，BATCH_UNFIT 表示不适合合并写入(较大的文件或稀疏文件)，BATCH_FAILED 表示读取子文件失败
+static int BatchPushFile(ANYF_T *AnyfType, BATCH_T *Batch, FILE *SubStream, INFO_T *Info) {
+    EXTENT_T *Extents;
+    size_t ExtentCount;
+    int64_t DataSize; // 数据块在暂存缓冲块中最多占用的字节数
+    char *Data;       // 数据块在暂存缓冲块中的位置
+    // 压缩的子文件作为一段写入，最多比原始数据多一个段头
+    // 在确定保存方式前判断，使不适合合并写入的子文件只采样和统计一次
+    DataSize = AnyfType->codec != CODEC_NONE ? (int64_t)CODEC_FRAME_SIZE + Info->fsize : Info->fsize;
+    if (Info->fsize > BATCH_ENTRY_MAX || DataSize > Batch->stage->size)
+        return BATCH_UNFIT;
+    if (!PlanFileEntry(AnyfType, SubStream, Info, &Extents, &ExtentCount))
+        return BATCH_FAILED;
+    if (Extents)
+        free(Extents);
+    if (Info->extra.flags & ENTRY_SPARSE)
+        return BATCH_UNFIT;
+    BatchMakeRoom(AnyfType, Batch, Info, DataSize);
+    Data = Batch->stage->fdata + Batch->staged;
+    // 大小等于0的文件无需读取
+    AnyfThrottle(AnyfType->throttle, 0LL, 1LL);
+    if (Info->extra.codec != CODEC_NONE) {
+        if (fread(Batch->raw, (size_t)Info->fsize, 1, SubStream) != 1)
+            return BATCH_FAILED;
+        if (Info->extra.flags & ENTRY_CRC)
+            Info->extra.crc = AnyfCrc32c(CRC32C_INIT, Batch->raw, (size_t)Info->fsize);
+        Info->extra.stored = (int64_t)AnyfCodecEncode(AnyfCodecOf(Info->extra.codec), AnyfType->level, DictOf(AnyfType, Info), Batch->raw, (size_t)Info->fsize, Data);
+    } else if (Info->fsize > 0) {
+        if (fread(Data, (size_t)Info->fsize, 1, SubStream) != 1)
+            return BATCH_FAILED;
+        if (Info->extra.flags & ENTRY_CRC)
+            Info->extra.crc = AnyfCrc32c(CRC32C_INIT, Data, (size_t)Info->fsize);
+    }
+    if (!BatchPushHead(AnyfType, Batch, Info))
+        return BATCH_FAILED;
+    if (Info->extra.stored > 0) {
+        Batch->iov[Batch->vecs].base = Data;
+        Batch->iov[Batch->vecs++].length = (size_t)Info->extra.stored;
+        Batch->staged += Info->extra.stored;
+        Batch->bytes += Info->extra.stored;
+    }
+    return BATCH_QUEUED;
+}
+
+// 清空固实块，下一个成员加入时重新打开
+static void SolidReset(SOLID_T *Solid) {
+    Solid->first = -1LL;
+    Solid->members = 0LL;
+    Solid->used = 0LL;
+}
+
+// 压缩正在填充的固实块并写入 ANYF 文件当前位置，其后依次写入其成员及夹在其中的子文件信息
+// 失败时丢弃这些子文件：从子文件信息表末尾删除并将 ANYF 文件指针移回固实块起始处
+static bool SolidFlush(ANYF_T *AnyfType, SOLID_T *Solid, BUFFER_T *Chunk) {
+    const CODEC_T *Codec = AnyfCodecOf(AnyfType->codec);
+    INFO_T *Block;          // 固实块的子文件信息
+    char *Content;          // 固实块内容：成员数量、偏移量表和数据区域
+    BUFFER_T *Owned;
+    char *Work;
+    int64_t Start;          // 固实块在 ANYF 文件中的起始偏移量
+    int64_t Position = 0LL; // 成员数据在数据区域中的偏移量，写入时为已压缩的原始字节数
+    int64_t Slot = 0LL;
+    size_t RawSize, FrameSize;
+    bool Success = false;
+    if (Solid->first < 0LL)
+        return true;
+    Block = &AnyfType->sheet[Solid->first];
+    // 偏移量表紧贴在数据区域之前，与数据区域组成连续的固实块内容
+    Content = Solid->raw + SOLID_TABLE_MAX - (size_t)(Solid->members + 1) * sizeof(int64_t);
+    memcpy(Content, &Solid->members, sizeof(int64_t));
+    for (int64_t i = Solid->first + 1; i < AnyfType->head.count; ++i) {
+        if (!(AnyfType->sheet[i].extra.flags & ENTRY_SOLID))
+            continue;
+        memcpy(Content + (size_t)(++Slot) * sizeof(int64_t), &Position, sizeof(int64_t));
+        Position += AnyfType->sheet[i].fsize;
+    }
+    Block->fsize = (Solid->members + 1) * (int64_t)sizeof(int64_t) + Solid->used;
+    Block->fnlen = 1;
+    Block->fname[0] = EMPTY_CHAR;
+    InitExtra(AnyfType, Block);
+    Block->extra.xsize = (int16_t)EXTRA_CODEC_SIZE;
+    Block->extra.flags = ENTRY_BLOCK;
+    Block->extra.stored = 0LL;
+    Block->extra.codec = (int16_t)AnyfType->codec;
+    if ((Start = Block->offset = AnyfTell(AnyfType->handle)) < 0LL)
+        goto DiscardAndReturn;
+    if (!(Work = CodecWorkArea(Chunk, &Owned)))
+        goto DiscardAndReturn;
+    if (WriteEntryHead(AnyfType, Block)) {
+        for (Position = 0LL; Position < Block->fsize; Position += (int64_t)RawSize) {
+            RawSize = (size_t)(Block->fsize - Position < CODEC_BLOCK_SIZE ? Block->fsize - Position : CODEC_BLOCK_SIZE);
+            FrameSize = AnyfCodecEncode(Codec, AnyfType->level, NULL, Content + Position, RawSize, Work);
+            AnyfThrottle(AnyfType->throttle, (int64_t)FrameSize, 1LL);
+            if (fwrite(Work, FrameSize, 1, AnyfType->handle) != 1)
+                break;
+            Block->extra.stored += (int64_t)FrameSize;
+        }
+        Success = Position >= Block->fsize && RewriteExtra(AnyfType, Block);
+    }
+    GiveWorkArea(Owned);
+    for (int64_t i = Solid->first + 1; Success && i < AnyfType->head.count; ++i) {
+        if ((AnyfType->sheet[i].offset = AnyfTell(AnyfType->handle)) < 0LL) {
+            Success = false;
+            break;
+        }
+        if (AnyfType->sheet[i].extra.flags & ENTRY_SOLID)
+            AnyfType->sheet[i].extra.block = Start;
+        Success = WriteEntryHead(AnyfType, &AnyfType->sheet[i]);
+    }
+    if (Success) {
+        AnyfType->head.feat |= FEAT_SOLID | FEAT_CODEC;
+        ++Solid->blocks;
+        SolidReset(Solid);
+        return true;
+    }
+DiscardAndReturn:
+    printf(MESSAGE_WARN "跳过：写入固实块失败，丢弃其中的%" I64_SPECIFIER "个子文件\n", AnyfType->head.count - Solid->first - 1);
+    AnyfType->head.count = Solid->first;
+    if (Start >= 0LL)
+        AnyfSeek(AnyfType->handle, Start, SEEK_SET);
+    SolidReset(Solid);
+    return false;
+}
+
+// 尝试将已打开的子文件加入正在填充的固实块，子文件数据读入固实块的数据区域，其子文件信息由调用者排在信息表末尾
+// 没有正在填充的固实块时先写入已有的批次，再在信息表中为新的固实块占一个位置；固实块已满时先写入
+// 固实块打开期间的空文件不是成员，同样排在信息表末尾，与成员一起写入，保持子文件在 ANYF 文件中的顺序
+// 返回 BATCH_QUEUED 表示已加入，BATCH_UNFIT 表示不适合加入(较大或不可压缩的文件)，BATCH_FAILED 表示读取子文件失败
+static int SolidPushFile(ANYF_T *AnyfType, SOLID_T *Solid, BATCH_T *Batch, FILE *SubStream, INFO_T *Info, BUFFER_T *Chunk) {
+    InitExtra(AnyfType, Info);
+    Info->offset = -1LL;
+    if (Info->fsize <= 0) {
+        // 空文件不是成员，但与 PlanFileEntry 一样记录修改时间
+        if (AnyfType->head.feat & FEAT_EXTRA) {
+            Info->extra.xsize = (int16_t)EXTRA_SIZE;
+            if (!OsFileMtime(SubStream, &Info->extra.mtime))
+                Info->extra.flags |= ENTRY_MTIME;
+        }
+        return Solid->first < 0LL ? BATCH_UNFIT : BATCH_QUEUED;
+    }
+    if (Info->fsize > SOLID_ENTRY_MAX || !WorthCoding(SubStream, Info->fsize))
+        return BATCH_UNFIT;
+    if (Solid->first >= 0LL && (Solid->members >= SOLID_MEMBER_MAX || Solid->used + Info->fsize > AnyfType->solid))
+        SolidFlush(AnyfType, Solid, Chunk);
+    AnyfThrottle(AnyfType->throttle, Info->fsize, 1LL);
+    if (fread(Solid->raw + SOLID_TABLE_MAX + Solid->used, (size_t)Info->fsize, 1, SubStream) != 1)
+        return BATCH_FAILED;
+    if (Solid->first < 0LL) {
+        if (Batch)
+            BatchFlush(AnyfType, Batch);
+        if (AnyfType->cells - AnyfType->head.count < 2LL && !ExpandBOM(AnyfType, (size_t)AnyfType->head.count + 2ULL)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+        }
+        Solid->first = AnyfType->head.count++;
+    }
+    Info->extra.xsize = (int16_t)EXTRA_SIZE;
+    Info->extra.flags = ENTRY_SOLID | ENTRY_CRC;
+    if (!OsFileMtime(SubStream, &Info->extra.mtime))
+        Info->extra.flags |= ENTRY_MTIME;
+    Info->extra.stored = 0LL;
+    Info->extra.slot = (int32_t)Solid->members++;
+    Info->extra.crc = AnyfCrc32c(CRC32C_INIT, Solid->raw + SOLID_TABLE_MAX + Solid->used, (size_t)Info->fsize);
+    Solid->used += Info->fsize;
+    return BATCH_QUEUED;
+}
+
+// 持久化模式下，自上次写回起又写入了至少 WRITEBACK_STEP 字节时让系统开始写回这部分数据
+// 参数 pMark 为上次写回的结束位置，写回后更新为 ANYF 文件指针当前位置
+static void StreamWriteback(ANYF_T *AnyfType, int64_t *pMark) {
+    int64_t Position;
+    if (!AnyfType->durable)
+        return;
+    if ((Position = AnyfTell(AnyfType->handle)) < 0LL || Position - *pMark < WRITEBACK_STEP)
+        return;
+    if (!OsFileWriteback(AnyfType->handle, *pMark, Position - *pMark))
+        *pMark = Position;
+}
+
+// 记录路径所在的文件系统，已记录过的文件系统不重复记录
+static bool NoteFileSystem(FSREF_T **ppRefs, size_t *pCount, const char *Path) {
+    FSREF_T *RefsTemp;
+    uint64_t Device;
+    if (OsFileDevice(Path, &Device))
+        return false;
+    for (size_t i = 0; i < *pCount; ++i) {
+        if ((*ppRefs)[i].device == Device)
             return true;
-        } else if (SizeRead < 0ULL)
+    }
+    if (!(RefsTemp = realloc(*ppRefs, (*pCount + 1) * sizeof(FSREF_T))))
+        return false;
+    *ppRefs = RefsTemp;
+    if (!(RefsTemp[*pCount].path = malloc(strlen(Path) + 1)))
+        return false;
+    strcpy(RefsTemp[*pCount].path, Path);
+    RefsTemp[(*pCount)++].device = Device;
+    return true;
+}
+
+// 逐个同步记录的文件系统并释放记录
+static void SyncFileSystems(FSREF_T *Refs, size_t Count) {
+    for (size_t i = 0; i < Count; ++i) {
+        if (OsFileSyncFS(Refs[i].path))
+            printf(MESSAGE_WARN "同步文件系统失败：%s\n", Refs[i].path);
+        free(Refs[i].path);
+    }
+    free(Refs);
+}
+
+// 从 ANYF 文件的 Offset 偏移量处(稀疏文件数据块起始处)提取稀疏文件
+// 只写入有数据的区域，其余部分通过截断文件恢复为空洞
+// 按偏移量读取 ANYF 文件，多个线程可同时提取不同的子文件，pCrc 不为NULL时把子文件内容(含空洞)累加到 *pCrc 的 CRC32C 上
+// SubStream 为NULL时只读取不写入(只校验)，以下各 Unpack 函数相同
+static bool UnpackSparse(FILE *AnyfFileStream, int64_t Offset, FILE *SubStream, const INFO_T *Info, BUFFER_T *Chunk, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    EXTENT_T Extents[EXTENT_BATCH]; // 每次读入的部分区域表
+    int64_t ExtentCount = 0LL;      // 尚未处理的区域数量
+    int64_t MapOffset, DataOffset;  // 区域表和区域数据在 ANYF 文件中的当前读取位置
+    int64_t Covered = 0LL;          // 已计入校验值的子文件字节数
+    size_t Batch;
+    if (Info->extra.stored > 0) {
+        if (OsFilePRead(AnyfFileStream, &ExtentCount, sizeof(int64_t), Offset))
             return false;
-        if (fwrite((*BufferRW)->fdata, SizeRead, 1, AnyfFileStream) != 1)
+        if (ExtentCount < 0LL || ExtentCount > Info->extra.stored / (int64_t)sizeof(EXTENT_T))
             return false;
+        MapOffset = Offset + (int64_t)sizeof(int64_t);
+        DataOffset = MapOffset + ExtentCount * (int64_t)sizeof(EXTENT_T);
+    }
+    while (ExtentCount > 0LL) {
+        Batch = (size_t)(ExtentCount < EXTENT_BATCH ? ExtentCount : EXTENT_BATCH);
+        if (OsFilePRead(AnyfFileStream, Extents, Batch * sizeof(EXTENT_T), MapOffset))
+            return false;
+        for (size_t i = 0; i < Batch; ++i) {
+            if (Extents[i].offset < 0LL || Extents[i].length < 0LL || Extents[i].offset + Extents[i].length > Info->fsize)
+                return false;
+            if (SubStream && AnyfSeek(SubStream, Extents[i].offset, SEEK_SET))
+                return false;
+            if (pCrc)
+                *pCrc = AnyfCrc32cZeros(*pCrc, Extents[i].offset - Covered);
+            if (!CopyStreamAt(AnyfFileStream, DataOffset, SubStream, Extents[i].length, Chunk, Throttle, pCrc))
+                return false;
+            DataOffset += Extents[i].length;
+            Covered = Extents[i].offset + Extents[i].length;
+        }
+        MapOffset += (int64_t)(Batch * sizeof(EXTENT_T));
+        ExtentCount -= (int64_t)Batch;
+    }
+    if (pCrc)
+        *pCrc = AnyfCrc32cZeros(*pCrc, Info->fsize - Covered);
+    return !SubStream || !OsFileTruncate(SubStream, Info->fsize);
+}
+
+// 从 ANYF 文件的 Offset 偏移量处(压缩数据块起始处)逐段解压 Info 的数据块
+// Target 不为NULL时解压到 Target(至少 Info->fsize 字节)，否则经工作区 Work 写入子文件当前位置，SubStream 也为NULL时只解压不写入
+// Dict 为压缩时使用的字典，按偏移量读取 ANYF 文件，多个线程可同时解压，pCrc 不为NULL时把解压结果累加到 *pCrc 的 CRC32C 上
+static bool DecodeFrames(FILE *AnyfFileStream, int64_t Offset, const INFO_T *Info, const CODECDICT_T *Dict, char *Work, char *Target, FILE *SubStream, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    const CODEC_T *Codec = AnyfCodecOf(Info->extra.codec);
+    int32_t Header[2];        // 段头：原始字节数和段内数据字节数
+    int64_t End = Offset + Info->extra.stored;
+    int64_t Written = 0LL;    // 已解压的字节数
+    // 分块表不属于各段
+    if (Info->extra.flags & ENTRY_CHUNKED)
+        End -= ChunkCountOf(Info) * (int64_t)sizeof(int64_t);
+    char *Raw;                // 本段原始数据的位置
+    if (!Codec) {
+        printf(MESSAGE_WARN "本程序不支持此子文件的压缩方式：%d\n", Info->extra.codec);
+        return false;
     }
+    while (Offset < End) {
+        if (End - Offset < (int64_t)CODEC_FRAME_SIZE || OsFilePRead(AnyfFileStream, Header, CODEC_FRAME_SIZE, Offset))
+            return false;
+        Offset += (int64_t)CODEC_FRAME_SIZE;
+        if (Header[0] <= 0 || Header[0] > CODEC_BLOCK_SIZE || Header[1] <= 0 || Header[1] > Header[0] || Header[1] > End - Offset || Header[0] > Info->fsize - Written)
+            return false;
+        AnyfThrottle(Throttle, (int64_t)Header[1], 1LL);
+        Raw = Target ? Target + Written : Work;
+        // 按原样保存的段直接读入原始数据区
+        if (Header[1] == Header[0]) {
+            if (OsFilePRead(AnyfFileStream, Raw, (size_t)Header[0], Offset))
+                return false;
+        } else if (OsFilePRead(AnyfFileStream, Work + CODEC_BLOCK_SIZE, (size_t)Header[1], Offset) || !AnyfCodecDecode(Codec, Dict, Work + CODEC_BLOCK_SIZE, (size_t)Header[1], Raw, (size_t)Header[0])) {
+            return false;
+        }
+        if (pCrc)
+            *pCrc = AnyfCrc32c(*pCrc, Raw, (size_t)Header[0]);
+        if (!Target && SubStream && fwrite(Raw, (size_t)Header[0], 1, SubStream) != 1)
+            return false;
+        Offset += Header[1];
+        Written += Header[0];
+    }
+    return Written == Info->fsize;
+}
+
+// 从 ANYF 文件的 Offset 偏移量处(压缩数据块起始处)逐段解压子文件，写入子文件当前位置
+// 按偏移量读取 ANYF 文件，多个线程可同时提取不同的子文件，pCrc 不为NULL时把解压结果累加到 *pCrc 的 CRC32C 上
+static bool UnpackCoded(FILE *AnyfFileStream, int64_t Offset, FILE *SubStream, const INFO_T *Info, const CODECDICT_T *Dict, BUFFER_T *Chunk, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    BUFFER_T *Owned;
+    char *Work;
+    bool Success;
+    if (!(Work = CodecWorkArea(Chunk, &Owned)))
+        return false;
+    Success = DecodeFrames(AnyfFileStream, Offset, Info, Dict, Work, NULL, SubStream, Throttle, pCrc);
+    GiveWorkArea(Owned);
+    return Success;
+}
+
+// 解压数据块中 Position 偏移量处的一段到 Work 开头，该段应有 RawSize 字节原始数据且不超出数据块的 Limit 偏移量
+// 成功时 *pNext 为下一段在数据块中的偏移量，按偏移量读取 ANYF 文件，多个线程可同时解压
+static bool DecodeFrameAt(FILE *AnyfFileStream, const INFO_T *Info, const CODEC_T *Codec, const CODECDICT_T *Dict, int64_t Position, int64_t Limit, int64_t RawSize, char *Work, int64_t *pNext, THROTTLE_T *Throttle) {
+    int64_t DataOffset = DataOffsetOf(Info);
+    int32_t Header[2]; // 段头：原始字节数和段内数据字节数
+    if (Position < 0 || Position > Limit - (int64_t)CODEC_FRAME_SIZE || OsFilePRead(AnyfFileStream, Header, CODEC_FRAME_SIZE, DataOffset + Position))
+        return false;
+    Position += (int64_t)CODEC_FRAME_SIZE;
+    if (Header[0] != RawSize || Header[1] <= 0 || Header[1] > Header[0] || Header[1] > Limit - Position)
+        return false;
+    AnyfThrottle(Throttle, (int64_t)Header[1], 1LL);
+    if (Header[1] == Header[0]) {
+        if (OsFilePRead(AnyfFileStream, Work, (size_t)Header[0], DataOffset + Position))
+            return false;
+    } else if (OsFilePRead(AnyfFileStream, Work + CODEC_BLOCK_SIZE, (size_t)Header[1], DataOffset + Position) || !AnyfCodecDecode(Codec, Dict, Work + CODEC_BLOCK_SIZE, (size_t)Header[1], Work, (size_t)Header[0])) {
+        return false;
+    }
+    *pNext = Position + Header[1];
     return true;
 }
 
-// 大文件复制，从 ANYF 文件流复制到提取子文件时新建的子文件流
-static bool MainCopyToSub(FILE *AnyfFileStream, int64_t Offset, int64_t SizeToRead, FILE *SubStream, BUFFER_T **BufferRW) {
-    if (!ExpandBUF(BufferRW, BUF_SIZE_U))
+// 返回第 Index 个分块应有的原始字节数
+static inline int64_t ChunkSizeOf(const INFO_T *Info, int64_t Index) {
+    return Info->fsize - Index * CODEC_BLOCK_SIZE < CODEC_BLOCK_SIZE ? Info->fsize - Index * CODEC_BLOCK_SIZE : CODEC_BLOCK_SIZE;
+}
+
+// 按分块表解压子文件第 First 到 Last 之前的分块，写入子文件中各分块对应的位置
+// 按偏移量读写，多个线程可同时解压同一子文件的不同分块，pCrc 不为NULL时把这些分块的内容依次累加到 *pCrc 的 CRC32C 上
+static bool UnpackChunks(FILE *AnyfFileStream, const INFO_T *Info, const CODECDICT_T *Dict, int64_t First, int64_t Last, FILE *SubStream, BUFFER_T *Chunk, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    const CODEC_T *Codec = AnyfCodecOf(Info->extra.codec);
+    int64_t Table = Info->extra.stored - ChunkCountOf(Info) * (int64_t)sizeof(int64_t); // 分块表在数据块中的偏移量
+    int64_t Position, Next;   // 本段和下一段在数据块中的偏移量
+    BUFFER_T *Owned;
+    char *Work;
+    bool Success = false;
+    if (!Codec) {
+        printf(MESSAGE_WARN "本程序不支持此子文件的压缩方式：%d\n", Info->extra.codec);
+        return false;
+    }
+    if (!(Info->extra.flags & ENTRY_CHUNKED) || Table < 0 || First < 0 || First >= Last || Last > ChunkCountOf(Info))
         return false;
-    if (AnyfSeek(AnyfFileStream, Offset, SEEK_SET))
+    if (!(Work = CodecWorkArea(Chunk, &Owned)))
         return false;
-    while (SizeToRead >= BUF_SIZE_U) {
-        if (fread((*BufferRW)->fdata, BUF_SIZE_U, 1, AnyfFileStream) != 1)
+    for (int64_t i = First; i < Last; ++i) {
+        if (OsFilePRead(AnyfFileStream, &Position, sizeof(int64_t), DataOffsetOf(Info) + Table + i * (int64_t)sizeof(int64_t)))
+            goto FreeAndReturn;
+        if (!DecodeFrameAt(AnyfFileStream, Info, Codec, Dict, Position, Table, ChunkSizeOf(Info, i), Work, &Next, Throttle))
+            goto FreeAndReturn;
+        if (pCrc)
+            *pCrc = AnyfCrc32c(*pCrc, Work, (size_t)ChunkSizeOf(Info, i));
+        if (SubStream && OsFilePWrite(SubStream, Work, (size_t)ChunkSizeOf(Info, i), i * CODEC_BLOCK_SIZE))
+            goto FreeAndReturn;
+    }
+    Success = true;
+FreeAndReturn:
+    GiveWorkArea(Owned);
+    return Success;
+}
+
+// 读取并解压 Block 偏移量处的固实块到 View 中，检查成员数量和偏移量表的大小
+static bool LoadSolid(FILE *AnyfFileStream, int32_t Feat, int64_t Block, SOLIDVIEW_T *View, BUFFER_T *Chunk, THROTTLE_T *Throttle) {
+    INFO_T Info;
+    BUFFER_T *Owned;
+    char *Work, *RawTemp;
+    bool Success;
+    View->block = -1LL;
+    if (!ReadHeadAt(AnyfFileStream, Feat, Block, &Info) || !(Info.extra.flags & ENTRY_BLOCK))
+        return false;
+    if (Info.fsize < (int64_t)sizeof(int64_t) || Info.fsize > (int64_t)SOLID_TABLE_MAX + SOLID_BLOCK_MAX)
+        return false;
+    if (View->cells < Info.fsize) {
+        if (!(RawTemp = realloc(View->raw, (size_t)Info.fsize)))
             return false;
-        if (fwrite((*BufferRW)->fdata, BUF_SIZE_U, 1, SubStream) != 1)
+        View->raw = RawTemp;
+        View->cells = Info.fsize;
+    }
+    if (!(Work = CodecWorkArea(Chunk, &Owned)))
+        return false;
+    Success = DecodeFrames(AnyfFileStream, DataOffsetOf(&Info), &Info, NULL, Work, View->raw, NULL, Throttle, NULL);
+    GiveWorkArea(Owned);
+    if (!Success)
+        return false;
+    memcpy(&View->count, View->raw, sizeof(int64_t));
+    if (View->count < 0LL || View->count > SOLID_MEMBER_MAX || (View->count + 1) * (int64_t)sizeof(int64_t) > Info.fsize)
+        return false;
+    View->size = Info.fsize;
+    View->block = Block;
+    return true;
+}
+
+// 查找固实块成员的数据，所在固实块不是 View 中已解压的固实块时先解压
+// 成功返回成员数据在 View->raw 中的位置，失败返回NULL
+static const char *SolidDataOf(FILE *AnyfFileStream, int32_t Feat, const INFO_T *Info, SOLIDVIEW_T *View, BUFFER_T *Chunk, THROTTLE_T *Throttle) {
+    int64_t Start;     // 成员数据在数据区域中的偏移量
+    int64_t DataStart; // 数据区域在固实块内容中的偏移量
+    if (View->block != Info->extra.block && !LoadSolid(AnyfFileStream, Feat, Info->extra.block, View, Chunk, Throttle))
+        return NULL;
+    if (Info->extra.slot < 0 || Info->extra.slot >= View->count)
+        return NULL;
+    DataStart = (View->count + 1) * (int64_t)sizeof(int64_t);
+    memcpy(&Start, View->raw + (Info->extra.slot + 1) * sizeof(int64_t), sizeof(int64_t));
+    if (Start < 0LL || Info->fsize > View->size - DataStart - Start)
+        return NULL;
+    return View->raw + DataStart + Start;
+}
+
+// 从固实块中提取成员，写入子文件当前位置，所在固实块不是 View 中已解压的固实块时先解压
+// pCrc 不为NULL时把成员数据累加到 *pCrc 的 CRC32C 上
+static bool UnpackSolid(FILE *AnyfFileStream, int32_t Feat, FILE *SubStream, const INFO_T *Info, SOLIDVIEW_T *View, BUFFER_T *Chunk, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    const char *Data = SolidDataOf(AnyfFileStream, Feat, Info, View, Chunk, Throttle);
+    if (!Data)
+        return false;
+    if (pCrc && Info->fsize > 0)
+        *pCrc = AnyfCrc32c(*pCrc, Data, (size_t)Info->fsize);
+    AnyfThrottle(Throttle, 0LL, 1LL);
+    return Info->fsize <= 0 || !SubStream || fwrite(Data, (size_t)Info->fsize, 1, SubStream) == 1;
+}
+
+// 交出范围内的一段数据：Buffer 不为NULL时复制到 Buffer 的 At 偏移量处，否则写入子文件当前位置
+// Data 为NULL表示全0的一段(稀疏文件的空洞)，写入子文件时只移动文件指针
+static bool PutRange(char *Buffer, FILE *SubStream, int64_t At, const void *Data, size_t Size) {
+    if (Buffer) {
+        if (Data)
+            memcpy(Buffer + At, Data, Size);
+        else
+            memset(Buffer + At, 0, Size);
+        return true;
+    }
+    if (!Data)
+        return !AnyfSeek(SubStream, At + (int64_t)Size, SEEK_SET);
+    return !Size || fwrite(Data, Size, 1, SubStream) == 1;
+}
+
+// 把 ANYF 文件 From 偏移量处的 Size 字节按原样交出，交给 Buffer 时只读一次
+static bool CopyRangeAt(FILE *AnyfFileStream, int64_t From, char *Buffer, FILE *SubStream, int64_t At, int64_t Size, BUFFER_T *Chunk, THROTTLE_T *Throttle) {
+    if (!Buffer)
+        return CopyStreamAt(AnyfFileStream, From, SubStream, Size, Chunk, Throttle, NULL);
+    AnyfThrottle(Throttle, Size, 1LL);
+    return Size <= 0 || !OsFilePRead(AnyfFileStream, Buffer + At, (size_t)Size, From);
+}
+
+// 读取稀疏子文件中从 Offset 起的 Length 字节，区域表之外的部分为0
+static bool RangeSparse(FILE *AnyfFileStream, const INFO_T *Info, int64_t Offset, int64_t Length, char *Buffer, FILE *SubStream, BUFFER_T *Chunk, THROTTLE_T *Throttle) {
+    EXTENT_T Extents[EXTENT_BATCH]; // 每次读入的部分区域表
+    int64_t ExtentCount = 0LL;      // 尚未处理的区域数量
+    int64_t MapOffset, DataOffset;  // 区域表和区域数据在 ANYF 文件中的当前读取位置
+    int64_t Position = Offset;      // 子文件中已交出的位置
+    int64_t End = Offset + Length, Until;
+    size_t Batch;
+    if (Info->extra.stored > 0) {
+        if (OsFilePRead(AnyfFileStream, &ExtentCount, sizeof(int64_t), DataOffsetOf(Info)))
             return false;
-        if ((SizeToRead -= BUF_SIZE_U) < BUF_SIZE_U) {
-            if (SizeToRead > 0LL) {
-                if (fread((*BufferRW)->fdata, SizeToRead, 1, AnyfFileStream) != 1)
-                    return false;
-                if (fwrite((*BufferRW)->fdata, SizeToRead, 1, SubStream) != 1)
+        if (ExtentCount < 0LL || ExtentCount > Info->extra.stored / (int64_t)sizeof(EXTENT_T))
+            return false;
+        MapOffset = DataOffsetOf(Info) + (int64_t)sizeof(int64_t);
+        DataOffset = MapOffset + ExtentCount * (int64_t)sizeof(EXTENT_T);
+    }
+    while (ExtentCount > 0LL && Position < End) {
+        Batch = (size_t)(ExtentCount < EXTENT_BATCH ? ExtentCount : EXTENT_BATCH);
+        if (OsFilePRead(AnyfFileStream, Extents, Batch * sizeof(EXTENT_T), MapOffset))
+            return false;
+        for (size_t i = 0; i < Batch && Position < End; ++i) {
+            if (Extents[i].offset < 0LL || Extents[i].length < 0LL || Extents[i].offset + Extents[i].length > Info->fsize)
+                return false;
+            if (Extents[i].offset + Extents[i].length > Position && Extents[i].offset < End) {
+                if (Extents[i].offset > Position) {
+                    if (!PutRange(Buffer, SubStream, Position - Offset, NULL, (size_t)(Extents[i].offset - Position)))
+                        return false;
+                    Position = Extents[i].offset;
+                }
+                Until = Extents[i].offset + Extents[i].length < End ? Extents[i].offset + Extents[i].length : End;
+                if (!CopyRangeAt(AnyfFileStream, DataOffset + (Position - Extents[i].offset), Buffer, SubStream, Position - Offset, Until - Position, Chunk, Throttle))
                     return false;
+                Position = Until;
             }
-            return true;
+            DataOffset += Extents[i].length;
         }
+        MapOffset += (int64_t)(Batch * sizeof(EXTENT_T));
+        ExtentCount -= (int64_t)Batch;
+    }
+    return Position >= End || PutRange(Buffer, SubStream, Position - Offset, NULL, (size_t)(End - Position));
+}
+
+// 读取压缩子文件中从 Offset 起的 Length 字节，只解压与范围重叠的分块
+// 有分块表时直接定位各分块，没有分块表时(较早的 ANYF 文件)逐个读段头跳过之前的段
+static bool RangeCoded(FILE *AnyfFileStream, const INFO_T *Info, const CODECDICT_T *Dict, int64_t Offset, int64_t Length, char *Buffer, FILE *SubStream, BUFFER_T *Chunk, THROTTLE_T *Throttle) {
+    const CODEC_T *Codec = AnyfCodecOf(Info->extra.codec);
+    int64_t Limit = Info->extra.stored; // 各段在数据块中的结束位置
+    int64_t Position = 0LL, Next;       // 本段和下一段在数据块中的偏移量
+    int64_t Walked = 0LL;               // 没有分块表时 Position 所在段的下标
+    int64_t From, Until;                // 范围在本段原始数据中的部分
+    int32_t Header[2];
+    BUFFER_T *Owned;
+    char *Work;
+    bool Success = false;
+    if (!Codec) {
+        printf(MESSAGE_WARN "本程序不支持此子文件的压缩方式：%d\n", Info->extra.codec);
+        return false;
     }
+    if (Info->extra.flags & ENTRY_CHUNKED)
+        Limit -= ChunkCountOf(Info) * (int64_t)sizeof(int64_t);
+    if (Limit < 0)
+        return false;
+    if (!(Work = CodecWorkArea(Chunk, &Owned)))
+        return false;
+    for (int64_t i = Offset / CODEC_BLOCK_SIZE; i * CODEC_BLOCK_SIZE < Offset + Length; ++i) {
+        if (Info->extra.flags & ENTRY_CHUNKED) {
+            if (OsFilePRead(AnyfFileStream, &Position, sizeof(int64_t), DataOffsetOf(Info) + Limit + i * (int64_t)sizeof(int64_t)))
+                goto FreeAndReturn;
+        } else {
+            for (; Walked < i; ++Walked) {
+                if (Position > Limit - (int64_t)CODEC_FRAME_SIZE || OsFilePRead(AnyfFileStream, Header, CODEC_FRAME_SIZE, DataOffsetOf(Info) + Position))
+                    goto FreeAndReturn;
+                if (Header[0] != CODEC_BLOCK_SIZE || Header[1] <= 0 || Header[1] > Header[0])
+                    goto FreeAndReturn;
+                Position += (int64_t)CODEC_FRAME_SIZE + Header[1];
+            }
+        }
+        if (!DecodeFrameAt(AnyfFileStream, Info, Codec, Dict, Position, Limit, ChunkSizeOf(Info, i), Work, &Next, Throttle))
+            goto FreeAndReturn;
+        From = Offset > i * CODEC_BLOCK_SIZE ? Offset - i * CODEC_BLOCK_SIZE : 0LL;
+        Until = Offset + Length < (i + 1) * CODEC_BLOCK_SIZE ? Offset + Length - i * CODEC_BLOCK_SIZE : ChunkSizeOf(Info, i);
+        if (!PutRange(Buffer, SubStream, i * CODEC_BLOCK_SIZE + From - Offset, Work + From, (size_t)(Until - From)))
+            goto FreeAndReturn;
+        Position = Next;
+        Walked = i + 1;
+    }
+    Success = true;
+FreeAndReturn:
+    GiveWorkArea(Owned);
+    return Success;
+}
+
+// 读取子文件中从 Offset 起的 Length 字节，超出子文件末尾的部分不读
+// Buffer 不为NULL时读入 Buffer，否则写入子文件当前位置，View 为逐个读取时已解压的固实块
+// 成功返回读取的字节数，范围无效或读取失败返回-1
+static int64_t ReadRange(ANYF_T *AnyfType, const INFO_T *Info, int64_t Offset, int64_t Length, char *Buffer, FILE *SubStream, BUFFER_T *Chunk, SOLIDVIEW_T *View) {
+    const char *Data;
+    bool Success;
+    if (Info->fsize < 0 || Offset < 0 || Length < 0 || Offset > Info->fsize) {
+        printf(MESSAGE_WARN "读取范围超出子文件大小：%s\n", Info->fname);
+        return -1LL;
+    }
+    if (Length > Info->fsize - Offset)
+        Length = Info->fsize - Offset;
+    if (!Length)
+        return 0LL;
+    if (Info->extra.flags & ENTRY_SPARSE) {
+        Success = RangeSparse(AnyfType->handle, Info, Offset, Length, Buffer, SubStream, Chunk, AnyfType->throttle);
+        // 末尾的空洞只移动了文件指针
+        if (Success && !Buffer)
+            Success = !OsFileTruncate(SubStream, Length);
+    } else if (Info->extra.flags & ENTRY_SOLID) {
+        Success = (Data = SolidDataOf(AnyfType->handle, AnyfType->head.feat, Info, View, Chunk, AnyfType->throttle)) && PutRange(Buffer, SubStream, 0LL, Data + Offset, (size_t)Length);
+    } else if (Info->extra.codec != CODEC_NONE) {
+        Success = RangeCoded(AnyfType->handle, Info, DictOf(AnyfType, Info), Offset, Length, Buffer, SubStream, Chunk, AnyfType->throttle);
+    } else {
+        Success = CopyRangeAt(AnyfType->handle, DataOffsetOf(Info) + Offset, Buffer, SubStream, 0LL, Length, Chunk, AnyfType->throttle);
+    }
+    return Success ? Length : -1LL;
+}
+
+// 判断子文件的数据块是否按原样连续保存(不是稀疏文件、压缩的子文件或固实块成员)
+static inline bool IsStoredAsIs(const INFO_T *Info) {
+    return !(Info->extra.flags & (ENTRY_SPARSE | ENTRY_SOLID)) && Info->extra.codec == CODEC_NONE;
+}
+
+// 判断子文件是否要提取，参数 Wanted 为NULL时提取全部子文件，作废的子文件和未完成的预留区域总是跳过
+// WIN平台的 Wanted 应已转为全小写
+static bool IsWanted(const INFO_T *Info, const char *Wanted) {
+    if (Info->extra.flags & ENTRY_SKIP)
+        return false;
+    if (!Wanted)
+        return true;
+#ifdef _WIN32
+    char NormcasedName[PATH_MAX_SIZE];
+    strcpy(NormcasedName, Info->fname);
+    return !strcmp(Wanted, OsPathNormcase(NormcasedName));
+#else
+    return !strcmp(Wanted, Info->fname);
+#endif // _WIN32
+}
+
+// 从第 Index 个子文件起向后查找可以一次读入的连续子文件数据块
+// 只合并要提取的、按原样保存的子文件(目录没有数据块，可以夹在其中)，读入的总字节数不超过 Limit
+// 稀疏文件、压缩的子文件和固实块成员结束合并
+// 返回合并读取的结束偏移量，*pEntries 为其中的子文件数量
+static int64_t SpanEndOf(const ANYF_T *AnyfType, int64_t Index, const char *Wanted, int64_t Limit, int64_t *pEntries) {
+    const INFO_T *Info;
+    int64_t SpanStart = DataOffsetOf(&AnyfType->sheet[Index]);
+    int64_t SpanEnd = SpanStart;
+    *pEntries = 0LL;
+    for (; Index < AnyfType->head.count; ++Index) {
+        Info = &AnyfType->sheet[Index];
+        if (!IsWanted(Info, Wanted))
+            break;
+        if (Info->fsize < 0)
+            continue;
+        if (!IsStoredAsIs(Info) || DataOffsetOf(Info) < SpanEnd)
+            break;
+        if (DataOffsetOf(Info) + Info->fsize - SpanStart > Limit)
+            break;
+        SpanEnd = DataOffsetOf(Info) + Info->fsize;
+        ++*pEntries;
+    }
+    return SpanEnd;
+}
+
+// 创建目录子文件，持久化模式下记录目录所在的文件系统
+// 新创建了目录返回 true，目录已存在或无法创建返回 false
+static bool UnpackDirectory(ANYF_T *AnyfType, const INFO_T *Info, const char *SubFilePath, FSREF_T **ppRefs, size_t *pCount) {
+    if (OsPathExists(SubFilePath)) {
+        if (OsPathIsDirectory(Info->fname))
+            return false;
+        printf(MESSAGE_WARN "跳过：目录名称已被文件占用s\n");
+        return false;
+    }
+    if (OsPathMakeDIR(SubFilePath)) {
+        printf(MESSAGE_WARN "跳过：无法在此位置创建目录\n");
+        return false;
+    }
+    if (AnyfType->durable && !NoteFileSystem(ppRefs, pCount, SubFilePath))
+        printf(MESSAGE_WARN "记录目录所在文件系统失败：%s\n", SubFilePath);
+    return true;
+}
+
+// 检查子文件的保存路径是否可用，父级目录不存在时创建，父级路径写入 Pardir
+// 可以创建子文件时返回 true，否则打印原因并返回 false
+static bool PrepareSubPath(const char *SubFilePath, int Overwrite, char *Pardir) {
+    if (OsPathExists(SubFilePath)) {
+        if (OsPathIsDirectory(SubFilePath)) {
+            printf(MESSAGE_WARN "跳过：文件路径已被目录占用：%s\n", SubFilePath);
+            return false;
+        }
+        if (!Overwrite) {
+            printf(MESSAGE_WARN "跳过：文件已存在但不允许覆盖：%s\n", SubFilePath);
+            return false;
+        }
+    }
+    if (!OsPathDirName(Pardir, PATH_MAX_SIZE, SubFilePath)) {
+        printf(MESSAGE_WARN "跳过：获取父级路径失败\n");
+        return false;
+    }
+    if (OsPathExists(Pardir)) {
+        if (OsPathIsFile(Pardir)) {
+            printf(MESSAGE_WARN "跳过：目录路径已被文件占用：%s\n", Pardir);
+            return false;
+        }
+    } else {
+        if (OsPathMakeDIR(Pardir)) {
+            printf(MESSAGE_WARN "跳过：目录创建失败：%s\n", Pardir);
+        }
+    }
+    return true;
+}
+
+// 按 AnyfType->update 判断保存路径处是否已有与子文件相同的文件，相同时不必提取
+// 修改时间只精确到秒的文件系统上，整秒的修改时间与子文件记录的修改时间在同一秒内即视为相同
+// 需要比较内容时把目标文件读入 Chunk 计算 CRC32C，此时 *pUsed 置为 true 表示 Chunk 原有的内容已被覆盖
+static bool IsCurrent(const ANYF_T *AnyfType, const INFO_T *Info, const char *SubFilePath, BUFFER_T *Chunk, bool *pUsed) {
+    FILE *Existing;  // 已有的目标文件
+    int64_t Size, Mtime, Remain;
+    size_t SizeOnce;
+    uint32_t Crc = CRC32C_INIT;
+    if (AnyfType->update == UPDATE_NONE || OsFileStat(SubFilePath, &Size, &Mtime) || Size != Info->fsize)
+        return false;
+    if (Info->fsize == 0LL)
+        return true;
+    if (AnyfType->update == UPDATE_MTIME && (Info->extra.flags & ENTRY_MTIME))
+        return Mtime == Info->extra.mtime || (Mtime % 1000000000LL == 0LL && Mtime == Info->extra.mtime - Info->extra.mtime % 1000000000LL);
+    if (!(Info->extra.flags & ENTRY_CRC) || !(Existing = fopen(SubFilePath, "rb")))
+        return false;
+    *pUsed = true;
+    for (Remain = Size; Remain > 0LL; Remain -= (int64_t)SizeOnce) {
+        SizeOnce = (size_t)(Remain < Chunk->size ? Remain : Chunk->size);
+        if (fread(Chunk->fdata, SizeOnce, 1, Existing) != 1)
+            break;
+        Crc = AnyfCrc32c(Crc, Chunk->fdata, SizeOnce);
+    }
+    fclose(Existing);
+    return Remain == 0LL && Crc == Info->extra.crc;
+}
+
+// 比较两个子文件名，WIN平台不区分大小写
+static int CompareSubName(const char *Left, const char *Right) {
+#ifdef _WIN32
+    return _stricmp(Left, Right);
+#else
+    return strcmp(Left, Right);
+#endif // _WIN32
+}
+
+// 按在信息表中的先后排列并行提取任务，同一子文件的多个任务按分块顺序排列
+static int CompareJobIndex(const void *Left, const void *Right) {
+    const COPYJOB_T *JobL = Left, *JobR = Right;
+    if (JobL->index != JobR->index)
+        return (JobL->index > JobR->index) - (JobL->index < JobR->index);
+    return (JobL->first > JobR->first) - (JobL->first < JobR->first);
+}
+
+// 按子文件名排列并行提取任务，同名的按在信息表中的先后排列
+static int CompareJobName(const void *Left, const void *Right) {
+    const COPYJOB_T *JobL = Left, *JobR = Right;
+    int Result = CompareSubName(JobL->name, JobR->name);
+    if (Result)
+        return Result;
+    return CompareJobIndex(Left, Right);
+}
+
+// 按数据块从大到小排列并行提取任务，大文件先开始，避免最后只剩一个线程在复制大文件
+static int CompareJobSize(const void *Left, const void *Right) {
+    const COPYJOB_T *JobL = Left, *JobR = Right;
+    if (JobL->size != JobR->size)
+        return JobL->size < JobR->size ? 1 : -1;
+    return CompareJobIndex(Left, Right);
+}
+
+// 用最多 AnyfType->jobs 个线程执行任务表中的全部任务，第0个线程由主线程担任并使用 BufferRW
+// 其余线程各从缓冲池取一个独占的缓冲块，缓冲块或线程不足时减少线程数
+// 返回时全部线程均已结束，各线程统计的条目数和字节数累加到 *pEntries 和 *pBytes
+static void RunCopyWorkers(COPYSHARE_T *Share, OSTHREAD_ROUTINE Routine, BUFPOOL_T *Pool, BUFFER_T *BufferRW, int64_t *pEntries, int64_t *pBytes) {
+    COPYWORKER_T *Workers;
+    size_t WorkerCount, Started;
+    WorkerCount = (size_t)Share->anyf->jobs < Share->count ? (size_t)Share->anyf->jobs : Share->count;
+    if (WorkerCount < 1ULL)
+        WorkerCount = 1ULL;
+    if (!(Workers = malloc(WorkerCount * sizeof(COPYWORKER_T)))) {
+        PRINT_ERROR_AND_ABORT("为并行线程分配内存失败");
+    }
+    Share->next = 0ULL;
+    Share->failed = false;
+    if (OsMutexInit(&Share->lock)) {
+        PRINT_ERROR_AND_ABORT("初始化互斥锁失败");
+    }
+    memset(Workers, 0, WorkerCount * sizeof(COPYWORKER_T));
+    Workers[0].share = Share;
+    Workers[0].chunk = BufferRW;
+    for (Started = 1ULL; Started < WorkerCount; ++Started) {
+        Workers[Started].share = Share;
+        if (!(Workers[Started].chunk = AnyfPoolTake(Pool)))
+            break;
+        if (OsThreadCreate(&Workers[Started].thread, Routine, &Workers[Started])) {
+            AnyfPoolGive(Pool, Workers[Started].chunk);
+            break;
+        }
+    }
+    if (Started < WorkerCount)
+        printf(MESSAGE_WARN "缓冲块或线程不足，只使用 %" I64_SPECIFIER " 个线程\n", (int64_t)Started);
+    Routine(&Workers[0]);
+    for (size_t i = 0; i < Started; ++i) {
+        if (i > 0) {
+            OsThreadJoin(Workers[i].thread);
+            AnyfPoolGive(Pool, Workers[i].chunk);
+        }
+        *pEntries += Workers[i].entries;
+        *pBytes += Workers[i].bytes;
+    }
+    OsMutexDestroy(&Share->lock);
+    free(Workers);
+}
+
+// 返回从第 First 个任务起属于同一固实块的连续任务的结束下标，不是固实块成员的任务自成一组
+static size_t SolidGroupEnd(const COPYSHARE_T *Share, size_t First) {
+    const INFO_T *Sheet = Share->anyf->sheet;
+    const INFO_T *Head = &Sheet[Share->jobs[First].index];
+    size_t End = First + 1;
+    if (!(Head->extra.flags & ENTRY_SOLID))
+        return End;
+    while (End < Share->count && (Sheet[Share->jobs[End].index].extra.flags & ENTRY_SOLID) && Sheet[Share->jobs[End].index].extra.block == Head->extra.block)
+        ++End;
+    return End;
+}
+
+// 返回并行提取任务写入的子文件字节数，分块并行解压的子文件的任务只负责其中的一部分
+static inline int64_t JobLengthOf(const COPYJOB_T *Job, const INFO_T *Info) {
+    if (!Job->last)
+        return Info->fsize;
+    return (Job->last * CODEC_BLOCK_SIZE < Info->fsize ? Job->last * CODEC_BLOCK_SIZE : Info->fsize) - Job->first * CODEC_BLOCK_SIZE;
+}
+
+// 并行提取的线程函数，逐个领取任务直到任务表为空
+// 所有路径检查已在主线程中完成，这里只创建并写入子文件，带校验值的子文件由主线程在全部任务完成后校验
+// 任务的 path 为NULL时只读取和解压子文件数据，不写入任何文件(只校验)
+static void ExtractWorker(void *Argument) {
+    COPYWORKER_T *Worker = Argument;
+    COPYSHARE_T *Share = Worker->share;
+    ANYF_T *AnyfType = Share->anyf;
+    COPYJOB_T *Job;
+    const INFO_T *Info;
+    uint32_t *pCrc;
+    FILE *SubStream;
+    SOLIDVIEW_T View = {-1LL, NULL, 0LL, 0LL, 0LL}; // 此线程已解压的固实块
+    size_t Next = 0ULL, Last = 0ULL;               // 已领取但尚未提取的任务下标范围
+    int64_t Offset, Length;                        // 本任务写入的子文件区域
+    bool Success;
+    for (;;) {
+        // 同一固实块的成员一次全部领取，每个固实块只由一个线程解压一次
+        if (Next == Last) {
+            OsMutexLock(&Share->lock);
+            Next = Last = Share->next;
+            if (Last < Share->count)
+                Last = SolidGroupEnd(Share, Last);
+            Share->next = Last;
+            OsMutexUnlock(&Share->lock);
+            if (Next == Last)
+                break;
+        }
+        Job = &Share->jobs[Next++];
+        Info = &AnyfType->sheet[Job->index];
+        // 分块并行解压的子文件已由主线程创建，各任务只写入自己的分块
+        SubStream = NULL;
+        if (Job->path && !(SubStream = fopen(Job->path, Job->last ? "r+b" : "wb"))) {
+            printf(MESSAGE_WARN "跳过：子文件创建失败：%s\n", Job->path);
+            continue;
+        }
+        Offset = Job->first * CODEC_BLOCK_SIZE;
+        Length = JobLengthOf(Job, Info);
+        pCrc = (Info->extra.flags & ENTRY_CRC) ? &Job->crc : NULL;
+        Job->crc = CRC32C_INIT;
+        if (Job->last)
+            Success = UnpackChunks(AnyfType->handle, Info, DictOf(AnyfType, Info), Job->first, Job->last, SubStream, Worker->chunk, AnyfType->throttle, pCrc);
+        else if (Info->extra.flags & ENTRY_SPARSE)
+            Success = UnpackSparse(AnyfType->handle, DataOffsetOf(Info), SubStream, Info, Worker->chunk, AnyfType->throttle, pCrc);
+        else if (Info->extra.flags & ENTRY_SOLID)
+            Success = UnpackSolid(AnyfType->handle, AnyfType->head.feat, SubStream, Info, &View, Worker->chunk, AnyfType->throttle, pCrc);
+        else if (Info->extra.codec != CODEC_NONE)
+            Success = UnpackCoded(AnyfType->handle, DataOffsetOf(Info), SubStream, Info, DictOf(AnyfType, Info), Worker->chunk, AnyfType->throttle, pCrc);
+        else
+            Success = CopyStreamAt(AnyfType->handle, DataOffsetOf(Info), SubStream, Info->fsize, Worker->chunk, AnyfType->throttle, pCrc);
+        if (!Success) {
+            if (SubStream)
+                fclose(SubStream);
+            printf(MESSAGE_WARN "跳过：%s子文件数据失败：%s\n", SubStream ? "写入" : "读取", Job->path ? Job->path : Job->name);
+            continue;
+        }
+        if (SubStream && AnyfType->durable) {
+#ifdef _WIN32
+            if (OsFileSyncData(SubStream))
+                printf(MESSAGE_WARN "同步子文件数据失败：%s\n", Job->path);
+#else
+            OsFileWriteback(SubStream, Offset, Length);
+#endif // _WIN32
+        }
+        if (SubStream)
+            fclose(SubStream);
+        Job->done = true;
+        if (!Job->first)
+            ++Worker->entries;
+        Worker->bytes += Length;
+    }
+    if (View.raw)
+        free(View.raw);
+}
+
+// 并行任务全部结束后校验带校验值的子文件，同一子文件的任务按分块顺序拼接各任务的校验值再与记录的比较
+// 不符的子文件从成功的条目中扣除，计入校验失败，任务表按信息表顺序重新排列
+// 提取完整且内容无误的子文件恢复打包时记录的修改时间
+static void CheckJobs(ANYF_T *AnyfType, COPYJOB_T *Jobs, size_t Count) {
+    const INFO_T *Info;
+    size_t Start, Started;
+    uint32_t Crc; // 子文件各任务拼接得到的校验值
+    bool Whole;   // 子文件的全部任务均已完成
+    qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobIndex);
+    for (Start = 0ULL; Start < Count; Start = Started) {
+        Info = &AnyfType->sheet[Jobs[Start].index];
+        Crc = Jobs[Start].crc;
+        Whole = Jobs[Start].done;
+        for (Started = Start + 1; Started < Count && Jobs[Started].index == Jobs[Start].index; ++Started) {
+            Whole = Whole && Jobs[Started].done;
+            Crc = AnyfCrc32cCombine(Crc, Jobs[Started].crc, JobLengthOf(&Jobs[Started], Info));
+        }
+        if (Whole && (Info->extra.flags & ENTRY_CRC) && Crc != Info->extra.crc) {
+            printf(MESSAGE_WARN "子文件内容与校验值不符：%s\n", Jobs[Start].path ? Jobs[Start].path : Jobs[Start].name);
+            --AnyfType->stats.entries;
+            ++AnyfType->stats.corrupted;
+        } else if (Whole && Jobs[Start].path && (Info->extra.flags & ENTRY_MTIME) && OsFileSetMtime(Jobs[Start].path, Info->extra.mtime)) {
+            printf(MESSAGE_WARN "恢复子文件修改时间失败：%s\n", Jobs[Start].path);
+        }
+    }
+}
+
+// 用 AnyfType->jobs 个线程并行提取子文件
+// 主线程先按信息表顺序创建全部目录并检查每个子文件的保存路径，再把子文件按大小分配给各线程
+// 同名子文件只提取一次，结果与逐个提取相同：允许覆盖时保留最后一个，否则保留第一个
+// 带分块表的子文件拆成多个任务，各线程同时解压不同的分块
+// 每个线程独占一个缓冲块，缓冲池不足时减少线程数，BufferRW 由调用者取出和归还
+static void ExtractParallel(ANYF_T *AnyfType, const char *Wanted, const char *Destination, int Overwrite, BUFPOOL_T *Pool, BUFFER_T *BufferRW, FSREF_T **ppRefs, size_t *pCount) {
+    char SubFilePath[PATH_MAX_SIZE];
+    char SubFilePardir[PATH_MAX_SIZE];
+    COPYSHARE_T Share;
+    COPYJOB_T *Jobs, *JobsTemp;
+    const INFO_T *Info;
+    FILE *SubStream;
+    size_t Count = 0ULL, Kept, Start, Started;
+    size_t Capacity = (size_t)(AnyfType->head.count > 0 ? AnyfType->head.count : 1);
+    int64_t Parts, Chunks, Rejected = -1LL;
+    bool Reread = false; // BufferRW 在此之后才由各线程使用，不必关心其内容是否被覆盖
+    if (!(Jobs = malloc(Capacity * sizeof(COPYJOB_T)))) {
+        PRINT_ERROR_AND_ABORT("为并行提取任务表分配内存失败");
+    }
+    // 目录先于所有子文件创建
+    for (int64_t Index = 0; Index < AnyfType->head.count; ++Index) {
+        Info = &AnyfType->sheet[Index];
+        if (!IsWanted(Info, Wanted))
+            continue;
+        printf(MESSAGE_INFO "提取：%s\n", Info->fname);
+        if (OsPathJoinPath(SubFilePath, PATH_MAX_SIZE, 2, Destination, Info->fname)) {
+            printf(MESSAGE_WARN "跳过：拼接子文件完整路径失败\n");
+            continue;
+        }
+        if (Info->fsize < 0) {
+            if (UnpackDirectory(AnyfType, Info, SubFilePath, ppRefs, pCount))
+                ++AnyfType->stats.entries;
+            continue;
+        }
+        Chunks = Info->extra.flags & ENTRY_CHUNKED ? ChunkCountOf(Info) : 0LL;
+        Parts = Chunks < (int64_t)AnyfType->jobs ? Chunks : (int64_t)AnyfType->jobs;
+        if (Parts < 1LL)
+            Parts = 1LL;
+        if (Count + (size_t)Parts > Capacity) {
+            Capacity = (Count + (size_t)Parts) * 2;
+            if (!(JobsTemp = realloc(Jobs, Capacity * sizeof(COPYJOB_T)))) {
+                PRINT_ERROR_AND_ABORT("为并行提取任务表分配内存失败");
+            }
+            Jobs = JobsTemp;
+        }
+        for (int64_t Part = 0; Part < Parts; ++Part) {
+            if (!(Jobs[Count].path = malloc(strlen(SubFilePath) + 1))) {
+                PRINT_ERROR_AND_ABORT("为子文件路径分配内存失败");
+            }
+            strcpy(Jobs[Count].path, SubFilePath);
+            Jobs[Count].index = Index;
+            // 固实块成员排在所有其他子文件之后，按信息表顺序排列，同一固实块的成员相邻
+            Jobs[Count].size = Info->extra.flags & ENTRY_SOLID ? -1LL : Info->extra.stored / Parts;
+            Jobs[Count].first = Parts > 1LL ? Chunks * Part / Parts : 0LL;
+            Jobs[Count].last = Parts > 1LL ? Chunks * (Part + 1) / Parts : 0LL;
+            Jobs[Count].done = false;
+            Jobs[Count++].name = Info->fname;
+        }
+    }
+    // 同名子文件只保留一个
+    qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobName);
+    for (Start = Kept = 0ULL; Start < Count; Start = Started) {
+        for (Started = Start + 1; Started < Count && !CompareSubName(Jobs[Start].name, Jobs[Started].name); ++Started)
+            ;
+        for (size_t i = Start; i < Started; ++i) {
+            if (Jobs[i].index == Jobs[Overwrite ? Started - 1 : Start].index) {
+                Jobs[Kept++] = Jobs[i];
+                continue;
+            }
+            if (!Overwrite && !Jobs[i].first)
+                printf(MESSAGE_WARN "跳过：文件已存在但不允许覆盖：%s\n", Jobs[i].path);
+            free(Jobs[i].path);
+        }
+    }
+    // 按信息表顺序检查保存路径
+    qsort(Jobs, Kept, sizeof(COPYJOB_T), CompareJobIndex);
+    // 同一子文件的多个任务只在第一个任务处检查一次，检查未通过的子文件的其余任务一并跳过
+    for (Start = Count = 0ULL; Start < Kept; ++Start) {
+        if (Jobs[Start].index == Rejected) {
+            free(Jobs[Start].path);
+            continue;
+        }
+        if (!Jobs[Start].first && IsCurrent(AnyfType, &AnyfType->sheet[Jobs[Start].index], Jobs[Start].path, BufferRW, &Reread)) {
+            printf(MESSAGE_INFO "跳过：文件已是最新：%s\n", Jobs[Start].path);
+            ++AnyfType->stats.current;
+            Rejected = Jobs[Start].index;
+            free(Jobs[Start].path);
+            continue;
+        }
+        if (!Jobs[Start].first && !PrepareSubPath(Jobs[Start].path, Overwrite, SubFilePardir)) {
+            Rejected = Jobs[Start].index;
+            free(Jobs[Start].path);
+            continue;
+        }
+        // 分块并行解压的子文件先按原大小创建，各任务再写入各自的分块
+        if (!Jobs[Start].first && Jobs[Start].last) {
+            if (!(SubStream = fopen(Jobs[Start].path, "wb")) || OsFileTruncate(SubStream, AnyfType->sheet[Jobs[Start].index].fsize)) {
+                if (SubStream)
+                    fclose(SubStream);
+                printf(MESSAGE_WARN "跳过：子文件创建失败：%s\n", Jobs[Start].path);
+                Rejected = Jobs[Start].index;
+                free(Jobs[Start].path);
+                continue;
+            }
+            fclose(SubStream);
+        }
+#ifndef _WIN32
+        if (!Jobs[Start].first && AnyfType->durable && !NoteFileSystem(ppRefs, pCount, SubFilePardir))
+            printf(MESSAGE_WARN "记录子文件所在文件系统失败：%s\n", Jobs[Start].path);
+#endif // _WIN32
+        Jobs[Count++] = Jobs[Start];
+    }
+    qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobSize);
+    Share.anyf = AnyfType;
+    Share.jobs = Jobs;
+    Share.count = Count;
+    RunCopyWorkers(&Share, ExtractWorker, Pool, BufferRW, &AnyfType->stats.entries, &AnyfType->stats.bytes);
+    CheckJobs(AnyfType, Jobs, Count);
+    for (size_t i = 0; i < Count; ++i)
+        free(Jobs[i].path);
+    free(Jobs);
+}
+
+// 把已打开的源文件从当前位置起的 Size 字节写入 ANYF 文件的 *pPosition 处，*pPosition 随之后移
+// Chunk 开头已有 Filled 字节待写入的内容(子文件信息等)，与第一段数据一起写入，pCrc 不为NULL时把读入的数据累加到 *pCrc 的 CRC32C 上
+static int CopyToSlot(ANYF_T *AnyfType, FILE *SubStream, int64_t *pPosition, int64_t Size, BUFFER_T *Chunk, size_t Filled, uint32_t *pCrc) {
+    size_t SizeOnce;
+    do {
+        SizeOnce = (size_t)(Size < Chunk->size - (int64_t)Filled ? Size : Chunk->size - (int64_t)Filled);
+        AnyfThrottle(AnyfType->throttle, (int64_t)SizeOnce, 1LL);
+        if (SizeOnce > 0 && fread(Chunk->fdata + Filled, SizeOnce, 1, SubStream) != 1)
+            return SLOT_CHANGED;
+        if (pCrc)
+            *pCrc = AnyfCrc32c(*pCrc, Chunk->fdata + Filled, SizeOnce);
+        if (OsFilePWrite(AnyfType->handle, Chunk->fdata, Filled + SizeOnce, *pPosition))
+            return SLOT_FAILED;
+        *pPosition += (int64_t)(Filled + SizeOnce);
+        Size -= (int64_t)SizeOnce;
+        Filled = 0ULL;
+    } while (Size > 0LL);
+    return SLOT_WRITTEN;
+}
+
+// 把已打开的源文件写入按 Info 预留的位置，包括子文件信息和数据块，WithHead 为 false 时不写子文件信息
+// 源文件的大小、空洞分布与计算布局时不同或读取失败时返回 SLOT_CHANGED，此时预留位置的内容不完整
+// 带校验值的子文件写完数据块后填好 Info->extra.crc，WithHead 为 true 时再重写已写入的扩展属性
+// Info->extra.mtime 换成复制前重新取得的修改时间
+static int PackSlot(ANYF_T *AnyfType, FILE *SubStream, INFO_T *Info, BUFFER_T *Chunk, bool WithHead) {
+    INFO_T Actual = *Info;  // 按源文件当前状态重新确定的保存方式
+    EXTENT_T *Extents;      // 源文件中有数据的区域
+    size_t ExtentCount;     // 有数据的区域数量
+    int64_t ExtentCount64;  // 写入文件的区域数量
+    int64_t Covered = 0LL;  // 已计入校验值的子文件字节数，空洞按0计入
+    uint32_t Crc = CRC32C_INIT;
+    uint32_t *pCrc = (Info->extra.flags & ENTRY_CRC) ? &Crc : NULL;
+    int64_t Position = WithHead ? Info->offset : DataOffsetOf(Info);
+    size_t Filled;
+    int Result = SLOT_CHANGED;
+    if (AnyfSeek(SubStream, 0, SEEK_END) || AnyfTell(SubStream) != Info->fsize)
+        return SLOT_CHANGED;
+    rewind(SubStream);
+    if (!PlanFileEntry(AnyfType, SubStream, &Actual, &Extents, &ExtentCount))
+        return SLOT_CHANGED;
+    if (Actual.extra.flags != Info->extra.flags || Actual.extra.stored != Info->extra.stored)
+        goto FreeAndReturn;
+    // 源文件可能在计算布局后被原地改写而大小不变，记录复制前重新取得的修改时间，与写入的内容和校验值一致
+    Info->extra.mtime = Actual.extra.mtime;
+    Filled = WithHead ? EncodeEntryHead(Info, Chunk->fdata) : 0ULL;
+    if (!(Info->extra.flags & ENTRY_SPARSE)) {
+        Result = CopyToSlot(AnyfType, SubStream, &Position, Info->fsize, Chunk, Filled, pCrc);
+    } else {
+        if (ExtentCount > 0) {
+            ExtentCount64 = (int64_t)ExtentCount;
+            memcpy(Chunk->fdata + Filled, &ExtentCount64, sizeof(int64_t));
+            Filled += sizeof(int64_t);
+        }
+        Result = SLOT_FAILED;
+        if (OsFilePWrite(AnyfType->handle, Chunk->fdata, Filled, Position))
+            goto FreeAndReturn;
+        Position += (int64_t)Filled;
+        if (ExtentCount > 0 && OsFilePWrite(AnyfType->handle, Extents, ExtentCount * sizeof(EXTENT_T), Position))
+            goto FreeAndReturn;
+        Position += (int64_t)(ExtentCount * sizeof(EXTENT_T));
+        Result = SLOT_WRITTEN;
+        for (size_t i = 0; Result == SLOT_WRITTEN && i < ExtentCount; ++i) {
+            if (AnyfSeek(SubStream, Extents[i].offset, SEEK_SET)) {
+                Result = SLOT_CHANGED;
+                break;
+            }
+            if (pCrc)
+                Crc = AnyfCrc32cZeros(Crc, Extents[i].offset - Covered);
+            Result = CopyToSlot(AnyfType, SubStream, &Position, Extents[i].length, Chunk, 0ULL, pCrc);
+            Covered = Extents[i].offset + Extents[i].length;
+        }
+        if (pCrc)
+            Crc = AnyfCrc32cZeros(Crc, Info->fsize - Covered);
+    }
+    // 复制期间变大的文件同样视为已变化
+    if (Result == SLOT_WRITTEN && (AnyfSeek(SubStream, Info->fsize, SEEK_SET) || fgetc(SubStream) != EOF))
+        Result = SLOT_CHANGED;
+    if (Result == SLOT_WRITTEN && pCrc) {
+        Info->extra.crc = Crc;
+        if (WithHead && OsFilePWrite(AnyfType->handle, &Info->extra, (size_t)Info->extra.xsize, Info->offset + FSIZE_FNLEN_SIZE + Info->fnlen))
+            Result = SLOT_FAILED;
+    }
+FreeAndReturn:
+    if (Extents)
+        free(Extents);
+    return Result;
+}
+
+// 并行打包的线程函数，逐个领取任务直到任务表为空
+// 每个子文件的信息已按计算好的布局填入信息表，这里把子文件信息和数据块写入各自的位置
+// 源文件已变化时在预留位置写入作废的子文件信息，并标记任务以便主线程重新打包
+// 位于 Share->deferred 处的子文件信息由主线程在发布预留区域时写入
+static void PackWorker(void *Argument) {
+    COPYWORKER_T *Worker = Argument;
+    COPYSHARE_T *Share = Worker->share;
+    ANYF_T *AnyfType = Share->anyf;
+    COPYJOB_T *Job;
+    INFO_T *Info;
+    FILE *SubStream;
+    int Result;
+    bool WithHead;
+    char EntryHead[ENTRY_HEAD_MAX];
+    for (;;) {
+        OsMutexLock(&Share->lock);
+        Job = Share->next < Share->count ? &Share->jobs[Share->next++] : NULL;
+        OsMutexUnlock(&Share->lock);
+        if (!Job)
+            return;
+        Info = &AnyfType->sheet[Job->index];
+        WithHead = Info->offset != Share->deferred;
+        if (!Job->path) {
+            Result = WithHead && OsFilePWrite(AnyfType->handle, EntryHead, EncodeEntryHead(Info, EntryHead), Info->offset) ? SLOT_FAILED : SLOT_WRITTEN;
+        } else if (!(SubStream = fopen(Job->path, "rb"))) {
+            Result = SLOT_CHANGED;
+        } else {
+            Result = PackSlot(AnyfType, SubStream, Info, Worker->chunk, WithHead);
+            fclose(SubStream);
+        }
+        if (Result == SLOT_CHANGED) {
+            // 只改标志，保留 stored 以便读取时跳过整个预留位置
+            Info->extra.flags = ENTRY_VOID;
+            Job->voided = true;
+            if (WithHead && OsFilePWrite(AnyfType->handle, EntryHead, EncodeEntryHead(Info, EntryHead), Info->offset))
+                Result = SLOT_FAILED;
+        }
+        if (Result == SLOT_FAILED) {
+            OsMutexLock(&Share->lock);
+            Share->failed = true;
+            OsMutexUnlock(&Share->lock);
+        } else if (Result == SLOT_WRITTEN) {
+            ++Worker->entries;
+            Worker->bytes += Info->extra.stored;
+        }
+    }
+}
+
+// 共享追加时为已打开的源文件单独预留区域，锁外写入后发布
+// Info 的 fnlen、fname 应已填好，成功时填好其余成员并返回 true，写入期间源文件发生变化时标记为作废
+static bool PackShared(ANYF_T *AnyfType, FILE *SubStream, INFO_T *Info, BUFFER_T *Chunk) {
+    EXTENT_T *Extents;
+    size_t ExtentCount;
+    int64_t Region;
+    int Result;
+    AnyfSeek(SubStream, 0, SEEK_END);
+    Info->fsize = (int64_t)AnyfTell(SubStream);
+    rewind(SubStream);
+    if (!PlanFileEntry(AnyfType, SubStream, Info, &Extents, &ExtentCount))
+        return false;
+    if (Extents)
+        free(Extents);
+    Info->offset = 0LL;
+    if ((Region = ReserveRegion(AnyfType, DataOffsetOf(Info) + Info->extra.stored)) < 0LL)
+        return false;
+    Info->offset = Region;
+    AnyfType->stats.bytes += DataOffsetOf(Info) + Info->extra.stored - Region;
+    if ((Result = PackSlot(AnyfType, SubStream, Info, Chunk, false)) == SLOT_CHANGED)
+        Info->extra.flags = ENTRY_VOID;
+    // 写入失败时不发布，整个区域保持占位状态
+    if (Result == SLOT_FAILED)
+        return false;
+    return PublishRegion(AnyfType, Info, 1LL, Result == SLOT_CHANGED ? FEAT_VOID : 0);
+}
+
+// 按 CompareSubName 的顺序排列已打包的子文件名
+static int ComparePackedName(const void *Left, const void *Right) {
+    return CompareSubName(*(char *const *)Left, *(char *const *)Right);
+}
+
+static void FreePacked(PACKED_T *Packed) {
+    free(Packed->names);
+    free(Packed->text);
+    Packed->names = NULL;
+    Packed->text = NULL;
+    Packed->count = 0ULL;
+}
+
+// 继续中断的打包时收集信息表中已打包的子文件名(读取时跳过的子文件除外)，复制到 *pPacked 中并排序
+// 信息表之后会扩充，不能直接指向其中的文件名；成功返回 true，*pPacked 用完后由 FreePacked 释放
+// 收集的文件名与待打包的文件名一样是UTF8编码：WIN平台信息表中的文件名已转为ANSI编码，从 ANYF 文件中重新读取
+static bool CollectPacked(const ANYF_T *AnyfType, PACKED_T *pPacked) {
+    size_t Bytes = 0ULL;
+    char *Cursor;
+    pPacked->count = 0ULL;
+    pPacked->names = NULL;
+    pPacked->text = NULL;
+    for (int64_t i = 0; i < AnyfType->head.count; ++i) {
+        if (!(AnyfType->sheet[i].extra.flags & ENTRY_SKIP))
+            Bytes += (size_t)AnyfType->sheet[i].fnlen;
+    }
+    if (!Bytes)
+        return true;
+    if (!(pPacked->names = malloc((size_t)AnyfType->head.count * sizeof(char *))) || !(pPacked->text = malloc(Bytes))) {
+        free(pPacked->names);
+        pPacked->names = NULL;
+        return false;
+    }
+    Cursor = pPacked->text;
+    for (int64_t i = 0; i < AnyfType->head.count; ++i) {
+        if (AnyfType->sheet[i].extra.flags & ENTRY_SKIP)
+            continue;
+#ifdef _WIN32
+        if (OsFilePRead(AnyfType->handle, Cursor, (size_t)AnyfType->sheet[i].fnlen, AnyfType->sheet[i].offset + FSIZE_FNLEN_SIZE)) {
+            FreePacked(pPacked);
+            return false;
+        }
+#else
+        memcpy(Cursor, AnyfType->sheet[i].fname, (size_t)AnyfType->sheet[i].fnlen);
+#endif // _WIN32
+        Cursor[AnyfType->sheet[i].fnlen - 1] = EMPTY_CHAR;
+        pPacked->names[pPacked->count++] = Cursor;
+        Cursor += AnyfType->sheet[i].fnlen;
+    }
+    qsort(pPacked->names, pPacked->count, sizeof(char *), ComparePackedName);
     return true;
 }
 
+// 判断子文件名 Name(UTF8编码)是否已在中断的打包中写入
+static bool IsPacked(const PACKED_T *Packed, const char *Name) {
+    return Packed->count > 0 && bsearch(&Name, Packed->names, Packed->count, sizeof(char *), ComparePackedName);
+}
+
+// 独占打包时提交检查点：把信息表中 *pCommitted 之后已写完的子文件计入文件头中的子文件数量，提交后 *pCommitted 更新为子文件总数
+// 调用前固实块和合并写入的批次都应已写入 ANYF 文件，中断后继续打包时从最后一个检查点之后写起
+// 检查点不记录 Merkle 根，打包结束时再计算；持久化模式下与打包结束时相同，先同步数据再更新并同步子文件数量
+static bool CommitCheckpoint(ANYF_T *AnyfType, int64_t *pCommitted) {
+    HEAD_T Disk;
+    int64_t End;
+    bool Stored;
+    if (fflush(AnyfType->handle) || (End = AnyfTell(AnyfType->handle)) < 0LL)
+        return false;
+    if (AnyfType->durable && OsFileSyncData(AnyfType->handle))
+        return false;
+    if (!LockHead(AnyfType))
+        return false;
+    if (OsFilePRead(AnyfType->handle, &Disk, sizeof(HEAD_T), AnyfType->start)) {
+        UnlockHead(AnyfType);
+        return false;
+    }
+    Disk.feat |= AnyfType->head.feat;
+    Disk.count += AnyfType->head.count - *pCommitted;
+    if (!Disk.dict)
+        Disk.dict = AnyfType->head.dict;
+    Disk.root = 0U;
+    Disk.leaves = 0LL;
+    if (Disk.feat & FEAT_SHARED)
+        Disk.tail = End;
+    Stored = StoreHead(AnyfType, &Disk);
+    UnlockHead(AnyfType);
+    if (!Stored || (AnyfType->durable && OsFileSyncData(AnyfType->handle)))
+        return false;
+    AnyfType->tail = End;
+    AnyfType->known = Disk.count;
+    *pCommitted = AnyfType->head.count;
+    return true;
+}
+
+// 用 AnyfType->jobs 个线程并行打包扫描到的路径，ANYF 文件应有 FEAT_EXTRA 特性
+// 主线程先按扫描顺序确定每个子文件的大小、保存方式和在 ANYF 文件中的位置，预分配空间后由各线程写入各自的位置
+// 源文件在此期间发生变化或无法读取时，其预留位置标记为作废，再由主线程重新打包追加到末尾
+// 共享追加时整个布局作为一个预留区域：锁内预留，锁外写入，写完后发布
+// 从第 *pNext 个路径起规划，独占打包时规划的字节数达到 AnyfType->checkpoint 就停止，以便提交检查点，*pNext 更新为下一个未处理的路径
+// Packed 中已有的子文件名跳过，返回作废的预留位置数量，这些作废的子文件信息也计入子文件总数
+static int64_t PackParallel(ANYF_T *AnyfType, SCANNER_T *PathScanner, size_t *pNext, const PACKED_T *Packed, const char *ParentDIR, const char *AnyfAbsPath, BUFPOOL_T *Pool, BUFFER_T *BufferRW) {
+#ifdef _WIN32
+    char NormcasedPath[PATH_MAX_SIZE];
+#endif
+    COPYSHARE_T Share;
+    COPYJOB_T *Jobs;
+    INFO_T InfoTemp;
+    FILE *SubFileStream;
+    EXTENT_T *Extents;
+    size_t ExtentCount, Count = 0ULL, i;
+    int64_t Voided = 0LL, Entries = 0LL, Bytes = 0LL;
+    int64_t CountBefore = AnyfType->head.count;
+    int64_t LayoutStart, LayoutEnd;
+    int64_t Region = -1LL; // 共享追加时预留区域的起始偏移量
+    // 共享追加时先按已知的链结束位置计算布局，预留后再整体移到预留的位置
+    if (fflush(AnyfType->handle) || (LayoutStart = AnyfType->shared ? AnyfType->tail : AnyfTell(AnyfType->handle)) < 0LL) {
+        WHETHER_CLOSE_REMOVE(AnyfType);
+        PRINT_ERROR_AND_ABORT("获取 ANYF 文件指针位置失败");
+    }
+    if (!(Jobs = malloc((PathScanner->count > 0 ? PathScanner->count : 1ULL) * sizeof(COPYJOB_T)))) {
+        WHETHER_CLOSE_REMOVE(AnyfType);
+        PRINT_ERROR_AND_ABORT("为并行打包任务表分配内存失败");
+    }
+    // 计算布局，打开源文件只为获取大小和空洞分布
+    LayoutEnd = LayoutStart;
+    for (i = *pNext; i < PathScanner->count; ++i) {
+        if (!AnyfType->shared && AnyfType->checkpoint > 0LL && LayoutEnd - LayoutStart >= AnyfType->checkpoint)
+            break;
+        printf(MESSAGE_INFO "打包：%s\n", PathScanner->paths[i]);
+        if (OsPathIsDirectory(PathScanner->paths[i])) {
+            InfoTemp.fsize = DIR_SIZE;
+            if (OsPathRelativePath(InfoTemp.fname, PATH_MAX_SIZE, PathScanner->paths[i], ParentDIR)) {
+                printf(MESSAGE_WARN "跳过：获取子目录相对路径失败\n");
+                continue;
+            }
+#ifdef _WIN32
+            StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
+#endif // _WIN32
+            if (IsPacked(Packed, InfoTemp.fname)) {
+                printf(MESSAGE_INFO "跳过：已在中断的打包中写入\n");
+                continue;
+            }
+            InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
+            InitExtra(AnyfType, &InfoTemp);
+            Jobs[Count].path = NULL;
+        } else {
+#ifndef _WIN32
+            if (!strcmp(AnyfAbsPath, PathScanner->paths[i]))
+#else
+            strcpy(NormcasedPath, PathScanner->paths[i]);
+            if (!strcmp(AnyfAbsPath, OsPathNormcase(NormcasedPath)))
+#endif // _WIN32
+            {
+                printf(MESSAGE_WARN "跳过：此文件是当前 ANYF 文件\n");
+                continue;
+            }
+            if (OsPathRelativePath(InfoTemp.fname, PATH_MAX_SIZE, PathScanner->paths[i], ParentDIR)) {
+                printf(MESSAGE_WARN "跳过：获取子文件相对路径失败\n");
+                continue;
+            }
+#ifdef _WIN32
+            StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
+#endif // _WIN32
+            if (IsPacked(Packed, InfoTemp.fname)) {
+                printf(MESSAGE_INFO "跳过：已在中断的打包中写入\n");
+                continue;
+            }
+            if (!(SubFileStream = fopen(PathScanner->paths[i], "rb"))) {
+                printf(MESSAGE_WARN "跳过：子文件打开失败\n");
+                continue;
+            }
+            AnyfSeek(SubFileStream, 0, SEEK_END);
+            InfoTemp.fsize = (int64_t)AnyfTell(SubFileStream);
+            rewind(SubFileStream);
+            if (!PlanFileEntry(AnyfType, SubFileStream, &InfoTemp, &Extents, &ExtentCount)) {
+                fclose(SubFileStream);
+                printf(MESSAGE_WARN "跳过：读取子文件失败\n");
+                continue;
+            }
+            if (Extents)
+                free(Extents);
+            fclose(SubFileStream);
+            InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
+            Jobs[Count].path = PathScanner->paths[i];
+        }
+        InfoTemp.offset = LayoutEnd;
+        LayoutEnd = DataOffsetOf(&InfoTemp) + InfoTemp.extra.stored;
+        Jobs[Count].index = AnyfType->head.count;
+        Jobs[Count].first = Jobs[Count].last = 0LL;
+        Jobs[Count].size = InfoTemp.extra.stored;
+        Jobs[Count].name = NULL;
+        Jobs[Count++].voided = false;
+        AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+    }
+    *pNext = i;
+    if (AnyfType->shared && Count > 0) {
+        if ((Region = ReserveRegion(AnyfType, LayoutEnd - LayoutStart)) < 0LL) {
+            AnyfType->head.count = CountBefore;
+            PRINT_ERROR_AND_ABORT("在 ANYF 文件中预留区域失败");
+        }
+        for (int64_t i = CountBefore; i < AnyfType->head.count; ++i)
+            AnyfType->sheet[i].offset += Region - LayoutStart;
+        LayoutEnd += Region - LayoutStart;
+        LayoutStart = Region;
+        AnyfType->stats.bytes += LayoutEnd - LayoutStart;
+    }
+    if (LayoutEnd > LayoutStart && OsFileAllocate(AnyfType->handle, LayoutStart, LayoutEnd - LayoutStart))
+        printf(MESSAGE_WARN "预分配 ANYF 文件空间失败，写入时再扩展文件\n");
+    qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobSize);
+    Share.anyf = AnyfType;
+    Share.jobs = Jobs;
+    Share.count = Count;
+    Share.deferred = Region;
+    RunCopyWorkers(&Share, PackWorker, Pool, BufferRW, &Entries, &Bytes);
+    if (Share.failed) {
+        AnyfType->head.count = CountBefore;
+        // 共享追加时其后可能已有其他写入者的区域，不发布即可，预留区域保持占位状态
+        if (AnyfType->shared) {
+            PRINT_ERROR_AND_ABORT("并行写入 ANYF 文件失败");
+        }
+        // 文件中的子文件数量尚未更新，截掉本次写入的内容即恢复原状
+        OsFileTruncate(AnyfType->handle, LayoutStart);
+        WHETHER_CLOSE_REMOVE(AnyfType);
+        PRINT_ERROR_AND_ABORT("并行写入 ANYF 文件失败");
+    }
+    if (AnyfType->shared) {
+        for (size_t i = 0; i < Count; ++i)
+            Voided += Jobs[i].voided ? 1LL : 0LL;
+        if (Count > 0 && !PublishRegion(AnyfType, &AnyfType->sheet[CountBefore], (int64_t)Count, Voided > 0LL ? FEAT_VOID : 0)) {
+            AnyfType->head.count = CountBefore;
+            PRINT_ERROR_AND_ABORT("发布 ANYF 文件中的预留区域失败");
+        }
+        if (Voided > 0LL)
+            AnyfType->head.feat |= FEAT_VOID;
+        qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobIndex);
+        for (size_t i = 0; i < Count; ++i) {
+            if (!Jobs[i].voided)
+                continue;
+            printf(MESSAGE_WARN "源文件在打包期间发生变化，重新打包：%s\n", Jobs[i].path);
+            if (!(SubFileStream = fopen(Jobs[i].path, "rb"))) {
+                printf(MESSAGE_WARN "跳过：子文件打开失败\n");
+                continue;
+            }
+            InfoTemp = AnyfType->sheet[Jobs[i].index];
+            if (!PackShared(AnyfType, SubFileStream, &InfoTemp, BufferRW)) {
+                fclose(SubFileStream);
+                printf(MESSAGE_WARN "跳过：将子文件写入 ANYF 文件失败\n");
+                continue;
+            }
+            fclose(SubFileStream);
+            if (AnyfType->cells <= AnyfType->head.count && !ExpandBOM(AnyfType, 1ULL)) {
+                PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+            }
+            if (InfoTemp.extra.flags & ENTRY_VOID) {
+                printf(MESSAGE_WARN "跳过：源文件仍在变化\n");
+                ++Voided;
+            }
+            AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+        }
+        free(Jobs);
+        return Voided;
+    }
+    // 已变化的源文件按当前状态逐个追加到末尾
+    if (AnyfSeek(AnyfType->handle, LayoutEnd, SEEK_SET)) {
+        WHETHER_CLOSE_REMOVE(AnyfType);
+        PRINT_ERROR_AND_ABORT("移动 ANYF 文件指针失败");
+    }
+    qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobIndex);
+    for (size_t i = 0; i < Count; ++i) {
+        if (!Jobs[i].voided)
+            continue;
+        ++Voided;
+        printf(MESSAGE_WARN "源文件在打包期间发生变化，重新打包：%s\n", Jobs[i].path);
+        if (!(SubFileStream = fopen(Jobs[i].path, "rb"))) {
+            printf(MESSAGE_WARN "跳过：子文件打开失败\n");
+            continue;
+        }
+        InfoTemp = AnyfType->sheet[Jobs[i].index];
+        AnyfSeek(SubFileStream, 0, SEEK_END);
+        InfoTemp.fsize = (int64_t)AnyfTell(SubFileStream);
+        rewind(SubFileStream);
+        if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL || !PackFileEntry(AnyfType, SubFileStream, &InfoTemp, BufferRW, Pool)) {
+            fclose(SubFileStream);
+            AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
+            printf(MESSAGE_WARN "跳过：将子文件写入 ANYF 文件失败\n");
+            continue;
+        }
+        fclose(SubFileStream);
+        if (AnyfType->cells <= AnyfType->head.count && !ExpandBOM(AnyfType, 1ULL)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+        }
+        AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+    }
+    if (Voided > 0LL) {
+        AnyfType->head.feat |= FEAT_VOID;
+        // 截掉重新打包失败时可能留下的残余数据
+        if ((LayoutEnd = AnyfTell(AnyfType->handle)) < 0LL || OsFileTruncate(AnyfType->handle, LayoutEnd)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("截断 ANYF 文件失败");
+        }
+    }
+    free(Jobs);
+    return Voided;
+}
+
 // 获取 JPEG 文件的净大小
-static int64_t RealSizeOfJPEG(FILE *JPEGPath, int64_t TotalSize, BUFFER_T **BufferS8) {
-    uint8_t *BufferU8;
-    int64_t EndPos = 0;
+// 以 Buffer 为窗口逐段查找结束标记，不需要把整个文件读入内存
+static int64_t RealSizeOfJPEG(FILE *JPEGHandle, int64_t TotalSize, BUFFER_T *Buffer) {
+    uint8_t *BufferU8 = (uint8_t *)Buffer->fdata;
+    int64_t Position = 0LL; // 已读取的字节数
+    int Previous = -1;      // 上一个字节的值
+    size_t SizeRead, Index;
     if (TotalSize < 4)
         return JPEG_INVALID;
-    if ((*BufferS8)->size < TotalSize)
-        if (!ExpandBUF(BufferS8, TotalSize))
+    rewind(JPEGHandle);
+    while (Position < TotalSize) {
+        SizeRead = (size_t)(TotalSize - Position < Buffer->size ? TotalSize - Position : Buffer->size);
+        if (fread(BufferU8, 1, SizeRead, JPEGHandle) != SizeRead)
             return JPEG_ERROR;
-    rewind(JPEGPath);
-    if (fread((*BufferS8)->fdata, 1, TotalSize, JPEGPath) != TotalSize) {
-        return JPEG_ERROR;
+        for (Index = 0; Index < SizeRead; ++Index) {
+            if (Position + (int64_t)Index == 1 && !(Previous == JPEG_SIG && BufferU8[Index] == JPEG_START))
+                return JPEG_INVALID;
+            if (Position + (int64_t)Index >= 3 && Previous == JPEG_SIG && BufferU8[Index] == JPEG_END)
+                return Position + (int64_t)Index + 1;
+            Previous = BufferU8[Index];
+        }
+        Position += (int64_t)SizeRead;
     }
-    BufferU8 = (uint8_t *)(*BufferS8)->fdata;
-    if (!(BufferU8[0] == JPEG_SIG && BufferU8[1] == JPEG_START))
-        return JPEG_INVALID;
-    for (EndPos = 4; EndPos <= TotalSize; ++EndPos)
-        if (BufferU8[EndPos - 2] == JPEG_SIG && BufferU8[EndPos - 1] == JPEG_END)
-            return EndPos;
     return JPEG_INVALID;
 }
 
@@ -116,23 +2171,25 @@ bool AnyfIsFakeJPEG(const char *FakeJPEGPath) {
     BUFFER_T *BufferRW;
     int64_t FakeJPEGSize, JPEGNetSize;
     HEAD_T HeadTemp;
-    static char PathBuffer[PATH_MAX_SIZE];
+    char PathBuffer[PATH_MAX_SIZE];
     bool FinalReturnCode = false;
     if (OsPathAbsolutePath(PathBuffer, PATH_MAX_SIZE, FakeJPEGPath))
         return FinalReturnCode;
     FakeJPEGHandle = fopen(PathBuffer, "rb");
     if (!FakeJPEGHandle)
         return FinalReturnCode;
-    if (AnyfSeek(FakeJPEGHandle, 0LL, SEEK_END))
-        return FinalReturnCode;
-    if ((FakeJPEGSize = AnyfTell(FakeJPEGHandle)) < 0LL)
-        return FinalReturnCode;
-    if (BufferRW = malloc(FakeJPEGSize + sizeof(HEAD_T) + sizeof(BUFFER_T))) {
-        BufferRW->size = FakeJPEGSize + sizeof(HEAD_T);
+    if (BufferRW = malloc(sizeof(BUFFER_T) + JPEG_SCAN_SIZE)) {
+        BufferRW->size = JPEG_SCAN_SIZE;
+        BufferRW->pool = NULL;
     } else {
-        return false;
+        fclose(FakeJPEGHandle);
+        return FinalReturnCode;
     }
-    JPEGNetSize = RealSizeOfJPEG(FakeJPEGHandle, FakeJPEGSize, &BufferRW);
+    if (AnyfSeek(FakeJPEGHandle, 0LL, SEEK_END))
+        goto FreeAndReturn;
+    if ((FakeJPEGSize = AnyfTell(FakeJPEGHandle)) < 0LL)
+        goto FreeAndReturn;
+    JPEGNetSize = RealSizeOfJPEG(FakeJPEGHandle, FakeJPEGSize, BufferRW);
     if (JPEGNetSize == JPEG_INVALID || JPEGNetSize == JPEG_ERROR)
         goto FreeAndReturn;
     if (FakeJPEGSize - JPEGNetSize < sizeof(HEAD_T)) {
@@ -151,11 +2208,35 @@ FreeAndReturn:
     return FinalReturnCode;
 }
 
+// 读入 Offset 处的共享字典子文件信息及字典内容到 AnyfType->dict，Feat 为 ANYF 文件的特性标志
+// 不使用也不改变流的文件指针
+static bool LoadDictionary(ANYF_T *AnyfType, int32_t Feat, int64_t Offset) {
+    INFO_T Info;
+    void *Data;
+    if (!ReadHeadAt(AnyfType->handle, Feat, Offset, &Info) || !(Info.extra.flags & ENTRY_DICTDATA))
+        return false;
+    if (Info.fsize <= 0 || Info.fsize > CODEC_DICT_MAX || Info.extra.stored != Info.fsize)
+        return false;
+    if (!(Data = malloc((size_t)Info.fsize)))
+        return false;
+    if (OsFilePRead(AnyfType->handle, Data, (size_t)Info.fsize, DataOffsetOf(&Info))) {
+        free(Data);
+        return false;
+    }
+    if (AnyfType->dict.data)
+        free((void *)AnyfType->dict.data);
+    AnyfType->dict.data = Data;
+    AnyfType->dict.size = (size_t)Info.fsize;
+    return true;
+}
+
 // 关闭ANYF_T对象
 void AnyfClose(ANYF_T *AnyfType) {
     if (AnyfType) {
         if (AnyfType->path)
             free(AnyfType->path);
+        if (AnyfType->dict.data)
+            free((void *)AnyfType->dict.data);
         if (AnyfType->sheet)
             free(AnyfType->sheet);
         if (AnyfType->handle)
@@ -172,7 +2253,7 @@ ANYF_T *AnyfMake(const char *AnyfPath, bool Overwrite) {
     char *AnyfPathCopied;           // 拷贝路径用于结构体
     if (OsPathAbsolutePath(PathBuffer, PATH_MAX_SIZE, AnyfPath)) {
         printf(MESSAGE_ERROR "无法获取 ANYF 文件绝对路径：%s\n", AnyfPath);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     printf(MESSAGE_INFO "创建文件：%s\n", PathBuffer);
     AnyfPathCopied = malloc(strlen(PathBuffer) + 1ULL);
@@ -183,34 +2264,34 @@ ANYF_T *AnyfMake(const char *AnyfPath, bool Overwrite) {
     if (OsPathExists(AnyfPathCopied)) {
         if (OsPathIsDirectory(AnyfPathCopied)) {
             printf(MESSAGE_ERROR "此位置已存在同名目录\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         } else if (OsPathLastState()) {
             printf(MESSAGE_ERROR "获取路径属性失败\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         } else if (!Overwrite) {
             printf(MESSAGE_ERROR "已存在同名文件但未指示覆盖\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     } else if (OsPathLastState()) {
         printf(MESSAGE_ERROR "无法检查此路径是否存在\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (!OsPathDirName(PathBuffer, PATH_MAX_SIZE, PathBuffer)) {
         printf(MESSAGE_ERROR "获取 ANYF 文件的父目录路径失败\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (!OsPathExists(PathBuffer)) {
         if (OsPathMakeDIR(PathBuffer)) {
             printf(MESSAGE_ERROR "为 ANYF 文件创建目录失败\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     } else if (!OsPathIsDirectory(PathBuffer)) {
         printf(MESSAGE_ERROR "父目录已被文件占用，无法创建 ANYF 文件\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
-    if (!(AnyfHandle = fopen(AnyfPathCopied, "wb"))) {
+    if (!(AnyfHandle = fopen(AnyfPathCopied, "w+b"))) {
         printf(MESSAGE_ERROR " ANYF 文件创建失败\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (fwrite(&DEFAULT_HEAD, sizeof(DEFAULT_HEAD), 1, AnyfHandle) != 1) {
         fclose(AnyfHandle);
@@ -225,6 +2306,27 @@ ANYF_T *AnyfMake(const char *AnyfPath, bool Overwrite) {
         AnyfType->cells = 0LL;
         AnyfType->path = AnyfPathCopied;
         AnyfType->handle = AnyfHandle;
+        AnyfType->pool = NULL;
+        AnyfType->durable = false;
+        AnyfType->profile = NULL;
+        AnyfType->throttle = NULL;
+        AnyfType->jobs = 1;
+        AnyfType->shared = false;
+        AnyfType->codec = CODEC_NONE;
+        AnyfType->level = 0;
+        AnyfType->solid = 0LL;
+        AnyfType->roffset = AnyfType->rlength = 0LL;
+        AnyfType->traindict = false;
+        AnyfType->checkpoint = 0LL;
+        AnyfType->resume = false;
+        AnyfType->update = UPDATE_NONE;
+        AnyfType->loaded = 0LL;
+        AnyfType->dict.data = NULL;
+        AnyfType->dict.size = 0ULL;
+        AnyfType->tail = (int64_t)(AnyfType->start + SUBDATA_OFFSET);
+        AnyfType->known = 0LL;
+        memset(&AnyfType->stats, 0, sizeof(STATS_T));
+        TrackOpened(AnyfType, NULL);
         return AnyfType;
     } else {
         fclose(AnyfHandle);
@@ -233,8 +2335,9 @@ ANYF_T *AnyfMake(const char *AnyfPath, bool Overwrite) {
     }
 }
 
-// 打开已存在的 ANYF 文件
-ANYF_T *AnyfOpen(const char *AnyfPath) {
+// 打开已存在的 ANYF 文件，ReadOnly 为真时以只读方式打开，用于显示信息和提取
+// 读取文件头和子文件信息链期间共享锁定文件头，与正在追加的写入者同时运行时也得到一致的子文件信息表
+ANYF_T *AnyfOpen(const char *AnyfPath, bool ReadOnly) {
     ANYF_T *AnyfType;               // ANYF 文件信息结构体
     HEAD_T HeadTemp;                // 临时 ANYF 文件头
     INFO_T *SubFileSheet;           // 子文件信息表
@@ -242,9 +2345,10 @@ ANYF_T *AnyfOpen(const char *AnyfPath) {
     char PathBuffer[PATH_MAX_SIZE]; // 绝对路径及父目录缓冲
     char *AnyfPathCopied;           // 拷贝路径用于结构体
     int64_t CellsCount = 0LL;       // 子文件信息表容量
+    int64_t ChainEnd;               // 子文件信息链的结束位置
     if (OsPathAbsolutePath(PathBuffer, PATH_MAX_SIZE, AnyfPath)) {
         printf(MESSAGE_ERROR "无法获取 ANYF 文件绝对路径：%s\n", AnyfPath);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     printf(MESSAGE_INFO "打开文件：%s\n", PathBuffer);
     AnyfPathCopied = malloc(strlen(PathBuffer) + 1ULL);
@@ -254,27 +2358,35 @@ ANYF_T *AnyfOpen(const char *AnyfPath) {
     strcpy(AnyfPathCopied, PathBuffer);
     if (!OsPathExists(AnyfPathCopied)) {
         printf(MESSAGE_ERROR "指定的文件路径不存在\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (!OsPathIsFile(AnyfPathCopied)) {
         if (OsPathLastState()) {
             printf(MESSAGE_ERROR "获取 ANYF 文件路径属性失败\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         } else {
             printf(MESSAGE_ERROR "此路径不是一个文件路径\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     }
-    if (!(AnyfHandle = fopen(AnyfPathCopied, "r+b"))) {
+    if (!(AnyfHandle = fopen(AnyfPathCopied, ReadOnly ? "rb" : "r+b"))) {
         printf(MESSAGE_ERROR " ANYF 文件打开失败\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
+    }
+    TrackOpened(NULL, AnyfHandle);
+    if (OsFileLock(AnyfHandle, HEAD_LOCK_OFFSET, LOCK_SIZE, false)) {
+        PRINT_ERROR_AND_ABORT("锁定 ANYF 文件头失败");
     }
     if (fread(&HeadTemp, sizeof(HeadTemp), 1, AnyfHandle) != 1) {
         PRINT_ERROR_AND_ABORT("读取 ANYF 文件头失败");
     }
     if (memcmp(DEFAULT_HEAD.id, HeadTemp.id, sizeof(DEFAULT_HEAD.id))) {
         printf(MESSAGE_ERROR "此文件不是一个 ANYF 文件\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
+    }
+    if (HeadTemp.feat & ~FEAT_KNOWN) {
+        printf(MESSAGE_ERROR "此 ANYF 文件使用了不支持的特性，请更新程序\n");
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (HeadTemp.count > 0)
         CellsCount = HeadTemp.count;
@@ -300,16 +2412,29 @@ ANYF_T *AnyfOpen(const char *AnyfPath) {
         if (fread(SubFileSheet[i].fname, SubFileSheet[i].fnlen, 1, AnyfHandle) != 1) {
             PRINT_ERROR_AND_ABORT("从 ANYF 文件读取子文件名失败");
         }
+        if (HeadTemp.feat & FEAT_EXTRA) {
+            if (!ReadExtra(AnyfHandle, &SubFileSheet[i].extra)) {
+                PRINT_ERROR_AND_ABORT("读取子文件扩展属性失败");
+            }
+        } else {
+            SubFileSheet[i].extra.xsize = 0;
+            SubFileSheet[i].extra.flags = 0;
+            SubFileSheet[i].extra.stored = SubFileSheet[i].fsize > 0 ? SubFileSheet[i].fsize : 0LL;
+        }
+        // 叶子值按文件中的(UTF8编码)文件名计算，WIN平台转为ANSI编码后的文件名不能用于计算
+        SubFileSheet[i].leaf = MerkleLeaf(&SubFileSheet[i]);
 #ifdef _WIN32
         StringUTF8ToANSI(SubFileSheet[i].fname, PMS, SubFileSheet[i].fname);
 #endif // _WIN32
-       // 遇到目录(大小是-1)或文件大小为0时没有数据块不需要移动文件指针
-        if (SubFileSheet[i].fsize <= 0)
+        // 遇到目录(大小是-1)或文件大小为0等没有数据块的情况不需要移动文件指针
+        if (SubFileSheet[i].extra.stored <= 0)
             continue;
-        if (AnyfSeek(AnyfHandle, SubFileSheet[i].fsize, SEEK_CUR)) {
+        if (AnyfSeek(AnyfHandle, SubFileSheet[i].extra.stored, SEEK_CUR)) {
             PRINT_ERROR_AND_ABORT("移动文件指针至下一个位置失败");
         }
     }
+    ChainEnd = AnyfTell(AnyfHandle);
+    OsFileUnlock(AnyfHandle, HEAD_LOCK_OFFSET, LOCK_SIZE);
     AnyfSeek(AnyfHandle, 0, SEEK_END); // 默认文件指针在末尾
     if (AnyfType = malloc(sizeof(ANYF_T))) {
         AnyfType->head = HeadTemp;
@@ -318,6 +2443,30 @@ ANYF_T *AnyfOpen(const char *AnyfPath) {
         AnyfType->cells = CellsCount;
         AnyfType->path = AnyfPathCopied;
         AnyfType->handle = AnyfHandle;
+        AnyfType->pool = NULL;
+        AnyfType->durable = false;
+        AnyfType->profile = NULL;
+        AnyfType->throttle = NULL;
+        AnyfType->jobs = 1;
+        AnyfType->shared = false;
+        AnyfType->codec = CODEC_NONE;
+        AnyfType->level = 0;
+        AnyfType->solid = 0LL;
+        AnyfType->roffset = AnyfType->rlength = 0LL;
+        AnyfType->traindict = false;
+        AnyfType->checkpoint = 0LL;
+        AnyfType->resume = false;
+        AnyfType->update = UPDATE_NONE;
+        AnyfType->loaded = HeadTemp.count;
+        AnyfType->dict.data = NULL;
+        AnyfType->dict.size = 0ULL;
+        AnyfType->tail = ChainEnd;
+        AnyfType->known = HeadTemp.count;
+        memset(&AnyfType->stats, 0, sizeof(STATS_T));
+        // 共享字典在打开时读入一次，提取和追加打包时直接使用
+        if ((HeadTemp.feat & FEAT_DICT) && !LoadDictionary(AnyfType, HeadTemp.feat, HeadTemp.dict))
+            printf(MESSAGE_WARN "读取共享字典失败，使用字典压缩的子文件无法提取\n");
+        TrackOpened(AnyfType, NULL);
         return AnyfType;
     } else {
         free(SubFileSheet), free(AnyfPathCopied);
@@ -325,22 +2474,141 @@ ANYF_T *AnyfOpen(const char *AnyfPath) {
     }
 }
 
+// 释放样本缓冲区，之后不再取样
+static void FinishTraining(TRAINER_T *Trainer) {
+    if (Trainer->samples)
+        free(Trainer->samples);
+    if (Trainer->sizes)
+        free(Trainer->sizes);
+    memset(Trainer, 0, sizeof(TRAINER_T));
+}
+
+// 准备在打包过程中训练共享字典，ANYF 文件已有字典时沿用已有的字典
+// pDisk 为锁定文件头后读到的文件头，其他写入者可能在本次打开后加入了字典
+// 需要训练时分配样本缓冲区并返回 true，之后由 TakeSample 从扫描到的小文件中取样
+static bool StartTraining(ANYF_T *AnyfType, const HEAD_T *pDisk, TRAINER_T *Trainer) {
+    memset(Trainer, 0, sizeof(TRAINER_T));
+    if (AnyfType->dict.size > 0ULL) {
+        printf(MESSAGE_INFO "此 ANYF 文件已有共享字典，沿用已有的字典\n");
+        return false;
+    }
+    if (pDisk->feat & FEAT_DICT) {
+        if (LoadDictionary(AnyfType, pDisk->feat, pDisk->dict)) {
+            AnyfType->head.dict = pDisk->dict;
+            printf(MESSAGE_INFO "此 ANYF 文件已有共享字典，沿用已有的字典\n");
+        } else {
+            printf(MESSAGE_WARN "读取已有的共享字典失败，不使用字典\n");
+        }
+        return false;
+    }
+    Trainer->samples = malloc(DICT_SAMPLE_BYTES);
+    Trainer->sizes = malloc(DICT_SAMPLE_FILES * sizeof(size_t));
+    if (!Trainer->samples || !Trainer->sizes) {
+        FinishTraining(Trainer);
+        printf(MESSAGE_WARN "为字典样本分配内存失败，不使用字典\n");
+        return false;
+    }
+    return true;
+}
+
+// 从已打开且不超过 DICT_ENTRY_MAX 字节的子文件开头取样，取样后文件指针移回开头
+// 样本数量或总字节数达到上限，应训练字典时返回 true
+static bool TakeSample(TRAINER_T *Trainer, FILE *SubStream, int64_t Size) {
+    size_t Piece;
+    if (Size > 0LL && Size <= DICT_ENTRY_MAX) {
+        Piece = (size_t)Size < DICT_SAMPLE_PIECE ? (size_t)Size : DICT_SAMPLE_PIECE;
+        if (Piece > DICT_SAMPLE_BYTES - Trainer->used)
+            Piece = DICT_SAMPLE_BYTES - Trainer->used;
+        if (!OsFilePRead(SubStream, Trainer->samples + Trainer->used, Piece, 0LL)) {
+            Trainer->sizes[Trainer->count++] = Piece;
+            Trainer->used += Piece;
+        }
+        rewind(SubStream);
+    }
+    return Trainer->count >= DICT_SAMPLE_FILES || Trainer->used >= DICT_SAMPLE_BYTES;
+}
+
+// 用已取得的样本训练共享字典，在 ANYF 文件当前位置写入字典子文件信息，之后打包的小文件使用此字典
+// 合并写入批次和固实块应已写入；样本太少或没有共有的片段时不使用字典
+// 返回写入的字典子文件数量
+static int64_t StoreDictionary(ANYF_T *AnyfType, TRAINER_T *Trainer) {
+    INFO_T InfoTemp;
+    char Dict[CODEC_DICT_MAX];
+    size_t Count = Trainer->count, Used = Trainer->used;
+    printf(MESSAGE_INFO "训练共享字典...\n");
+    if (Count >= DICT_SAMPLE_MIN)
+        InfoTemp.fsize = (int64_t)AnyfCodecTrain(Trainer->samples, Trainer->sizes, Count, Dict, CODEC_DICT_MAX);
+    else
+        InfoTemp.fsize = 0LL;
+    FinishTraining(Trainer);
+    if (InfoTemp.fsize <= 0) {
+        printf(MESSAGE_WARN "适合训练字典的小文件太少或没有共有的内容，不使用字典\n");
+        return 0LL;
+    }
+    InfoTemp.fnlen = 1;
+    InfoTemp.fname[0] = EMPTY_CHAR;
+    InitExtra(AnyfType, &InfoTemp);
+    InfoTemp.extra.flags = ENTRY_DICTDATA;
+    if (AnyfType->cells <= AnyfType->head.count && !ExpandBOM(AnyfType, 1ULL))
+        return 0LL;
+    if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL)
+        return 0LL;
+    if (!(AnyfType->dict.data = malloc((size_t)InfoTemp.fsize)) || !WriteEntryHead(AnyfType, &InfoTemp) || fwrite(Dict, (size_t)InfoTemp.fsize, 1, AnyfType->handle) != 1) {
+        AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
+        if (AnyfType->dict.data)
+            free((void *)AnyfType->dict.data);
+        AnyfType->dict.data = NULL;
+        printf(MESSAGE_WARN "写入共享字典失败，不使用字典\n");
+        return 0LL;
+    }
+    memcpy((void *)AnyfType->dict.data, Dict, (size_t)InfoTemp.fsize);
+    AnyfType->dict.size = (size_t)InfoTemp.fsize;
+    AnyfType->head.dict = InfoTemp.offset;
+    AnyfType->head.feat |= FEAT_DICT;
+    AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+    printf(MESSAGE_INFO "共享字典：从%zu个文件的%zu字节样本训练得到%" I64_SPECIFIER "字节\n", Count, Used, InfoTemp.fsize);
+    return 1LL;
+}
+
 // 将目标打包进已创建的空 ANYF 文件
 ANYF_T *AnyfPack(const char *ToBePacked, bool Recursion, ANYF_T *AnyfType, bool Append) {
     // 如果 ToBePacked 是目录，则此变量用于存放其父目录
     char *ParentDIR;
     // 存放绝对路径用于比较是否同一文件
-    static char AbsPathBuffer1[PATH_MAX_SIZE]; // ANYF 文件
-    static char AbsPathBuffer2[PATH_MAX_SIZE]; // 子文件
+    char AbsPathBuffer1[PATH_MAX_SIZE]; // ANYF 文件
+    char AbsPathBuffer2[PATH_MAX_SIZE]; // 子文件
 #ifdef _WIN32
-    static char NormcasedBuffer[PATH_MAX_SIZE]; // WIN平台比较路径是否相同需要先转全小写
+    char NormcasedBuffer[PATH_MAX_SIZE]; // WIN平台比较路径是否相同需要先转全小写
 #endif
-    // 收集路径的 scanlist 扫描器
+    // 收集路径的 scanlist 扫描器，并行打包时使用
     SCANNER_T *PathScanner;
+    OSSCAN_T *Scan;          // 边扫描边打包时的流式扫描
+    const char *ScannedPath; // 流式扫描取出的路径
     FILE *SubFileStream; // 打开子文件共用指针
     // 用于临时读写文件大小、文件名长度、文件名，也用于更新 ANYF 文件结构体的子文件信息表
     INFO_T InfoTemp;
-    BUFFER_T *BufferRW; // 文件读写缓冲区
+    BUFPOOL_T *Pool;    // 缓冲池，ANYF_T 未指定时使用临时的默认缓冲池
+    BUFFER_T *BufferRW; // 从缓冲池取出的文件读写缓冲块
+    BUFFER_T *Owned;    // 试取的压缩工作区
+    BATCH_T *Batch;     // 连续小文件和目录的合并写入批次，为NULL时逐个写入
+    int BatchTried;     // 尝试将子文件加入批次或固实块的结果
+    SOLID_T Solid = {-1LL, 0LL, 0LL, 0LL, NULL, NULL}; // 固实打包时正在填充的固实块，raw 为NULL时不使用固实块
+    int64_t WritebackMark; // 持久化模式下已开始写回的数据结束位置
+    int64_t PackStart;     // 本次打包写入的起始位置
+    int64_t PackEnd;       // 独占追加时本次打包写入的结束位置
+    int64_t Voided = 0LL;  // 并行打包时作废的子文件数量
+    int64_t Dictionaries = 0LL; // 本次打包写入的共享字典子文件数量
+    TRAINER_T Trainer = {NULL, NULL, 0ULL, 0ULL}; // 训练共享字典时取得的样本
+    HEAD_T DiskHead;       // 独占追加时锁定文件头后读到的文件头
+    bool Located;          // 独占追加时是否已确定追加位置
+    PACKED_T Packed;       // 继续中断的打包时已打包的子文件名
+    size_t Next;           // 并行打包时下一个未处理的扫描结果
+    int64_t Position;      // ANYF 文件指针当前位置
+    int64_t CheckpointMark; // 最近一次提交检查点时的写入位置
+    int64_t CountBefore = AnyfType->head.count;
+    int64_t Committed = CountBefore; // 已计入文件头的子文件数量
+    int64_t Started = AnyfNanoClock();
+    int64_t WaitedBefore = AnyfType->throttle ? AnyfType->throttle->waited : 0LL;
     if (!ToBePacked) {
         PRINT_ERROR_AND_ABORT("打包目标路径是空指针");
     } else if (!*ToBePacked) {
@@ -348,24 +2616,98 @@ ANYF_T *AnyfPack(const char *ToBePacked, bool Recursion, ANYF_T *AnyfType, bool
     }
     if (!OsPathExists(ToBePacked)) {
         printf(MESSAGE_ERROR "目标文件或目录不存在：%s\n", ToBePacked);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (AnyfType->head.count > 0LL && !Append) {
         printf(MESSAGE_WARN "此 ANYF 文件已包含%" I64_SPECIFIER "个子文件，但未指定追加打包\n", AnyfType->head.count);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     strcpy(AbsPathBuffer1, AnyfType->path);
     if (!OsPathNormpath(OsPathNormcase(AbsPathBuffer1), PATH_MAX_SIZE)) {
         WHETHER_CLOSE_REMOVE(AnyfType);
         PRINT_ERROR_AND_ABORT("获取标准形式路径失败");
     }
-    // 初始缓冲区大小 BUF_SIZE_L 字节
-    if (BufferRW = malloc(sizeof(BUFFER_T) + BUF_SIZE_L)) {
-        BufferRW->size = BUF_SIZE_L;
+    if (!(Pool = AnyfType->pool) && !(Pool = AnyfPoolMake(BUF_SIZE_L, BUF_SIZE_U))) {
+        WHETHER_CLOSE_REMOVE(AnyfType);
+        PRINT_ERROR_AND_ABORT("创建缓冲池失败");
+    }
+    if (!(BufferRW = AnyfPoolTake(Pool))) {
+        WHETHER_CLOSE_REMOVE(AnyfType);
+        PRINT_ERROR_AND_ABORT("从缓冲池取出文件读写缓冲块失败");
+    }
+    // 占位子文件信息要用扩展属性记录预留区域的大小
+    if (AnyfType->shared && !(AnyfType->head.feat & FEAT_EXTRA)) {
+        printf(MESSAGE_WARN "此 ANYF 文件格式较旧，不能与其他写入者同时追加，改为独占追加\n");
+        AnyfType->shared = false;
+    }
+    // 压缩方式同样记录在扩展属性中
+    if (AnyfType->codec != CODEC_NONE && !(AnyfType->head.feat & FEAT_EXTRA)) {
+        printf(MESSAGE_WARN "此 ANYF 文件格式较旧，不能保存压缩的子文件，改为按原样保存\n");
+        AnyfType->codec = CODEC_NONE;
+    }
+    // 缓冲块小于压缩工作区时，压缩工作区从缓冲池另取，--max-mem 过小则容纳不下
+    if (AnyfType->codec != CODEC_NONE) {
+        if (!CodecWorkArea(BufferRW, &Owned)) {
+            printf(MESSAGE_WARN "缓冲池没有足够的额度容纳压缩工作区，改为按原样保存\n");
+            AnyfType->codec = CODEC_NONE;
+        }
+        GiveWorkArea(Owned);
+    }
+    // 压缩后的大小写完才知道，不能预先规划预留区域和并行打包的布局
+    if (AnyfType->codec != CODEC_NONE && AnyfType->shared) {
+        printf(MESSAGE_WARN "压缩打包时不能与其他写入者同时追加，改为独占追加\n");
+        AnyfType->shared = false;
+    }
+    if (AnyfType->codec != CODEC_NONE && AnyfType->jobs > 1)
+        printf(MESSAGE_INFO "压缩打包时逐个写入子文件，[-j]选项用于扫描目录和分块并行压缩大于 1MB 的子文件\n");
+    if (AnyfType->solid > 0LL && AnyfType->codec == CODEC_NONE) {
+        printf(MESSAGE_WARN "固实块需要压缩，未指定压缩方式时不使用固实块\n");
+        AnyfType->solid = 0LL;
+    }
+    if (AnyfType->traindict && AnyfType->codec == CODEC_NONE) {
+        printf(MESSAGE_WARN "共享字典用于压缩，未指定压缩方式时不训练字典\n");
+        AnyfType->traindict = false;
+    }
+    // 截掉最后一个检查点之后的内容时不能有其他写入者正在其后写入
+    if (AnyfType->resume && AnyfType->shared) {
+        printf(MESSAGE_WARN "继续中断的打包时不能与其他写入者同时追加，改为独占追加\n");
+        AnyfType->shared = false;
+    }
+    AnyfType->stats.skipped = 0LL;
+    // 独占追加时整个打包过程锁定追加位置，从子文件信息链当前的结束位置写起，文件头只在开始和结束时短暂锁定
+    // 共享追加时只在预留和发布区域时短暂锁定
+    if (AnyfType->shared) {
+        AnyfType->stats.bytes = 0LL;
     } else {
+        if (!LockAppend(AnyfType) || !LockHead(AnyfType)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("锁定 ANYF 文件头失败");
+        }
+        Located = LocateTail(AnyfType, &DiskHead);
+        UnlockHead(AnyfType);
+        if (!Located || AnyfSeek(AnyfType->handle, AnyfType->tail, SEEK_SET)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("确定 ANYF 文件的追加位置失败");
+        }
+        // 最后一个检查点之后写入的内容不属于任何已计入的子文件，截掉后从检查点继续
+        if (AnyfType->resume) {
+            if (OsFileTruncate(AnyfType->handle, AnyfType->tail)) {
+                PRINT_ERROR_AND_ABORT("截断 ANYF 文件失败");
+            }
+            printf(MESSAGE_INFO "从检查点继续打包：已有%" I64_SPECIFIER "个子文件\n", AnyfType->known);
+        }
+    }
+    if (!AnyfType->resume) {
+        Packed.count = 0ULL;
+        Packed.names = NULL;
+        Packed.text = NULL;
+    } else if (!CollectPacked(AnyfType, &Packed)) {
         WHETHER_CLOSE_REMOVE(AnyfType);
-        PRINT_ERROR_AND_ABORT("为文件读写缓冲区分配初始内存失败");
+        PRINT_ERROR_AND_ABORT("为已打包的子文件名分配内存失败");
     }
+    if ((WritebackMark = AnyfTell(AnyfType->handle)) < 0LL)
+        WritebackMark = 0LL;
+    PackStart = CheckpointMark = WritebackMark;
     if (OsPathIsFile(ToBePacked)) {
         printf(MESSAGE_INFO "打包：%s\n", ToBePacked);
         if (OsPathAbsolutePath(AbsPathBuffer2, PATH_MAX_SIZE, ToBePacked)) {
@@ -381,69 +2723,58 @@ ANYF_T *AnyfPack(const char *ToBePacked, bool Recursion, ANYF_T *AnyfType, bool
         {
             WHETHER_CLOSE_REMOVE(AnyfType);
             printf(MESSAGE_ERROR "退出：此文件是当前 ANYF 文件\n");
-            exit(EXIT_CODE_SUCCESS);
+            AnyfAbort(EXIT_CODE_SUCCESS);
         }
         if (!OsPathBaseName(InfoTemp.fname, PATH_MAX_SIZE, AbsPathBuffer2)) {
             WHETHER_CLOSE_REMOVE(AnyfType);
             printf(MESSAGE_ERROR "获取子文件名失败：%s\n", AbsPathBuffer2);
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
 #ifdef _WIN32
         // WIN平台需要把文件名字符转为UTF8编码的字符串
         StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
 #endif // _WIN32
         InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
-        if (!(SubFileStream = fopen(ToBePacked, "rb"))) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            printf(MESSAGE_ERROR "打开子文件失败：%s\n", ToBePacked);
-            exit(EXIT_CODE_FAILURE);
-        }
-        AnyfSeek(SubFileStream, 0, SEEK_END);
-        InfoTemp.fsize = AnyfTell(SubFileStream);
-        rewind(SubFileStream); // 子文件读取大小后文件指针移回开头备用
-        // 无需将 ANYF 文件指针移至末尾，因为 AnyfOpen 或 AnyfMake 函数已将其移至末尾
-        if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            PRINT_ERROR_AND_ABORT("获取当前子文件信息起始偏移量失败");
-        }
-        // 将 INFO_T 结构体从第二个成员 fsize 开始写入文件，第一个成员 offset 不需要保存到文件
-        if (fwrite(&InfoTemp.fsize, FSIZE_FNLEN_SIZE + InfoTemp.fnlen, 1, AnyfType->handle) != 1) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            PRINT_ERROR_AND_ABORT("写入子文件属性失败");
-        }
-        if (InfoTemp.fsize > BUF_SIZE_U) {
-            if (!SubCopyToMain(SubFileStream, AnyfType->handle, &BufferRW)) {
-                WHETHER_CLOSE_REMOVE(AnyfType);
-                PRINT_ERROR_AND_ABORT("将子文件写入 ANYF 文件失败\n");
-            }
-        } else if (InfoTemp.fsize > 0) {
-            if (InfoTemp.fsize > BufferRW->size && !ExpandBUF(&BufferRW, InfoTemp.fsize)) {
-                WHETHER_CLOSE_REMOVE(AnyfType);
-                PRINT_ERROR_AND_ABORT("扩充文件读写缓冲区空间失败");
-            }
-            if (fread(BufferRW->fdata, InfoTemp.fsize, 1, SubFileStream) != 1) {
+        if (IsPacked(&Packed, InfoTemp.fname)) {
+            printf(MESSAGE_INFO "跳过：已在中断的打包中写入\n");
+        } else {
+            if (!(SubFileStream = fopen(ToBePacked, "rb"))) {
                 WHETHER_CLOSE_REMOVE(AnyfType);
-                PRINT_ERROR_AND_ABORT("读取子文件失败");
+                printf(MESSAGE_ERROR "打开子文件失败：%s\n", ToBePacked);
+                AnyfAbort(EXIT_CODE_FAILURE);
             }
-            if (fwrite(BufferRW, InfoTemp.fsize, 1, AnyfType->handle) != 1) {
-                WHETHER_CLOSE_REMOVE(AnyfType);
-                PRINT_ERROR_AND_ABORT("写入子文件失败");
+            AnyfSeek(SubFileStream, 0, SEEK_END);
+            InfoTemp.fsize = AnyfTell(SubFileStream);
+            rewind(SubFileStream); // 子文件读取大小后文件指针移回开头备用
+            if (AnyfType->cells <= AnyfType->head.count) {
+                if (!ExpandBOM(AnyfType, 1ULL)) {
+                    WHETHER_CLOSE_REMOVE(AnyfType);
+                    PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+                }
             }
-        }
-        fclose(SubFileStream);
-        AnyfSeek(AnyfType->handle, AnyfType->start + COUNT_OFFSET, SEEK_SET);
-        if (fwrite(&AnyfType->head.count, sizeof(int64_t), 1, AnyfType->handle) != 1) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            PRINT_ERROR_AND_ABORT("更新子文件数量失败");
-        }
-        AnyfSeek(AnyfType->handle, 0LL, SEEK_END);
-        if (AnyfType->cells <= AnyfType->head.count) {
-            if (!ExpandBOM(AnyfType, 1ULL)) {
-                WHETHER_CLOSE_REMOVE(AnyfType);
-                PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+            if (AnyfType->shared) {
+                if (!PackShared(AnyfType, SubFileStream, &InfoTemp, BufferRW)) {
+                    PRINT_ERROR_AND_ABORT("将子文件写入 ANYF 文件失败");
+                }
+                fclose(SubFileStream);
+                if (InfoTemp.extra.flags & ENTRY_VOID) {
+                    printf(MESSAGE_WARN "源文件在打包期间发生变化，已作废\n");
+                    ++Voided;
+                }
+                AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+            } else {
+                if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL) {
+                    WHETHER_CLOSE_REMOVE(AnyfType);
+                    PRINT_ERROR_AND_ABORT("获取当前子文件信息起始偏移量失败");
+                }
+                if (!PackFileEntry(AnyfType, SubFileStream, &InfoTemp, BufferRW, Pool)) {
+                    WHETHER_CLOSE_REMOVE(AnyfType);
+                    PRINT_ERROR_AND_ABORT("将子文件写入 ANYF 文件失败");
+                }
+                fclose(SubFileStream);
+                AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
             }
         }
-        AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
     } else if (OsPathIsDirectory(ToBePacked)) {
         if (OsPathAbsolutePath(AbsPathBuffer2, PATH_MAX_SIZE, ToBePacked)) {
             WHETHER_CLOSE_REMOVE(AnyfType);
@@ -458,159 +2789,278 @@ ANYF_T *AnyfPack(const char *ToBePacked, bool Recursion, ANYF_T *AnyfType, bool
             WHETHER_CLOSE_REMOVE(AnyfType);
             PRINT_ERROR_AND_ABORT("为子文件父目录缓冲区分配内存失败");
         }
-        printf(MESSAGE_INFO "扫描目录...\n");
-        if (!(PathScanner = OsPathMakeScanner(0))) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            PRINT_ERROR_AND_ABORT("创建路径扫描器失败");
-        }
-        if (OsPathScanPath(AbsPathBuffer2, OSPATH_BOTH, Recursion, &PathScanner)) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            printf(MESSAGE_ERROR "扫描目录失败：%s\n", AbsPathBuffer2);
-            exit(EXIT_CODE_FAILURE);
-        }
-        if (!ExpandBOM(AnyfType, PathScanner->count)) {
-            WHETHER_CLOSE_REMOVE(AnyfType);
-            PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
-        }
-        for (size_t i = 0; i < PathScanner->count; ++i) {
-            printf(MESSAGE_INFO "打包：%s\n", PathScanner->paths[i]);
-            if (OsPathIsDirectory(PathScanner->paths[i])) {
-                InfoTemp.fsize = DIR_SIZE; // 目录大小定义为DIR_SIZE
-                if (OsPathRelativePath(InfoTemp.fname, PATH_MAX_SIZE, PathScanner->paths[i], ParentDIR)) {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
-                    }
-                    printf(MESSAGE_WARN "跳过：获取子目录相对路径失败");
-                    continue;
+        // 新格式的 ANYF 文件可以标记作废的子文件，才能并行打包
+        // 并行打包要先知道所有子文件的大小才能规划布局，仍扫描完整个目录再开始
+        // 共享追加时整个目录树作为一个预留区域，同样先扫描完整个目录
+        if ((AnyfType->jobs > 1 && (AnyfType->head.feat & FEAT_EXTRA) && AnyfType->codec == CODEC_NONE) || AnyfType->shared) {
+            printf(MESSAGE_INFO "扫描目录...\n");
+            if (!(PathScanner = OsPathMakeScanner(0))) {
+                WHETHER_CLOSE_REMOVE(AnyfType);
+                PRINT_ERROR_AND_ABORT("创建路径扫描器失败");
+            }
+            // 扫描结果按名称排序，与线程数无关，同一目录树总是打包为相同的顺序
+            if (OsScanPath(AbsPathBuffer2, OSPATH_BOTH, Recursion, AnyfType->jobs, &PathScanner)) {
+                WHETHER_CLOSE_REMOVE(AnyfType);
+                printf(MESSAGE_ERROR "扫描目录失败：%s\n", AbsPathBuffer2);
+                AnyfAbort(EXIT_CODE_FAILURE);
+            }
+            if (!ExpandBOM(AnyfType, PathScanner->count)) {
+                WHETHER_CLOSE_REMOVE(AnyfType);
+                PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+            }
+            // 独占打包时分段规划和写入，每段写完提交一次检查点
+            for (Next = 0ULL; Next < PathScanner->count;) {
+                Voided += PackParallel(AnyfType, PathScanner, &Next, &Packed, ParentDIR, AbsPathBuffer1, Pool, BufferRW);
+                if (Next < PathScanner->count && !CommitCheckpoint(AnyfType, &Committed))
+                    printf(MESSAGE_WARN "提交检查点失败，继续打包\n");
+            }
+            OsPathDeleteScanner(PathScanner);
+        } else {
+            // 从扫描到的小文件中取样，取够后训练字典，不另外扫描目录
+            if (AnyfType->traindict)
+                StartTraining(AnyfType, &DiskHead, &Trainer);
+            // 后台线程扫描目录，扫描到的路径按与 OsScanPath 相同的顺序立即打包
+            if (!(Scan = OsScanStart(AbsPathBuffer2, OSPATH_BOTH, Recursion, AnyfType->jobs, 0ULL))) {
+                WHETHER_CLOSE_REMOVE(AnyfType);
+                printf(MESSAGE_ERROR "扫描目录失败：%s\n", AbsPathBuffer2);
+                AnyfAbort(EXIT_CODE_FAILURE);
+            }
+            // 固实块缓冲区计入 --max-mem 的上限
+            if (AnyfType->solid > 0LL) {
+                if (Solid.area = AnyfPoolTakeSized(Pool, (int64_t)SOLID_TABLE_MAX + AnyfType->solid))
+                    Solid.raw = Solid.area->fdata;
+                else
+                    printf(MESSAGE_WARN "缓冲池没有足够的额度容纳固实块，改为逐个压缩子文件\n");
+            }
+            // 缓冲池没有多余的缓冲块用于暂存数据块时不合并写入
+            if (Batch = malloc(sizeof(BATCH_T))) {
+                if (Batch->stage = AnyfPoolTake(Pool)) {
+                    BatchReset(Batch);
+                } else {
+                    free(Batch);
+                    Batch = NULL;
+                }
+            }
+            while (ScannedPath = OsScanNext(Scan)) {
+                StreamWriteback(AnyfType, &WritebackMark);
+                // 自上次检查点又写入了足够多的数据时，先写入固实块和批次，再提交检查点
+                if (AnyfType->checkpoint > 0LL && (Position = AnyfTell(AnyfType->handle)) >= 0LL && Position - CheckpointMark >= AnyfType->checkpoint) {
+                    if (Solid.raw)
+                        SolidFlush(AnyfType, &Solid, BufferRW);
+                    if (Batch)
+                        BatchFlush(AnyfType, Batch);
+                    if (!CommitCheckpoint(AnyfType, &Committed))
+                        printf(MESSAGE_WARN "提交检查点失败，继续打包\n");
+                    CheckpointMark = Position;
                 }
+                // 子文件总数在扫描结束前未知，信息表容量不足时成倍扩充
+                if (AnyfType->cells <= AnyfType->head.count && !ExpandBOM(AnyfType, (size_t)AnyfType->head.count)) {
+                    WHETHER_CLOSE_REMOVE(AnyfType);
+                    PRINT_ERROR_AND_ABORT("扩充子文件信息表容量失败");
+                }
+                printf(MESSAGE_INFO "打包：%s\n", ScannedPath);
+                if (OsPathIsDirectory(ScannedPath)) {
+                    InfoTemp.fsize = DIR_SIZE; // 目录大小定义为DIR_SIZE
+                    if (OsPathRelativePath(InfoTemp.fname, PATH_MAX_SIZE, ScannedPath, ParentDIR)) {
+                        printf(MESSAGE_WARN "跳过：获取子目录相对路径失败");
+                        continue;
+                    }
 #ifdef _WIN32
-                // WIN平台要把字符串转为UTF8编码写入文件
-                StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
+                    // WIN平台要把字符串转为UTF8编码写入文件
+                    StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
 #endif // _WIN32
-                InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
-                if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL) {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
+                    if (IsPacked(&Packed, InfoTemp.fname)) {
+                        printf(MESSAGE_INFO "跳过：已在中断的打包中写入\n");
+                        continue;
                     }
-                    printf(MESSAGE_WARN "跳过：获取当前子文件信息起始偏移量失败\n");
-                    continue;
-                }
-                // 按fsize、fnlen类型长度及fnlen值将finfo_tmp的一部分写入 ANYF 文件
-                if (fwrite(&InfoTemp.fsize, FSIZE_FNLEN_SIZE + InfoTemp.fnlen, 1, AnyfType->handle) != 1) {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
-                    } else {
+                    InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
+                    InitExtra(AnyfType, &InfoTemp);
+                    // 固实块打开期间的目录与其成员一起写入
+                    if (Solid.first >= 0LL) {
+                        InfoTemp.offset = -1LL;
+                        AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+                        continue;
+                    }
+                    if (Batch) {
+                        BatchMakeRoom(AnyfType, Batch, &InfoTemp, 0LL);
+                        if (!BatchPushHead(AnyfType, Batch, &InfoTemp)) {
+                            printf(MESSAGE_WARN "跳过：获取当前子文件信息起始偏移量失败\n");
+                            continue;
+                        }
+                        AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+                        continue;
+                    }
+                    if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL) {
+                        printf(MESSAGE_WARN "跳过：获取当前子文件信息起始偏移量失败\n");
+                        continue;
+                    }
+                    // 按fsize、fnlen类型长度及fnlen值将finfo_tmp的一部分写入 ANYF 文件
+                    if (!WriteEntryHead(AnyfType, &InfoTemp)) {
                         AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
+                        printf(MESSAGE_WARN "跳过：写入子文件属性失败\n");
+                        continue;
                     }
-                    printf(MESSAGE_WARN "跳过：写入子文件属性失败\n");
-                    continue;
-                }
-            } else {
+                } else {
 #ifndef _WIN32
-                if (!strcmp(AbsPathBuffer1, PathScanner->paths[i]))
+                    if (!strcmp(AbsPathBuffer1, ScannedPath))
 #else
-                strcpy(NormcasedBuffer, PathScanner->paths[i]);
-                if (!strcmp(AbsPathBuffer1, OsPathNormcase(NormcasedBuffer)))
+                    strcpy(NormcasedBuffer, ScannedPath);
+                    if (!strcmp(AbsPathBuffer1, OsPathNormcase(NormcasedBuffer)))
 #endif // _WIN32
-                {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
-                    }
-                    printf(MESSAGE_WARN "跳过：此文件是当前 ANYF 文件\n");
-                    continue;
-                }
-                if (OsPathRelativePath(InfoTemp.fname, PATH_MAX_SIZE, PathScanner->paths[i], ParentDIR)) {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
+                    {
+                        printf(MESSAGE_WARN "跳过：此文件是当前 ANYF 文件\n");
+                        continue;
                     }
-                    printf(MESSAGE_WARN "跳过：获取子文件相对路径失败\n");
-                    continue;
-                }
-                if (!(SubFileStream = fopen(PathScanner->paths[i], "rb"))) {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
+                    if (OsPathRelativePath(InfoTemp.fname, PATH_MAX_SIZE, ScannedPath, ParentDIR)) {
+                        printf(MESSAGE_WARN "跳过：获取子文件相对路径失败\n");
+                        continue;
                     }
-                    printf(MESSAGE_WARN "跳过：子文件打开失败\n");
-                    continue;
-                }
-                AnyfSeek(SubFileStream, 0, SEEK_END);
-                InfoTemp.fsize = (int64_t)AnyfTell(SubFileStream);
-                // 子文件读取大小后指针移回开头备用
-                rewind(SubFileStream);
 #ifdef _WIN32 // WIN平台需要将文件名编码转为UTF8保存
-                StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
+                    StringANSIToUTF8(InfoTemp.fname, PATH_MAX_SIZE, InfoTemp.fname);
 #endif // _WIN32
-                InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
-                if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL) {
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
-                    }
-                    fclose(SubFileStream);
-                    printf(MESSAGE_WARN "跳过：获取 ANYF 文件指针位置失败\n");
-                    continue;
-                }
-                if (fwrite(&InfoTemp.fsize, FSIZE_FNLEN_SIZE + InfoTemp.fnlen, 1, AnyfType->handle) != 1) {
-                    printf(MESSAGE_WARN "跳过：写入子文件属性失败\n");
-                    if (i >= PathScanner->count - 1) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
-                    } else {
-                        AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
+                    // 只比较文件名，已打包的源文件不再打开
+                    if (IsPacked(&Packed, InfoTemp.fname)) {
+                        printf(MESSAGE_INFO "跳过：已在中断的打包中写入\n");
+                        continue;
                     }
-                    fclose(SubFileStream);
-                    continue;
-                }
-                if (InfoTemp.fsize > BUF_SIZE_U) {
-                    if (!SubCopyToMain(SubFileStream, AnyfType->handle, &BufferRW)) {
-                        if (i >= PathScanner->count - 1) {
-                            WHETHER_CLOSE_REMOVE(AnyfType);
-                        } else {
-                            AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
-                        }
-                        fclose(SubFileStream);
-                        printf(MESSAGE_WARN "跳过：将子文件写入 ANYF 文件失败\n");
+                    if (!(SubFileStream = fopen(ScannedPath, "rb"))) {
+                        printf(MESSAGE_WARN "跳过：子文件打开失败\n");
                         continue;
                     }
-                } else if (InfoTemp.fsize > 0) { // 大小等于0的文件无需读写
-                    if (InfoTemp.fsize > BufferRW->size && !ExpandBUF(&BufferRW, InfoTemp.fsize)) {
-                        WHETHER_CLOSE_REMOVE(AnyfType);
-                        PRINT_ERROR_AND_ABORT("扩充文件读写缓冲区空间失败");
+                    AnyfSeek(SubFileStream, 0, SEEK_END);
+                    InfoTemp.fsize = (int64_t)AnyfTell(SubFileStream);
+                    // 子文件读取大小后指针移回开头备用
+                    rewind(SubFileStream);
+                    InfoTemp.fnlen = (int16_t)(strlen(InfoTemp.fname) + 1);
+                    // 样本取够时先写入批次和固实块，字典写在它们之后，从此子文件起使用字典
+                    if (Trainer.samples && TakeSample(&Trainer, SubFileStream, InfoTemp.fsize)) {
+                        if (Solid.raw)
+                            SolidFlush(AnyfType, &Solid, BufferRW);
+                        if (Batch)
+                            BatchFlush(AnyfType, Batch);
+                        Dictionaries = StoreDictionary(AnyfType, &Trainer);
                     }
-                    if (fread(BufferRW->fdata, InfoTemp.fsize, 1, SubFileStream) != 1) {
-                        if (i >= PathScanner->count - 1) {
-                            WHETHER_CLOSE_REMOVE(AnyfType);
+                    if (Solid.raw) {
+                        BatchTried = SolidPushFile(AnyfType, &Solid, Batch, SubFileStream, &InfoTemp, BufferRW);
+                        if (BatchTried == BATCH_QUEUED) {
+                            fclose(SubFileStream);
+                            AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+                            continue;
+                        } else if (BatchTried == BATCH_FAILED) {
+                            fclose(SubFileStream);
+                            printf(MESSAGE_WARN "跳过：读取子文件失败\n");
+                            continue;
                         }
+                        // 不加入固实块的子文件写入前先写入固实块，保持子文件在 ANYF 文件中的顺序
+                        SolidFlush(AnyfType, &Solid, BufferRW);
+                    }
+                    if (Batch) {
+                        BatchTried = BatchPushFile(AnyfType, Batch, SubFileStream, &InfoTemp);
+                        if (BatchTried == BATCH_QUEUED) {
+                            fclose(SubFileStream);
+                            AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+                            continue;
+                        } else if (BatchTried == BATCH_FAILED) {
+                            fclose(SubFileStream);
+                            printf(MESSAGE_WARN "跳过：读取子文件失败\n");
+                            continue;
+                        }
+                        // 单独写入前先写入已有的批次，保持子文件在 ANYF 文件中的顺序
+                        BatchFlush(AnyfType, Batch);
+                    }
+                    if ((InfoTemp.offset = AnyfTell(AnyfType->handle)) < 0LL) {
                         fclose(SubFileStream);
-                        printf(MESSAGE_WARN "跳过：读取子文件失败\n");
+                        printf(MESSAGE_WARN "跳过：获取 ANYF 文件指针位置失败\n");
                         continue;
                     }
-                    if (fwrite(BufferRW->fdata, InfoTemp.fsize, 1, AnyfType->handle) != 1) {
-                        if (i >= PathScanner->count - 1) {
-                            WHETHER_CLOSE_REMOVE(AnyfType);
-                        } else {
-                            AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
-                        }
+                    if (!PackFileEntry(AnyfType, SubFileStream, &InfoTemp, BufferRW, Pool)) {
+                        AnyfSeek(AnyfType->handle, InfoTemp.offset, SEEK_SET);
                         fclose(SubFileStream);
                         printf(MESSAGE_WARN "跳过：将子文件写入 ANYF 文件失败\n");
                         continue;
                     }
+                    fclose(SubFileStream);
                 }
-                fclose(SubFileStream);
+                AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
+            }
+            // 小文件不够多，直到扫描结束样本也没有取够时不使用字典
+            if (Trainer.samples) {
+                FinishTraining(&Trainer);
+                printf(MESSAGE_WARN "适合训练字典的小文件太少，不使用字典\n");
+            }
+            if (Solid.raw) {
+                SolidFlush(AnyfType, &Solid, BufferRW);
+                AnyfPoolGive(Pool, Solid.area);
+            }
+            if (Batch) {
+                BatchFlush(AnyfType, Batch);
+                AnyfPoolGive(Pool, Batch->stage);
+                free(Batch);
+            }
+            if (OsScanFinish(Scan)) {
+                WHETHER_CLOSE_REMOVE(AnyfType);
+                printf(MESSAGE_ERROR "扫描目录失败：%s\n", AbsPathBuffer2);
+                AnyfAbort(EXIT_CODE_FAILURE);
             }
-            AnyfType->sheet[AnyfType->head.count++] = InfoTemp;
         }
-        OsPathDeleteScanner(PathScanner);
     } else {
         WHETHER_CLOSE_REMOVE(AnyfType);
         printf(MESSAGE_ERROR "路径不是文件也不是目录：%s\n", ToBePacked);
-        exit(EXIT_CODE_FAILURE);
-    }
-    AnyfSeek(AnyfType->handle, AnyfType->start + COUNT_OFFSET, SEEK_SET);
-    if (fwrite(&AnyfType->head.count, sizeof(int64_t), 1, AnyfType->handle) != 1) {
-        WHETHER_CLOSE_REMOVE(AnyfType);
-        PRINT_ERROR_AND_ABORT("更新 ANYF 文件中的子文件数量失败");
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
-    if (BufferRW)
-        free(BufferRW);
+    AnyfType->stats.entries = AnyfType->head.count - CountBefore - Voided - Solid.blocks - Dictionaries;
+    // 共享追加时各区域已分别发布，写入的字节数在预留时累计
+    if (!AnyfType->shared) {
+        if ((PackEnd = AnyfTell(AnyfType->handle)) < 0LL) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("获取 ANYF 文件指针位置失败");
+        }
+        AnyfType->stats.bytes = PackEnd - PackStart;
+        // 持久化模式下先确保子文件数据落盘，再更新并同步子文件数量
+        // 任何时候崩溃，文件中的子文件数量都不会指向未写入磁盘的数据
+        if (AnyfType->durable && OsFileSyncData(AnyfType->handle)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("同步 ANYF 文件数据失败");
+        }
+        // 新增的特性标志与子文件数量一起生效
+        // 打包期间共享追加的写入者可能已发布区域，重新读取文件头，只加上本次打包的数量
+        // 读取者在此之前只能看到旧的子文件数量，之后看到的子文件数量指向的数据都已写入文件
+        if (!LockHead(AnyfType) || OsFilePRead(AnyfType->handle, &DiskHead, sizeof(HEAD_T), AnyfType->start)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("锁定 ANYF 文件头失败");
+        }
+        DiskHead.feat |= AnyfType->head.feat;
+        DiskHead.count += AnyfType->head.count - Committed;
+        if (!DiskHead.dict)
+            DiskHead.dict = AnyfType->head.dict;
+        // 信息表包含文件中全部子文件时更新 Merkle 根，其他写入者在打包期间追加过则不再记录
+        DiskHead.root = 0U;
+        DiskHead.leaves = 0LL;
+        if (DiskHead.count == AnyfType->head.count && (DiskHead.leaves = AnyfMerkleRoot(AnyfType, &DiskHead.root)) < 0LL) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("为计算 Merkle 根分配内存失败");
+        }
+        if (DiskHead.feat & FEAT_SHARED)
+            DiskHead.tail = PackEnd;
+        if (!StoreHead(AnyfType, &DiskHead)) {
+            WHETHER_CLOSE_REMOVE(AnyfType);
+            PRINT_ERROR_AND_ABORT("更新 ANYF 文件中的子文件数量失败");
+        }
+        if (AnyfType->durable && OsFileSyncData(AnyfType->handle)) {
+            PRINT_ERROR_AND_ABORT("同步 ANYF 文件中的子文件数量失败");
+        }
+        AnyfType->head.feat = DiskHead.feat;
+        AnyfType->tail = PackEnd;
+        AnyfType->known = DiskHead.count;
+        UnlockHead(AnyfType);
+        UnlockAppend(AnyfType);
+    }
+    FreePacked(&Packed);
+    AnyfType->stats.elapsed = AnyfNanoClock() - Started;
+    AnyfType->stats.throttled = AnyfType->throttle ? AnyfType->throttle->waited - WaitedBefore : 0LL;
+    AnyfPoolGive(Pool, BufferRW);
+    if (Pool != AnyfType->pool)
+        AnyfPoolDelete(Pool);
     return AnyfType;
 }
 
@@ -625,9 +3075,9 @@ ANYF_T *AnyfInfo(const char *AnyfPath) {
     char Delimiters1[EQUAL_MAX];     // 打印的子文件列表分隔符共用缓冲区
     char *Delimiters2, *Delimiters3; // 用于将上面缓冲区分离为三个字符串
     if (AnyfIsFakeJPEG(AnyfPath))
-        AnyfType = AnyfOpenFakeJPEG(AnyfPath);
+        AnyfType = AnyfOpenFakeJPEG(AnyfPath, true);
     else
-        AnyfType = AnyfOpen(AnyfPath);
+        AnyfType = AnyfOpen(AnyfPath, true);
     Spec = AnyfType->head.std;
     for (Index = 0; Index < AnyfType->head.count; ++Index) {
         NameLenTemp = strlen(AnyfType->sheet[Index].fname);
@@ -655,31 +3105,69 @@ ANYF_T *AnyfInfo(const char *AnyfPath) {
     Delimiters3[NameLenMax] = EMPTY_CHAR;
     printf("%s\t%s\t%s\n", Delimiters1, Delimiters2, Delimiters3);
     for (Index = 0; Index < AnyfType->head.count; ++Index) {
-        printf("%19" I64_SPECIFIER "\t%s\t%s\n", AnyfType->sheet[Index].fsize, AnyfType->sheet[Index].fsize < 0 ? "目录" : "文件", AnyfType->sheet[Index].fname);
+        if (AnyfType->sheet[Index].extra.flags & ENTRY_SKIP)
+            continue;
+        printf("%19" I64_SPECIFIER "\t%s\t%s\n", AnyfType->sheet[Index].fsize, AnyfType->sheet[Index].fsize < 0 ? "目录" : (AnyfType->sheet[Index].extra.flags & ENTRY_SPARSE ? "稀疏" : (AnyfType->sheet[Index].extra.flags & ENTRY_SOLID ? "固实" : (AnyfType->sheet[Index].extra.codec != CODEC_NONE ? "压缩" : "文件"))), AnyfType->sheet[Index].fname);
     }
     printf("\n ANYF 文件格式版本：");
     printf("%hd.%hd.%hd.%hd\t", Spec[0], Spec[1], Spec[2], Spec[3]);
     printf("包含条目总数：");
-    printf("%" I64_SPECIFIER "\n\n", AnyfType->head.count);
+    printf("%" I64_SPECIFIER "\n", AnyfType->head.count);
+    if (AnyfType->head.leaves > 0LL)
+        printf(" Merkle 根：%08X\t叶子数量：%" I64_SPECIFIER "\n\n", (unsigned)AnyfType->head.root, AnyfType->head.leaves);
+    else
+        printf(" Merkle 根：未记录\n\n");
     return AnyfType;
 }
 
+// 打印最近一次打包或提取的统计信息
+void AnyfPrintStats(const ANYF_T *AnyfType) {
+    const STATS_T *Stats = &AnyfType->stats;
+    printf(MESSAGE_INFO "统计：条目 %" I64_SPECIFIER " 个，%s %" I64_SPECIFIER " 字节，用时 %.3f 秒", Stats->entries, Stats->verified ? "读取并校验" : "写入", Stats->bytes, (double)Stats->elapsed / 1e9);
+    if (AnyfType->throttle)
+        printf("，限速等待 %.3f 秒", (double)Stats->throttled / 1e9);
+    if (AnyfType->codec != CODEC_NONE)
+        printf("，不可压缩而未压缩 %" I64_SPECIFIER " 字节", Stats->skipped);
+    if (Stats->corrupted > 0)
+        printf("，校验失败 %" I64_SPECIFIER " 个", Stats->corrupted);
+    if (Stats->unchecked > 0)
+        printf("，没有校验值 %" I64_SPECIFIER " 个", Stats->unchecked);
+    if (Stats->current > 0)
+        printf("，已是最新而跳过 %" I64_SPECIFIER " 个", Stats->current);
+    printf("\n");
+}
+
 // 从 ANYF 文件中提取子文件
 ANYF_T *AnyfExtract(const char *ToExtract, const char *Destination, int Overwrite, ANYF_T *AnyfType) {
     int64_t Index;  // 循环遍历子文件时的下标
     int64_t Offset; // 子文件信息在 ANYF 文件中的偏移量
 #ifdef _WIN32
-    static char NormcasedBuffer1[PATH_MAX_SIZE];
-    static char NormcasedBuffer2[PATH_MAX_SIZE];
+    char NormcasedBuffer1[PATH_MAX_SIZE];
 #endif
-    static char SubFilePathBuffer[PATH_MAX_SIZE];
-    static char SubFilePardirBuffer[PATH_MAX_SIZE];
-    BUFFER_T *BufferRW;      // 从 ANYF 文件提取到子文件时的读写缓冲区
+    const char *Wanted = ToExtract; // 要提取的子文件名，WIN平台转为全小写
+    char SubFilePathBuffer[PATH_MAX_SIZE];
+    char SubFilePardirBuffer[PATH_MAX_SIZE];
+    BUFPOOL_T *Pool;         // 缓冲池，ANYF_T 未指定时使用临时的默认缓冲池
+    BUFFER_T *BufferRW;      // 从 ANYF 文件提取到子文件时的读写缓冲块
     FILE *EachSubFileHandle; // 创建子文件时每个子文件的二进制文件流句柄
-    if (BufferRW = malloc(sizeof(BUFFER_T) + BUF_SIZE_L)) {
-        BufferRW->size = BUF_SIZE_L;
-    } else {
-        PRINT_ERROR_AND_ABORT("为文件读写缓冲区分配内存失败");
+    FSREF_T *FileSystems = NULL; // 持久化模式下提取的子文件所在的文件系统
+    size_t FileSystemCount = 0ULL;
+    // BufferRW 中已读入的 ANYF 文件范围，连续的小文件一次读入后分别写入各子文件
+    int64_t WindowStart = 0LL, WindowEnd = 0LL;
+    int64_t SpanEnd, SpanEntries;
+    SOLIDVIEW_T View = {-1LL, NULL, 0LL, 0LL, 0LL}; // 逐个提取时已解压的固实块
+    bool Ranged = AnyfType->rlength > 0LL;         // 只提取子文件的指定范围
+    int64_t Written;                               // 写入子文件的字节数
+    uint32_t Crc, *pCrc;                           // 写入子文件的内容的 CRC32C，只提取指定范围时不校验
+    bool Reread = false;                           // 判断目标文件是否最新时覆盖了 BufferRW 中已读入的内容
+    int64_t Started = AnyfNanoClock();
+    int64_t WaitedBefore = AnyfType->throttle ? AnyfType->throttle->waited : 0LL;
+    memset(&AnyfType->stats, 0, sizeof(STATS_T));
+    if (!(Pool = AnyfType->pool) && !(Pool = AnyfPoolMake(BUF_SIZE_L, BUF_SIZE_U))) {
+        PRINT_ERROR_AND_ABORT("创建缓冲池失败");
+    }
+    if (!(BufferRW = AnyfPoolTake(Pool))) {
+        PRINT_ERROR_AND_ABORT("从缓冲池取出文件读写缓冲块失败");
     }
     if (!Destination || !*Destination)
         Destination = PATH_CDIRS;
@@ -687,112 +3175,308 @@ ANYF_T *AnyfExtract(const char *ToExtract, const char *Destination, int Overwrit
         if (!OsPathExists(Destination)) {
             if (OsPathLastState()) {
                 fprintf(stderr, MESSAGE_ERROR "获取路径属性失败：%s\n", Destination);
-                exit(EXIT_CODE_FAILURE);
+                AnyfAbort(EXIT_CODE_FAILURE);
             }
             if (OsPathMakeDIR(Destination)) {
                 fprintf(stderr, MESSAGE_ERROR "创建目录失败：%s\n", Destination);
-                exit(EXIT_CODE_FAILURE);
+                AnyfAbort(EXIT_CODE_FAILURE);
             }
         } else if (!OsPathIsDirectory(Destination)) {
             fprintf(stderr, MESSAGE_ERROR "保存目录已被文件名占用：%s\n", Destination);
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     }
 #ifdef _WIN32
     if (ToExtract) {
         strcpy(NormcasedBuffer1, ToExtract);
-        OsPathNormcase(NormcasedBuffer1);
+        Wanted = OsPathNormcase(NormcasedBuffer1);
     }
 #endif
-    for (Index = 0; Index < AnyfType->head.count; ++Index) {
-        if (ToExtract) {
-#ifdef _WIN32
-            strcpy(NormcasedBuffer2, AnyfType->sheet[Index].fname);
-            if (strcmp(NormcasedBuffer1, OsPathNormcase(NormcasedBuffer2)))
-                continue;
-#else
-            if (strcmp(ToExtract, AnyfType->sheet[Index].fname))
-                continue;
-#endif
-        }
-        printf(MESSAGE_INFO "提取：%s\n", AnyfType->sheet[Index].fname);
-        if (OsPathJoinPath(SubFilePathBuffer, PATH_MAX_SIZE, 2, Destination, AnyfType->sheet[Index].fname)) {
-            printf(MESSAGE_WARN "跳过：拼接子文件完整路径失败\n");
-            continue;
-        }
-        if (AnyfType->sheet[Index].fsize < 0) {
-            if (OsPathExists(SubFilePathBuffer)) {
-                if (OsPathIsDirectory(AnyfType->sheet[Index].fname))
-                    continue;
-                printf(MESSAGE_WARN "跳过：目录名称已被文件占用s\n");
+    if (Ranged && !ToExtract) {
+        printf(MESSAGE_WARN "没有指定子文件名，忽略提取范围\n");
+        Ranged = false;
+    }
+    // 跳过已是最新的目标文件时，其余目标文件都应换成子文件的内容
+    if (AnyfType->update != UPDATE_NONE && !Ranged)
+        Overwrite = true;
+    // 只提取指定范围时通常只读少量数据，逐个提取即可
+    if (AnyfType->jobs > 1 && !Ranged) {
+        ExtractParallel(AnyfType, Wanted, Destination, Overwrite, Pool, BufferRW, &FileSystems, &FileSystemCount);
+    } else {
+        for (Index = 0; Index < AnyfType->head.count; ++Index) {
+            if (!IsWanted(&AnyfType->sheet[Index], Wanted))
                 continue;
-            }
-            if (OsPathMakeDIR(SubFilePathBuffer)) {
-                printf(MESSAGE_WARN "跳过：无法在此位置创建目录\n");
+            printf(MESSAGE_INFO "提取：%s\n", AnyfType->sheet[Index].fname);
+            if (OsPathJoinPath(SubFilePathBuffer, PATH_MAX_SIZE, 2, Destination, AnyfType->sheet[Index].fname)) {
+                printf(MESSAGE_WARN "跳过：拼接子文件完整路径失败\n");
                 continue;
             }
-        } else {
-            if (OsPathExists(SubFilePathBuffer)) {
-                if (OsPathIsDirectory(SubFilePathBuffer)) {
-                    printf(MESSAGE_WARN "跳过：文件路径已被目录占用：%s\n", SubFilePathBuffer);
+            if (AnyfType->sheet[Index].fsize < 0) {
+                if (UnpackDirectory(AnyfType, &AnyfType->sheet[Index], SubFilePathBuffer, &FileSystems, &FileSystemCount))
+                    ++AnyfType->stats.entries;
+            } else {
+                if (!Ranged && IsCurrent(AnyfType, &AnyfType->sheet[Index], SubFilePathBuffer, BufferRW, &Reread)) {
+                    printf(MESSAGE_INFO "跳过：文件已是最新：%s\n", SubFilePathBuffer);
+                    ++AnyfType->stats.current;
                     continue;
                 }
-                if (!Overwrite) {
-                    printf(MESSAGE_WARN "跳过：文件已存在但不允许覆盖：%s\n", SubFilePathBuffer);
-                    continue;
+                if (Reread) {
+                    WindowStart = WindowEnd = 0LL;
+                    Reread = false;
                 }
-            }
-            if (!OsPathDirName(SubFilePardirBuffer, PATH_MAX_SIZE, SubFilePathBuffer)) {
-                printf(MESSAGE_WARN "跳过：获取父级路径失败\n");
-                continue;
-            }
-            if (OsPathExists(SubFilePardirBuffer)) {
-                if (OsPathIsFile(SubFilePardirBuffer)) {
-                    printf(MESSAGE_WARN "跳过：目录路径已被文件占用：%s\n", SubFilePardirBuffer);
+                if (!PrepareSubPath(SubFilePathBuffer, Overwrite, SubFilePardirBuffer))
                     continue;
-                }
-            } else {
-                if (OsPathMakeDIR(SubFilePardirBuffer)) {
-                    printf(MESSAGE_WARN "跳过：目录创建失败：%s\n", SubFilePardirBuffer);
-                }
-            }
-            if (!(EachSubFileHandle = fopen(SubFilePathBuffer, "wb"))) {
-                printf(MESSAGE_WARN "跳过：子文件创建失败：%s\n", SubFilePathBuffer);
-                continue;
-            }
-            Offset = AnyfType->sheet[Index].offset + FSIZE_FNLEN_SIZE + AnyfType->sheet[Index].fnlen;
-            if (AnyfType->sheet[Index].fsize > BUF_SIZE_U) {
-                if (!MainCopyToSub(AnyfType->handle, Offset, AnyfType->sheet[Index].fsize, EachSubFileHandle, &BufferRW)) {
-                    printf(MESSAGE_WARN "跳过：写入子文件数据失败：%s\n", SubFilePathBuffer);
+                if (!(EachSubFileHandle = fopen(SubFilePathBuffer, "wb"))) {
+                    printf(MESSAGE_WARN "跳过：子文件创建失败：%s\n", SubFilePathBuffer);
                     continue;
                 }
-            } else if (AnyfType->sheet[Index].fsize > 0) {
-                if (BufferRW->size < AnyfType->sheet[Index].fsize) {
-                    if (!ExpandBUF(&BufferRW, AnyfType->sheet[Index].fsize)) {
-                        PRINT_ERROR_AND_ABORT("扩充文件读写缓冲区失败");
+                Offset = DataOffsetOf(&AnyfType->sheet[Index]);
+                Written = AnyfType->sheet[Index].fsize;
+                Crc = CRC32C_INIT;
+                pCrc = !Ranged && (AnyfType->sheet[Index].extra.flags & ENTRY_CRC) ? &Crc : NULL;
+                if (!Ranged && AnyfType->sheet[Index].fsize > 0 && IsStoredAsIs(&AnyfType->sheet[Index])) {
+                    // 不在已读入的范围内时，尝试把此子文件及其后连续的小文件一次读入
+                    if (Offset < WindowStart || Offset + AnyfType->sheet[Index].fsize > WindowEnd) {
+                        WindowStart = WindowEnd = 0LL;
+                        SpanEnd = SpanEndOf(AnyfType, Index, Wanted, BufferRW->size, &SpanEntries);
+                        if (SpanEntries > 1)
+                            AnyfThrottle(AnyfType->throttle, SpanEnd - Offset, 1LL);
+                        if (SpanEntries > 1 && !AnyfSeek(AnyfType->handle, Offset, SEEK_SET) && fread(BufferRW->fdata, (size_t)(SpanEnd - Offset), 1, AnyfType->handle) == 1) {
+                            WindowStart = Offset;
+                            WindowEnd = SpanEnd;
+                        }
                     }
                 }
-                if (AnyfSeek(AnyfType->handle, Offset, SEEK_SET)) {
-                    printf(MESSAGE_WARN "跳过：移动 ANYF 文件指针失败\n");
-                    continue;
+                if (Ranged) {
+                    if ((Written = ReadRange(AnyfType, &AnyfType->sheet[Index], AnyfType->roffset, AnyfType->rlength, NULL, EachSubFileHandle, BufferRW, &View)) < 0LL) {
+                        fclose(EachSubFileHandle);
+                        printf(MESSAGE_WARN "跳过：读取子文件的指定范围失败：%s\n", SubFilePathBuffer);
+                        continue;
+                    }
+                } else if (AnyfType->sheet[Index].fsize > 0 && IsStoredAsIs(&AnyfType->sheet[Index]) && Offset >= WindowStart && Offset + AnyfType->sheet[Index].fsize <= WindowEnd) {
+                    // 数据已在合并读取时计入限速，这里只计写入次数
+                    AnyfThrottle(AnyfType->throttle, 0LL, 1LL);
+                    if (pCrc)
+                        Crc = AnyfCrc32c(Crc, BufferRW->fdata + (Offset - WindowStart), (size_t)AnyfType->sheet[Index].fsize);
+                    if (fwrite(BufferRW->fdata + (Offset - WindowStart), (size_t)AnyfType->sheet[Index].fsize, 1, EachSubFileHandle) != 1) {
+                        fclose(EachSubFileHandle);
+                        printf(MESSAGE_WARN "跳过：写入子文件数据失败：%s\n", SubFilePathBuffer);
+                        continue;
+                    }
+                } else if (AnyfType->sheet[Index].fsize > 0) {
+                    // 逐个复制会覆盖 BufferRW 中已读入的内容
+                    WindowStart = WindowEnd = 0LL;
+                    if (AnyfType->sheet[Index].extra.flags & ENTRY_SPARSE) {
+                        if (!UnpackSparse(AnyfType->handle, Offset, EachSubFileHandle, &AnyfType->sheet[Index], BufferRW, AnyfType->throttle, pCrc)) {
+                            fclose(EachSubFileHandle);
+                            printf(MESSAGE_WARN "跳过：写入稀疏子文件数据失败：%s\n", SubFilePathBuffer);
+                            continue;
+                        }
+                    } else if (AnyfType->sheet[Index].extra.flags & ENTRY_SOLID) {
+                        if (!UnpackSolid(AnyfType->handle, AnyfType->head.feat, EachSubFileHandle, &AnyfType->sheet[Index], &View, BufferRW, AnyfType->throttle, pCrc)) {
+                            fclose(EachSubFileHandle);
+                            printf(MESSAGE_WARN "跳过：从固实块提取子文件数据失败：%s\n", SubFilePathBuffer);
+                            continue;
+                        }
+                    } else if (AnyfType->sheet[Index].extra.codec != CODEC_NONE) {
+                        if (!UnpackCoded(AnyfType->handle, Offset, EachSubFileHandle, &AnyfType->sheet[Index], DictOf(AnyfType, &AnyfType->sheet[Index]), BufferRW, AnyfType->throttle, pCrc)) {
+                            fclose(EachSubFileHandle);
+                            printf(MESSAGE_WARN "跳过：解压子文件数据失败：%s\n", SubFilePathBuffer);
+                            continue;
+                        }
+                    } else if (AnyfSeek(AnyfType->handle, Offset, SEEK_SET)) {
+                        fclose(EachSubFileHandle);
+                        printf(MESSAGE_WARN "跳过：移动 ANYF 文件指针失败\n");
+                        continue;
+                    } else if (!AnyfCopyWithPlan(AnyfType->handle, EachSubFileHandle, AnyfType->sheet[Index].fsize, BufferRW, AnyfProfilePlan(AnyfType->profile, AnyfType->sheet[Index].fsize), AnyfType->throttle, pCrc)) {
+                        fclose(EachSubFileHandle);
+                        printf(MESSAGE_WARN "跳过：写入子文件数据失败：%s\n", SubFilePathBuffer);
+                        continue;
+                    }
                 }
-                if (fread(BufferRW->fdata, AnyfType->sheet[Index].fsize, 1, AnyfType->handle) != 1) {
-                    printf(MESSAGE_WARN "跳过：读取子文件数据失败");
-                    continue;
+                if (AnyfType->durable) {
+#ifdef _WIN32
+                    // WIN平台不能按文件系统同步，逐个同步子文件
+                    if (OsFileSyncData(EachSubFileHandle))
+                        printf(MESSAGE_WARN "同步子文件数据失败：%s\n", SubFilePathBuffer);
+#else
+                    // 先开始写回，结束时按文件系统统一等待写回完成
+                    OsFileWriteback(EachSubFileHandle, 0LL, Written);
+                    if (!NoteFileSystem(&FileSystems, &FileSystemCount, SubFilePardirBuffer))
+                        printf(MESSAGE_WARN "记录子文件所在文件系统失败：%s\n", SubFilePathBuffer);
+#endif // _WIN32
                 }
-                if (fwrite(BufferRW->fdata, AnyfType->sheet[Index].fsize, 1, EachSubFileHandle) != 1) {
-                    printf(MESSAGE_WARN "跳过：写入子文件数据失败");
+                fclose(EachSubFileHandle);
+                AnyfType->stats.bytes += Written;
+                if (pCrc && Crc != AnyfType->sheet[Index].extra.crc) {
+                    printf(MESSAGE_WARN "子文件内容与校验值不符：%s\n", SubFilePathBuffer);
+                    ++AnyfType->stats.corrupted;
                     continue;
                 }
+                if (!Ranged && (AnyfType->sheet[Index].extra.flags & ENTRY_MTIME) && OsFileSetMtime(SubFilePathBuffer, AnyfType->sheet[Index].extra.mtime))
+                    printf(MESSAGE_WARN "恢复子文件修改时间失败：%s\n", SubFilePathBuffer);
+                ++AnyfType->stats.entries;
             }
-            fclose(EachSubFileHandle);
         }
     }
-    if (BufferRW)
-        free(BufferRW);
+    if (FileSystemCount > 0) {
+        printf(MESSAGE_INFO "同步%" I64_SPECIFIER "个文件系统...\n", (int64_t)FileSystemCount);
+        SyncFileSystems(FileSystems, FileSystemCount);
+    } else if (FileSystems) {
+        free(FileSystems);
+    }
+    if (View.raw)
+        free(View.raw);
+    AnyfType->stats.elapsed = AnyfNanoClock() - Started;
+    AnyfType->stats.throttled = AnyfType->throttle ? AnyfType->throttle->waited - WaitedBefore : 0LL;
+    AnyfPoolGive(Pool, BufferRW);
+    if (Pool != AnyfType->pool)
+        AnyfPoolDelete(Pool);
     return AnyfType;
 }
 
+// 用 AnyfType->jobs 个线程校验 ANYF 文件，ToVerify 不为NULL时只校验同名的子文件
+// 先由信息表重新计算 Merkle 根与文件头中记录的比较，确认信息表(含各子文件的校验值)未被改动
+// 再读取并解压各子文件的数据块与其校验值比较，不写入任何文件；分块压缩的子文件拆成多个任务，各线程同时解压不同的分块
+// 全部子文件的内容与校验值相符且 Merkle 根相符(或未记录)时返回 true
+bool AnyfVerify(const char *ToVerify, ANYF_T *AnyfType) {
+#ifdef _WIN32
+    char NormcasedBuffer1[PATH_MAX_SIZE];
+#endif
+    const char *Wanted = ToVerify; // 要校验的子文件名，WIN平台转为全小写
+    BUFPOOL_T *Pool;               // 缓冲池，ANYF_T 未指定时使用临时的默认缓冲池
+    BUFFER_T *BufferRW;            // 主线程使用的读写缓冲块
+    COPYSHARE_T Share;
+    COPYJOB_T *Jobs, *JobsTemp;
+    const INFO_T *Info;
+    size_t Count = 0ULL;
+    size_t Capacity = (size_t)(AnyfType->head.count > 0 ? AnyfType->head.count : 1);
+    int64_t Parts, Chunks, Leaves;
+    uint32_t Root;
+    bool RootMatched = true;
+    bool Whole; // 子文件的全部任务均已完成
+    int64_t Started = AnyfNanoClock();
+    int64_t WaitedBefore = AnyfType->throttle ? AnyfType->throttle->waited : 0LL;
+    memset(&AnyfType->stats, 0, sizeof(STATS_T));
+    AnyfType->stats.verified = true;
+    if ((Leaves = AnyfMerkleRoot(AnyfType, &Root)) < 0LL) {
+        PRINT_ERROR_AND_ABORT("为计算 Merkle 根分配内存失败");
+    }
+    if (!AnyfType->head.leaves) {
+        printf(MESSAGE_INFO "文件头中没有记录 Merkle 根，信息表计算得到：%08X(%" I64_SPECIFIER " 个叶子)\n", (unsigned)Root, Leaves);
+    } else if (AnyfType->head.leaves != Leaves || AnyfType->head.root != Root) {
+        printf(MESSAGE_WARN "Merkle 根与文件头中记录的不符：记录 %08X(%" I64_SPECIFIER " 个叶子)，计算得到 %08X(%" I64_SPECIFIER " 个叶子)\n", (unsigned)AnyfType->head.root, AnyfType->head.leaves, (unsigned)Root, Leaves);
+        RootMatched = false;
+    } else {
+        printf(MESSAGE_INFO "Merkle 根相符：%08X(%" I64_SPECIFIER " 个叶子)\n", (unsigned)Root, Leaves);
+    }
+    if (!(Pool = AnyfType->pool) && !(Pool = AnyfPoolMake(BUF_SIZE_L, BUF_SIZE_U))) {
+        PRINT_ERROR_AND_ABORT("创建缓冲池失败");
+    }
+    if (!(BufferRW = AnyfPoolTake(Pool))) {
+        PRINT_ERROR_AND_ABORT("从缓冲池取出文件读写缓冲块失败");
+    }
+#ifdef _WIN32
+    if (ToVerify) {
+        strcpy(NormcasedBuffer1, ToVerify);
+        Wanted = OsPathNormcase(NormcasedBuffer1);
+    }
+#endif
+    if (!(Jobs = malloc(Capacity * sizeof(COPYJOB_T)))) {
+        PRINT_ERROR_AND_ABORT("为并行校验任务表分配内存失败");
+    }
+    for (int64_t Index = 0; Index < AnyfType->head.count; ++Index) {
+        Info = &AnyfType->sheet[Index];
+        if (!IsWanted(Info, Wanted) || Info->fsize <= 0)
+            continue;
+        if (!(Info->extra.flags & ENTRY_CRC))
+            ++AnyfType->stats.unchecked;
+        Chunks = Info->extra.flags & ENTRY_CHUNKED ? ChunkCountOf(Info) : 0LL;
+        Parts = Chunks < (int64_t)AnyfType->jobs ? Chunks : (int64_t)AnyfType->jobs;
+        if (Parts < 1LL)
+            Parts = 1LL;
+        if (Count + (size_t)Parts > Capacity) {
+            Capacity = (Count + (size_t)Parts) * 2;
+            if (!(JobsTemp = realloc(Jobs, Capacity * sizeof(COPYJOB_T)))) {
+                PRINT_ERROR_AND_ABORT("为并行校验任务表分配内存失败");
+            }
+            Jobs = JobsTemp;
+        }
+        for (int64_t Part = 0; Part < Parts; ++Part) {
+            Jobs[Count].path = NULL;
+            Jobs[Count].index = Index;
+            Jobs[Count].size = Info->extra.flags & ENTRY_SOLID ? -1LL : Info->extra.stored / Parts;
+            Jobs[Count].first = Parts > 1LL ? Chunks * Part / Parts : 0LL;
+            Jobs[Count].last = Parts > 1LL ? Chunks * (Part + 1) / Parts : 0LL;
+            Jobs[Count].done = false;
+            Jobs[Count++].name = Info->fname;
+        }
+    }
+    qsort(Jobs, Count, sizeof(COPYJOB_T), CompareJobSize);
+    Share.anyf = AnyfType;
+    Share.jobs = Jobs;
+    Share.count = Count;
+    RunCopyWorkers(&Share, ExtractWorker, Pool, BufferRW, &AnyfType->stats.entries, &AnyfType->stats.bytes);
+    CheckJobs(AnyfType, Jobs, Count);
+    // 数据块读取或解压失败的子文件同样计入校验失败，CheckJobs 已按信息表顺序排列任务，同一子文件的任务相邻
+    for (size_t Start = 0ULL, Next; Start < Count; Start = Next) {
+        Whole = true;
+        for (Next = Start; Next < Count && Jobs[Next].index == Jobs[Start].index; ++Next)
+            Whole = Whole && Jobs[Next].done;
+        if (Whole)
+            continue;
+        // 第一个任务完成时已计入成功的条目
+        if (Jobs[Start].done)
+            --AnyfType->stats.entries;
+        ++AnyfType->stats.corrupted;
+    }
+    free(Jobs);
+    AnyfType->stats.elapsed = AnyfNanoClock() - Started;
+    AnyfType->stats.throttled = AnyfType->throttle ? AnyfType->throttle->waited - WaitedBefore : 0LL;
+    AnyfPoolGive(Pool, BufferRW);
+    if (Pool != AnyfType->pool)
+        AnyfPoolDelete(Pool);
+    return RootMatched && !AnyfType->stats.corrupted;
+}
+
+// 读取名为 SubName 的子文件中从 Offset 起的 Length 字节到 Buffer，超出子文件末尾的部分不读
+// 同名子文件读取第一个，与不允许覆盖时提取的结果相同；原样保存的子文件只读一次，压缩的子文件只解压与范围重叠的分块
+// 成功返回读取的字节数，找不到子文件、子文件是目录、范围无效或读取失败返回-1
+int64_t AnyfReadRange(ANYF_T *AnyfType, const char *SubName, int64_t Offset, int64_t Length, void *Buffer) {
+#ifdef _WIN32
+    char NormcasedBuffer[PATH_MAX_SIZE];
+#endif
+    const char *Wanted = SubName;
+    SOLIDVIEW_T View = {-1LL, NULL, 0LL, 0LL, 0LL};
+    BUFPOOL_T *Pool;
+    BUFFER_T *Chunk;
+    int64_t Index, Result = -1LL;
+    if (!SubName || !Buffer)
+        return -1LL;
+#ifdef _WIN32
+    if (strlen(SubName) >= PATH_MAX_SIZE)
+        return -1LL;
+    Wanted = OsPathNormcase(strcpy(NormcasedBuffer, SubName));
+#endif
+    for (Index = 0; Index < AnyfType->head.count && !IsWanted(&AnyfType->sheet[Index], Wanted); ++Index)
+        ;
+    if (Index >= AnyfType->head.count || AnyfType->sheet[Index].fsize < 0)
+        return -1LL;
+    if (!(Pool = AnyfType->pool) && !(Pool = AnyfPoolMake(BUF_SIZE_L, BUF_SIZE_U))) {
+        PRINT_ERROR_AND_ABORT("创建缓冲池失败");
+    }
+    if (!(Chunk = AnyfPoolTake(Pool))) {
+        PRINT_ERROR_AND_ABORT("从缓冲池取出文件读写缓冲块失败");
+    }
+    Result = ReadRange(AnyfType, &AnyfType->sheet[Index], Offset, Length, Buffer, NULL, Chunk, &View);
+    if (View.raw)
+        free(View.raw);
+    AnyfPoolGive(Pool, Chunk);
+    if (Pool != AnyfType->pool)
+        AnyfPoolDelete(Pool);
+    return Result;
+}
+
 // 创建空的伪装的 JPEG 文件
 ANYF_T *AnyfMakeFakeJPEG(const char *AnyfPath, const char *JPEGPath, bool Overwrite) {
     ANYF_T *AnyfType;               // ANYF 文件信息结构体
@@ -805,7 +3489,7 @@ ANYF_T *AnyfMakeFakeJPEG(const char *AnyfPath, const char *JPEGPath, bool Overwr
     char PathBuffer[PATH_MAX_SIZE]; // 绝对路径及父目录缓冲
     if (OsPathAbsolutePath(PathBuffer, PATH_MAX_SIZE, AnyfPath)) {
         printf(MESSAGE_ERROR "无法获取 ANYF 文件绝对路径：%s\n", AnyfPath);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     printf(MESSAGE_INFO "创建文件：%s\n", PathBuffer);
     AnyfPathCopied = malloc(strlen(PathBuffer) + 1ULL);
@@ -816,36 +3500,36 @@ ANYF_T *AnyfMakeFakeJPEG(const char *AnyfPath, const char *JPEGPath, bool Overwr
     if (OsPathExists(AnyfPathCopied)) {
         if (OsPathIsDirectory(AnyfPathCopied)) {
             printf(MESSAGE_ERROR "此位置已存在同名目录\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         } else if (OsPathLastState()) {
             printf(MESSAGE_ERROR "获取路径属性失败\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         } else if (!Overwrite) {
             printf(MESSAGE_ERROR "已存在同名文件但未指示覆盖\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     } else if (OsPathLastState()) {
         printf(MESSAGE_ERROR "无法检查此路径是否存在\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (!OsPathDirName(PathBuffer, PATH_MAX_SIZE, PathBuffer)) {
         printf(MESSAGE_ERROR "获取 ANYF 文件的父目录路径失败\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (!OsPathExists(PathBuffer)) {
         if (OsPathMakeDIR(PathBuffer)) {
             printf(MESSAGE_ERROR "为 ANYF 文件创建目录失败\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     } else if (!OsPathIsDirectory(PathBuffer)) {
         printf(MESSAGE_ERROR "父目录名已被文件名占用：%s\n", PathBuffer);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (!OsPathIsFile(JPEGPath)) {
         printf(MESSAGE_ERROR "指定的图片路径不是一个文件或不存在：%s\n", JPEGPath);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
-    if (!(AnyfHandle = fopen(AnyfPathCopied, "wb"))) {
+    if (!(AnyfHandle = fopen(AnyfPathCopied, "w+b"))) {
         PRINT_ERROR_AND_ABORT(" ANYF 文件创建失败");
     }
     if (!(JPEGHandle = fopen(JPEGPath, "rb"))) {
@@ -862,52 +3546,40 @@ ANYF_T *AnyfMakeFakeJPEG(const char *AnyfPath, const char *JPEGPath, bool Overwr
         fclose(AnyfHandle), remove(AnyfPathCopied);
         PRINT_ERROR_AND_ABORT("读取 JPEG 文件大小失败");
     }
-    if (BufferRW = malloc(sizeof(BUFFER_T) + BUF_SIZE_L)) {
-        BufferRW->size = BUF_SIZE_L;
+    if (BufferRW = malloc(sizeof(BUFFER_T) + JPEG_SCAN_SIZE)) {
+        BufferRW->size = JPEG_SCAN_SIZE;
+        BufferRW->pool = NULL;
     } else {
-        fclose(AnyfHandle), remove(AnyfPathCopied);
+        fclose(JPEGHandle);
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
         PRINT_ERROR_AND_ABORT("为文件读写缓冲区分配内存失败");
     }
-    JPEGNetSize = RealSizeOfJPEG(JPEGHandle, FakeJPEGSize, &BufferRW);
+    JPEGNetSize = RealSizeOfJPEG(JPEGHandle, FakeJPEGSize, BufferRW);
     rewind(JPEGHandle);
+    // 中止前释放缓冲区、关闭两个文件流并删除未完成的 ANYF 文件
     if (JPEGNetSize == JPEG_INVALID) {
+        free(BufferRW), fclose(JPEGHandle);
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
         printf(MESSAGE_WARN "无效的 JPEG 文件：%s\n", JPEGPath);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     } else if (JPEGNetSize == JPEG_ERROR) {
+        free(BufferRW), fclose(JPEGHandle);
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
         PRINT_ERROR_AND_ABORT("验证 JPEG 文件过程中发生错误");
     }
-    if (FakeJPEGSize > BUF_SIZE_U) {
-        if (!SubCopyToMain(JPEGHandle, AnyfHandle, &BufferRW)) {
-            fclose(JPEGHandle);
-            fclose(AnyfHandle), remove(AnyfPathCopied);
-            PRINT_ERROR_AND_ABORT("复制 JPEG 文件到 ANYF 文件失败");
-        }
-    } else {
-        if (FakeJPEGSize > BufferRW->size) {
-            if (!ExpandBUF(&BufferRW, FakeJPEGSize)) {
-                fclose(JPEGHandle);
-                fclose(AnyfHandle), remove(AnyfPathCopied);
-                PRINT_ERROR_AND_ABORT("为文件读写缓冲区扩充内存失败");
-            }
-        }
-        if (fread(BufferRW->fdata, FakeJPEGSize, 1, JPEGHandle) != 1) {
-            fclose(JPEGHandle);
-            fclose(AnyfHandle), remove(AnyfPathCopied);
-            PRINT_ERROR_AND_ABORT("读取 JPEG 文件失败");
-        }
-        if (fwrite(BufferRW->fdata, FakeJPEGSize, 1, AnyfHandle) != 1) {
-            fclose(JPEGHandle);
-            fclose(AnyfHandle), remove(AnyfPathCopied);
-            PRINT_ERROR_AND_ABORT("复制 JPEG 文件到 ANYF 文件失败");
-        }
+    if (!CopyStream(JPEGHandle, AnyfHandle, FakeJPEGSize, BufferRW, NULL, NULL)) {
+        free(BufferRW), fclose(JPEGHandle);
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
+        PRINT_ERROR_AND_ABORT("复制 JPEG 文件到 ANYF 文件失败");
     }
     fclose(JPEGHandle);
+    free(BufferRW);
     if (AnyfSeek(AnyfHandle, JPEGNetSize, SEEK_SET)) {
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
         PRINT_ERROR_AND_ABORT("移动 JPEG 文件指针失败");
     }
     if (fwrite(&DEFAULT_HEAD, sizeof(HEAD_T), 1, AnyfHandle) != 1) {
-        fclose(JPEGHandle);
-        fclose(AnyfHandle), remove(AnyfPathCopied);
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
         PRINT_ERROR_AND_ABORT("写入 ANYF 文件头信息失败");
     }
     // 最后一次写入后 ANYF 文件的文件指针已移至末尾不需再移
@@ -918,17 +3590,36 @@ ANYF_T *AnyfMakeFakeJPEG(const char *AnyfPath, const char *JPEGPath, bool Overwr
         AnyfType->cells = 0LL;
         AnyfType->path = AnyfPathCopied;
         AnyfType->handle = AnyfHandle;
-        if (BufferRW)
-            free(BufferRW);
+        AnyfType->pool = NULL;
+        AnyfType->durable = false;
+        AnyfType->profile = NULL;
+        AnyfType->throttle = NULL;
+        AnyfType->jobs = 1;
+        AnyfType->shared = false;
+        AnyfType->codec = CODEC_NONE;
+        AnyfType->level = 0;
+        AnyfType->solid = 0LL;
+        AnyfType->roffset = AnyfType->rlength = 0LL;
+        AnyfType->traindict = false;
+        AnyfType->checkpoint = 0LL;
+        AnyfType->resume = false;
+        AnyfType->update = UPDATE_NONE;
+        AnyfType->loaded = 0LL;
+        AnyfType->dict.data = NULL;
+        AnyfType->dict.size = 0ULL;
+        AnyfType->tail = (int64_t)(AnyfType->start + SUBDATA_OFFSET);
+        AnyfType->known = 0LL;
+        memset(&AnyfType->stats, 0, sizeof(STATS_T));
+        TrackOpened(AnyfType, NULL);
         return AnyfType;
     } else {
-        fclose(AnyfHandle), remove(AnyfPathCopied);
+        fclose(AnyfHandle), remove(AnyfPathCopied), free(AnyfPathCopied);
         PRINT_ERROR_AND_ABORT("为 ANYF 文件信息结构体分配内存失败");
     }
 }
 
-// 打开已存在的伪装的 JPEG 文件
-ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath) {
+// 打开已存在的伪装的 JPEG 文件，ReadOnly 同 AnyfOpen
+ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath, bool ReadOnly) {
     ANYF_T *AnyfType;               // ANYF 文件信息结构体
     HEAD_T HeadTemp;                // 临时 ANYF 文件头
     INFO_T *SubFilesBOM;            // 子文件信息表
@@ -936,12 +3627,13 @@ ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath) {
     char PathBuffer[PATH_MAX_SIZE]; // 绝对路径及父目录缓冲
     char *AnyfPathCopied;           // 拷贝路径用于结构体
     int64_t CellsNum = 0LL;         // 子文件信息表容量
+    int64_t ChainEnd;               // 子文件信息链的结束位置
     BUFFER_T *BufferRW;             // 文件读写缓冲区
     int64_t FakeJPEGSize;           // JPEG 文件的总大小
     int64_t JPEGNetSize;            // JPEG 文件净大小
     if (OsPathAbsolutePath(PathBuffer, PATH_MAX_SIZE, FakeJPEGPath)) {
         printf(MESSAGE_ERROR "无法获取文件绝对路径：%s\n", FakeJPEGPath);
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     printf(MESSAGE_INFO "打开文件：%s\n", PathBuffer);
     AnyfPathCopied = malloc(strlen(PathBuffer) + 1ULL);
@@ -952,51 +3644,62 @@ ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath) {
     if (!OsPathIsFile(AnyfPathCopied)) {
         if (OsPathLastState()) {
             printf(MESSAGE_ERROR "获取 ANYF 文件路径属性失败\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         } else {
             printf(MESSAGE_ERROR "此路径不是一个文件路径\n");
-            exit(EXIT_CODE_FAILURE);
+            AnyfAbort(EXIT_CODE_FAILURE);
         }
     }
-    if (BufferRW = malloc(sizeof(BUFFER_T) + BUF_SIZE_L)) {
-        BufferRW->size = BUF_SIZE_L;
+    if (BufferRW = malloc(sizeof(BUFFER_T) + JPEG_SCAN_SIZE)) {
+        BufferRW->size = JPEG_SCAN_SIZE;
+        BufferRW->pool = NULL;
     } else {
         PRINT_ERROR_AND_ABORT("为文件读写缓冲区分配内存失败");
     }
-    if (!(AnyfHandle = fopen(AnyfPathCopied, "r+b"))) {
+    if (!(AnyfHandle = fopen(AnyfPathCopied, ReadOnly ? "rb" : "r+b"))) {
         printf(MESSAGE_ERROR " ANYF 文件打开失败\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
+    TrackOpened(NULL, AnyfHandle);
     if (AnyfSeek(AnyfHandle, 0LL, SEEK_END)) {
         PRINT_ERROR_AND_ABORT("无法移动文件指针至末尾");
     }
     if ((FakeJPEGSize = AnyfTell(AnyfHandle)) < 0) {
         PRINT_ERROR_AND_ABORT("获取伪装为 JPEG 的 ANYF 文件大小失败");
     }
-    JPEGNetSize = RealSizeOfJPEG(AnyfHandle, FakeJPEGSize, &BufferRW);
+    JPEGNetSize = RealSizeOfJPEG(AnyfHandle, FakeJPEGSize, BufferRW);
+    free(BufferRW);
     if (JPEGNetSize == JPEG_INVALID) {
         printf(MESSAGE_WARN "当前 ANYF 文件没有伪装为 JPEG 文件\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     } else if (JPEGNetSize == JPEG_ERROR) {
         printf(MESSAGE_ERROR "验证伪装为 JPEG 的 ANYF 文件过程中发生错误\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     // 计算 JPEG 总大小与净大小之差是否大于 HeadTemp 的大小
     // 目的是确认 JPEG 文件末尾是否至少含有 ANYF 文件头大小的其他数据
     if (FakeJPEGSize - JPEGNetSize <= sizeof(HeadTemp)) {
         printf(MESSAGE_ERROR "指定的 JPEG 文件内不包含 ANYF 文件\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (AnyfSeek(AnyfHandle, JPEGNetSize, SEEK_SET)) {
         printf(MESSAGE_ERROR "移动文件指针失败\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
+    }
+    // 与 AnyfOpen 相同，读取文件头和子文件信息链期间共享锁定文件头
+    if (OsFileLock(AnyfHandle, HEAD_LOCK_OFFSET, LOCK_SIZE, false)) {
+        PRINT_ERROR_AND_ABORT("锁定 ANYF 文件头失败");
     }
     if (fread(&HeadTemp, sizeof(HeadTemp), 1, AnyfHandle) != 1) {
         PRINT_ERROR_AND_ABORT("读取 ANYF 文件头失败");
     }
     if (memcmp(DEFAULT_HEAD.id, HeadTemp.id, sizeof(DEFAULT_HEAD.id))) {
         printf(MESSAGE_ERROR "指定的 JPEG 文件内不包含 ANYF 文件\n");
-        exit(EXIT_CODE_FAILURE);
+        AnyfAbort(EXIT_CODE_FAILURE);
+    }
+    if (HeadTemp.feat & ~FEAT_KNOWN) {
+        printf(MESSAGE_ERROR "此 ANYF 文件使用了不支持的特性，请更新程序\n");
+        AnyfAbort(EXIT_CODE_FAILURE);
     }
     if (HeadTemp.count > 0)
         CellsNum = HeadTemp.count;
@@ -1019,16 +3722,29 @@ ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath) {
         if (fread(SubFilesBOM[i].fname, SubFilesBOM[i].fnlen, 1, AnyfHandle) != 1) {
             PRINT_ERROR_AND_ABORT("从 ANYF 文件读取子文件名失败");
         }
+        if (HeadTemp.feat & FEAT_EXTRA) {
+            if (!ReadExtra(AnyfHandle, &SubFilesBOM[i].extra)) {
+                PRINT_ERROR_AND_ABORT("读取子文件扩展属性失败");
+            }
+        } else {
+            SubFilesBOM[i].extra.xsize = 0;
+            SubFilesBOM[i].extra.flags = 0;
+            SubFilesBOM[i].extra.stored = SubFilesBOM[i].fsize > 0 ? SubFilesBOM[i].fsize : 0LL;
+        }
+        // 叶子值按文件中的(UTF8编码)文件名计算，WIN平台转为ANSI编码后的文件名不能用于计算
+        SubFilesBOM[i].leaf = MerkleLeaf(&SubFilesBOM[i]);
 #ifdef _WIN32
         StringUTF8ToANSI(SubFilesBOM[i].fname, PMS, SubFilesBOM[i].fname);
 #endif // _WIN32
-       // 遇到目录(大小是-1)或文件大小为0时没有数据块不需要移动文件指针
-        if (SubFilesBOM[i].fsize <= 0)
+        // 遇到目录(大小是-1)或文件大小为0等没有数据块的情况不需要移动文件指针
+        if (SubFilesBOM[i].extra.stored <= 0)
             continue;
-        if (AnyfSeek(AnyfHandle, SubFilesBOM[i].fsize, SEEK_CUR)) {
+        if (AnyfSeek(AnyfHandle, SubFilesBOM[i].extra.stored, SEEK_CUR)) {
             PRINT_ERROR_AND_ABORT("移动文件指针至下一个位置失败");
         }
     }
+    ChainEnd = AnyfTell(AnyfHandle);
+    OsFileUnlock(AnyfHandle, HEAD_LOCK_OFFSET, LOCK_SIZE);
     // 默认将文件指针置于末尾
     AnyfSeek(AnyfHandle, 0, SEEK_END);
     if (AnyfType = malloc(sizeof(ANYF_T))) {
@@ -1038,6 +3754,30 @@ ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath) {
         AnyfType->cells = CellsNum;
         AnyfType->path = AnyfPathCopied;
         AnyfType->handle = AnyfHandle;
+        AnyfType->pool = NULL;
+        AnyfType->durable = false;
+        AnyfType->profile = NULL;
+        AnyfType->throttle = NULL;
+        AnyfType->jobs = 1;
+        AnyfType->shared = false;
+        AnyfType->codec = CODEC_NONE;
+        AnyfType->level = 0;
+        AnyfType->solid = 0LL;
+        AnyfType->roffset = AnyfType->rlength = 0LL;
+        AnyfType->traindict = false;
+        AnyfType->checkpoint = 0LL;
+        AnyfType->resume = false;
+        AnyfType->update = UPDATE_NONE;
+        AnyfType->loaded = HeadTemp.count;
+        AnyfType->dict.data = NULL;
+        AnyfType->dict.size = 0ULL;
+        AnyfType->tail = ChainEnd;
+        AnyfType->known = HeadTemp.count;
+        memset(&AnyfType->stats, 0, sizeof(STATS_T));
+        // 共享字典在打开时读入一次，提取和追加打包时直接使用
+        if ((HeadTemp.feat & FEAT_DICT) && !LoadDictionary(AnyfType, HeadTemp.feat, HeadTemp.dict))
+            printf(MESSAGE_WARN "读取共享字典失败，使用字典压缩的子文件无法提取\n");
+        TrackOpened(AnyfType, NULL);
         return AnyfType;
     } else {
         free(SubFilesBOM), free(AnyfPathCopied);
@@ -1,12 +1,21 @@
 #ifndef __ANYF_H
 #define __ANYF_H
 #include <limits.h>
+#include <setjmp.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "../osfile/osfile.h"
 #include "../ospath/ospath.h"
+#include "../osscan/osscan.h"
+#include "../osthread/osthread.h"
+#include "bufpool.h"
+#include "codec.h"
+#include "crc32c.h"
+#include "profile.h"
 
 #define ANYF_VER "0.1.10"
 
@@ -46,16 +55,11 @@ int StringUTF8ToANSI(char buf[], int bfsize, char *utf8STR);
 
 #define ID_COUNT  16  // HEAD_T 的 id 数组元素个数
 #define STD_COUNT 4   // HEAD_T 的 std 数组元素个数
-#define EMT_COUNT 256 // HEAD_T 的 emt 数组元素个数
+#define EMT_COUNT 224 // HEAD_T 的 emt 数组元素个数
 
-// 文件读写缓冲区
-typedef struct {
-    int64_t size;
-    char fdata[];
-} BUFFER_T;
-
-#define BUF_SIZE_L 8388608LL   // 文件读写缓冲区大小下限
-#define BUF_SIZE_U 134217728LL // 文件读写缓冲区大小上限
+#define BUF_SIZE_L 8388608LL   // 缓冲池中每个缓冲块的默认字节数
+#define BUF_SIZE_U 134217728LL // 缓冲池默认的总字节数上限
+#define THREAD_MAX 256         // 并行线程数上限
 #define DIR_SIZE   -1          // 定义：目录本身大小为 -1
 #define EQUAL_MAX  512         // 显示子文件信息时分隔符(等号)缓冲区大小
 
@@ -66,42 +70,289 @@ typedef struct {
 #define JPEG_INVALID 0  // 无效的 JPEG 图像
 #define JPEG_ERROR   -1 // 检查 JPEG 图像过程中出现了错误
 
+#define JPEG_SCAN_SIZE 65536 // 查找 JPEG 结束标记及复制 JPEG 模板时的缓冲区大小
+
+// HEAD_T 的 feat 成员可用的特性标志
+#define FEAT_EXTRA 0x00000001 // 每个子文件信息的文件名之后都有扩展属性 EXTRA_T
+#define FEAT_VOID   0x00000002 // 含有作废的子文件信息(ENTRY_VOID)，读取时应跳过
+#define FEAT_SHARED 0x00000004 // 曾被多个写入者同时追加：文件头的 tail 有效，可能含有预留区域的占位子文件信息(ENTRY_PENDING)
+#define FEAT_CODEC  0x00000008 // 含有压缩的子文件(EXTRA_T 的 codec 不为 CODEC_NONE)，数据块为 codec.h 中说明的分段格式
+#define FEAT_SOLID  0x00000010 // 含有固实块(ENTRY_BLOCK)及数据保存在其中的子文件(ENTRY_SOLID)
+#define FEAT_DICT   0x00000020 // 含有共享字典(ENTRY_DICTDATA)及用它压缩的子文件(ENTRY_DICT)，文件头的 dict 有效
+#define FEAT_KNOWN  (FEAT_EXTRA | FEAT_VOID | FEAT_SHARED | FEAT_CODEC | FEAT_SOLID | FEAT_DICT) // 本程序支持的全部特性，含其他特性的 ANYF 文件拒绝打开
+
+// EXTRA_T 的 flags 成员可用的子文件数据块标志
+#define ENTRY_SPARSE  0x0001 // 稀疏文件：数据块由区域表和各数据区域组成，空洞不保存
+#define ENTRY_VOID    0x0002 // 作废的子文件：并行打包时源文件发生了变化，数据块只占位，有效的副本追加在其后
+#define ENTRY_PENDING 0x0004 // 预留区域的占位子文件信息：数据块覆盖整个预留区域，写入者完成后换成区域中的第一个子文件信息
+#define ENTRY_SOLID   0x0008 // 固实块的成员：没有自己的数据块，数据在 EXTRA_T 的 block 指向的固实块中
+#define ENTRY_BLOCK   0x0010 // 固实块：文件名为空字符串，数据块为压缩的固实块内容，位于其成员之前
+#define ENTRY_CHUNKED 0x0020 // 压缩的数据块由多个分块(段)组成，各段之后是分块表：每段在数据块中的偏移量(int64_t 数组)
+#define ENTRY_DICT     0x0040 // 压缩时使用了共享字典，解压时需要同一字典
+#define ENTRY_DICTDATA 0x0080 // 共享字典：文件名为空字符串，数据块为按原样保存的字典内容
+#define ENTRY_CRC      0x0100 // EXTRA_T 的 crc 为子文件内容(稀疏文件含空洞)的 CRC32C，提取时校验
+#define ENTRY_MTIME    0x0200 // EXTRA_T 的 mtime 为打包时源文件的修改时间，提取后恢复
+#define ENTRY_SKIP    (ENTRY_VOID | ENTRY_PENDING | ENTRY_BLOCK | ENTRY_DICTDATA) // 读取时跳过的子文件
+
+#define EXTENT_BATCH 256 // 提取稀疏文件时每次读入的区域表元素数量
+
+#define BATCH_ENTRY_MAX 65536 // 数据块不超过此字节数的子文件与相邻子文件合并写入
+#define BATCH_HEAD_SIZE 65536 // 合并写入时暂存子文件信息的缓冲区字节数
+
+// 固实块内容为成员数量(int64_t)、各成员数据在数据区域中的偏移量(int64_t 数组)和按顺序拼接的成员数据
+#define SOLID_BLOCK_MIN  1048576LL // 固实块数据区域字节数上限可选的最小值
+#define SOLID_BLOCK_MAX  4194304LL // 固实块数据区域字节数上限可选的最大值
+#define SOLID_ENTRY_MAX  65536     // 不超过此字节数且可压缩的子文件加入固实块
+#define SOLID_MEMBER_MAX 8192      // 每个固实块最多的成员数量
+#define SOLID_TABLE_MAX  ((SOLID_MEMBER_MAX + 1) * sizeof(int64_t)) // 固实块中成员数量和偏移量表的最大字节数
+
+// 训练共享字典时从边扫描边打包的小文件开头取样本，取够后训练并写入字典，之前打包的子文件不使用字典
+// 只有不超过 DICT_ENTRY_MAX 字节的子文件使用字典压缩
+#define DICT_ENTRY_MAX    65536     // 使用字典压缩的子文件字节数上限
+#define DICT_SAMPLE_FILES 256       // 取样的文件数量，取满或样本总字节数达到上限时训练字典
+#define DICT_SAMPLE_BYTES 1048576   // 样本总字节数上限
+#define DICT_SAMPLE_PIECE 8192      // 每个文件最多取开头的字节数
+#define DICT_SAMPLE_MIN   8         // 样本文件少于此数量时不训练字典
+
+#define WRITEBACK_STEP 8388608LL // 持久化模式下打包时每写入此字节数就让系统开始写回
+
+#define CHECKPOINT_DEFAULT 1073741824LL // 命令行打包时默认每写入此字节数提交一次检查点
+
+// 提取时判断目标文件已是最新、可以跳过的方式
+#define UPDATE_NONE     0 // 不判断，总是写入
+#define UPDATE_MTIME    1 // 大小和修改时间都与子文件相同，子文件没有修改时间时按 UPDATE_CHECKSUM 判断
+#define UPDATE_CHECKSUM 2 // 大小相同且内容的 CRC32C 与子文件的校验值相同
+
+// 锁定 ANYF 文件末尾之外的字节而不是文件头本身：WIN平台的字节范围锁会阻止其他句柄读写被锁定的范围
+// 文件头锁：写入者更新文件头或子文件信息时独占锁定，读取者读取文件头和子文件信息链时共享锁定，都只短暂持有
+// 追加锁：独占追加的写入者整个打包过程独占锁定，共享追加的写入者预留区域时短暂独占锁定，先于文件头锁加锁
+#define HEAD_LOCK_OFFSET   0x7FFFFFFFFFFFFFF0LL
+#define APPEND_LOCK_OFFSET (HEAD_LOCK_OFFSET + 1LL)
+#define LOCK_SIZE          1LL
+
+// 并行打包时把子文件写入预留位置的结果
+#define SLOT_WRITTEN 0 // 已写入
+#define SLOT_CHANGED 1 // 源文件与计算布局时不同或无法读取，预留位置应作废
+#define SLOT_FAILED  2 // 写入 ANYF 文件失败
+
+// 尝试将子文件加入合并写入批次的结果
+#define BATCH_QUEUED 0 // 已加入批次
+#define BATCH_UNFIT  1 // 不适合合并写入，应单独写入
+#define BATCH_FAILED 2 // 读取子文件失败
+
+// 继续中断的打包时信息表中已有的子文件名，排序后用于跳过已打包的路径
+typedef struct {
+    char **names; // 指向 text 中各文件名，按 CompareSubName 的顺序排列
+    char *text;   // 依次存放的各文件名
+    size_t count; // 文件名数量，为0时不跳过任何路径
+} PACKED_T;
+
+// 打包时从扫描到的小文件中取得的字典样本，samples 为NULL时不取样
+typedef struct {
+    char *samples; // 首尾相接的样本
+    size_t *sizes; // 各样本字节数
+    size_t count;  // 样本数量
+    size_t used;   // 样本总字节数
+} TRAINER_T;
+
 // 文件头信息集合
 // 注意结构体成员的内存对齐
 // 因为要把结构体直接写入到文件或从文件直接读取
 #pragma pack(16)
 typedef struct {
     char id[ID_COUNT];      // 文件标识符
+    int32_t feat;           // 文件特性标志
     char emt[EMT_COUNT];    // 预留空字节
+    uint32_t root;          // 子文件信息表的 Merkle 根，见 AnyfMerkleRoot
+    int64_t leaves;         // root 覆盖的子文件数量，为0时没有记录 Merkle 根
+    int64_t dict;           // 特性标志含 FEAT_DICT 时为共享字典子文件信息的偏移量，否则为零
+    int64_t tail;           // 特性标志含 FEAT_SHARED 时为子文件信息链的结束位置(含已预留的区域)，否则为零
     int16_t std[STD_COUNT]; // 文件规范版本
     int64_t count;          // 包含文件总数
 } HEAD_T;                   // 文件头信息结构体
 #pragma pack()
 
+// 子文件扩展属性，文件头特性标志含 FEAT_EXTRA 时紧跟在文件名之后写入
+// 读取时以 xsize 为准，较旧的程序写入的 EXTRA_T 缺少的成员视为零，较新的程序增加的成员跳过
+#pragma pack(2)
+typedef struct {
+    int16_t xsize;  // 写入文件的 EXTRA_T 字节数
+    int16_t flags;  // 子文件数据块标志
+    int64_t stored; // 子文件数据块在 ANYF 文件中实际占用的字节数
+    int16_t codec;  // 子文件数据块的压缩方式，CODEC_ 开头的宏，不压缩的子文件不写入此成员
+    int64_t block;  // 固实块成员所在固实块的子文件信息偏移量，只有固实块成员和带校验值的子文件写入此成员及之后的成员
+    int32_t slot;   // 固实块成员在固实块偏移量表中的下标
+    uint32_t crc;   // 子文件内容的 CRC32C，flags 含 ENTRY_CRC 时有效
+    int64_t mtime;  // 源文件的修改时间，自1970年1月1日 UTC 起的纳秒数，flags 含 ENTRY_MTIME 时有效
+} EXTRA_T;
+#pragma pack()
+
 // 子文件信息，包括文件大小,文件名长度,文件名
 // 注意结构体成员的内存对齐
 // 因为要把结构体直接写入到文件或从文件直接读取
-// 写入 ANYF 文件时从 fsize 开始写，offset 不写入文件
-// 子文件信息：<fsize、fnlen、fname、子文件字节码>为一个子文件信息
+// 写入 ANYF 文件时从 fsize 开始写，offset、leaf 和 extra 不随 fsize 一起写入
+// 子文件信息：<fsize、fnlen、fname、[extra]、子文件字节码>为一个子文件信息
 #pragma pack(2)
 typedef struct {
     int64_t offset;  // 子文件信息在 ANYF 中的偏移量
+    uint32_t leaf;   // 打开 ANYF 文件时按文件中的子文件信息计算的 Merkle 叶子值，见 ANYF_T 的 loaded
+    EXTRA_T extra;   // 子文件扩展属性，没有扩展属性的 ANYF 文件中 xsize 为0
     int64_t fsize;   // 子文件数据内容的字节数大小
     int16_t fnlen;   // 子文件的文件名长度
     char fname[PMS]; // 子文件的文件名字符串，UTF8编码
 } INFO_T;
 #pragma pack()
 
+// 打包或提取的统计信息
+typedef struct {
+    int64_t entries;   // 处理的条目数量
+    int64_t bytes;     // 写入的字节数
+    int64_t elapsed;   // 总用时，单位纳秒
+    int64_t throttled; // 因限速等待的时间，单位纳秒
+    int64_t skipped;   // 压缩打包时判断为不可压缩而按原样保存的字节数
+    int64_t corrupted; // 提取或校验时内容与 CRC32C 不符或无法读取的子文件数量
+    int64_t unchecked; // 校验时没有 CRC32C 而只检查能否读取的子文件数量
+    int64_t current;   // 提取时目标文件已是最新而跳过的子文件数量
+    bool verified;     // 为 true 时是校验的统计，bytes 为读取并校验的字节数，没有写入数据
+} STATS_T;
+
 // 文件基本信息结构体
 typedef struct {
-    HEAD_T head;   // 文件的头信息
-    int64_t start; // 标识符起始位置
-    INFO_T *sheet; // 子文件信息表
-    int64_t cells; // sheet 的容量
-    char *path;    // 文件的绝对路径
-    FILE *handle;  // 打开的二进制流
+    HEAD_T head;     // 文件的头信息
+    int64_t start;   // 标识符起始位置
+    INFO_T *sheet;   // 子文件信息表
+    int64_t cells;   // sheet 的容量
+    char *path;      // 文件的绝对路径
+    FILE *handle;    // 打开的二进制流
+    BUFPOOL_T *pool; // 复制数据使用的缓冲池，为NULL时使用默认缓冲池，由调用者释放
+    bool durable;    // 为 true 时打包和提取完成前把数据同步到磁盘
+    const PROFILE_T *profile; // 按数据块大小选择读写方式的校准配置，为NULL时使用默认配置，由调用者释放
+    THROTTLE_T *throttle;     // 读写限速器，为NULL时不限速，由调用者释放
+    int jobs;                 // 打包和提取时的并行线程数，不大于1时逐个处理
+    bool shared;              // 为 true 时与其他写入者同时追加：锁内只预留区域，锁外写入数据，否则整个打包过程独占文件头锁
+    int64_t tail;             // 最近一次锁定文件头时得知的子文件信息链结束位置，追加的内容从此处写起
+    int64_t known;            // 与 tail 对应的文件中的子文件总数，含其他写入者追加的子文件
+    int codec;                // 打包时子文件数据块的压缩方式，CODEC_NONE 表示不压缩
+    int level;                // 打包时的压缩等级
+    int64_t solid;            // 打包时固实块数据区域的字节数上限，为0时不使用固实块
+    int64_t roffset;          // 按名称提取时只提取子文件中从 roffset 起的 rlength 字节
+    int64_t rlength;          // 为0时提取整个子文件
+    bool traindict;           // 为 true 时打包前从小文件训练共享字典，已有字典的 ANYF 文件沿用已有的字典
+    CODECDICT_T dict;         // 打开时读入的共享字典，size 为0表示没有，data 在关闭时释放
+    int64_t checkpoint;       // 独占打包时每写入约此字节数提交一次检查点(把已写完的子文件计入文件头)，为0时只在结束时提交
+    bool resume;              // 为 true 时继续中断的打包：截掉最后一个检查点之后的内容，跳过信息表中已有的路径
+    int64_t loaded;           // 信息表开头打开时从文件读入的子文件数量，这些子文件的 leaf 有效，WIN平台其文件名已转为ANSI编码
+    int update;               // 提取时跳过已是最新的目标文件的判断方式，UPDATE_ 开头的宏，UPDATE_NONE 以外的方式会覆盖不是最新的目标文件
+    STATS_T stats;            // 最近一次打包或提取的统计信息
 } ANYF_T;
 
+// 合并写入批次：连续的小文件和目录的子文件信息及数据块先暂存，再一次性向量写入 ANYF 文件
+// 写入文件的字节与逐个写入完全相同
+typedef struct {
+    OSIOV_T iov[OSFILE_IOV_MAX];  // 待写入的内存块，子文件信息和数据块交替排列
+    int vecs;                     // iov 中已使用的元素数量
+    int64_t entries;              // 批次中的子文件数量
+    int64_t base;                 // 批次在 ANYF 文件中的起始偏移量
+    int64_t bytes;                // 批次的总字节数
+    BUFFER_T *stage;              // 暂存数据块的缓冲块，取自缓冲池
+    int64_t staged;               // stage 中已使用的字节数
+    size_t headed;                // heads 中已使用的字节数
+    char heads[BATCH_HEAD_SIZE];  // 暂存子文件信息
+    char raw[BATCH_ENTRY_MAX];    // 压缩打包时暂存读入的子文件原始数据
+} BATCH_T;
+
+// 固实打包时正在填充的固实块，连续的小文件先拼接在内存中，填满或遇到不能加入的子文件时压缩写入
+typedef struct {
+    int64_t first;   // 固实块在子文件信息表中的下标，其后直到表末尾为其成员及夹在其中的目录和空文件，-1 表示没有正在填充的固实块
+    int64_t members; // 成员数量
+    int64_t used;    // 已拼接的成员数据字节数
+    int64_t blocks;  // 本次打包写入的固实块数量
+    char *raw;       // SOLID_TABLE_MAX 字节的偏移量表区域，其后是 AnyfType->solid 字节的数据区域
+    BUFFER_T *area;  // 从缓冲池另取的缓冲区，raw 指向其数据
+} SOLID_T;
+
+// 提取时已解压的固实块，同一固实块的成员连续提取时只解压一次
+typedef struct {
+    int64_t block; // 固实块的子文件信息偏移量，-1 表示没有
+    char *raw;     // 解压后的固实块内容
+    int64_t size;  // 固实块内容字节数
+    int64_t cells; // raw 的容量
+    int64_t count; // 成员数量
+} SOLIDVIEW_T;
+
+// 持久化模式下提取时涉及的文件系统，结束时每个文件系统只同步一次
+typedef struct {
+    uint64_t device; // 文件系统的设备号
+    char *path;      // 该文件系统中的一个目录，用于同步
+} FSREF_T;
+
+// 并行打包或提取的一个子文件
+typedef struct {
+    int64_t index;    // 子文件在信息表中的下标
+    int64_t size;     // 子文件数据块实际占用的字节数，按此从大到小分配给线程
+    const char *name; // 子文件名，指向信息表
+    char *path;       // 提取时为子文件的保存路径，打包时为源文件路径(目录为NULL)
+    bool voided;      // 打包时源文件发生了变化，预留的位置已作废
+    int64_t first;    // 提取时分块并行解压的子文件由多个任务组成，每个任务负责 first 到 last 之前的分块
+    int64_t last;     // 为0时任务负责整个子文件
+    bool done;        // 提取时任务已成功写入
+    uint32_t crc;     // 提取时任务写入的内容的 CRC32C，分块并行解压的子文件由主线程合并后校验
+} COPYJOB_T;
+
+// 并行打包或提取时各线程共享的任务表
+typedef struct {
+    ANYF_T *anyf;     // 正在打包或提取的 ANYF 文件
+    COPYJOB_T *jobs;  // 已排好序的任务
+    size_t count;     // 任务数量
+    size_t next;      // 下一个待领取的任务下标
+    bool failed;      // 打包时写入 ANYF 文件失败
+    int64_t deferred; // 打包时此偏移量处的子文件信息留到发布预留区域时写入，为-1时没有
+    OSMUTEX_T lock;   // 保护 next 和 failed
+} COPYSHARE_T;
+
+// 分块并行压缩一个子文件时各线程共享的状态，各分块同时压缩，按分块顺序写入 ANYF 文件当前位置
+typedef struct {
+    ANYF_T *anyf;         // 正在打包的 ANYF 文件
+    FILE *source;         // 源文件，各线程按偏移量读取
+    const CODEC_T *codec; // 压缩方式
+    const CODECDICT_T *dict; // 压缩使用的字典，为NULL时不使用
+    int64_t size;         // 源文件字节数
+    int64_t count;        // 分块数量
+    int64_t next;         // 下一个待领取的分块下标
+    int64_t turn;         // 下一个应写入的分块下标
+    int64_t stored;       // 已写入的字节数
+    uint32_t crc;         // 已写入的分块的原始内容的 CRC32C
+    int64_t *table;       // 各分块在数据块中的偏移量
+    bool failed;          // 读取源文件或写入 ANYF 文件失败
+    OSMUTEX_T lock;       // 保护以上可变成员，持有时才能写入 ANYF 文件
+    OSCOND_T turned;      // turn 改变或出错时广播
+} CHUNKSHARE_T;
+
+// 分块并行压缩的一个线程
+typedef struct {
+    CHUNKSHARE_T *share; // 共享的状态
+    BUFFER_T *chunk;     // 此线程独占的缓冲块，小于 CODEC_WORK_SIZE 时另行分配工作区
+    OSTHREAD_T thread;   // 线程句柄
+} CHUNKWORKER_T;
+
+// 并行打包或提取的一个线程
+typedef struct {
+    COPYSHARE_T *share; // 共享的任务表
+    BUFFER_T *chunk;    // 此线程独占的读写缓冲块
+    OSTHREAD_T thread;  // 线程句柄
+    int64_t entries;    // 此线程提取的子文件数量
+    int64_t bytes;      // 此线程写入的字节数
+} COPYWORKER_T;
+
+// 出错中止的拦截点，批量模式下每个任务在自己的线程中用 AnyfSetAbortHook 设置
+// 未设置拦截点的线程出错时直接退出程序
+typedef struct {
+    jmp_buf jump;  // 出错时 longjmp 回到的位置
+    int code;      // 出错时的退出状态码
+    ANYF_T *anyf;  // 此线程最近创建或打开的 ANYF_T，中止后由设置者关闭
+    FILE *handle;  // 已打开但尚未交给 ANYF_T 的 ANYF 文件流，中止后由设置者关闭
+} ABORTHOOK_T;
+
 // 默认 ANYF 文件头信息，可修改 id 内容以自定义文件标识
 static const HEAD_T DEFAULT_HEAD = {
     // 格式标识："\377Anyf Momo\0"等16字节，余下为零
@@ -118,44 +369,72 @@ static const HEAD_T DEFAULT_HEAD = {
             0x4d, // 'M'
             0x6f, // 'o'
         },
+    // 新建的 ANYF 文件中每个子文件信息都带有扩展属性
+    .feat = FEAT_EXTRA,
     // 分别为：2位年份，主版本，次版本，修订版本
-    .std = {22, 1, 0, 6},
-    // 预留的 256 个字节用于可能增加的信息
+    .std = {22, 1, 1, 0},
+    // 预留的 224 个字节用于可能增加的信息
     .emt = {0},
+    // 只有多个写入者同时追加过的 ANYF 文件才记录子文件信息链的结束位置
+    .tail = 0LL,
     // ANYF 文件中包含的子文件总数，初始总数总是设置为零
     .count = 0LL,
 };
 
-// 出错时打印调试信息并退出程序
+// 不会返回的函数
+#ifdef _MSC_VER
+#define ANYF_NORETURN __declspec(noreturn)
+#else
+#define ANYF_NORETURN _Noreturn
+#endif // _MSC_VER
+
+// 出错时打印调试信息并退出程序，设置了拦截点时只中止当前任务
 #define PRINT_ERROR_AND_ABORT(STR) \
     fprintf(stderr, MESSAGE_ERROR STR ": 源码 %s 第 %d 行，版本 %s\n", OsPathBaseName(NULL, 0ULL, __FILE__), __LINE__, ANYF_VER); \
-    exit(EXIT_CODE_FAILURE)
+    AnyfAbort(EXIT_CODE_FAILURE)
 
 // 出错时判断是否关闭文件流并删除文件
 #define WHETHER_CLOSE_REMOVE(ANYFTYPE) \
-    if (ANYFTYPE->head.count <= 0) { \
-        fclose(ANYFTYPE->handle), remove(ANYFTYPE->path); \
+    if (ANYFTYPE->head.count <= 0 && ANYFTYPE->known <= 0) { \
+        fclose(ANYFTYPE->handle), ANYFTYPE->handle = NULL, remove(ANYFTYPE->path); \
     }
 
 #define FSIZE_SIZE (sizeof(int64_t))             // INFO_T 的 fsize 成员大小
 #define FNLEN_SIZE (sizeof(int16_t))             // INFO_T 的 fnlen 成员大小
 #define ID_SIZE    (ID_COUNT * sizeof(char))     // HEAD_T 的 id 成员大小
+#define FEAT_SIZE  (sizeof(int32_t))             // HEAD_T 的 feat 成员大小
 #define STD_SIZE   (STD_COUNT * sizeof(int16_t)) // HEAD_T 的 std 成员大小
 #define EMT_SIZE   (EMT_COUNT * sizeof(char))    // HEAD_T 的 emt 成员大小
+#define ROOT_SIZE  (sizeof(uint32_t))            // HEAD_T 的 root 成员大小
+#define LEAF_SIZE  (sizeof(int64_t))             // HEAD_T 的 leaves 成员大小
+#define DICT_SIZE  (sizeof(int64_t))             // HEAD_T 的 dict 成员大小
+#define TAIL_SIZE  (sizeof(int64_t))             // HEAD_T 的 tail 成员大小
 #define COUNT_SIZE (sizeof(int64_t))             // HEAD_T 的 count 成员大小
 
-#define COUNT_OFFSET     (ID_SIZE + STD_SIZE + EMT_SIZE)              // HEAD_T 中的 count 在 ANYF 文件中的偏移量
-#define SUBDATA_OFFSET   (ID_SIZE + STD_SIZE + EMT_SIZE + COUNT_SIZE) // ANYF 文件中首个子文件信息(见前面注释)起始偏移量
-#define FSIZE_FNLEN_SIZE (FSIZE_SIZE + FNLEN_SIZE)                    // INFO_T 中 fsize 和 fnlen 两个成员的大小之和
+#define FEAT_OFFSET      (ID_SIZE)                                                             // HEAD_T 中的 feat 在 ANYF 文件中的偏移量
+#define COUNT_OFFSET     (ID_SIZE + FEAT_SIZE + EMT_SIZE + ROOT_SIZE + LEAF_SIZE + DICT_SIZE + TAIL_SIZE + STD_SIZE) // HEAD_T 中的 count 在 ANYF 文件中的偏移量
+#define SUBDATA_OFFSET   (COUNT_OFFSET + COUNT_SIZE)                                           // ANYF 文件中首个子文件信息(见前面注释)起始偏移量
+#define FSIZE_FNLEN_SIZE (FSIZE_SIZE + FNLEN_SIZE)                                             // INFO_T 中 fsize 和 fnlen 两个成员的大小之和
+#define EXTRA_SIZE       (sizeof(EXTRA_T))                                                     // 写入 ANYF 文件的 EXTRA_T 大小
+#define EXTRA_BASE_SIZE  (offsetof(EXTRA_T, codec))                                            // 不压缩的子文件写入 ANYF 文件的 EXTRA_T 大小，与较旧的程序写入的相同
+#define EXTRA_CODEC_SIZE (offsetof(EXTRA_T, block))                                            // 压缩的子文件和固实块写入 ANYF 文件的 EXTRA_T 大小
+#define ENTRY_HEAD_MAX   (FSIZE_FNLEN_SIZE + PMS + EXTRA_SIZE)                                 // 写入 ANYF 文件的子文件信息最大字节数
+#define PENDING_HEAD     (FSIZE_FNLEN_SIZE + 1 + EXTRA_BASE_SIZE)                              // 预留区域的占位子文件信息字节数(文件名为空字符串)，小于任何实际的子文件信息
 
 ANYF_T *AnyfMake(const char *AnyfPath, bool Overwrite);
-ANYF_T *AnyfOpen(const char *AnyfPath);
+ANYF_T *AnyfOpen(const char *AnyfPath, bool ReadOnly);
 void AnyfClose(ANYF_T *AnyfType);
 ANYF_T *AnyfPack(const char *ToBePacked, bool Recursion, ANYF_T *AnyfType, bool Append);
 ANYF_T *AnyfExtract(const char *ToExtract, const char *Destination, int Overwrite, ANYF_T *AnyfType);
+int64_t AnyfReadRange(ANYF_T *AnyfType, const char *SubName, int64_t Offset, int64_t Length, void *Buffer);
+bool AnyfVerify(const char *ToVerify, ANYF_T *AnyfType);
+int64_t AnyfMerkleRoot(const ANYF_T *AnyfType, uint32_t *pRoot);
 ANYF_T *AnyfInfo(const char *AnyfPath);
 bool AnyfIsFakeJPEG(const char *FakeJPEGPath);
 ANYF_T *AnyfMakeFakeJPEG(const char *AnyfPath, const char *JPEGPath, bool Overwrite);
-ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath);
+ANYF_T *AnyfOpenFakeJPEG(const char *FakeJPEGPath, bool ReadOnly);
+void AnyfPrintStats(const ANYF_T *AnyfType);
+void AnyfSetAbortHook(ABORTHOOK_T *Hook);
+ANYF_NORETURN void AnyfAbort(int Code);
 
 #endif //__ANYF_H
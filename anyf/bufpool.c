@@ -0,0 +1,158 @@
+#include "bufpool.h"
+
+#include <stdlib.h>
+
+#define LEASE_STEP 8 // 记录取出的缓冲块的数组每次扩充的元素数量
+
+// 本线程取出的缓冲块记录到此处，为NULL时不记录
+static OSTHREAD_LOCAL POOLLEASE_T *POOL_LEASE = NULL;
+
+// 记录本线程取出的缓冲块，内存不足时不记录
+static void LeaseAdd(BUFFER_T *Buffer) {
+    BUFFER_T **ItemsTemp;
+    if (!POOL_LEASE)
+        return;
+    if (POOL_LEASE->count >= POOL_LEASE->slots) {
+        if (!(ItemsTemp = realloc(POOL_LEASE->items, (POOL_LEASE->slots + LEASE_STEP) * sizeof(BUFFER_T *))))
+            return;
+        POOL_LEASE->items = ItemsTemp;
+        POOL_LEASE->slots += LEASE_STEP;
+    }
+    POOL_LEASE->items[POOL_LEASE->count++] = Buffer;
+}
+
+// 从本线程的记录中删除已归还的缓冲块
+static void LeaseRemove(BUFFER_T *Buffer) {
+    if (!POOL_LEASE)
+        return;
+    for (size_t i = POOL_LEASE->count; i > 0; --i) {
+        if (POOL_LEASE->items[i - 1] == Buffer) {
+            POOL_LEASE->items[i - 1] = POOL_LEASE->items[--POOL_LEASE->count];
+            return;
+        }
+    }
+}
+
+// 创建缓冲池
+// 参数 Chunk 为每个缓冲块的字节数，参数 Limit 为所有缓冲块总字节数上限
+// Chunk 大于 Limit 时以 Limit 作为缓冲块大小，Limit 不足 POOL_CHUNK_MIN 则失败
+// 成功返回缓冲池指针，失败返回NULL
+BUFPOOL_T *AnyfPoolMake(int64_t Chunk, int64_t Limit) {
+    BUFPOOL_T *Pool;
+    if (Limit < POOL_CHUNK_MIN)
+        return NULL;
+    if (Chunk > Limit)
+        Chunk = Limit;
+    if (Chunk < POOL_CHUNK_MIN)
+        Chunk = POOL_CHUNK_MIN;
+    if (!(Pool = malloc(sizeof(BUFPOOL_T))))
+        return NULL;
+    Pool->chunk = Chunk;
+    Pool->limit = Limit;
+    Pool->total = 0LL;
+    Pool->idle = 0ULL;
+    Pool->slots = (size_t)(Limit / Chunk);
+    if (!(Pool->spare = malloc(Pool->slots * sizeof(BUFFER_T *)))) {
+        free(Pool);
+        return NULL;
+    }
+    if (OsMutexInit(&Pool->lock)) {
+        free(Pool->spare);
+        free(Pool);
+        return NULL;
+    }
+    return Pool;
+}
+
+// 释放缓冲池及其中所有空闲缓冲块
+// 调用前应已归还所有取出的缓冲块
+void AnyfPoolDelete(BUFPOOL_T *Pool) {
+    if (!Pool)
+        return;
+    while (Pool->idle > 0)
+        free(Pool->spare[--Pool->idle]);
+    OsMutexDestroy(&Pool->lock);
+    free(Pool->spare);
+    free(Pool);
+}
+
+// 从缓冲池取出一个缓冲块
+// 没有空闲缓冲块时，在总字节数不超过上限的前提下新分配一个
+// 成功返回缓冲块指针，已达上限或内存不足返回NULL
+BUFFER_T *AnyfPoolTake(BUFPOOL_T *Pool) {
+    BUFFER_T *Buffer = NULL;
+    if (!Pool)
+        return NULL;
+    OsMutexLock(&Pool->lock);
+    if (Pool->idle > 0) {
+        Buffer = Pool->spare[--Pool->idle];
+    } else if (Pool->total + Pool->chunk <= Pool->limit) {
+        if (Buffer = malloc(sizeof(BUFFER_T) + Pool->chunk)) {
+            Buffer->size = Pool->chunk;
+            Buffer->pool = Pool;
+            Pool->total += Pool->chunk;
+        }
+    }
+    OsMutexUnlock(&Pool->lock);
+    if (Buffer)
+        LeaseAdd(Buffer);
+    return Buffer;
+}
+
+// 从缓冲池另取一个 Size 字节的缓冲区，用于缓冲块容纳不下的工作区
+// 与缓冲块一同计入总字节数上限，额度不足时先释放空闲缓冲块
+// 成功返回缓冲区指针，由 AnyfPoolGive 归还，已达上限或内存不足返回NULL
+BUFFER_T *AnyfPoolTakeSized(BUFPOOL_T *Pool, int64_t Size) {
+    BUFFER_T *Buffer = NULL;
+    if (!Pool || Size <= 0LL)
+        return NULL;
+    OsMutexLock(&Pool->lock);
+    while (Pool->total + Size > Pool->limit && Pool->idle > 0) {
+        Pool->total -= Pool->chunk;
+        free(Pool->spare[--Pool->idle]);
+    }
+    if (Pool->total + Size <= Pool->limit) {
+        if (Buffer = malloc(sizeof(BUFFER_T) + (size_t)Size)) {
+            Buffer->size = Size;
+            Buffer->pool = Pool;
+            Pool->total += Size;
+        }
+    }
+    OsMutexUnlock(&Pool->lock);
+    if (Buffer)
+        LeaseAdd(Buffer);
+    return Buffer;
+}
+
+// 将缓冲块归还缓冲池以便复用，另取的缓冲区直接释放
+void AnyfPoolGive(BUFPOOL_T *Pool, BUFFER_T *Buffer) {
+    if (!Pool || !Buffer)
+        return;
+    LeaseRemove(Buffer);
+    OsMutexLock(&Pool->lock);
+    if (Pool->idle < Pool->slots && Buffer->size == Pool->chunk) {
+        Pool->spare[Pool->idle++] = Buffer;
+        Buffer = NULL;
+    } else {
+        Pool->total -= Buffer->size;
+    }
+    OsMutexUnlock(&Pool->lock);
+    free(Buffer);
+}
+
+// 此后本线程取出和归还的缓冲块记录到 Lease 中，参数为NULL时停止记录
+// 其他线程取出的缓冲块不记录，应由取出它的线程负责归还
+void AnyfPoolTrack(POOLLEASE_T *Lease) { POOL_LEASE = Lease; }
+
+// 将 Lease 中记录的缓冲块全部归还缓冲池并释放记录
+void AnyfPoolReclaim(BUFPOOL_T *Pool, POOLLEASE_T *Lease) {
+    if (!Lease)
+        return;
+    if (POOL_LEASE == Lease)
+        POOL_LEASE = NULL;
+    while (Lease->count > 0)
+        AnyfPoolGive(Pool, Lease->items[--Lease->count]);
+    free(Lease->items);
+    Lease->items = NULL;
+    Lease->slots = 0ULL;
+}
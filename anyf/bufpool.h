@@ -0,0 +1,46 @@
+#ifndef __BUFPOOL_H
+#define __BUFPOOL_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../osthread/osthread.h"
+
+typedef struct BUFPOOL BUFPOOL_T;
+
+// 文件读写缓冲区
+typedef struct {
+    int64_t size;
+    BUFPOOL_T *pool; // 取出此缓冲区的缓冲池，不属于缓冲池时为NULL
+    char fdata[];
+} BUFFER_T;
+
+#define POOL_CHUNK_MIN 65536LL // 缓冲池中每个缓冲块的最小字节数
+
+// 固定大小缓冲块组成的缓冲池，所有复制过程共用，可由多个线程同时存取
+// 池中已分配的缓冲块和另取的大缓冲区总字节数不会超过 limit
+struct BUFPOOL {
+    OSMUTEX_T lock;   // 保护以下成员
+    int64_t chunk;    // 每个缓冲块的字节数
+    int64_t limit;    // 已分配缓冲块总字节数上限
+    int64_t total;    // 已分配缓冲块总字节数
+    size_t idle;      // 空闲缓冲块数量
+    size_t slots;     // 数组 spare 的容量
+    BUFFER_T **spare; // 空闲缓冲块数组
+};
+
+// 一个线程从缓冲池取出且尚未归还的缓冲块，出错中止的任务据此归还
+typedef struct {
+    BUFFER_T **items; // 取出的缓冲块
+    size_t count;     // 缓冲块数量
+    size_t slots;     // 数组 items 的容量
+} POOLLEASE_T;
+
+BUFPOOL_T *AnyfPoolMake(int64_t Chunk, int64_t Limit);
+void AnyfPoolDelete(BUFPOOL_T *Pool);
+BUFFER_T *AnyfPoolTake(BUFPOOL_T *Pool);
+BUFFER_T *AnyfPoolTakeSized(BUFPOOL_T *Pool, int64_t Size);
+void AnyfPoolGive(BUFPOOL_T *Pool, BUFFER_T *Buffer);
+void AnyfPoolTrack(POOLLEASE_T *Lease);
+void AnyfPoolReclaim(BUFPOOL_T *Pool, POOLLEASE_T *Lease);
+
+#endif // __BUFPOOL_H
@@ -0,0 +1,294 @@
+#include "codec.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz.h"
+
+#ifdef ANYF_WITH_ZLIB
+#include <zlib.h>
+#endif // ANYF_WITH_ZLIB
+#ifdef ANYF_WITH_ZSTD
+#include <zstd.h>
+#endif // ANYF_WITH_ZSTD
+
+#define CODEC_NAME_NONE "none" // 命令行中表示不压缩的名称
+
+#ifdef ANYF_WITH_ZLIB
+// 使用字典时 zlib 流的头部记录字典的校验值，解压时字典不同会失败
+static size_t ZlibEncode(const void *Source, size_t SourceSize, void *Target, size_t TargetCapacity, int Level, const CODECDICT_T *Dict) {
+    uLongf Length = (uLongf)TargetCapacity;
+    z_stream Stream;
+    int Result;
+    if (!Dict || !Dict->size) {
+        if (compress2(Target, &Length, Source, (uLong)SourceSize, Level) != Z_OK)
+            return 0;
+        return (size_t)Length;
+    }
+    memset(&Stream, 0, sizeof(z_stream));
+    if (deflateInit(&Stream, Level) != Z_OK)
+        return 0;
+    Stream.next_in = (Bytef *)Source;
+    Stream.avail_in = (uInt)SourceSize;
+    Stream.next_out = Target;
+    Stream.avail_out = (uInt)TargetCapacity;
+    Result = deflateSetDictionary(&Stream, Dict->data, (uInt)Dict->size);
+    if (Result == Z_OK)
+        Result = deflate(&Stream, Z_FINISH);
+    Length = Stream.total_out;
+    deflateEnd(&Stream);
+    return Result == Z_STREAM_END ? (size_t)Length : 0;
+}
+
+static bool ZlibDecode(const void *Source, size_t SourceSize, void *Target, size_t TargetSize, const CODECDICT_T *Dict) {
+    uLongf Length = (uLongf)TargetSize;
+    z_stream Stream;
+    int Result;
+    if (!Dict || !Dict->size)
+        return uncompress(Target, &Length, Source, (uLong)SourceSize) == Z_OK && Length == (uLongf)TargetSize;
+    memset(&Stream, 0, sizeof(z_stream));
+    if (inflateInit(&Stream) != Z_OK)
+        return false;
+    Stream.next_in = (Bytef *)Source;
+    Stream.avail_in = (uInt)SourceSize;
+    Stream.next_out = Target;
+    Stream.avail_out = (uInt)TargetSize;
+    Result = inflate(&Stream, Z_FINISH);
+    if (Result == Z_NEED_DICT && inflateSetDictionary(&Stream, Dict->data, (uInt)Dict->size) == Z_OK)
+        Result = inflate(&Stream, Z_FINISH);
+    Length = Stream.total_out;
+    inflateEnd(&Stream);
+    return Result == Z_STREAM_END && Length == (uLongf)TargetSize;
+}
+#endif // ANYF_WITH_ZLIB
+
+#ifdef ANYF_WITH_ZSTD
+// 字典不是 zstd 训练的格式，按原始内容字典使用
+static size_t ZstdEncode(const void *Source, size_t SourceSize, void *Target, size_t TargetCapacity, int Level, const CODECDICT_T *Dict) {
+    ZSTD_CCtx *Context;
+    size_t Length;
+    if (!Dict || !Dict->size) {
+        Length = ZSTD_compress(Target, TargetCapacity, Source, SourceSize, Level);
+        return ZSTD_isError(Length) ? 0 : Length;
+    }
+    if (!(Context = ZSTD_createCCtx()))
+        return 0;
+    Length = ZSTD_compress_usingDict(Context, Target, TargetCapacity, Source, SourceSize, Dict->data, Dict->size, Level);
+    ZSTD_freeCCtx(Context);
+    return ZSTD_isError(Length) ? 0 : Length;
+}
+
+static bool ZstdDecode(const void *Source, size_t SourceSize, void *Target, size_t TargetSize, const CODECDICT_T *Dict) {
+    ZSTD_DCtx *Context;
+    size_t Length;
+    if (!Dict || !Dict->size) {
+        Length = ZSTD_decompress(Target, TargetSize, Source, SourceSize);
+        return !ZSTD_isError(Length) && Length == TargetSize;
+    }
+    if (!(Context = ZSTD_createDCtx()))
+        return false;
+    Length = ZSTD_decompress_usingDict(Context, Target, TargetSize, Source, SourceSize, Dict->data, Dict->size);
+    ZSTD_freeDCtx(Context);
+    return !ZSTD_isError(Length) && Length == TargetSize;
+}
+#endif // ANYF_WITH_ZSTD
+
+// 本程序可用的压缩方式，下标为压缩方式编号，编译时未找到依赖库的为NULL
+static const CODEC_T CODEC_LZ_T = {CODEC_LZ, "lz", LZ_LEVEL_MIN, LZ_LEVEL_MAX, LZ_LEVEL_DEFAULT, AnyfLZEncode, AnyfLZDecode};
+#ifdef ANYF_WITH_ZLIB
+static const CODEC_T CODEC_ZLIB_T = {CODEC_ZLIB, "zlib", 1, 9, 6, ZlibEncode, ZlibDecode};
+#endif // ANYF_WITH_ZLIB
+#ifdef ANYF_WITH_ZSTD
+static const CODEC_T CODEC_ZSTD_T = {CODEC_ZSTD, "zstd", 1, 19, 3, ZstdEncode, ZstdDecode};
+#endif // ANYF_WITH_ZSTD
+
+static const CODEC_T *const CODECS[CODEC_COUNT] = {
+    [CODEC_LZ] = &CODEC_LZ_T,
+#ifdef ANYF_WITH_ZLIB
+    [CODEC_ZLIB] = &CODEC_ZLIB_T,
+#endif // ANYF_WITH_ZLIB
+#ifdef ANYF_WITH_ZSTD
+    [CODEC_ZSTD] = &CODEC_ZSTD_T,
+#endif // ANYF_WITH_ZSTD
+};
+
+// 可用的压缩方式名称列表，用于帮助和错误信息
+static const char CODEC_NAMES[] = CODEC_NAME_NONE ", lz"
+#ifdef ANYF_WITH_ZLIB
+                                  ", zlib"
+#endif // ANYF_WITH_ZLIB
+#ifdef ANYF_WITH_ZSTD
+                                  ", zstd"
+#endif // ANYF_WITH_ZSTD
+    ;
+
+// 按编号获取压缩方式，CODEC_NONE、未知编号及本程序未编译进的压缩方式返回NULL
+const CODEC_T *AnyfCodecOf(int Id) {
+    if (Id <= CODEC_NONE || Id >= CODEC_COUNT)
+        return NULL;
+    return CODECS[Id];
+}
+
+// 解析命令行中的压缩方式，格式为 名称[:等级]，不指定等级时使用默认等级
+// 成功返回 true，*pId 为压缩方式编号，*pLevel 为压缩等级(不压缩时为0)
+bool AnyfCodecParse(const char *Spec, int *pId, int *pLevel) {
+    const char *Separator = strchr(Spec, CODEC_SPEC_SEPARATOR);
+    size_t NameLength = Separator ? (size_t)(Separator - Spec) : strlen(Spec);
+    char *End;
+    long Level;
+    if (NameLength == strlen(CODEC_NAME_NONE) && !strncmp(Spec, CODEC_NAME_NONE, NameLength) && !Separator) {
+        *pId = CODEC_NONE;
+        *pLevel = 0;
+        return true;
+    }
+    for (int i = CODEC_NONE + 1; i < CODEC_COUNT; ++i) {
+        if (!CODECS[i] || strlen(CODECS[i]->name) != NameLength || strncmp(Spec, CODECS[i]->name, NameLength))
+            continue;
+        *pId = i;
+        if (!Separator) {
+            *pLevel = CODECS[i]->ldefault;
+            return true;
+        }
+        Level = strtol(Separator + 1, &End, 10);
+        if (End == Separator + 1 || *End || Level < CODECS[i]->lmin || Level > CODECS[i]->lmax)
+            return false;
+        *pLevel = (int)Level;
+        return true;
+    }
+    return false;
+}
+
+const char *AnyfCodecNames(void) {
+    return CODEC_NAMES;
+}
+
+// 按字节出现的频率估计数据的熵，单位为位/字节，取值0到8，越接近8越难压缩
+double AnyfCodecEntropy(const void *Data, size_t Size) {
+    const unsigned char *Bytes = Data;
+    size_t Histogram[256] = {0};
+    double Entropy = 0.0, Probability;
+    for (size_t i = 0; i < Size; ++i)
+        ++Histogram[Bytes[i]];
+    for (int i = 0; i < 256; ++i) {
+        if (!Histogram[i])
+            continue;
+        Probability = (double)Histogram[i] / (double)Size;
+        Entropy -= Probability * log2(Probability);
+    }
+    return Entropy;
+}
+
+// 压缩一段不超过 CODEC_BLOCK_SIZE 字节的原始数据，在 Frame 中写入段头和段内数据
+// Frame 至少应有 CODEC_FRAME_SIZE + RawSize 字节，压缩失败或没有变小时按原样保存
+// 返回写入 Frame 的字节数
+size_t AnyfCodecEncode(const CODEC_T *Codec, int Level, const CODECDICT_T *Dict, const void *Raw, size_t RawSize, void *Frame) {
+    int32_t Header[2];
+    size_t Packed = 0;
+    // 容量比原始数据少一个字节，压缩后不能变小的数据尽早放弃
+    if (RawSize > 1)
+        Packed = Codec->encode(Raw, RawSize, (char *)Frame + CODEC_FRAME_SIZE, RawSize - 1, Level, Dict);
+    if (!Packed || Packed >= RawSize) {
+        memcpy((char *)Frame + CODEC_FRAME_SIZE, Raw, RawSize);
+        Packed = RawSize;
+    }
+    Header[0] = (int32_t)RawSize;
+    Header[1] = (int32_t)Packed;
+    memcpy(Frame, Header, CODEC_FRAME_SIZE);
+    return CODEC_FRAME_SIZE + Packed;
+}
+
+// 解压一段的段内数据，PackedSize 等于 RawSize 时按原样复制
+bool AnyfCodecDecode(const CODEC_T *Codec, const CODECDICT_T *Dict, const void *Packed, size_t PackedSize, void *Raw, size_t RawSize) {
+    if (PackedSize == RawSize) {
+        memcpy(Raw, Packed, RawSize);
+        return true;
+    }
+    if (PackedSize > RawSize)
+        return false;
+    return Codec->decode(Packed, PackedSize, Raw, RawSize, Dict);
+}
+
+static inline uint32_t KmerHashOf(const unsigned char *Pointer) {
+    uint64_t Value;
+    memcpy(&Value, Pointer, sizeof(uint64_t));
+    return (uint32_t)((Value * 0x9E3779B97F4A7C15ULL) >> (64 - CODEC_TRAIN_HASH_LOG));
+}
+
+// 从 Count 个首尾相接的样本(各 Sizes[i] 字节)训练不超过 Capacity 字节的字典，返回字典字节数，失败或没有共有的片段返回0
+// 先统计每个片段在多少个样本中出现，再反复选出共有片段得分最高的一段，选中后其中的片段不再计分
+// 越早选出的段放在字典中越靠后的位置，离原始数据越近，匹配距离越短
+size_t AnyfCodecTrain(const void *Samples, const size_t *Sizes, size_t Count, void *Dict, size_t Capacity) {
+    const unsigned char *Bytes = Samples;
+    uint32_t *Shared;        // 各片段哈希值出现在多少个样本中
+    uint32_t *Seen;          // 各片段哈希值最近出现在哪个样本中(下标加1)
+    uint32_t *Hashes;        // 样本中每个位置开始的片段的哈希值
+    size_t *Picked;          // 选出的各段在样本中的起始位置和长度，交替存放
+    size_t Total = 0, Used = 0, Chosen = 0, Start, Length, Best = 0, BestLength = 0, Position;
+    uint64_t Score, BestScore;
+    for (size_t i = 0; i < Count; ++i)
+        Total += Sizes[i];
+    if (Total < CODEC_TRAIN_KMER || Capacity < CODEC_TRAIN_SEGMENT)
+        return 0;
+    Shared = calloc((size_t)1 << CODEC_TRAIN_HASH_LOG, sizeof(uint32_t));
+    Seen = calloc((size_t)1 << CODEC_TRAIN_HASH_LOG, sizeof(uint32_t));
+    Hashes = malloc(Total * sizeof(uint32_t));
+    Picked = malloc((Capacity / CODEC_TRAIN_KMER + 1) * 2 * sizeof(size_t)); // 较短的样本选出的段不足 CODEC_TRAIN_SEGMENT 字节
+    if (!Shared || !Seen || !Hashes || !Picked)
+        goto FreeAndReturn;
+    for (size_t i = 0, Offset = 0; i < Count; Offset += Sizes[i++]) {
+        for (size_t j = 0; j + CODEC_TRAIN_KMER <= Sizes[i]; ++j) {
+            Hashes[Offset + j] = KmerHashOf(Bytes + Offset + j);
+            if (Seen[Hashes[Offset + j]] != (uint32_t)(i + 1)) {
+                Seen[Hashes[Offset + j]] = (uint32_t)(i + 1);
+                ++Shared[Hashes[Offset + j]];
+            }
+        }
+    }
+    while (Used + CODEC_TRAIN_SEGMENT <= Capacity) {
+        BestScore = 0;
+        for (size_t i = 0, Offset = 0; i < Count; Offset += Sizes[i++]) {
+            if (Sizes[i] < CODEC_TRAIN_KMER)
+                continue;
+            // 每个样本中长度为 Length 的窗口逐字节滑动，窗口得分为其中各片段出现在其他样本中的次数之和
+            Length = Sizes[i] < CODEC_TRAIN_SEGMENT ? Sizes[i] : CODEC_TRAIN_SEGMENT;
+            Score = 0;
+            for (size_t j = 0; j + CODEC_TRAIN_KMER <= Length; ++j)
+                Score += Shared[Hashes[Offset + j]] > 1 ? Shared[Hashes[Offset + j]] - 1 : 0;
+            for (Start = 0;; ++Start) {
+                if (Score > BestScore) {
+                    BestScore = Score;
+                    Best = Offset + Start;
+                    BestLength = Length;
+                }
+                if (Start + Length >= Sizes[i])
+                    break;
+                Position = Offset + Start;
+                Score -= Shared[Hashes[Position]] > 1 ? Shared[Hashes[Position]] - 1 : 0;
+                Position += Length - CODEC_TRAIN_KMER + 1;
+                Score += Shared[Hashes[Position]] > 1 ? Shared[Hashes[Position]] - 1 : 0;
+            }
+        }
+        if (!BestScore)
+            break;
+        for (size_t j = 0; j + CODEC_TRAIN_KMER <= BestLength; ++j)
+            Shared[Hashes[Best + j]] = 0;
+        Picked[Chosen * 2] = Best;
+        Picked[Chosen++ * 2 + 1] = BestLength;
+        Used += BestLength;
+    }
+    for (size_t i = 0, End = Used; i < Chosen; ++i) {
+        End -= Picked[i * 2 + 1];
+        memcpy((unsigned char *)Dict + End, Bytes + Picked[i * 2], Picked[i * 2 + 1]);
+    }
+FreeAndReturn:
+    if (Shared)
+        free(Shared);
+    if (Seen)
+        free(Seen);
+    if (Hashes)
+        free(Hashes);
+    if (Picked)
+        free(Picked);
+    return Used;
+}
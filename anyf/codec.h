@@ -0,0 +1,63 @@
+#ifndef __CODEC_H
+#define __CODEC_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 子文件数据块的压缩方式编号，写入 EXTRA_T 的 codec 成员，已使用的编号不能改变含义
+#define CODEC_NONE  0 // 按原样保存
+#define CODEC_LZ    1 // 内置的快速 LZ 压缩
+#define CODEC_ZLIB  2 // zlib(deflate)，编译时找到 zlib 才可用
+#define CODEC_ZSTD  3 // zstd，编译时找到 libzstd 才可用
+#define CODEC_COUNT 4
+
+// 压缩的数据块由若干段组成，每段原始数据不超过 CODEC_BLOCK_SIZE 字节，段前为 CODEC_FRAME_SIZE 字节的段头
+// 段头为原始字节数和段内数据字节数(均为 int32_t)，压缩后不小于原始数据时两者相等，段内数据按原样保存
+#define CODEC_BLOCK_SIZE 1048576
+#define CODEC_FRAME_SIZE (2 * sizeof(int32_t))
+#define CODEC_WORK_SIZE  (2 * CODEC_BLOCK_SIZE + CODEC_FRAME_SIZE) // 压缩或解压一段需要的工作区：原始数据和一个完整的段
+
+#define CODEC_SPEC_SEPARATOR ':' // 命令行中压缩方式名称与压缩等级之间的分隔符
+
+// 压缩前从子文件中均匀取 CODEC_SAMPLE_COUNT 处各 CODEC_SAMPLE_SIZE 字节，按字节分布估计熵
+// 熵超过 CODEC_ENTROPY_LIMIT 位/字节的子文件(如已压缩的音视频、图片)按原样保存，不超过全部采样字节数的子文件直接尝试压缩
+#define CODEC_SAMPLE_SIZE   4096
+#define CODEC_SAMPLE_COUNT  3
+#define CODEC_ENTROPY_LIMIT 7.5
+
+// 共享字典：训练得到的典型数据片段，压缩和解压时相当于位于每段原始数据之前，使很小的子文件也能找到匹配
+// 字典不超过 CODEC_DICT_MAX 字节，即 zlib 的窗口大小，内置的 LZ 压缩和 zstd 都能引用整个字典
+#define CODEC_DICT_MAX 32768
+
+// 训练字典时按 CODEC_TRAIN_KMER 字节的片段统计在多少个样本中出现，再反复选出覆盖最多共有片段的 CODEC_TRAIN_SEGMENT 字节
+#define CODEC_TRAIN_KMER     8
+#define CODEC_TRAIN_SEGMENT  256
+#define CODEC_TRAIN_HASH_LOG 18
+
+typedef struct {
+    const void *data; // 字典内容
+    size_t size;      // 字典字节数，为0时与不使用字典相同
+} CODECDICT_T;
+
+// 一种压缩方式
+typedef struct {
+    int id;              // 压缩方式编号，CODEC_ 开头的宏
+    const char *name;    // 命令行中使用的名称
+    int lmin;            // 压缩等级下限
+    int lmax;            // 压缩等级上限
+    int ldefault;        // 默认压缩等级
+    // 压缩 Source 到 Target，返回压缩后的字节数，失败或 Target 容量不足返回0，Dict 为NULL时不使用字典
+    size_t (*encode)(const void *Source, size_t SourceSize, void *Target, size_t TargetCapacity, int Level, const CODECDICT_T *Dict);
+    // 解压 Source 到 Target，解压结果必须正好是 TargetSize 字节，Dict 应与压缩时相同
+    bool (*decode)(const void *Source, size_t SourceSize, void *Target, size_t TargetSize, const CODECDICT_T *Dict);
+} CODEC_T;
+
+const CODEC_T *AnyfCodecOf(int Id);
+bool AnyfCodecParse(const char *Spec, int *pId, int *pLevel);
+const char *AnyfCodecNames(void);
+double AnyfCodecEntropy(const void *Data, size_t Size);
+size_t AnyfCodecEncode(const CODEC_T *Codec, int Level, const CODECDICT_T *Dict, const void *Raw, size_t RawSize, void *Frame);
+bool AnyfCodecDecode(const CODEC_T *Codec, const CODECDICT_T *Dict, const void *Packed, size_t PackedSize, void *Raw, size_t RawSize);
+size_t AnyfCodecTrain(const void *Samples, const size_t *Sizes, size_t Count, void *Dict, size_t Capacity);
+
+#endif // __CODEC_H
@@ -0,0 +1,14 @@
+#ifndef __CRC32C_H
+#define __CRC32C_H
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C(Castagnoli 多项式)，与 iSCSI、ext4 等使用的相同
+// 累加计算：对空数据的值为 CRC32C_INIT，AnyfCrc32c(AnyfCrc32c(CRC32C_INIT, A), B) 等于 A、B 连接后的 CRC32C
+#define CRC32C_INIT 0U
+
+uint32_t AnyfCrc32c(uint32_t Crc, const void *Data, size_t Size);
+uint32_t AnyfCrc32cZeros(uint32_t Crc, int64_t Size);
+uint32_t AnyfCrc32cCombine(uint32_t First, uint32_t Second, int64_t SecondSize);
+
+#endif // __CRC32C_H
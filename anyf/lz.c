@@ -0,0 +1,233 @@
+#include "lz.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 内置的快速 LZ 压缩，不依赖外部库
+// 压缩结果由若干序列组成，每个序列为：
+//   标记字节：高4位为字面量长度，低4位为匹配长度减 LZ_MIN_MATCH，取值15时其后跟随扩展长度字节
+//   [字面量扩展长度] 字面量 [匹配距离(2字节，小端序) [匹配扩展长度]]
+// 扩展长度字节逐个累加，遇到小于255的字节结束；最后一个序列只有字面量，读完即结束
+// 使用字典时字典相当于位于原始数据之前，匹配可以引用字典中的字节，压缩结果中不含字典
+
+#define LZ_MIN_MATCH     4      // 最短的匹配长度
+#define LZ_LAST_LITERALS 5      // 末尾至少保留为字面量的字节数
+#define LZ_WINDOW        65535  // 匹配距离上限
+#define LZ_HASH_LOG      14     // 哈希表元素个数的对数，哈希表在栈上，共 64KB
+#define LZ_LENGTH_MASK   15     // 标记字节中一个长度字段的最大值
+#define LZ_LEVEL_LAZY    7      // 不低于此压缩等级时使用惰性匹配：下一个位置的匹配更长时放弃当前匹配
+
+static inline uint32_t Read32(const uint8_t *Pointer) {
+    uint32_t Value;
+    memcpy(&Value, Pointer, sizeof(uint32_t));
+    return Value;
+}
+
+static inline uint32_t HashOf(uint32_t Sequence) {
+    return (Sequence * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+// 写入长度字段超出标记字节的部分
+static bool PutLength(uint8_t **ppOut, const uint8_t *OutEnd, size_t Length) {
+    uint8_t *Out = *ppOut;
+    for (; Length >= 255; Length -= 255) {
+        if (Out >= OutEnd)
+            return false;
+        *Out++ = 255;
+    }
+    if (Out >= OutEnd)
+        return false;
+    *Out++ = (uint8_t)Length;
+    *ppOut = Out;
+    return true;
+}
+
+// 读取长度字段超出标记字节的部分并加到 *pLength 上
+static bool GetLength(const uint8_t **ppIn, const uint8_t *InEnd, size_t *pLength, size_t Limit) {
+    const uint8_t *In = *ppIn;
+    uint8_t Byte;
+    do {
+        if (In >= InEnd)
+            return false;
+        Byte = *In++;
+        *pLength += Byte;
+        // 长度不可能超过输出的大小，防止损坏的数据使长度溢出
+        if (*pLength > Limit)
+            return false;
+    } while (Byte == 255);
+    *ppIn = In;
+    return true;
+}
+
+// 写入一个序列，Distance 为0时只有字面量(最后一个序列)
+static bool PutSequence(uint8_t **ppOut, const uint8_t *OutEnd, const uint8_t *Literals, size_t LiteralLength, size_t Distance, size_t MatchLength) {
+    uint8_t *Token = *ppOut;
+    size_t MatchCode = Distance ? MatchLength - LZ_MIN_MATCH : 0;
+    if (Token >= OutEnd)
+        return false;
+    *Token = (uint8_t)(((LiteralLength < LZ_LENGTH_MASK ? LiteralLength : LZ_LENGTH_MASK) << 4) | (MatchCode < LZ_LENGTH_MASK ? MatchCode : LZ_LENGTH_MASK));
+    ++*ppOut;
+    if (LiteralLength >= LZ_LENGTH_MASK && !PutLength(ppOut, OutEnd, LiteralLength - LZ_LENGTH_MASK))
+        return false;
+    if ((size_t)(OutEnd - *ppOut) < LiteralLength)
+        return false;
+    memcpy(*ppOut, Literals, LiteralLength);
+    *ppOut += LiteralLength;
+    if (!Distance)
+        return true;
+    if (OutEnd - *ppOut < 2)
+        return false;
+    (*ppOut)[0] = (uint8_t)(Distance & 0xFF);
+    (*ppOut)[1] = (uint8_t)(Distance >> 8);
+    *ppOut += 2;
+    if (MatchCode >= LZ_LENGTH_MASK && !PutLength(ppOut, OutEnd, MatchCode - LZ_LENGTH_MASK))
+        return false;
+    return true;
+}
+
+// 压缩 In 中从 Start 到 SourceSize 的字节到 Target，Start 之前为字典，只用于匹配
+static size_t EncodeFrom(const uint8_t *In, size_t Start, size_t SourceSize, void *Target, size_t TargetCapacity, int Level) {
+    uint8_t *Out = Target;
+    const uint8_t *OutEnd = Out + TargetCapacity;
+    uint32_t Table[1 << LZ_HASH_LOG]; // 各哈希值最近出现的位置加1，0表示没有
+    size_t Position = Start, Anchor = Start, Candidate, MatchLength, Limit;
+    unsigned Misses = 0;                      // 连续未找到匹配的次数，越多则跳过越多字节
+    unsigned SkipShift = (unsigned)Level + 2; // 压缩等级越高，跳过的字节数增长越慢
+    size_t Next, NextLength;
+    uint32_t Sequence, Hash;
+    // 哈希表只保存32位位置
+    if (SourceSize > UINT32_MAX - 1)
+        return 0;
+    memset(Table, 0, sizeof(Table));
+    // 字典中窗口内的每个位置都加入哈希表，越靠近原始数据的位置越晚加入，同一哈希值保留较近的位置
+    for (size_t i = Start > LZ_WINDOW ? Start - LZ_WINDOW : 0; i + LZ_MIN_MATCH <= Start; ++i)
+        Table[HashOf(Read32(In + i))] = (uint32_t)(i + 1);
+    if (SourceSize > Start + LZ_LAST_LITERALS + LZ_MIN_MATCH) {
+        Limit = SourceSize - LZ_LAST_LITERALS;
+        while (Position + LZ_MIN_MATCH <= Limit) {
+            Sequence = Read32(In + Position);
+            Hash = HashOf(Sequence);
+            Candidate = Table[Hash];
+            Table[Hash] = (uint32_t)(Position + 1);
+            if (!Candidate || Position - (Candidate - 1) > LZ_WINDOW || Read32(In + Candidate - 1) != Sequence) {
+                Position += 1 + (Misses++ >> SkipShift);
+                continue;
+            }
+            --Candidate;
+            MatchLength = LZ_MIN_MATCH;
+            while (Position + MatchLength < Limit && In[Candidate + MatchLength] == In[Position + MatchLength])
+                ++MatchLength;
+            while (Level >= LZ_LEVEL_LAZY && Position + 1 + LZ_MIN_MATCH <= Limit) {
+                Hash = HashOf(Read32(In + Position + 1));
+                Next = Table[Hash];
+                NextLength = 0;
+                Table[Hash] = (uint32_t)(Position + 2);
+                if (Next && Position + 1 - (Next - 1) <= LZ_WINDOW) {
+                    --Next;
+                    while (Position + 1 + NextLength < Limit && In[Next + NextLength] == In[Position + 1 + NextLength])
+                        ++NextLength;
+                }
+                if (NextLength <= MatchLength)
+                    break;
+                ++Position;
+                Candidate = Next;
+                MatchLength = NextLength;
+            }
+            // 向前扩展匹配，吸收尚未输出的字面量
+            while (Position > Anchor && Candidate > 0 && In[Position - 1] == In[Candidate - 1]) {
+                --Position;
+                --Candidate;
+                ++MatchLength;
+            }
+            if (!PutSequence(&Out, OutEnd, In + Anchor, Position - Anchor, Position - Candidate, MatchLength))
+                return 0;
+            Position += MatchLength;
+            Anchor = Position;
+            Misses = 0;
+        }
+    }
+    if (!PutSequence(&Out, OutEnd, In + Anchor, SourceSize - Anchor, 0, 0))
+        return 0;
+    return (size_t)(Out - (uint8_t *)Target);
+}
+
+// 压缩 Source 中的 SourceSize 字节到 Target，Level 越高查找匹配越仔细
+// 返回压缩后的字节数，Target 容量不足时返回0，不可压缩的数据可给出略小于 SourceSize 的容量以便尽早放弃
+size_t AnyfLZEncode(const void *Source, size_t SourceSize, void *Target, size_t TargetCapacity, int Level, const CODECDICT_T *Dict) {
+    uint8_t *Joined; // 字典和原始数据拼接在一起，匹配可以跨越两者
+    size_t Length;
+    if (!Dict || !Dict->size)
+        return EncodeFrom(Source, 0, SourceSize, Target, TargetCapacity, Level);
+    if (!(Joined = malloc(Dict->size + SourceSize)))
+        return 0;
+    memcpy(Joined, Dict->data, Dict->size);
+    memcpy(Joined + Dict->size, Source, SourceSize);
+    Length = EncodeFrom(Joined, Dict->size, Dict->size + SourceSize, Target, TargetCapacity, Level);
+    free(Joined);
+    return Length;
+}
+
+// 解压 Source 中的 SourceSize 字节到 Base 的 Start 偏移量处，Start 之前为字典，解压结果必须正好是 TargetSize 字节
+// 数据损坏时返回 false，不会越界读写
+static bool DecodeInto(const void *Source, size_t SourceSize, uint8_t *Base, size_t Start, size_t TargetSize) {
+    const uint8_t *In = Source;
+    const uint8_t *InEnd = In + SourceSize;
+    uint8_t *Out = Base + Start;
+    uint8_t *OutEnd = Out + TargetSize;
+    const uint8_t *Match;
+    size_t Length, Distance;
+    uint8_t Token;
+    for (;;) {
+        if (In >= InEnd)
+            return false;
+        Token = *In++;
+        Length = Token >> 4;
+        if (Length == LZ_LENGTH_MASK && !GetLength(&In, InEnd, &Length, TargetSize))
+            return false;
+        if (Length > (size_t)(InEnd - In) || Length > (size_t)(OutEnd - Out))
+            return false;
+        memcpy(Out, In, Length);
+        Out += Length;
+        In += Length;
+        if (In == InEnd)
+            return Out == OutEnd;
+        if (InEnd - In < 2)
+            return false;
+        Distance = (size_t)In[0] | ((size_t)In[1] << 8);
+        In += 2;
+        if (Distance == 0 || Distance > (size_t)(Out - Base))
+            return false;
+        Length = Token & LZ_LENGTH_MASK;
+        if (Length == LZ_LENGTH_MASK && !GetLength(&In, InEnd, &Length, TargetSize))
+            return false;
+        Length += LZ_MIN_MATCH;
+        if (Length > (size_t)(OutEnd - Out))
+            return false;
+        Match = Out - Distance;
+        // 距离小于长度时源和目标重叠，重复的部分要逐字节复制
+        if (Distance >= Length) {
+            memcpy(Out, Match, Length);
+            Out += Length;
+        } else {
+            while (Length--)
+                *Out++ = *Match++;
+        }
+    }
+}
+
+// 解压 Source 中的 SourceSize 字节到 Target，解压结果必须正好是 TargetSize 字节
+// 数据损坏时返回 false，不会越界读写
+bool AnyfLZDecode(const void *Source, size_t SourceSize, void *Target, size_t TargetSize, const CODECDICT_T *Dict) {
+    uint8_t *Joined; // 字典之后紧跟解压结果，匹配可以引用字典
+    bool Success;
+    if (!Dict || !Dict->size)
+        return DecodeInto(Source, SourceSize, Target, 0, TargetSize);
+    if (!(Joined = malloc(Dict->size + TargetSize)))
+        return false;
+    memcpy(Joined, Dict->data, Dict->size);
+    if (Success = DecodeInto(Source, SourceSize, Joined, Dict->size, TargetSize))
+        memcpy(Target, Joined + Dict->size, TargetSize);
+    free(Joined);
+    return Success;
+}
@@ -0,0 +1,15 @@
+#ifndef __LZ_H
+#define __LZ_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "codec.h"
+
+#define LZ_LEVEL_MIN     1 // 最快，压缩率最低
+#define LZ_LEVEL_MAX     9 // 最慢，压缩率最高
+#define LZ_LEVEL_DEFAULT 5
+
+size_t AnyfLZEncode(const void *Source, size_t SourceSize, void *Target, size_t TargetCapacity, int Level, const CODECDICT_T *Dict);
+bool AnyfLZDecode(const void *Source, size_t SourceSize, void *Target, size_t TargetSize, const CODECDICT_T *Dict);
+
+#endif // __LZ_H
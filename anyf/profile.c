@@ -0,0 +1,324 @@
+#include "profile.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../osfile/osfile.h"
+#include "../ospath/ospath.h"
+
+#define PROBE_STEP_COUNT 3                // 校准时尝试的每次读写字节数个数
+#define PROBE_STEP_MAX   8388608LL        // 校准时尝试的最大每次读写字节数
+#define PROBE_PREFIX     ".anyf_probe_"   // 校准时在目标目录创建的临时文件名前缀
+#define PROFILE_LINE_MAX 128              // 校准配置文件每行最大字节数
+#define PROFILE_TEMP_EXT ".tmp"           // 保存校准配置文件时的临时文件扩展名
+
+// 校准时尝试的每次读写字节数
+static const int64_t PROBE_STEPS[PROBE_STEP_COUNT] = {65536LL, 1048576LL, 8388608LL};
+// 校准各大小类别时使用的文件大小和文件数量，每个类别写入的总量在几到几十 MB
+static const int64_t PROBE_SIZES[SIZE_CLASS_COUNT] = {16384LL, 1048576LL, 33554432LL};
+static const int PROBE_FILES[SIZE_CLASS_COUNT] = {256, 8, 1};
+
+// 没有校准配置时使用的读写方式，与校准前的行为相同
+static const PROFILE_T DEFAULT_PROFILE = {
+    .device = 0ULL,
+    .plans =
+        {
+            {IO_STDIO, PROFILE_STEP_DEFAULT},
+            {IO_STDIO, PROFILE_STEP_DEFAULT},
+            {IO_STDIO, PROFILE_STEP_DEFAULT},
+        },
+};
+
+// 获取校准配置文件路径：环境变量 PROFILE_ENV 指定的路径，否则为用户主目录下的 PROFILE_NAME
+static bool ProfilePath(char *Buffer, size_t BufferSize) {
+    const char *Path = getenv(PROFILE_ENV);
+    if (Path && *Path) {
+        if (strlen(Path) >= BufferSize)
+            return false;
+        strcpy(Buffer, Path);
+        return true;
+    }
+#ifdef _WIN32
+    Path = getenv("USERPROFILE");
+#else
+    Path = getenv("HOME");
+#endif // _WIN32
+    if (!Path || !*Path)
+        return false;
+    return !OsPathJoinPath(Buffer, BufferSize, 2, Path, PROFILE_NAME);
+}
+
+// 填充默认校准配置
+void AnyfProfileDefault(PROFILE_T *Profile) {
+    *Profile = DEFAULT_PROFILE;
+}
+
+// 根据数据块大小获取读写方式，Profile 为NULL时使用默认配置
+const IOPLAN_T *AnyfProfilePlan(const PROFILE_T *Profile, int64_t Size) {
+    if (!Profile)
+        Profile = &DEFAULT_PROFILE;
+    if (Size < SIZE_SMALL_MAX)
+        return &Profile->plans[SIZE_CLASS_SMALL];
+    if (Size < SIZE_MEDIUM_MAX)
+        return &Profile->plans[SIZE_CLASS_MEDIUM];
+    return &Profile->plans[SIZE_CLASS_LARGE];
+}
+
+// 校准配置需要的缓冲块大小：各类别每次读写字节数的最大值，不小于 POOL_CHUNK_MIN
+int64_t AnyfProfileChunk(const PROFILE_T *Profile) {
+    int64_t Chunk = POOL_CHUNK_MIN;
+    if (!Profile)
+        Profile = &DEFAULT_PROFILE;
+    for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+        if (Profile->plans[i].method == IO_STDIO && Profile->plans[i].step > Chunk)
+            Chunk = Profile->plans[i].step;
+    }
+    return Chunk;
+}
+
+// 按读写方式从流 From 的当前位置复制 Size 字节到流 To 的当前位置
+// IO_KERNEL 方式不可用时退回标准库读写，每次读写的字节数不超过缓冲块大小
+// Throttle 不为NULL时每次读写前按限速领取令牌，内核内复制也按相同字节数分段
+// pCrc 不为NULL时把复制的数据累加到 *pCrc 的 CRC32C 上，数据必须经过缓冲块，因此不使用内核内复制
+bool AnyfCopyWithPlan(FILE *From, FILE *To, int64_t Size, BUFFER_T *Chunk, const IOPLAN_T *Plan, THROTTLE_T *Throttle, uint32_t *pCrc) {
+    size_t SizeOnce; // 每次读写的大小
+    int64_t Step = Chunk->size;
+    if (Plan->step > 0LL && Plan->step < Step)
+        Step = Plan->step;
+    if (Plan->method == IO_KERNEL && !pCrc) {
+        while (Size > 0LL) {
+            SizeOnce = (size_t)(Throttle && Size > Step ? Step : Size);
+            // 复制失败时流的状态不变，余下部分改用标准库读写
+            if (OsFileCopyRange(From, To, (int64_t)SizeOnce))
+                break;
+            AnyfThrottle(Throttle, (int64_t)SizeOnce, 1LL);
+            Size -= (int64_t)SizeOnce;
+        }
+    }
+    while (Size > 0LL) {
+        SizeOnce = (size_t)(Size < Step ? Size : Step);
+        AnyfThrottle(Throttle, (int64_t)SizeOnce, 1LL);
+        if (fread(Chunk->fdata, SizeOnce, 1, From) != 1)
+            return false;
+        if (pCrc)
+            *pCrc = AnyfCrc32c(*pCrc, Chunk->fdata, SizeOnce);
+        if (fwrite(Chunk->fdata, SizeOnce, 1, To) != 1)
+            return false;
+        Size -= (int64_t)SizeOnce;
+    }
+    return true;
+}
+
+// 拼接校准临时文件路径，Role 为 's'(源文件) 或 'd'(目标文件)
+static bool ProbePath(char *Buffer, size_t BufferSize, const char *Directory, int Role, int Index) {
+    char NameBuffer[32];
+    snprintf(NameBuffer, sizeof(NameBuffer), PROBE_PREFIX "%c%d", Role, Index);
+    return !OsPathJoinPath(Buffer, BufferSize, 2, Directory, NameBuffer);
+}
+
+// 用一种读写方式把校准源文件逐个复制到目标文件并同步到磁盘，返回耗时(纳秒)，失败返回-1
+// IO_KERNEL 方式直接使用内核内复制，不可用时视为失败，避免把标准库读写的耗时当作内核内复制的耗时
+static int64_t ProbeOnce(const char *Directory, int Class, const IOPLAN_T *Plan, BUFFER_T *Chunk) {
+    char SourcePath[PATH_MAX_SIZE], TargetPath[PATH_MAX_SIZE];
+    FILE *Source, *Target;
+    int64_t Started, Elapsed = -1LL;
+    bool Succeeded = true;
+    int i;
+    Started = AnyfNanoClock();
+    for (i = 0; Succeeded && i < PROBE_FILES[Class]; ++i) {
+        if (!ProbePath(SourcePath, PATH_MAX_SIZE, Directory, 's', i) || !ProbePath(TargetPath, PATH_MAX_SIZE, Directory, 'd', i))
+            return -1LL;
+        if (!(Source = fopen(SourcePath, "rb"))) {
+            Succeeded = false;
+            break;
+        }
+        if (!(Target = fopen(TargetPath, "wb"))) {
+            fclose(Source);
+            Succeeded = false;
+            break;
+        }
+        if (Plan->method == IO_KERNEL)
+            Succeeded = !OsFileCopyRange(Source, Target, PROBE_SIZES[Class]);
+        else
+            Succeeded = AnyfCopyWithPlan(Source, Target, PROBE_SIZES[Class], Chunk, Plan, NULL, NULL);
+        if (Succeeded && OsFileSyncData(Target))
+            Succeeded = false;
+        fclose(Source);
+        fclose(Target);
+    }
+    if (Succeeded)
+        Elapsed = AnyfNanoClock() - Started;
+    for (int j = 0; j < i; ++j) {
+        if (ProbePath(TargetPath, PATH_MAX_SIZE, Directory, 'd', j))
+            remove(TargetPath);
+    }
+    return Elapsed;
+}
+
+// 创建校准某个大小类别使用的源文件，内容为伪随机字节，避免文件系统压缩或去重影响结果
+static bool ProbeSources(const char *Directory, int Class, BUFFER_T *Chunk) {
+    char SourcePath[PATH_MAX_SIZE];
+    FILE *Source;
+    uint32_t Seed = 2463534242U;
+    int64_t Remaining, SizeOnce;
+    for (int64_t k = 0; k < Chunk->size; ++k) {
+        Seed ^= Seed << 13, Seed ^= Seed >> 17, Seed ^= Seed << 5;
+        Chunk->fdata[k] = (char)Seed;
+    }
+    for (int i = 0; i < PROBE_FILES[Class]; ++i) {
+        if (!ProbePath(SourcePath, PATH_MAX_SIZE, Directory, 's', i))
+            return false;
+        if (!(Source = fopen(SourcePath, "wb")))
+            return false;
+        for (Remaining = PROBE_SIZES[Class]; Remaining > 0LL; Remaining -= SizeOnce) {
+            SizeOnce = Remaining < Chunk->size ? Remaining : Chunk->size;
+            if (fwrite(Chunk->fdata, (size_t)SizeOnce, 1, Source) != 1) {
+                fclose(Source);
+                return false;
+            }
+        }
+        if (OsFileSyncData(Source)) {
+            fclose(Source);
+            return false;
+        }
+        fclose(Source);
+    }
+    return true;
+}
+
+// 删除校准某个大小类别使用的源文件
+static void ProbeCleanup(const char *Directory, int Class) {
+    char SourcePath[PATH_MAX_SIZE];
+    for (int i = 0; i < PROBE_FILES[Class]; ++i) {
+        if (ProbePath(SourcePath, PATH_MAX_SIZE, Directory, 's', i))
+            remove(SourcePath);
+    }
+}
+
+// 在目录 Directory 所在的文件系统上校准各大小类别的读写方式
+// 每个类别依次尝试标准库读写的各种每次读写字节数以及内核内复制，选用耗时最短的方式
+// 校准过程在 Directory 中创建并删除临时文件，写入总量约 160MB
+// 成功返回0，失败返回1，失败时 Profile 为默认配置
+int AnyfProfileCalibrate(const char *Directory, PROFILE_T *Profile) {
+    BUFFER_T *Chunk;
+    IOPLAN_T Candidate;
+    int64_t Elapsed, Fastest;
+    int FinalReturnCode = RESULT_SUCCESS;
+    AnyfProfileDefault(Profile);
+    if (OsFileDevice(Directory, &Profile->device))
+        return RESULT_FAILURE;
+    if (!(Chunk = malloc(sizeof(BUFFER_T) + PROBE_STEP_MAX)))
+        return RESULT_FAILURE;
+    Chunk->size = PROBE_STEP_MAX;
+    Chunk->pool = NULL;
+    for (int Class = 0; Class < SIZE_CLASS_COUNT; ++Class) {
+        if (!ProbeSources(Directory, Class, Chunk)) {
+            ProbeCleanup(Directory, Class);
+            FinalReturnCode = RESULT_FAILURE;
+            break;
+        }
+        Fastest = -1LL;
+        // 最后一个候选为内核内复制，其余为标准库读写
+        for (int i = 0; i <= PROBE_STEP_COUNT; ++i) {
+            if (i < PROBE_STEP_COUNT) {
+                // 每次读写字节数明显超过文件大小时结果与较小的字节数相同，不必尝试
+                if (i > 0 && PROBE_STEPS[i - 1] >= PROBE_SIZES[Class])
+                    continue;
+                Candidate.method = IO_STDIO;
+                Candidate.step = PROBE_STEPS[i];
+            } else {
+                Candidate.method = IO_KERNEL;
+                Candidate.step = Profile->plans[Class].step;
+            }
+            if ((Elapsed = ProbeOnce(Directory, Class, &Candidate, Chunk)) < 0LL)
+                continue;
+            if (Fastest < 0LL || Elapsed < Fastest) {
+                Fastest = Elapsed;
+                Profile->plans[Class] = Candidate;
+            }
+        }
+        ProbeCleanup(Directory, Class);
+        if (Fastest < 0LL) {
+            FinalReturnCode = RESULT_FAILURE;
+            break;
+        }
+    }
+    free(Chunk);
+    if (FinalReturnCode)
+        AnyfProfileDefault(Profile);
+    return FinalReturnCode;
+}
+
+// 读取校准配置文件中路径 Path 所在文件系统的配置
+// 成功返回0；没有配置文件或其中没有此文件系统的配置时返回1，此时 Profile 为默认配置
+int AnyfProfileLoad(const char *Path, PROFILE_T *Profile) {
+    char ProfileFile[PATH_MAX_SIZE];
+    char Line[PROFILE_LINE_MAX];
+    FILE *Stream;
+    uint64_t Device, LineDevice;
+    int Class;
+    IOPLAN_T Plan;
+    int Found = 0; // 找到的大小类别数量
+    AnyfProfileDefault(Profile);
+    if (OsFileDevice(Path, &Device) || !ProfilePath(ProfileFile, PATH_MAX_SIZE))
+        return RESULT_FAILURE;
+    if (!(Stream = fopen(ProfileFile, "r")))
+        return RESULT_FAILURE;
+    while (fgets(Line, PROFILE_LINE_MAX, Stream)) {
+        if (sscanf(Line, "%" SCNx64 " %d %" SCNd32 " %" SCNd64, &LineDevice, &Class, &Plan.method, &Plan.step) != 4)
+            continue;
+        if (LineDevice != Device || Class < 0 || Class >= SIZE_CLASS_COUNT)
+            continue;
+        if (Plan.method != IO_STDIO && Plan.method != IO_KERNEL)
+            continue;
+        if (Plan.step < POOL_CHUNK_MIN || Plan.step > PROBE_STEP_MAX)
+            continue;
+        Profile->plans[Class] = Plan;
+        ++Found;
+    }
+    fclose(Stream);
+    Profile->device = Device;
+    return Found > 0 ? RESULT_SUCCESS : RESULT_FAILURE;
+}
+
+// 保存校准配置，替换配置文件中同一文件系统原有的配置
+// 成功返回0，失败返回1
+int AnyfProfileSave(const PROFILE_T *Profile) {
+    char ProfileFile[PATH_MAX_SIZE];
+    char TempFile[PATH_MAX_SIZE];
+    char Line[PROFILE_LINE_MAX];
+    FILE *OldStream, *NewStream;
+    uint64_t LineDevice;
+    if (!ProfilePath(ProfileFile, PATH_MAX_SIZE) || strlen(ProfileFile) + sizeof(PROFILE_TEMP_EXT) > PATH_MAX_SIZE)
+        return RESULT_FAILURE;
+    strcpy(TempFile, ProfileFile);
+    strcat(TempFile, PROFILE_TEMP_EXT);
+    if (!(NewStream = fopen(TempFile, "w")))
+        return RESULT_FAILURE;
+    fprintf(NewStream, "# anyf 校准配置：设备号 大小类别 复制方式 每次读写字节数\n");
+    // 保留其他文件系统的配置
+    if (OldStream = fopen(ProfileFile, "r")) {
+        while (fgets(Line, PROFILE_LINE_MAX, OldStream)) {
+            if (sscanf(Line, "%" SCNx64, &LineDevice) != 1 || LineDevice == Profile->device)
+                continue;
+            fputs(Line, NewStream);
+        }
+        fclose(OldStream);
+    }
+    for (int i = 0; i < SIZE_CLASS_COUNT; ++i)
+        fprintf(NewStream, "%" PRIx64 " %d %" PRId32 " %" PRId64 "\n", Profile->device, i, Profile->plans[i].method, Profile->plans[i].step);
+    if (fclose(NewStream)) {
+        remove(TempFile);
+        return RESULT_FAILURE;
+    }
+#ifdef _WIN32
+    // WIN平台的 rename 不能覆盖已存在的文件
+    remove(ProfileFile);
+#endif // _WIN32
+    if (rename(TempFile, ProfileFile)) {
+        remove(TempFile);
+        return RESULT_FAILURE;
+    }
+    return RESULT_SUCCESS;
+}
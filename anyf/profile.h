@@ -0,0 +1,48 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bufpool.h"
+#include "crc32c.h"
+#include "throttle.h"
+
+// 复制数据块的方式
+#define IO_STDIO  0 // 标准库缓冲读写，每次读写 step 字节
+#define IO_KERNEL 1 // 内核内复制(copy_file_range)，不支持时退回 IO_STDIO
+
+// 按数据块大小划分的类别
+#define SIZE_CLASS_SMALL  0 // 小于 SIZE_SMALL_MAX 字节
+#define SIZE_CLASS_MEDIUM 1 // 小于 SIZE_MEDIUM_MAX 字节
+#define SIZE_CLASS_LARGE  2 // 其余
+#define SIZE_CLASS_COUNT  3
+
+#define SIZE_SMALL_MAX  65536LL   // 小文件类别的字节数上限(不含)
+#define SIZE_MEDIUM_MAX 8388608LL // 中等文件类别的字节数上限(不含)
+
+#define PROFILE_STEP_DEFAULT 8388608LL      // 没有校准配置时每次读写的字节数
+#define PROFILE_ENV          "ANYF_PROFILE" // 可用此环境变量指定校准配置文件路径
+#define PROFILE_NAME         ".anyf_profile" // 默认校准配置文件名，位于用户主目录
+
+// 一个大小类别的读写方式
+typedef struct {
+    int32_t method; // 复制方式：IO_STDIO 或 IO_KERNEL
+    int64_t step;   // IO_STDIO 方式每次读写的字节数，受缓冲块大小限制
+} IOPLAN_T;
+
+// 一个设备(文件系统)的校准配置
+typedef struct {
+    uint64_t device;                   // 文件系统设备号
+    IOPLAN_T plans[SIZE_CLASS_COUNT];  // 各大小类别的读写方式
+} PROFILE_T;
+
+void AnyfProfileDefault(PROFILE_T *Profile);
+int AnyfProfileCalibrate(const char *Directory, PROFILE_T *Profile);
+int AnyfProfileSave(const PROFILE_T *Profile);
+int AnyfProfileLoad(const char *Path, PROFILE_T *Profile);
+int64_t AnyfProfileChunk(const PROFILE_T *Profile);
+const IOPLAN_T *AnyfProfilePlan(const PROFILE_T *Profile, int64_t Size);
+bool AnyfCopyWithPlan(FILE *From, FILE *To, int64_t Size, BUFFER_T *Chunk, const IOPLAN_T *Plan, THROTTLE_T *Throttle, uint32_t *pCrc);
+
+#endif // __PROFILE_H
@@ -0,0 +1,104 @@
+#include "throttle.h"
+
+#include <errno.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif // _WIN32
+
+// 单调时钟的当前时间，单位纳秒，只用于计算时间差
+int64_t AnyfNanoClock(void) {
+#ifdef _WIN32
+    LARGE_INTEGER Counter, Frequency;
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+    return (int64_t)((double)Counter.QuadPart * 1e9 / (double)Frequency.QuadPart);
+#else
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (int64_t)Now.tv_sec * 1000000000LL + (int64_t)Now.tv_nsec;
+#endif // _WIN32
+}
+
+// 休眠 Nanoseconds 纳秒
+static void SleepNanoseconds(int64_t Nanoseconds) {
+#ifdef _WIN32
+    Sleep((DWORD)((Nanoseconds + 999999LL) / 1000000LL));
+#else
+    struct timespec Duration = {
+        .tv_sec = (time_t)(Nanoseconds / 1000000000LL),
+        .tv_nsec = (long)(Nanoseconds % 1000000000LL),
+    };
+    while (nanosleep(&Duration, &Duration) && errno == EINTR)
+        ;
+#endif // _WIN32
+}
+
+// 按经过的时间补充令牌，令牌最多积累一秒的量
+static void Refill(THROTTLE_T *Throttle) {
+    int64_t Now = AnyfNanoClock();
+    double Seconds = (double)(Now - Throttle->last) / 1e9;
+    Throttle->last = Now;
+    if (Throttle->byterate > 0LL) {
+        Throttle->bytes += Seconds * (double)Throttle->byterate;
+        if (Throttle->bytes > (double)Throttle->byterate)
+            Throttle->bytes = (double)Throttle->byterate;
+    }
+    if (Throttle->oprate > 0LL) {
+        Throttle->ops += Seconds * (double)Throttle->oprate;
+        if (Throttle->ops > (double)Throttle->oprate)
+            Throttle->ops = (double)Throttle->oprate;
+    }
+}
+
+// 初始化限速器，ByteRate 和 OpRate 为0表示对应项不限
+void AnyfThrottleInit(THROTTLE_T *Throttle, int64_t ByteRate, int64_t OpRate) {
+    Throttle->byterate = ByteRate > 0LL ? ByteRate : 0LL;
+    Throttle->oprate = OpRate > 0LL ? OpRate : 0LL;
+    Throttle->bytes = (double)Throttle->byterate;
+    Throttle->ops = (double)Throttle->oprate;
+    Throttle->last = AnyfNanoClock();
+    Throttle->waited = 0LL;
+    Throttle->sleepers = 0;
+    Throttle->since = 0LL;
+    OsMutexInit(&Throttle->lock);
+}
+
+// 释放限速器的锁，限速器本身由调用者释放
+void AnyfThrottleDelete(THROTTLE_T *Throttle) {
+    OsMutexDestroy(&Throttle->lock);
+}
+
+// 读写 Bytes 字节、Ops 次之前调用，令牌不足时休眠到欠账还清为止
+// Throttle 为NULL或两项都不限时立即返回，多个线程同时调用时各自休眠，不互相阻塞
+// 累计等待时间只计至少有一个线程在休眠的时长，不是各线程休眠时间之和
+void AnyfThrottle(THROTTLE_T *Throttle, int64_t Bytes, int64_t Ops) {
+    double WaitSeconds = 0.0, OpWait; // 需要等待的秒数
+    if (!Throttle || (!Throttle->byterate && !Throttle->oprate))
+        return;
+    OsMutexLock(&Throttle->lock);
+    Refill(Throttle);
+    if (Throttle->byterate > 0LL) {
+        Throttle->bytes -= (double)Bytes;
+        if (Throttle->bytes < 0.0)
+            WaitSeconds = -Throttle->bytes / (double)Throttle->byterate;
+    }
+    if (Throttle->oprate > 0LL) {
+        Throttle->ops -= (double)Ops;
+        if (Throttle->ops < 0.0 && (OpWait = -Throttle->ops / (double)Throttle->oprate) > WaitSeconds)
+            WaitSeconds = OpWait;
+    }
+    if (WaitSeconds > 0.0 && !Throttle->sleepers++)
+        Throttle->since = AnyfNanoClock();
+    OsMutexUnlock(&Throttle->lock);
+    if (WaitSeconds <= 0.0)
+        return;
+    SleepNanoseconds((int64_t)(WaitSeconds * 1e9));
+    OsMutexLock(&Throttle->lock);
+    if (!--Throttle->sleepers)
+        Throttle->waited += AnyfNanoClock() - Throttle->since;
+    OsMutexUnlock(&Throttle->lock);
+}
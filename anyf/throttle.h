@@ -0,0 +1,26 @@
+#ifndef __THROTTLE_H
+#define __THROTTLE_H
+#include <stdint.h>
+
+#include "../osthread/osthread.h"
+
+// 令牌桶限速器，同时限制每秒读写字节数和每秒读写次数
+// 令牌最多积累一秒的量，允许短时间的突发读写，可由多个线程共用
+typedef struct {
+    OSMUTEX_T lock;   // 保护以下成员
+    int64_t byterate; // 每秒读写字节数上限，为0时不限
+    int64_t oprate;   // 每秒读写次数上限，为0时不限
+    double bytes;     // 当前的字节令牌数，可为负数(表示欠账)
+    double ops;       // 当前的次数令牌数，可为负数
+    int64_t last;     // 上次补充令牌的时间，单位纳秒
+    int64_t waited;   // 因限速累计等待的时间，单位纳秒，多个线程同时等待的时间只计一次
+    int sleepers;     // 正在因限速休眠的线程数
+    int64_t since;    // 最近一次由没有线程休眠变为有线程休眠的时间，单位纳秒
+} THROTTLE_T;
+
+int64_t AnyfNanoClock(void);
+void AnyfThrottleInit(THROTTLE_T *Throttle, int64_t ByteRate, int64_t OpRate);
+void AnyfThrottleDelete(THROTTLE_T *Throttle);
+void AnyfThrottle(THROTTLE_T *Throttle, int64_t Bytes, int64_t Ops);
+
+#endif // __THROTTLE_H
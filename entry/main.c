@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -12,230 +13,781 @@
 #include "info.h"
 #include "main.h"
 
-int ParseCommands(int argc, char **argvs) {
-    bool Overwrite = false;
-    bool Append = false;
-    bool Recursion = false;
-    int SubOption;
-    ANYF_T *pAnyfType; // ANYF 文件信息结构体指针
-    static char AnyfFilePath[PATH_MAX_SIZE];
-    static char TargetPath[PATH_MAX_SIZE];
-    static char JPEGFilePath[PATH_MAX_SIZE];
-    static char Executable[PATH_MAX_SIZE];
-    static char NameToExtract[PATH_MAX_SIZE];
-    const char *pNameToExtract = NameToExtract;
-    // 主命令，必须是第一个命令行参数
-    const char *MAINCMD_HELP = "help"; // 显示此程序的帮助信息
-    const char *MAINCMD_VERS = "vers"; // 显示此程序的版本信息
-    const char *MAINCMD_INFO = "info"; // 显示 ANYF 文件信息及其子文件列表
-    const char *MAINCMD_PACK = "pack"; // 将目录或文件打包为 ANYF 文件
-    const char *MAINCMD_FAKE = "fake"; // 打包目录或文件并将其伪装为 JPEG 文件
-    const char *MAINCMD_EXTR = "extr"; // 从 ANYF 文件中提取目录或文件
+// 解析带可选单位(K、M、G)的字节数，例如 512K、64M、1G
+// 成功返回 true，格式错误、数值不是正数或换算后超出 int64_t 范围返回 false
+static bool ParseByteSize(const char *String, int64_t *pSize) {
+    char *EndPointer;
+    long long Value;
+    int64_t Multiplier = 1LL; // 单位对应的字节数
+    errno = 0;
+    Value = strtoll(String, &EndPointer, 10);
+    if (EndPointer == String || Value <= 0LL || errno == ERANGE)
+        return false;
+    switch (*EndPointer) {
+    case 'g':
+    case 'G':
+        Multiplier *= 1024LL;
+        // fall through
+    case 'm':
+    case 'M':
+        Multiplier *= 1024LL;
+        // fall through
+    case 'k':
+    case 'K':
+        Multiplier *= 1024LL;
+        ++EndPointer;
+        // fall through
+    case EMPTY_CHAR:
+        break;
+    default:
+        return false;
+    }
+    if (*EndPointer && strcmp(EndPointer, "B") && strcmp(EndPointer, "b"))
+        return false;
+    if ((int64_t)Value > INT64_MAX / Multiplier)
+        return false;
+    *pSize = (int64_t)Value * Multiplier;
+    return true;
+}
 
-    const char *SUBCMD_INFO = "f:";        // 主命令[info]的子选项
-    const char *SUBCMD_PACK = "f:t:ora";   // 主命令[pack]的子选项
-    const char *SUBCMD_FAKE = "j:f:t:ora"; // 主命令[fake]的子选项
-    const char *SUBCMD_EXTR = "f:t:n:o";   // 主命令[extr]的子选项
+// 解析限速和 I/O 优先级选项：--bwlimit、--iops-limit、--ioprio
+// I/O 优先级作用于整个进程，解析时只记录，由 RunCommand 在执行命令前设置
+// 成功返回0，参数无效返回1
+static int ParseLimitOption(int Option, const char *Argument, double *pBandWidth, long long *pIOPSLimit, int *pIOPriority) {
+    char *EndPointer;
+    switch (Option) {
+    case LONGOPT_BWLIMIT:
+        *pBandWidth = strtod(Argument, &EndPointer);
+        if (EndPointer == Argument || *EndPointer || *pBandWidth <= 0.0) {
+            fprintf(stderr, MESSAGE_ERROR "无效的带宽上限：%s\n", Argument);
+            return EXIT_CODE_FAILURE;
+        }
+        break;
+    case LONGOPT_IOPS:
+        *pIOPSLimit = strtoll(Argument, &EndPointer, 10);
+        if (EndPointer == Argument || *EndPointer || *pIOPSLimit <= 0LL) {
+            fprintf(stderr, MESSAGE_ERROR "无效的每秒读写次数上限：%s\n", Argument);
+            return EXIT_CODE_FAILURE;
+        }
+        break;
+    case LONGOPT_IOPRIO:
+        if (!strcmp(Argument, "idle")) {
+            *pIOPriority = OSFILE_IOPRIO_IDLE;
+        } else if (!strcmp(Argument, "be")) {
+            *pIOPriority = OSFILE_IOPRIO_BE;
+        } else {
+            fprintf(stderr, MESSAGE_ERROR "无效的 I/O 优先级：%s，可用 idle 或 be\n", Argument);
+            return EXIT_CODE_FAILURE;
+        }
+        break;
+    }
+    return EXIT_CODE_SUCCESS;
+}
 
-    if (argc < 2) {
-        fprintf(stderr, MESSAGE_ERROR "命令行参数不足，请使用 %s 命令查看使用帮助\n", MAINCMD_HELP);
+// 解析并行线程数选项[-j]，0 表示使用 CPU 核心数
+// 成功返回0，参数无效返回1
+static int ParseJobsOption(const char *Argument, long *pJobs) {
+    char *EndPointer;
+    *pJobs = strtol(Argument, &EndPointer, 10);
+    if (EndPointer == Argument || *EndPointer || *pJobs < 0L || *pJobs > THREAD_MAX) {
+        fprintf(stderr, MESSAGE_ERROR "无效的线程数：%s，应为 0 到 %d 之间的整数\n", Argument, THREAD_MAX);
         return EXIT_CODE_FAILURE;
     }
-    AnyfFilePath[0] = EMPTY_CHAR;
-    TargetPath[0] = EMPTY_CHAR;
-    JPEGFilePath[0] = EMPTY_CHAR;
-    optind = 2; // 查找参数从第3个开始，否则查不到（此变量是 getopt.h 全局变量）
-    OsPathSplitExt(Executable, PATH_MAX_SIZE, NULL, 0, OsPathBaseName(NULL, 0, argvs[0]), '.');
-    if (!strcmp(argvs[1], MAINCMD_HELP)) {
-        printf(COMMANDUSAGE, Executable);
+    if (*pJobs == 0L)
+        *pJobs = OsThreadCPUCount();
+    return EXIT_CODE_SUCCESS;
+}
+
+// 校准结果中各大小类别的名称
+static const char *PROFILE_CLASS_NAMES[SIZE_CLASS_COUNT] = {"小于 64K 的文件", "小于 8M 的文件", "其余文件"};
+
+// 主命令，必须是第一个命令行参数
+static const char *MAINCMD_HELP = "help";       // 显示此程序的帮助信息
+static const char *MAINCMD_VERS = "vers";       // 显示此程序的版本信息
+static const char *MAINCMD_INFO = "info";       // 显示 ANYF 文件信息及其子文件列表
+static const char *MAINCMD_PACK = "pack";       // 将目录或文件打包为 ANYF 文件
+static const char *MAINCMD_FAKE = "fake";       // 打包目录或文件并将其伪装为 JPEG 文件
+static const char *MAINCMD_EXTR = "extr";       // 从 ANYF 文件中提取目录或文件
+static const char *MAINCMD_CALI = "calibrate";  // 校准设备的读写方式
+static const char *MAINCMD_BATC = "batch";      // 按任务清单批量执行命令
+static const char *MAINCMD_VERI = "verify";     // 校验 ANYF 文件中的子文件
+
+static const char *SUBCMD_INFO = "f:";          // 主命令[info]的子选项
+static const char *SUBCMD_PACK = "f:t:oraj:z:"; // 主命令[pack]的子选项
+static const char *SUBCMD_FAKE = "j:f:t:oraz:"; // 主命令[fake]的子选项
+static const char *SUBCMD_EXTR = "f:t:n:oj:";   // 主命令[extr]的子选项
+static const char *SUBCMD_CALI = "t:";          // 主命令[calibrate]的子选项
+static const char *SUBCMD_BATC = "m:t:j:";      // 主命令[batch]的子选项
+static const char *SUBCMD_VERI = "f:n:j:";      // 主命令[verify]的子选项
+
+// 主命令[pack]、[fake]、[extr]、[verify]共用的长选项
+static const struct option LONGOPTS_COPY[] = {
+    {"max-mem", required_argument, NULL, LONGOPT_MAX_MEM},
+    {"durable", no_argument, NULL, LONGOPT_DURABLE},
+    {"bwlimit", required_argument, NULL, LONGOPT_BWLIMIT},
+    {"iops-limit", required_argument, NULL, LONGOPT_IOPS},
+    {"ioprio", required_argument, NULL, LONGOPT_IOPRIO},
+    {"shared", no_argument, NULL, LONGOPT_SHARED},
+    {"solid", required_argument, NULL, LONGOPT_SOLID},
+    {"offset", required_argument, NULL, LONGOPT_OFFSET},
+    {"length", required_argument, NULL, LONGOPT_LENGTH},
+    {"train-dict", no_argument, NULL, LONGOPT_TRAIN_DICT},
+    {"resume", no_argument, NULL, LONGOPT_RESUME},
+    {"checkpoint", required_argument, NULL, LONGOPT_CHECKPOINT},
+    {"update", no_argument, NULL, LONGOPT_UPDATE},
+    {"checksum", no_argument, NULL, LONGOPT_CHECKSUM},
+    {NULL, 0, NULL, 0},
+};
+
+// 主命令[batch]的长选项
+static const struct option LONGOPTS_BATC[] = {
+    {"max-mem", required_argument, NULL, LONGOPT_MAX_MEM},
+    {"ioprio", required_argument, NULL, LONGOPT_IOPRIO},
+    {NULL, 0, NULL, 0},
+};
+
+// 没有长选项的主命令使用
+static const struct option LONGOPTS_NONE[] = {
+    {NULL, 0, NULL, 0},
+};
+
+// 不含扩展名的程序文件名，用于帮助信息
+static char Executable[PATH_MAX_SIZE];
+
+// 一条命令解析后的参数，单独运行和批量运行共用
+typedef struct {
+    int command;                  // 主命令，CMD_ 开头的宏
+    bool overwrite;               // [-o]
+    bool append;                  // [-a]
+    bool recursion;               // [-r]
+    bool durable;                 // [--durable]
+    bool shared;                  // [--shared]
+    bool traindict;               // [--train-dict]
+    bool resume;                  // [--resume]
+    int64_t checkpoint;           // [--checkpoint] 每写入此字节数提交一次检查点，0 表示只在结束时提交
+    int update;                   // [--update]、[--checksum] 跳过已是最新的目标文件的判断方式，UPDATE_ 开头的宏
+    int64_t maxmem;               // [--max-mem] 缓冲池总字节数上限
+    double bandwidth;             // [--bwlimit] 每秒读写 MB 数上限，0 表示不限
+    long long iopslimit;          // [--iops-limit] 每秒读写次数上限，0 表示不限
+    int ioprio;                   // [--ioprio] I/O 优先级，OSFILE_IOPRIO_ 开头的宏，-1 表示不设置
+    long jobs;                    // [-j] 并行线程数
+    int codec;                    // [-z] 压缩方式，CODEC_ 开头的宏
+    int level;                    // [-z] 压缩等级
+    int64_t solid;                // [--solid] 固实块字节数上限，0 表示不使用固实块
+    int64_t roffset;              // [--offset] 提取范围的起始偏移量
+    int64_t rlength;              // [--length] 提取范围的字节数，0 表示提取整个子文件
+    char anyf[PATH_MAX_SIZE];     // [-f] ANYF 文件路径
+    char target[PATH_MAX_SIZE];   // [-t] 打包目标、保存目录、校准目录或批量模式的结果文件
+    char jpeg[PATH_MAX_SIZE];     // 主命令[fake]的[-j] JPEG 文件路径
+    char name[PATH_MAX_SIZE];     // [-n] 要提取的子文件名
+    char manifest[PATH_MAX_SIZE]; // [-m] 批量模式的任务清单路径
+} COMMAND_T;
+
+// 批量模式的一个任务
+typedef struct {
+    char *line;    // 清单中的命令行，不含行尾换行符
+    size_t number; // 在清单中的行号
+    int status;    // 退出状态码
+} BATCHJOB_T;
+
+// 批量模式各线程共享的状态
+typedef struct {
+    BATCHJOB_T *jobs; // 清单中的全部任务
+    size_t count;     // 任务数量
+    size_t next;      // 下一个待领取的任务下标
+    BUFPOOL_T *pool;  // 所有任务共用的缓冲池
+    OSMUTEX_T lock;   // 保护 next，同时使不可重入的 getopt 逐个解析
+} BATCHSHARE_T;
+
+// 批量模式的一个线程
+typedef struct {
+    BATCHSHARE_T *share; // 共享的状态
+    OSTHREAD_T thread;   // 线程句柄
+    ABORTHOOK_T hook;    // 任务出错中止时跳回的位置
+    POOLLEASE_T lease;   // 任务从缓冲池取出的缓冲块，中止后据此归还
+} BATCHWORKER_T;
+
+// 复制选项参数中的路径
+// 成功返回0，路径太长返回1
+static int CopyPathOption(char Buffer[], const char *Argument) {
+    if (strlen(Argument) >= PATH_MAX_SIZE) {
+        fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", Argument);
+        return EXIT_CODE_FAILURE;
+    }
+    strcpy(Buffer, Argument);
+    return EXIT_CODE_SUCCESS;
+}
+
+// 解析一条命令，argvs[0] 是主命令，其后是选项
+// 成功返回0，主命令或选项无效返回1
+static int ParseCommand(int argc, char **argvs, COMMAND_T *Command) {
+    int SubOption;
+    const char *SubOptions;
+    const struct option *LongOptions = LONGOPTS_NONE;
+    memset(Command, 0, sizeof(COMMAND_T));
+    Command->maxmem = BUF_SIZE_U;
+    Command->checkpoint = CHECKPOINT_DEFAULT;
+    Command->jobs = 1L;
+    Command->ioprio = -1;
+    if (!strcmp(argvs[0], MAINCMD_HELP)) {
+        Command->command = CMD_HELP;
         return EXIT_CODE_SUCCESS;
-    } else if (!strcmp(argvs[1], MAINCMD_VERS)) {
-        printf(AUTHOR_INFO "\n" BUILT_INFO "\n", Executable);
+    } else if (!strcmp(argvs[0], MAINCMD_VERS)) {
+        Command->command = CMD_VERS;
         return EXIT_CODE_SUCCESS;
-    } else if (!strcmp(argvs[1], MAINCMD_PACK)) {
-        while ((SubOption = getopt(argc, argvs, SUBCMD_PACK)) != -1) {
-            switch (SubOption) {
-            case 'f':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(AnyfFilePath, optarg);
-                break;
-            case 't':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(TargetPath, optarg);
-                break;
-            case 'a':
-                Append = true;
-                break;
-            case 'r':
-                Recursion = true;
-                break;
-            case 'o':
-                Overwrite = true;
-                break;
-            default:
-                fprintf(stderr, MESSAGE_ERROR "没有此选项：-%c，请使用'%s %s'命令查看使用帮助", optopt, Executable, MAINCMD_HELP);
+    } else if (!strcmp(argvs[0], MAINCMD_INFO)) {
+        Command->command = CMD_INFO;
+        SubOptions = SUBCMD_INFO;
+    } else if (!strcmp(argvs[0], MAINCMD_PACK)) {
+        Command->command = CMD_PACK;
+        SubOptions = SUBCMD_PACK;
+        LongOptions = LONGOPTS_COPY;
+    } else if (!strcmp(argvs[0], MAINCMD_FAKE)) {
+        Command->command = CMD_FAKE;
+        SubOptions = SUBCMD_FAKE;
+        LongOptions = LONGOPTS_COPY;
+    } else if (!strcmp(argvs[0], MAINCMD_EXTR)) {
+        Command->command = CMD_EXTR;
+        SubOptions = SUBCMD_EXTR;
+        LongOptions = LONGOPTS_COPY;
+    } else if (!strcmp(argvs[0], MAINCMD_VERI)) {
+        Command->command = CMD_VERI;
+        SubOptions = SUBCMD_VERI;
+        LongOptions = LONGOPTS_COPY;
+    } else if (!strcmp(argvs[0], MAINCMD_CALI)) {
+        Command->command = CMD_CALI;
+        SubOptions = SUBCMD_CALI;
+    } else if (!strcmp(argvs[0], MAINCMD_BATC)) {
+        Command->command = CMD_BATC;
+        SubOptions = SUBCMD_BATC;
+        LongOptions = LONGOPTS_BATC;
+    } else {
+        fprintf(stderr, MESSAGE_ERROR "没有此命令：%s，请使用'%s %s'命令查看使用帮助\n", argvs[0], Executable, MAINCMD_HELP);
+        return EXIT_CODE_FAILURE;
+    }
+    // argvs[0] 相当于程序名，从 argvs[1] 开始查找选项
+    // optind 置0使 getopt 重新初始化，批量模式下会多次解析（此变量是 getopt.h 全局变量）
+    optind = 0;
+    while ((SubOption = getopt_long(argc, argvs, SubOptions, LongOptions, NULL)) != -1) {
+        switch (SubOption) {
+        case LONGOPT_MAX_MEM:
+            if (!ParseByteSize(optarg, &Command->maxmem) || Command->maxmem < POOL_CHUNK_MIN) {
+                fprintf(stderr, MESSAGE_ERROR "无效的内存上限：%s，不能小于 %lld 字节\n", optarg, POOL_CHUNK_MIN);
+                return EXIT_CODE_FAILURE;
+            }
+            break;
+        case LONGOPT_DURABLE:
+            Command->durable = true;
+            break;
+        case LONGOPT_SHARED:
+            Command->shared = true;
+            break;
+        case LONGOPT_TRAIN_DICT:
+            Command->traindict = true;
+            break;
+        case LONGOPT_RESUME:
+            Command->resume = true;
+            break;
+        case LONGOPT_UPDATE:
+            if (Command->update == UPDATE_NONE)
+                Command->update = UPDATE_MTIME;
+            break;
+        case LONGOPT_CHECKSUM:
+            Command->update = UPDATE_CHECKSUM;
+            break;
+        case LONGOPT_CHECKPOINT:
+            // 0 表示不提交检查点，ParseByteSize 只接受正数
+            if (!strcmp(optarg, "0"))
+                Command->checkpoint = 0LL;
+            else if (!ParseByteSize(optarg, &Command->checkpoint)) {
+                fprintf(stderr, MESSAGE_ERROR "无效的检查点间隔：%s\n", optarg);
+                return EXIT_CODE_FAILURE;
+            }
+            break;
+        case LONGOPT_SOLID:
+            if (!ParseByteSize(optarg, &Command->solid) || Command->solid < SOLID_BLOCK_MIN || Command->solid > SOLID_BLOCK_MAX) {
+                fprintf(stderr, MESSAGE_ERROR "无效的固实块大小：%s，应在 1M 到 4M 之间\n", optarg);
+                return EXIT_CODE_FAILURE;
+            }
+            break;
+        case LONGOPT_OFFSET:
+            // 偏移量可以为0，ParseByteSize 只接受正数
+            if (strcmp(optarg, "0") && !ParseByteSize(optarg, &Command->roffset)) {
+                fprintf(stderr, MESSAGE_ERROR "无效的偏移量：%s\n", optarg);
                 return EXIT_CODE_FAILURE;
             }
+            // 只指定偏移量时提取到子文件末尾
+            if (!Command->rlength)
+                Command->rlength = INT64_MAX;
+            break;
+        case LONGOPT_LENGTH:
+            if (!ParseByteSize(optarg, &Command->rlength)) {
+                fprintf(stderr, MESSAGE_ERROR "无效的字节数：%s\n", optarg);
+                return EXIT_CODE_FAILURE;
+            }
+            break;
+        case LONGOPT_BWLIMIT:
+        case LONGOPT_IOPS:
+        case LONGOPT_IOPRIO:
+            if (ParseLimitOption(SubOption, optarg, &Command->bandwidth, &Command->iopslimit, &Command->ioprio))
+                return EXIT_CODE_FAILURE;
+            break;
+        case 'f':
+            if (CopyPathOption(Command->anyf, optarg))
+                return EXIT_CODE_FAILURE;
+            break;
+        case 't':
+            if (CopyPathOption(Command->target, optarg))
+                return EXIT_CODE_FAILURE;
+            break;
+        case 'm':
+            if (CopyPathOption(Command->manifest, optarg))
+                return EXIT_CODE_FAILURE;
+            break;
+        case 'n':
+            if (strlen(optarg) >= PATH_MAX_SIZE) {
+                fprintf(stderr, MESSAGE_ERROR "输入的文件名过长\n");
+                return EXIT_CODE_FAILURE;
+            }
+            strcpy(Command->name, optarg);
+            break;
+        case 'a':
+            Command->append = true;
+            break;
+        case 'r':
+            Command->recursion = true;
+            break;
+        case 'o':
+            Command->overwrite = true;
+            break;
+        case 'z':
+            if (!AnyfCodecParse(optarg, &Command->codec, &Command->level)) {
+                fprintf(stderr, MESSAGE_ERROR "无效的压缩方式：%s，可用的压缩方式：%s\n", optarg, AnyfCodecNames());
+                return EXIT_CODE_FAILURE;
+            }
+            break;
+        case 'j':
+            // 主命令[fake]的[-j]选项是 JPEG 文件路径，其余主命令是线程数
+            if (Command->command == CMD_FAKE) {
+                if (CopyPathOption(Command->jpeg, optarg))
+                    return EXIT_CODE_FAILURE;
+            } else if (ParseJobsOption(optarg, &Command->jobs))
+                return EXIT_CODE_FAILURE;
+            break;
+        default:
+            fprintf(stderr, MESSAGE_ERROR "没有此选项：-%c，请使用'%s %s'命令查看使用帮助", optopt, Executable, MAINCMD_HELP);
+            return EXIT_CODE_FAILURE;
         }
-        if (!*AnyfFilePath) {
+    }
+    switch (Command->command) {
+    case CMD_PACK:
+    case CMD_FAKE:
+    case CMD_EXTR:
+    case CMD_INFO:
+    case CMD_VERI:
+        if (!*Command->anyf) {
             fprintf(stderr, MESSAGE_ERROR "没有输入 ANYF 文件路径，此路径应使用[-f]选项指定\n");
             return EXIT_CODE_FAILURE;
         }
-        if (!*TargetPath) {
+        if ((Command->command == CMD_PACK || Command->command == CMD_FAKE) && !*Command->target) {
             fprintf(stderr, MESSAGE_ERROR "没有输入要打包的目标路径，此路径应使用[-t]选项指定\n");
             return EXIT_CODE_FAILURE;
         }
-        // 指定了 -a 选项且 ANYF 文件存在，则 -o 选项不生效
-        if (OsPathExists(AnyfFilePath) && Append) {
-            pAnyfType = AnyfOpen(AnyfFilePath);
-        } else {
-            // 指定了 -a 选项但 ANYF 文件不存在，则 -a / -o 选项无意义
-            // 未指定 -a 选项但 ANYF 文件存在，则指定 -o 选项将覆盖文件
-            pAnyfType = AnyfMake(AnyfFilePath, Overwrite);
+        if (Command->command == CMD_FAKE && !*Command->jpeg) {
+            fprintf(stderr, MESSAGE_ERROR "没有输入 JPEG 文件路径，此路径应使用[-j]选项指定\n");
+            return EXIT_CODE_FAILURE;
         }
-        AnyfPack(TargetPath, Recursion, pAnyfType, Append);
-        AnyfClose(pAnyfType);
-        return EXIT_CODE_SUCCESS;
-    } else if (!strcmp(argvs[1], MAINCMD_EXTR)) {
-        while ((SubOption = getopt(argc, argvs, SUBCMD_EXTR)) != -1) {
-            switch (SubOption) {
-            case 'n':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "输入的文件名过长\n");
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(NameToExtract, optarg);
-                break;
-            case 'f':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(AnyfFilePath, optarg);
-                break;
-            case 't':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(TargetPath, optarg);
-                break;
-            case 'o':
-                Overwrite = true;
-                break;
-            default:
-                fprintf(stderr, MESSAGE_ERROR "没有此选项：-%c，请使用'%s %s'命令查看使用帮助", optopt, Executable, MAINCMD_HELP);
-                return EXIT_CODE_FAILURE;
-            }
+        if (Command->command == CMD_EXTR && !*Command->target)
+            strcpy(Command->target, PATH_CDIRS);
+        if (Command->command == CMD_EXTR && Command->rlength && !*Command->name) {
+            fprintf(stderr, MESSAGE_ERROR "提取指定范围时需要使用[-n]选项指定子文件名\n");
+            return EXIT_CODE_FAILURE;
         }
-        if (!*AnyfFilePath) {
-            fprintf(stderr, MESSAGE_ERROR "没有输入 ANYF 文件路径，此路径应使用[-f]选项指定\n");
+        break;
+    case CMD_CALI:
+        if (!*Command->target)
+            strcpy(Command->target, PATH_CDIRS);
+        break;
+    case CMD_BATC:
+        if (!*Command->manifest) {
+            fprintf(stderr, MESSAGE_ERROR "没有输入任务清单路径，此路径应使用[-m]选项指定\n");
             return EXIT_CODE_FAILURE;
         }
-        if (!*TargetPath)
-            strcpy(TargetPath, PATH_CDIRS);
-        if (!*NameToExtract)
-            pNameToExtract = NULL;
-        if (AnyfIsFakeJPEG(AnyfFilePath))
-            pAnyfType = AnyfOpenFakeJPEG(AnyfFilePath);
-        else
-            pAnyfType = AnyfOpen(AnyfFilePath);
-        AnyfExtract(pNameToExtract, TargetPath, Overwrite, pAnyfType);
-        AnyfClose(pAnyfType);
-        return EXIT_CODE_SUCCESS;
-    } else if (!strcmp(argvs[1], MAINCMD_INFO)) {
-        while ((SubOption = getopt(argc, argvs, SUBCMD_INFO)) != -1) {
-            switch (SubOption) {
-            case 'f':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(AnyfFilePath, optarg);
-                break;
-            default:
-                fprintf(stderr, MESSAGE_ERROR "没有此选项：-%c，请使用'%s %s'命令查看使用帮助", optopt, Executable, MAINCMD_HELP);
+        // 不指定结果文件则保存在任务清单旁，文件名为清单文件名加上 BATCH_RESULT_EXT
+        if (!*Command->target) {
+            if (strlen(Command->manifest) + strlen(BATCH_RESULT_EXT) >= PATH_MAX_SIZE) {
+                fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", Command->manifest);
                 return EXIT_CODE_FAILURE;
             }
+            strcat(strcpy(Command->target, Command->manifest), BATCH_RESULT_EXT);
         }
-        if (!*AnyfFilePath) {
-            fprintf(stderr, MESSAGE_ERROR "没有输入 ANYF 文件路径，此路径应使用[-f]选项指定\n");
-            return EXIT_CODE_FAILURE;
-        }
-        pAnyfType = AnyfInfo(AnyfFilePath);
+        break;
+    }
+    return EXIT_CODE_SUCCESS;
+}
+
+static int RunBatch(const COMMAND_T *Command);
+
+// 执行一条解析好的命令
+// 参数 SharedPool 为批量模式下所有任务共用的缓冲池，为NULL时创建自己的缓冲池
+// 成功返回0，失败返回1
+static int RunCommand(const COMMAND_T *Command, BUFPOOL_T *SharedPool) {
+    BUFPOOL_T *pBufferPool; // 所有复制过程共用的缓冲池
+    PROFILE_T IOProfile;    // 目标设备的校准配置
+    THROTTLE_T Throttle;    // 读写限速器
+    ANYF_T *pAnyfType;      // ANYF 文件信息结构体指针
+    bool Packing = Command->command == CMD_PACK || Command->command == CMD_FAKE;
+    int Status = EXIT_CODE_SUCCESS;
+    if (Command->ioprio >= 0 && OsFileIOPriority(Command->ioprio))
+        printf(MESSAGE_WARN "设置 I/O 优先级失败，按默认优先级读写\n");
+    switch (Command->command) {
+    case CMD_HELP:
+        printf(COMMANDUSAGE, Executable);
+        return EXIT_CODE_SUCCESS;
+    case CMD_VERS:
+        printf(AUTHOR_INFO "\n" BUILT_INFO "\n", Executable);
+        return EXIT_CODE_SUCCESS;
+    case CMD_INFO:
+        pAnyfType = AnyfInfo(Command->anyf);
         AnyfClose(pAnyfType);
         return EXIT_CODE_SUCCESS;
-    } else if (!strcmp(argvs[1], MAINCMD_FAKE)) {
-        while ((SubOption = getopt(argc, argvs, SUBCMD_FAKE)) != -1) {
-            switch (SubOption) {
-            case 'f':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(AnyfFilePath, optarg);
-                break;
-            case 't':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(TargetPath, optarg);
-                break;
-            case 'a':
-                Append = true;
-                break;
-            case 'r':
-                Recursion = true;
-                break;
-            case 'o':
-                Overwrite = true;
-                break;
-            case 'j':
-                if (strlen(optarg) >= PATH_MAX_SIZE) {
-                    fprintf(stderr, MESSAGE_ERROR "路径太长：%s\n", optarg);
-                    return EXIT_CODE_FAILURE;
-                }
-                strcpy(JPEGFilePath, optarg);
-                break;
-            default:
-                fprintf(stderr, MESSAGE_ERROR "没有此选项：-%c，请使用'%s %s'命令查看使用帮助", optopt, Executable, MAINCMD_HELP);
-                return EXIT_CODE_FAILURE;
-            }
-        }
-        if (!*AnyfFilePath) {
-            fprintf(stderr, MESSAGE_ERROR "没有输入 ANYF 文件路径，此路径应使用[-f]选项指定\n");
+    case CMD_CALI:
+        if (!OsPathIsDirectory(Command->target)) {
+            fprintf(stderr, MESSAGE_ERROR "要校准的路径不是目录：%s\n", Command->target);
             return EXIT_CODE_FAILURE;
         }
-        if (!*TargetPath) {
-            fprintf(stderr, MESSAGE_ERROR "没有输入要打包的目标路径，此路径应使用[-t]选项指定\n");
+        printf(MESSAGE_INFO "校准：%s\n", Command->target);
+        if (AnyfProfileCalibrate(Command->target, &IOProfile)) {
+            fprintf(stderr, MESSAGE_ERROR "校准失败，请确认目录可写且有足够空间\n");
             return EXIT_CODE_FAILURE;
         }
-        if (!*JPEGFilePath) {
-            fprintf(stderr, MESSAGE_ERROR "没有输入 JPEG 文件路径，此路径应使用[-j]选项指定\n");
+        for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            printf(MESSAGE_INFO "%s：%s", PROFILE_CLASS_NAMES[i], IOProfile.plans[i].method == IO_KERNEL ? "内核内复制" : "标准库读写");
+            if (IOProfile.plans[i].method == IO_STDIO)
+                printf("，每次读写 %" I64_SPECIFIER " 字节", IOProfile.plans[i].step);
+            printf("\n");
+        }
+        if (AnyfProfileSave(&IOProfile)) {
+            fprintf(stderr, MESSAGE_ERROR "保存校准配置失败\n");
             return EXIT_CODE_FAILURE;
         }
-        // 选项 -a 和 -o 同时出现的处理办法见 MAINCMD_PACK 命令的注释
-        if (OsPathExists(AnyfFilePath) && Append) {
+        return EXIT_CODE_SUCCESS;
+    case CMD_BATC:
+        return RunBatch(Command);
+    case CMD_PACK:
+        // 指定了 -a 选项且 ANYF 文件存在，则 -o 选项不生效，继续中断的打包相当于追加
+        if (OsPathExists(Command->anyf) && (Command->append || Command->resume)) {
+            pAnyfType = AnyfOpen(Command->anyf, false);
+        } else {
+            // 指定了 -a 选项但 ANYF 文件不存在，则 -a / -o 选项无意义
+            // 未指定 -a 选项但 ANYF 文件存在，则指定 -o 选项将覆盖文件
+            pAnyfType = AnyfMake(Command->anyf, Command->overwrite);
+        }
+        // 按 ANYF 文件所在设备的校准配置读写，没有校准配置时使用默认方式
+        AnyfProfileLoad(pAnyfType->path, &IOProfile);
+        break;
+    case CMD_FAKE:
+        // 选项 -a 和 -o 同时出现的处理办法见 CMD_PACK 的注释
+        if (OsPathExists(Command->anyf) && (Command->append || Command->resume)) {
             printf(MESSAGE_WARN "已存在 ANYF 文件且指定追加打包，[-j]选项不生效\n");
-            pAnyfType = AnyfOpenFakeJPEG(AnyfFilePath);
+            pAnyfType = AnyfOpenFakeJPEG(Command->anyf, false);
         } else {
-            pAnyfType = AnyfMakeFakeJPEG(AnyfFilePath, JPEGFilePath, Overwrite);
+            pAnyfType = AnyfMakeFakeJPEG(Command->anyf, Command->jpeg, Command->overwrite);
         }
-        AnyfPack(TargetPath, Recursion, pAnyfType, Append);
+        AnyfProfileLoad(pAnyfType->path, &IOProfile);
+        break;
+    case CMD_EXTR:
+        if (AnyfIsFakeJPEG(Command->anyf))
+            pAnyfType = AnyfOpenFakeJPEG(Command->anyf, true);
+        else
+            pAnyfType = AnyfOpen(Command->anyf, true);
+        // 按保存目录所在设备的校准配置读写，保存目录尚不存在时使用当前目录所在设备的配置
+        if (AnyfProfileLoad(Command->target, &IOProfile))
+            AnyfProfileLoad(PATH_CDIRS, &IOProfile);
+        break;
+    case CMD_VERI:
+        if (AnyfIsFakeJPEG(Command->anyf))
+            pAnyfType = AnyfOpenFakeJPEG(Command->anyf, true);
+        else
+            pAnyfType = AnyfOpen(Command->anyf, true);
+        // 只读取 ANYF 文件，按其所在设备的校准配置读取
+        AnyfProfileLoad(pAnyfType->path, &IOProfile);
+        break;
+    default:
+        return EXIT_CODE_FAILURE;
+    }
+    // 以下为主命令[pack]、[fake]、[extr]、[verify]共用的复制过程
+    if (!(pBufferPool = SharedPool) && !(pBufferPool = AnyfPoolMake(AnyfProfileChunk(&IOProfile), Command->maxmem))) {
+        fprintf(stderr, MESSAGE_ERROR "创建缓冲池失败\n");
         AnyfClose(pAnyfType);
-        return EXIT_CODE_SUCCESS;
+        return EXIT_CODE_FAILURE;
+    }
+    pAnyfType->pool = pBufferPool;
+    pAnyfType->profile = &IOProfile;
+    pAnyfType->durable = Command->durable;
+    pAnyfType->shared = Command->shared && Packing;
+    pAnyfType->codec = Command->codec;
+    pAnyfType->level = Command->level;
+    pAnyfType->solid = Packing ? Command->solid : 0LL;
+    pAnyfType->traindict = Command->traindict && Packing;
+    pAnyfType->checkpoint = Packing ? Command->checkpoint : 0LL;
+    pAnyfType->resume = Command->resume && Packing;
+    pAnyfType->roffset = Command->command == CMD_EXTR ? Command->roffset : 0LL;
+    pAnyfType->rlength = Command->command == CMD_EXTR ? Command->rlength : 0LL;
+    pAnyfType->update = Command->command == CMD_EXTR ? Command->update : UPDATE_NONE;
+    AnyfThrottleInit(&Throttle, (int64_t)(Command->bandwidth * 1048576.0), (int64_t)Command->iopslimit);
+    if (Command->bandwidth > 0.0 || Command->iopslimit > 0LL)
+        pAnyfType->throttle = &Throttle;
+    pAnyfType->jobs = (int)Command->jobs;
+    if (Command->command == CMD_EXTR)
+        AnyfExtract(*Command->name ? Command->name : NULL, Command->target, Command->overwrite, pAnyfType);
+    else if (Command->command == CMD_VERI)
+        Status = AnyfVerify(*Command->name ? Command->name : NULL, pAnyfType) ? EXIT_CODE_SUCCESS : EXIT_CODE_FAILURE;
+    else
+        AnyfPack(Command->target, Command->recursion, pAnyfType, Command->append || Command->resume);
+    AnyfPrintStats(pAnyfType);
+    AnyfClose(pAnyfType);
+    if (!SharedPool)
+        AnyfPoolDelete(pBufferPool);
+    AnyfThrottleDelete(&Throttle);
+    return Status;
+}
+
+// 把命令行按空白分割为参数，双引号内的空白不分割，改变原字符串
+// 返回参数个数，最多 Max 个，多余的部分忽略
+static int SplitCommandLine(char *Line, char **Argv, int Max) {
+    int Argc = 0;
+    char *Write;
+    while (Argc < Max) {
+        while (*Line == ' ' || *Line == '\t')
+            ++Line;
+        if (!*Line)
+            break;
+        Argv[Argc++] = Write = Line;
+        for (bool Quoted = false; *Line && (Quoted || (*Line != ' ' && *Line != '\t')); ++Line) {
+            if (*Line == '"')
+                Quoted = !Quoted;
+            else
+                *Write++ = *Line;
+        }
+        if (*Line)
+            ++Line;
+        *Write = EMPTY_CHAR;
+    }
+    return Argc;
+}
+
+// 读取任务清单，每行一条命令，格式与命令行相同但不含程序名
+// 空行和以 # 开头的行忽略
+// 成功返回任务数组，*pCount 为任务数量，失败返回NULL
+static BATCHJOB_T *LoadManifest(const char *Path, size_t *pCount) {
+    FILE *Manifest;
+    BATCHJOB_T *Jobs = NULL, *JobsTemp;
+    char *Line, *Start;
+    size_t Length, Slots = 0ULL, Number = 0ULL;
+    bool Success = true;
+    *pCount = 0ULL;
+    if (!(Manifest = fopen(Path, "r"))) {
+        fprintf(stderr, MESSAGE_ERROR "打开任务清单失败：%s\n", Path);
+        return NULL;
+    }
+    if (!(Line = malloc(BATCH_LINE_MAX))) {
+        fclose(Manifest);
+        fprintf(stderr, MESSAGE_ERROR "为任务清单读取缓冲区分配内存失败\n");
+        return NULL;
+    }
+    while (Success && fgets(Line, BATCH_LINE_MAX, Manifest)) {
+        ++Number;
+        Length = strlen(Line);
+        if (Length + 1 >= BATCH_LINE_MAX && Line[Length - 1] != '\n') {
+            fprintf(stderr, MESSAGE_ERROR "任务清单第 %zu 行太长\n", Number);
+            Success = false;
+            break;
+        }
+        while (Length > 0 && (Line[Length - 1] == '\n' || Line[Length - 1] == '\r'))
+            Line[--Length] = EMPTY_CHAR;
+        for (Start = Line; *Start == ' ' || *Start == '\t'; ++Start)
+            ;
+        if (!*Start || *Start == '#')
+            continue;
+        if (*pCount >= Slots) {
+            if (!(JobsTemp = realloc(Jobs, (Slots + BATCH_JOB_STEP) * sizeof(BATCHJOB_T)))) {
+                fprintf(stderr, MESSAGE_ERROR "为任务列表分配内存失败\n");
+                Success = false;
+                break;
+            }
+            Jobs = JobsTemp;
+            Slots += BATCH_JOB_STEP;
+        }
+        if (!(Jobs[*pCount].line = malloc(strlen(Start) + 1))) {
+            fprintf(stderr, MESSAGE_ERROR "为任务列表分配内存失败\n");
+            Success = false;
+            break;
+        }
+        strcpy(Jobs[*pCount].line, Start);
+        Jobs[*pCount].number = Number;
+        Jobs[(*pCount)++].status = EXIT_CODE_FAILURE;
+    }
+    if (Success && ferror(Manifest)) {
+        fprintf(stderr, MESSAGE_ERROR "读取任务清单失败：%s\n", Path);
+        Success = false;
+    }
+    free(Line);
+    fclose(Manifest);
+    if (Success && *pCount == 0ULL) {
+        fprintf(stderr, MESSAGE_ERROR "任务清单中没有任务：%s\n", Path);
+        Success = false;
+    }
+    if (!Success) {
+        for (size_t i = 0; i < *pCount; ++i)
+            free(Jobs[i].line);
+        free(Jobs);
+        return NULL;
+    }
+    return Jobs;
+}
+
+// 执行批量模式的一个任务，任务出错中止时关闭它打开的 ANYF 文件并归还它取出的缓冲块
+static void RunBatchJob(BATCHWORKER_T *Worker, BATCHJOB_T *Job) {
+    BATCHSHARE_T *Share = Worker->share;
+    COMMAND_T *Command;
+    char *Argv[BATCH_ARGS_MAX];
+    char *LineCopy;
+    int Argc, Parsed;
+    Command = malloc(sizeof(COMMAND_T));
+    LineCopy = malloc(strlen(Job->line) + 1);
+    if (!Command || !LineCopy) {
+        fprintf(stderr, MESSAGE_ERROR "第 %zu 行：为任务分配内存失败\n", Job->number);
+        free(Command), free(LineCopy);
+        return;
+    }
+    Argc = SplitCommandLine(strcpy(LineCopy, Job->line), Argv, BATCH_ARGS_MAX);
+    OsMutexLock(&Share->lock);
+    Parsed = ParseCommand(Argc, Argv, Command);
+    OsMutexUnlock(&Share->lock);
+    if (Parsed) {
+        fprintf(stderr, MESSAGE_ERROR "第 %zu 行：命令无效\n", Job->number);
+    } else if (Command->command != CMD_PACK && Command->command != CMD_FAKE && Command->command != CMD_EXTR && Command->command != CMD_INFO && Command->command != CMD_VERI) {
+        fprintf(stderr, MESSAGE_ERROR "第 %zu 行：批量模式只能执行 pack、fake、extr、info、verify 命令\n", Job->number);
+    } else if (Command->ioprio >= 0) {
+        // I/O 优先级作用于整个进程，会影响同时执行的其他任务，只能在 batch 命令上指定
+        fprintf(stderr, MESSAGE_ERROR "第 %zu 行：任务不能指定 --ioprio 选项，请在 batch 命令上指定\n", Job->number);
     } else {
-        fprintf(stderr, MESSAGE_ERROR "没有此命令：%s，请使用'%s %s'命令查看使用帮助\n", argvs[1], Executable, MAINCMD_HELP);
+        // 缓冲池按线程数分配，任务内部不再并行
+        Command->jobs = 1L;
+        AnyfPoolTrack(&Worker->lease);
+        AnyfSetAbortHook(&Worker->hook);
+        if (!setjmp(Worker->hook.jump)) {
+            Job->status = RunCommand(Command, Share->pool);
+        } else {
+            Job->status = Worker->hook.code;
+            if (Worker->hook.anyf)
+                AnyfClose(Worker->hook.anyf);
+            else if (Worker->hook.handle)
+                fclose(Worker->hook.handle);
+        }
+        AnyfSetAbortHook(NULL);
+        AnyfPoolReclaim(Share->pool, &Worker->lease);
+    }
+    free(Command);
+    free(LineCopy);
+}
+
+// 批量模式的线程函数，逐个领取任务直到清单中的任务全部领完
+static void BatchWorker(void *Argument) {
+    BATCHWORKER_T *Worker = Argument;
+    BATCHSHARE_T *Share = Worker->share;
+    BATCHJOB_T *Job;
+    for (;;) {
+        OsMutexLock(&Share->lock);
+        Job = Share->next < Share->count ? &Share->jobs[Share->next++] : NULL;
+        OsMutexUnlock(&Share->lock);
+        if (!Job)
+            return;
+        RunBatchJob(Worker, Job);
+    }
+}
+
+// 用多个线程执行任务清单中的全部任务，所有任务共用一个缓冲池
+// 每个任务的退出状态码按清单顺序写入结果文件，每行为：行号、状态码、命令，以制表符分隔
+// 全部任务成功返回0，否则返回1
+static int RunBatch(const COMMAND_T *Command) {
+    BATCHSHARE_T Share;
+    BATCHWORKER_T *Workers;
+    PROFILE_T IOProfile;
+    FILE *Results;
+    size_t Threads, Started, Failed = 0ULL;
+    int FinalReturnCode = EXIT_CODE_SUCCESS;
+    if (!(Share.jobs = LoadManifest(Command->manifest, &Share.count)))
         return EXIT_CODE_FAILURE;
+    AnyfProfileLoad(PATH_CDIRS, &IOProfile);
+    if (!(Share.pool = AnyfPoolMake(AnyfProfileChunk(&IOProfile), Command->maxmem))) {
+        fprintf(stderr, MESSAGE_ERROR "创建缓冲池失败\n");
+        FinalReturnCode = EXIT_CODE_FAILURE;
+        goto FreeAndReturn;
     }
-    return EXIT_CODE_SUCCESS;
+    // 每个任务最多同时占用两个缓冲块，线程数超过缓冲块数量的一半时任务可能取不到缓冲块
+    Threads = (size_t)Command->jobs;
+    if (Threads > Share.pool->slots / 2ULL) {
+        Threads = Share.pool->slots / 2ULL > 0ULL ? Share.pool->slots / 2ULL : 1ULL;
+        printf(MESSAGE_WARN "受[--max-mem]限制，只使用 %zu 个线程\n", Threads);
+    }
+    if (Threads > Share.count)
+        Threads = Share.count;
+    if (!(Workers = calloc(Threads, sizeof(BATCHWORKER_T)))) {
+        fprintf(stderr, MESSAGE_ERROR "为批量任务线程分配内存失败\n");
+        FinalReturnCode = EXIT_CODE_FAILURE;
+        goto FreeAndReturn;
+    }
+    Share.next = 0ULL;
+    OsMutexInit(&Share.lock);
+    // 第0个线程由主线程担任，创建失败时减少线程数
+    for (Started = 1ULL; Started < Threads; ++Started) {
+        Workers[Started].share = &Share;
+        if (OsThreadCreate(&Workers[Started].thread, BatchWorker, &Workers[Started]))
+            break;
+    }
+    Workers[0].share = &Share;
+    BatchWorker(&Workers[0]);
+    for (size_t i = 1; i < Started; ++i)
+        OsThreadJoin(Workers[i].thread);
+    OsMutexDestroy(&Share.lock);
+    free(Workers);
+    if (!(Results = fopen(Command->target, "w"))) {
+        fprintf(stderr, MESSAGE_ERROR "创建结果文件失败：%s\n", Command->target);
+        FinalReturnCode = EXIT_CODE_FAILURE;
+    }
+    for (size_t i = 0; i < Share.count; ++i) {
+        if (Share.jobs[i].status != EXIT_CODE_SUCCESS)
+            ++Failed;
+        if (Results)
+            fprintf(Results, "%zu\t%d\t%s\n", Share.jobs[i].number, Share.jobs[i].status, Share.jobs[i].line);
+    }
+    if (Results && fclose(Results)) {
+        fprintf(stderr, MESSAGE_ERROR "写入结果文件失败：%s\n", Command->target);
+        FinalReturnCode = EXIT_CODE_FAILURE;
+    }
+    printf(MESSAGE_INFO "批量任务完成：共 %zu 个，失败 %zu 个，结果保存在：%s\n", Share.count, Failed, Command->target);
+    if (Failed > 0ULL)
+        FinalReturnCode = EXIT_CODE_FAILURE;
+FreeAndReturn:
+    AnyfPoolDelete(Share.pool);
+    for (size_t i = 0; i < Share.count; ++i)
+        free(Share.jobs[i].line);
+    free(Share.jobs);
+    return FinalReturnCode;
+}
+
+int ParseCommands(int argc, char **argvs) {
+    static COMMAND_T Command;
+    if (argc < 2) {
+        fprintf(stderr, MESSAGE_ERROR "命令行参数不足，请使用 %s 命令查看使用帮助\n", MAINCMD_HELP);
+        return EXIT_CODE_FAILURE;
+    }
+    OsPathSplitExt(Executable, PATH_MAX_SIZE, NULL, 0, OsPathBaseName(NULL, 0, argvs[0]), '.');
+    if (ParseCommand(argc - 1, argvs + 1, &Command))
+        return EXIT_CODE_FAILURE;
+    return RunCommand(&Command, NULL);
 }
 
 int main(int argc, char *argvs[]) {
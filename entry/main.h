@@ -1,6 +1,38 @@
 #ifndef __MAIN_H
 #define __MAIN_H
 
+// 长选项的 getopt_long 返回值，取值避开所有单字符选项
+#define LONGOPT_MAX_MEM    0x100 // --max-mem
+#define LONGOPT_DURABLE    0x101 // --durable
+#define LONGOPT_BWLIMIT    0x102 // --bwlimit
+#define LONGOPT_IOPS       0x103 // --iops-limit
+#define LONGOPT_IOPRIO     0x104 // --ioprio
+#define LONGOPT_SHARED     0x105 // --shared
+#define LONGOPT_SOLID      0x106 // --solid
+#define LONGOPT_OFFSET     0x107 // --offset
+#define LONGOPT_LENGTH     0x108 // --length
+#define LONGOPT_TRAIN_DICT 0x109 // --train-dict
+#define LONGOPT_RESUME     0x10A // --resume
+#define LONGOPT_CHECKPOINT 0x10B // --checkpoint
+#define LONGOPT_UPDATE     0x10C // --update
+#define LONGOPT_CHECKSUM   0x10D // --checksum
+
+// 主命令编号
+#define CMD_HELP 0 // help
+#define CMD_VERS 1 // vers
+#define CMD_INFO 2 // info
+#define CMD_PACK 3 // pack
+#define CMD_FAKE 4 // fake
+#define CMD_EXTR 5 // extr
+#define CMD_CALI 6 // calibrate
+#define CMD_BATC 7 // batch
+#define CMD_VERI 8 // verify
+
+#define BATCH_LINE_MAX   (4 * PATH_MAX_SIZE) // 任务清单每行的最大字节数
+#define BATCH_ARGS_MAX   64                  // 任务清单每行最多的参数个数
+#define BATCH_JOB_STEP   256                 // 任务数组每次扩充的元素数量
+#define BATCH_RESULT_EXT ".result"           // 默认结果文件名为任务清单文件名加上此后缀
+
 #define COMMANDUSAGE \
     "用法: %s [子命令] [选项1 [参数]] [选项2 [参数]]...\n\n" \
     "可用的子命令:\n" \
@@ -8,19 +40,37 @@
     "   [fake]\t将文件或目录打包并伪装为 JPEG 文件。\n" \
     "   [extr]\t从 ANYF 文件或伪装的 JPEG 文件中提取目录或文件。\n" \
     "   [info]\t显示 ANYF 文件信息及其子文件列表。\n" \
+    "   [verify]\t多线程校验 ANYF 文件或伪装的 JPEG 文件中各子文件的内容及文件头中记录的 Merkle 根，不写入任何文件。\n" \
+    "   [calibrate]\t测试目录所在设备上各种读写方式的速度并保存校准配置，之后在此设备上打包和提取时按文件大小选用最快的读写方式。\n" \
+    "   [batch]\t按任务清单在一个进程内批量执行 pack、fake、extr、info、verify 命令，所有任务共用线程和缓冲池。\n" \
     "   [help]\t显示此帮助信息。\n" \
     "   [vers]\t显示程序版本信息及其他信息。\n\n" \
 \
     "各个子命令的可用选项:\n" \
     "   [info]命令可用选项:\n" \
     "       [-f] 文件路径\t此选项指定要从中读取并显示子文件或目录列表及其他信息的 ANYF 文件的路径。\n\n" \
+\
+    "   [calibrate]命令可用选项:\n" \
+    "       [-t] 目录路径\t此选项指定要校准的设备上的一个目录，校准过程会在此目录中创建并删除约 160MB 的临时文件。不使用此选项则校准当前目录所在的设备。校准配置保存在用户主目录下的 .anyf_profile 文件中，也可以用环境变量 ANYF_PROFILE 指定配置文件路径。\n\n" \
 \
     "   [pack]命令可用选项:\n" \
     "       [-f] 文件路径\t此选项指定即将被创建或被追加的 ANYF 文件路径。路径应包括文件名和扩展名，扩展名虽不影响打包和解包，但建议以<.af>作为扩展名以便辨认。\n" \
     "       [-t] 路径\t此选项指定即将被打包的目标，该目标将被打包到[-f]选项指定的 ANYF 文件中。此选项可以指定文件或目录路径。\n" \
     "       [-r]\t\t使用此选项表示在[-t]选项指定的是一个目录路径的情况下层层深入搜索该目录内的所有子目录和文件，如果[-t]选项指定的是一个文件路径则此选项不生效。不使用此选项则只收集[-t]所指目录的一代子目录和文件。\n" \
     "       [-a]\t\t使用此选项表示指定打包模式为\"追加打包\"。如果[-f]选项指定的 ANYF 文件已存在且使用了此选项，则把要打包的目标追加打包到已存在的 ANYF 文件中，不使用此选项则根据是否使用了[-o]选项决定是否覆盖同名文件或退出程序，[-f]选项指定的 ANYF 文件不存在则此选项不生效。\n" \
-    "       [-o]\t\t此选项请慎用！！！使用此选项表示在[-f]选项指定的 AMYF 文件已存在的情况下，允许以\"覆盖\"的方式创建新文件。如果[-f]选项指定的 AMYF 文件已存在且同时使用了此选项和[-a]选项，则只有[-a]选项生效。\n\n"\
+    "       [-o]\t\t此选项请慎用！！！使用此选项表示在[-f]选项指定的 AMYF 文件已存在的情况下，允许以\"覆盖\"的方式创建新文件。如果[-f]选项指定的 AMYF 文件已存在且同时使用了此选项和[-a]选项，则只有[-a]选项生效。\n" \
+    "       [-j] 线程数\t此选项指定并行打包的线程数，0 表示使用 CPU 核心数。先按扫描结果计算每个子文件在 ANYF 文件中的位置，再由各线程同时读取源文件并写入各自的位置；打包期间发生变化的源文件会被重新打包到末尾。每个线程占用一个缓冲块，线程数受[--max-mem]限制。不使用此选项则逐个打包。\n" \
+    "       [-z] 压缩方式[:等级]\t此选项指定子文件数据块的压缩方式：lz 为内置的快速压缩，等级 1-9，默认 5；zlib 等级 1-9，默认 6；zstd 等级 1-19，默认 3；zlib 和 zstd 只在编译时找到相应的库才可用；none 表示不压缩。每个子文件按 1MB 分段压缩，压缩后没有变小的段按原样保存，提取时自动解压，稀疏文件不压缩。使用此选项时逐个写入子文件，不能与[--shared]同时生效；同时使用[-j]时大于 1MB 的子文件由多个线程分段并行压缩，并记录各段的位置以便提取时并行解压。使用此选项后的 ANYF 文件不能被旧版本程序读取。\n" \
+    "       [--max-mem] 字节数\t此选项指定读写数据时缓冲区占用内存的总上限，可使用 K、M、G 作为单位，例如 64M。不使用此选项则上限为 128M。\n" \
+    "       [--durable]\t\t使用此选项表示在打包结束前把 ANYF 文件数据同步到磁盘：先同步子文件数据，再更新并同步子文件数量，即使中途断电或崩溃，ANYF 文件中的子文件数量也不会指向未写入磁盘的数据。此选项会使打包变慢。\n" \
+    "       [--checkpoint] 字节数\t此选项指定提交检查点的间隔，可使用 K、M、G 作为单位，0 表示只在打包结束时提交。每写入约这么多字节，就把已写完的子文件计入 ANYF 文件头中的子文件数量，中途中断时这些子文件仍然有效。与其他写入者同时追加时不提交检查点。不使用此选项则间隔为 1G。\n" \
+    "       [--resume]\t\t使用此选项表示继续中断的打包：截掉[-f]选项指定的 ANYF 文件中最后一个检查点之后的内容，再打包[-t]选项指定的目标中子文件名尚未出现在 ANYF 文件中的路径，已打包的源文件不再读取。相当于同时使用[-a]选项，不能与[--shared]同时生效。[-f]选项指定的 ANYF 文件不存在时从头打包。\n" \
+    "       [--solid] 字节数\t此选项表示把连续的小文件(不超过 64K 且可压缩)拼接为固实块后整体压缩，参数为每个固实块的数据字节数上限，可使用 K、M 作为单位，应在 1M 到 4M 之间。固实块前有各成员的偏移量表，提取时每个固实块只解压一次，只提取一个子文件时只解压其所在的固实块。需要同时使用[-z]选项。使用此选项后的 ANYF 文件不能被旧版本程序读取。\n" \
+    "       [--train-dict]\t使用此选项表示打包目录时从最先扫描到的不超过 64K 的文件开头取样，取满 256 个文件或 1M 字节后训练一个不超过 32K 的共享字典保存在 ANYF 文件中，之后不超过 64K 的子文件都用此字典压缩，适合大量格式相同的小文件(如 JSON)。取样不另外扫描目录，训练前已打包的子文件不使用字典，小文件不够取满时不使用字典。ANYF 文件已有字典时沿用已有的字典，追加打包时即使不使用此选项也会使用已有的字典。提取时字典在打开 ANYF 文件时读入一次。需要同时使用[-z]选项，与[--solid]同时使用时加入固实块的小文件不使用字典。使用此选项后的 ANYF 文件不能被旧版本程序读取。\n" \
+    "       [--shared]\t\t使用此选项表示与其他同样使用此选项的进程同时向[-f]选项指定的 ANYF 文件追加打包。每次只在锁定 ANYF 文件头时预留一段空间，数据在锁外写入，写完后再发布到 ANYF 文件中。目标为目录时先扫描完整个目录。使用此选项后的 ANYF 文件不能被旧版本程序读取。不使用此选项则追加打包期间独占 ANYF 文件。\n" \
+    "       [--bwlimit] MB/s\t此选项限制每秒读写的数据量，单位 MB，可以是小数，例如 20 或 0.5。\n" \
+    "       [--iops-limit] 次数\t此选项限制每秒读写的次数。\n" \
+    "       [--ioprio] 优先级\t此选项设置读写磁盘的优先级：idle 表示只在磁盘空闲时读写，be 为系统默认优先级。适合在业务繁忙的主机上后台运行。\n\n"\
 \
     "   [fake]命令可用选项:\n" \
     "       [-f] 文件路径\t此选项指定即将被创建或被追加的 ANYF 文件路径。路径应包括文件名和扩展名，扩展名虽不影响打包和解包，但建议以<.jpg>或<.jpeg>作为扩展名，这样创建的 ANYF 文件看起来就是正常可用的 JPEG 文件。\n" \
@@ -28,12 +78,49 @@
     "       [-t] 路径\t此选项指定即将被打包的目标，该目标将被打包到[-f]选项指定的 ANYF 文件中。此选项可以指定文件或目录路径。\n" \
     "       [-r]\t\t使用此选项表示在[-t]选项指定的是一个目录路径的情况下层层深入搜索该目录内的所有子目录和文件，如果[-t]选项指定的是一个文件路径则此选项不生效。不使用此选项则只收集[-t]所指目录的一代子目录和文件。\n" \
     "       [-a]\t\t使用此选项表示指定打包模式为\"追加打包\"。如果[-f]选项指定的 ANYF 文件已存在且使用了此选项，则把要打包的目标追加打包到已存在的 ANYF 文件中，不使用此选项则根据是否使用了[-o]选项决定是否覆盖同名文件或退出程序，[-f]选项指定的 ANYF 文件不存在则此选项不生效。\n" \
-    "       [-o]\t\t此选项请慎用！！！使用此选项表示在[-f]选项指定的 AMYF 文件已存在的情况下，允许以\"覆盖\"的方式创建新文件。如果[-f]选项指定的 AMYF 文件已存在且同时使用了此选项和[-a]选项，则只有[-a]选项生效。\n\n"\
+    "       [-o]\t\t此选项请慎用！！！使用此选项表示在[-f]选项指定的 AMYF 文件已存在的情况下，允许以\"覆盖\"的方式创建新文件。如果[-f]选项指定的 AMYF 文件已存在且同时使用了此选项和[-a]选项，则只有[-a]选项生效。\n" \
+    "       [-z] 压缩方式[:等级]\t此选项指定子文件数据块的压缩方式：lz 为内置的快速压缩，等级 1-9，默认 5；zlib 等级 1-9，默认 6；zstd 等级 1-19，默认 3；zlib 和 zstd 只在编译时找到相应的库才可用；none 表示不压缩。每个子文件按 1MB 分段压缩，压缩后没有变小的段按原样保存，提取时自动解压，稀疏文件不压缩。使用此选项时逐个写入子文件，不能与[--shared]同时生效；同时使用[-j]时大于 1MB 的子文件由多个线程分段并行压缩，并记录各段的位置以便提取时并行解压。使用此选项后的 ANYF 文件不能被旧版本程序读取。\n" \
+    "       [--max-mem] 字节数\t此选项指定读写数据时缓冲区占用内存的总上限，可使用 K、M、G 作为单位，例如 64M。不使用此选项则上限为 128M。\n" \
+    "       [--durable]\t\t使用此选项表示在打包结束前把 ANYF 文件数据同步到磁盘：先同步子文件数据，再更新并同步子文件数量，即使中途断电或崩溃，ANYF 文件中的子文件数量也不会指向未写入磁盘的数据。此选项会使打包变慢。\n" \
+    "       [--checkpoint] 字节数\t此选项指定提交检查点的间隔，可使用 K、M、G 作为单位，0 表示只在打包结束时提交。每写入约这么多字节，就把已写完的子文件计入 ANYF 文件头中的子文件数量，中途中断时这些子文件仍然有效。与其他写入者同时追加时不提交检查点。不使用此选项则间隔为 1G。\n" \
+    "       [--resume]\t\t使用此选项表示继续中断的打包：截掉[-f]选项指定的 ANYF 文件中最后一个检查点之后的内容，再打包[-t]选项指定的目标中子文件名尚未出现在 ANYF 文件中的路径，已打包的源文件不再读取。相当于同时使用[-a]选项，不能与[--shared]同时生效。[-f]选项指定的 ANYF 文件不存在时从头打包。\n" \
+    "       [--solid] 字节数\t此选项表示把连续的小文件(不超过 64K 且可压缩)拼接为固实块后整体压缩，参数为每个固实块的数据字节数上限，可使用 K、M 作为单位，应在 1M 到 4M 之间。固实块前有各成员的偏移量表，提取时每个固实块只解压一次，只提取一个子文件时只解压其所在的固实块。需要同时使用[-z]选项。使用此选项后的 ANYF 文件不能被旧版本程序读取。\n" \
+    "       [--train-dict]\t使用此选项表示打包目录时从最先扫描到的不超过 64K 的文件开头取样，取满 256 个文件或 1M 字节后训练一个不超过 32K 的共享字典保存在 ANYF 文件中，之后不超过 64K 的子文件都用此字典压缩，适合大量格式相同的小文件(如 JSON)。取样不另外扫描目录，训练前已打包的子文件不使用字典，小文件不够取满时不使用字典。ANYF 文件已有字典时沿用已有的字典，追加打包时即使不使用此选项也会使用已有的字典。提取时字典在打开 ANYF 文件时读入一次。需要同时使用[-z]选项，与[--solid]同时使用时加入固实块的小文件不使用字典。使用此选项后的 ANYF 文件不能被旧版本程序读取。\n" \
+    "       [--shared]\t\t使用此选项表示与其他同样使用此选项的进程同时向[-f]选项指定的 ANYF 文件追加打包。每次只在锁定 ANYF 文件头时预留一段空间，数据在锁外写入，写完后再发布到 ANYF 文件中。目标为目录时先扫描完整个目录。使用此选项后的 ANYF 文件不能被旧版本程序读取。不使用此选项则追加打包期间独占 ANYF 文件。\n" \
+    "       [--bwlimit] MB/s\t此选项限制每秒读写的数据量，单位 MB，可以是小数，例如 20 或 0.5。\n" \
+    "       [--iops-limit] 次数\t此选项限制每秒读写的次数。\n" \
+    "       [--ioprio] 优先级\t此选项设置读写磁盘的优先级：idle 表示只在磁盘空闲时读写，be 为系统默认优先级。适合在业务繁忙的主机上后台运行。\n\n"\
 \
     "   [extr]命令可用选项:\n" \
     "       [-f] 文件路径\t此选项指定要解包的 ANYF 文件的路径，程序将从此路径指示的 ANYF 文件中提取子文件或目录。\n" \
     "       [-t] 目录路径\t此选项指定提取 ANYF 文件中的子文件时的保存目的地路径，忽略此选项则将提取的内容保存到当前目录。\n" \
     "       [-n] 文件名\t此选项指定想要从[-f]选项指定的 ANYF 文件中提取的子文件或目录的名称。注意，此选项的<文件名>指的是使用 info 命令列出的子文件名，包括文件名的路径前缀。不使用此选项则提取全部子文件。\n" \
-    "       [-o]\t\t此选项请慎用！！！使用此选项表示从 ANYF 文件提取子文件时允许直接覆盖[-t]选项指定的目录中的同路径同名子文件，不使用此选项则表示跳过该子文件的提取。\n\n"
+    "       [-o]\t\t此选项请慎用！！！使用此选项表示从 ANYF 文件提取子文件时允许直接覆盖[-t]选项指定的目录中的同路径同名子文件，不使用此选项则表示跳过该子文件的提取。\n" \
+    "       [-j] 线程数\t此选项指定并行提取的线程数，0 表示使用 CPU 核心数。分段压缩的大文件由多个线程同时解压不同的段。每个线程占用一个缓冲块，线程数受[--max-mem]限制。不使用此选项则逐个提取。\n" \
+    "       [--offset] 字节数\t此选项指定只提取[-n]选项指定的子文件中从此偏移量开始的部分，可使用 K、M、G 作为单位。保存的文件只包含该范围的数据。压缩的子文件只解压与范围重叠的段。\n" \
+    "       [--length] 字节数\t此选项指定只提取[-n]选项指定的子文件中从[--offset]起的这么多字节，可使用 K、M、G 作为单位，超出子文件末尾的部分不提取。只使用[--offset]时提取到子文件末尾。使用[--offset]或[--length]时[-j]选项不生效。\n" \
+    "       [--update]\t\t使用此选项表示只提取保存目录中缺少或与子文件不同的文件：已有文件的大小和修改时间都与子文件相同时跳过，其余文件直接覆盖，相当于同时使用[-o]选项，中断的提取再次运行即可继续。提取的子文件都恢复打包时的修改时间，旧版本程序创建的 ANYF 文件没有记录修改时间，改为比较内容校验值。使用[--offset]或[--length]时不生效。\n" \
+    "       [--checksum]\t使用此选项表示按[--update]的方式提取，但不看修改时间，而是读取大小相同的已有文件计算内容校验值，与子文件的校验值相同时跳过。比[--update]慢，适合修改时间不可靠的情况。\n" \
+    "       [--max-mem] 字节数\t此选项指定读写数据时缓冲区占用内存的总上限，可使用 K、M、G 作为单位，例如 64M。不使用此选项则上限为 128M。\n" \
+    "       [--durable]\t\t使用此选项表示在提取结束前把提取的子文件同步到磁盘，每个文件系统只同步一次。此选项会使提取变慢。\n" \
+    "       [--bwlimit] MB/s\t此选项限制每秒读写的数据量，单位 MB，可以是小数，例如 20 或 0.5。\n" \
+    "       [--iops-limit] 次数\t此选项限制每秒读写的次数。\n" \
+    "       [--ioprio] 优先级\t此选项设置读写磁盘的优先级：idle 表示只在磁盘空闲时读写，be 为系统默认优先级。\n\n" \
+\
+    "   [verify]命令可用选项:\n" \
+    "       [-f] 文件路径\t此选项指定要校验的 ANYF 文件的路径。先由信息表重新计算 Merkle 根(以各子文件的大小、文件名和内容校验值为叶子的 CRC32C 树，用于发现意外损坏，不能防篡改)并与文件头中记录的比较，再读取并解压各子文件的数据与其校验值比较。共享追加打包或旧版本程序创建的 ANYF 文件没有记录 Merkle 根，只校验子文件内容。有子文件不符时退出状态码为 1。\n" \
+    "       [-n] 文件名\t此选项指定只校验[-f]选项指定的 ANYF 文件中同名的子文件，写法同[extr]命令。Merkle 根仍按整个信息表校验。不使用此选项则校验全部子文件。\n" \
+    "       [-j] 线程数\t此选项指定并行校验的线程数，0 表示使用 CPU 核心数。分段压缩的大文件由多个线程同时解压不同的段，再把各段的校验值拼接后比较。每个线程占用一个缓冲块，线程数受[--max-mem]限制。不使用此选项则只用一个线程。\n" \
+    "       [--max-mem] 字节数\t此选项指定读取数据时缓冲区占用内存的总上限，可使用 K、M、G 作为单位，例如 64M。不使用此选项则上限为 128M。\n" \
+    "       [--bwlimit] MB/s\t此选项限制每秒读取的数据量，单位 MB，可以是小数，例如 20 或 0.5。\n" \
+    "       [--iops-limit] 次数\t此选项限制每秒读取的次数。\n" \
+    "       [--ioprio] 优先级\t此选项设置读取磁盘的优先级：idle 表示只在磁盘空闲时读取，be 为系统默认优先级。\n\n" \
+\
+    "   [batch]命令可用选项:\n" \
+    "       [-m] 文件路径\t此选项指定任务清单的路径。清单每行一条命令，写法与命令行相同但不含程序名，例如 pack -f ./1.af -t ./data -r，含空格的路径可用双引号括起。空行和以 # 开头的行被忽略。一个任务出错不影响其他任务。\n" \
+    "       [-t] 文件路径\t此选项指定结果文件的路径，按清单顺序每行写入一个任务的行号、退出状态码和命令，以制表符分隔，状态码 0 表示成功。不使用此选项则结果保存在任务清单路径加上<.result>的文件中。\n" \
+    "       [-j] 线程数\t此选项指定同时执行任务的线程数，0 表示使用 CPU 核心数。每个任务在一个线程内逐个复制子文件，任务自身的[-j]选项不生效。每个线程最多占用两个缓冲块，线程数受[--max-mem]限制。不使用此选项则逐个执行任务。\n" \
+    "       [--max-mem] 字节数\t此选项指定所有任务共用的缓冲池占用内存的总上限，任务自身的[--max-mem]选项不生效。不使用此选项则上限为 128M。\n" \
+    "       [--ioprio] 优先级\t此选项设置所有任务读写磁盘的优先级，可用值同[pack]命令。优先级作用于整个进程，清单中的任务不能使用此选项。\n\n"
 
 #endif // __MAIN_H
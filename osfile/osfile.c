@@ -0,0 +1,555 @@
+#ifndef _WIN32
+#define _GNU_SOURCE // SEEK_DATA、SEEK_HOLE 等需要此宏
+#endif // _WIN32
+
+#include "osfile.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif // __linux__
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include "../ospath/ospath.h"
+
+// 数据区域数组每次扩充的元素数量
+#define EXTENT_STEP 64
+
+#ifdef _WIN32
+// WIN平台同步句柄上带 OVERLAPPED 偏移量的 ReadFile、WriteFile 仍会移动句柄的文件指针
+// 按偏移量读写前保存文件指针、读写后恢复，并发读写时恢复顺序不定，用锁串行化保存与恢复之间的读写
+static SRWLOCK PositionLock = SRWLOCK_INIT;
+
+// 加锁并保存句柄的文件指针，成功返回0，失败返回1且不持有锁
+static int SavePosition(HANDLE FileHandle, LARGE_INTEGER *pSaved) {
+    LARGE_INTEGER Zero;
+    Zero.QuadPart = 0;
+    AcquireSRWLockExclusive(&PositionLock);
+    if (SetFilePointerEx(FileHandle, Zero, pSaved, FILE_CURRENT))
+        return RESULT_SUCCESS;
+    ReleaseSRWLockExclusive(&PositionLock);
+    return RESULT_FAILURE;
+}
+
+// 恢复句柄的文件指针并解锁，读写结果 Result 为失败或恢复失败时返回1，否则返回0
+static int RestorePosition(HANDLE FileHandle, LARGE_INTEGER Saved, int Result) {
+    if (!SetFilePointerEx(FileHandle, Saved, NULL, FILE_BEGIN))
+        Result = RESULT_FAILURE;
+    ReleaseSRWLockExclusive(&PositionLock);
+    return Result;
+}
+#endif // _WIN32
+
+// 向数据区域数组末尾添加一个数据区域，必要时扩充数组
+static bool AppendExtent(EXTENT_T **ppExtents, size_t *pCount, size_t *pSlots, int64_t Offset, int64_t Length) {
+    EXTENT_T *ExtentsTemp;
+    if (*pCount >= *pSlots) {
+        ExtentsTemp = realloc(*ppExtents, (*pSlots + EXTENT_STEP) * sizeof(EXTENT_T));
+        if (!ExtentsTemp)
+            return false;
+        *ppExtents = ExtentsTemp;
+        *pSlots += EXTENT_STEP;
+    }
+    (*ppExtents)[*pCount].offset = Offset;
+    (*ppExtents)[*pCount].length = Length;
+    ++*pCount;
+    return true;
+}
+
+// 获取文件中所有有数据的区域，文件空洞不包含在内
+// 参数 Size 为文件大小，只查找 [0, Size) 范围
+// 成功后 *ppExtents 指向新分配的数组(由调用者 free，数量为0时可能为NULL)，*pCount 为数组元素数量
+// 不支持查询空洞的平台或文件系统上，整个文件作为一个数据区域返回
+// 函数返回后文件指针位于文件开头
+// 成功返回0，失败返回1
+int OsFileDataExtents(FILE *Stream, int64_t Size, EXTENT_T **ppExtents, size_t *pCount) {
+    size_t Slots = 0;
+    int FinalReturnCode = RESULT_SUCCESS;
+    *ppExtents = NULL;
+    *pCount = 0;
+    if (Size <= 0LL)
+        return RESULT_SUCCESS;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    int FileDesc = fileno(Stream);
+    off_t DataStart, HoleStart = 0;
+    while (HoleStart < Size) {
+        DataStart = lseek(FileDesc, HoleStart, SEEK_DATA);
+        if (DataStart < 0) {
+            if (errno == ENXIO) // 其后再没有数据
+                break;
+            // 文件系统不支持查询空洞，当作没有空洞处理
+            free(*ppExtents), *ppExtents = NULL, *pCount = 0;
+            goto WholeFile;
+        }
+        if (DataStart >= Size)
+            break;
+        HoleStart = lseek(FileDesc, DataStart, SEEK_HOLE);
+        if (HoleStart < 0) {
+            free(*ppExtents), *ppExtents = NULL, *pCount = 0;
+            goto WholeFile;
+        }
+        if (HoleStart > Size)
+            HoleStart = Size;
+        if (!AppendExtent(ppExtents, pCount, &Slots, DataStart, HoleStart - DataStart)) {
+            free(*ppExtents), *ppExtents = NULL, *pCount = 0;
+            FinalReturnCode = RESULT_FAILURE;
+            goto RewindAndReturn;
+        }
+    }
+    goto RewindAndReturn;
+WholeFile:
+#endif // SEEK_DATA && SEEK_HOLE
+    if (!AppendExtent(ppExtents, pCount, &Slots, 0LL, Size))
+        FinalReturnCode = RESULT_FAILURE;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+RewindAndReturn:
+#endif // SEEK_DATA && SEEK_HOLE
+    rewind(Stream);
+    return FinalReturnCode;
+}
+
+// 将文件截断或扩展到 Size 字节，扩展部分在支持空洞的文件系统上成为空洞
+// 成功返回0，失败返回1
+int OsFileTruncate(FILE *Stream, int64_t Size) {
+    if (fflush(Stream))
+        return RESULT_FAILURE;
+#ifdef _WIN32
+    return _chsize_s(_fileno(Stream), Size) ? RESULT_FAILURE : RESULT_SUCCESS;
+#else
+    return ftruncate(fileno(Stream), (off_t)Size) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 将多个内存块按顺序写入文件当前位置，在支持的平台上合并为尽量少的 writev 调用
+// 参数 Count 不能超过 OSFILE_IOV_MAX
+// 函数返回后文件指针位于写入的数据之后，可继续用标准库函数读写
+// 成功返回0，失败返回1
+int OsFileWriteV(FILE *Stream, const OSIOV_T *Vector, int Count) {
+    if (Count <= 0)
+        return RESULT_SUCCESS;
+    if (Count > OSFILE_IOV_MAX)
+        return RESULT_FAILURE;
+#ifdef _WIN32
+    for (int i = 0; i < Count; ++i) {
+        if (Vector[i].length > 0 && fwrite(Vector[i].base, Vector[i].length, 1, Stream) != 1)
+            return RESULT_FAILURE;
+    }
+    return RESULT_SUCCESS;
+#else
+    struct iovec IOVector[OSFILE_IOV_MAX];
+    struct iovec *Pending = IOVector; // 尚未写完的第一个内存块
+    int FileDesc = fileno(Stream);
+    ssize_t Written;
+    off_t Position;
+    // 先把标准库缓冲区中的数据写入文件，使文件描述符的位置与文件指针一致
+    if (fflush(Stream))
+        return RESULT_FAILURE;
+    for (int i = 0; i < Count; ++i) {
+        IOVector[i].iov_base = (void *)Vector[i].base;
+        IOVector[i].iov_len = Vector[i].length;
+    }
+    while (Count > 0) {
+        if ((Written = writev(FileDesc, Pending, Count)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return RESULT_FAILURE;
+        }
+        // 跳过已经写完的内存块，部分写入的内存块调整起始地址后继续写
+        while (Count > 0 && (size_t)Written >= Pending->iov_len) {
+            Written -= (ssize_t)Pending->iov_len;
+            ++Pending, --Count;
+        }
+        if (Count > 0) {
+            Pending->iov_base = (char *)Pending->iov_base + Written;
+            Pending->iov_len -= (size_t)Written;
+        }
+    }
+    // 标准库记录的文件位置已过时，重新定位文件指针
+    if ((Position = lseek(FileDesc, 0, SEEK_CUR)) < 0)
+        return RESULT_FAILURE;
+    return fseeko(Stream, Position, SEEK_SET) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 让系统开始把文件 [Offset, Offset + Length) 范围内的脏页写回磁盘，不等待写回完成
+// 用于持续产生大量数据时分摊写回，避免最后一次同步等待过久
+// 不支持的平台上什么也不做
+// 成功返回0，失败返回1
+int OsFileWriteback(FILE *Stream, int64_t Offset, int64_t Length) {
+    if (fflush(Stream))
+        return RESULT_FAILURE;
+#ifdef SYNC_FILE_RANGE_WRITE
+    if (Length > 0LL && sync_file_range(fileno(Stream), (off_t)Offset, (off_t)Length, SYNC_FILE_RANGE_WRITE))
+        return RESULT_FAILURE;
+#endif // SYNC_FILE_RANGE_WRITE
+    return RESULT_SUCCESS;
+}
+
+// 将文件数据(以及读取数据必需的元数据，如文件大小)写入磁盘，等待写入完成
+// 成功返回0，失败返回1
+int OsFileSyncData(FILE *Stream) {
+    if (fflush(Stream))
+        return RESULT_FAILURE;
+#ifdef _WIN32
+    return _commit(_fileno(Stream)) ? RESULT_FAILURE : RESULT_SUCCESS;
+#elif defined(__APPLE__)
+    return fsync(fileno(Stream)) ? RESULT_FAILURE : RESULT_SUCCESS;
+#else
+    return fdatasync(fileno(Stream)) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 获取路径所在文件系统的设备号，用于判断不同路径是否在同一文件系统
+// 成功返回0，失败返回1
+int OsFileDevice(const char *Path, uint64_t *pDevice) {
+#ifdef _WIN32
+    struct _stat64 PathStat;
+    if (_stat64(Path, &PathStat))
+        return RESULT_FAILURE;
+#else
+    struct stat PathStat;
+    if (stat(Path, &PathStat))
+        return RESULT_FAILURE;
+#endif // _WIN32
+    *pDevice = (uint64_t)PathStat.st_dev;
+    return RESULT_SUCCESS;
+}
+
+// 将路径所在文件系统的全部缓存数据写入磁盘，等待写入完成
+// 没有 syncfs 的 POSIX 平台同步所有文件系统，WIN平台不支持(调用者应逐个同步文件)
+// 成功返回0，失败返回1
+int OsFileSyncFS(const char *Path) {
+#ifdef _WIN32
+    return RESULT_FAILURE;
+#elif defined(__linux__)
+    int FileDesc, FinalReturnCode;
+    if ((FileDesc = open(Path, O_RDONLY)) < 0)
+        return RESULT_FAILURE;
+    FinalReturnCode = syncfs(FileDesc) ? RESULT_FAILURE : RESULT_SUCCESS;
+    close(FileDesc);
+    return FinalReturnCode;
+#else
+    sync();
+    return RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 在内核中把流 From 当前位置起的 Size 字节复制到流 To 的当前位置，数据不经过用户空间
+// 成功后两个流的文件指针都位于复制的数据之后
+// 失败时两个流的文件指针不变(To 中可能已写入部分数据)，调用者可改用普通读写重新复制
+// 不支持的平台或文件系统上总是失败
+// 成功返回0，失败返回1
+int OsFileCopyRange(FILE *From, FILE *To, int64_t Size) {
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    off_t InOffset, OutOffset;
+    ssize_t Copied;
+    if ((InOffset = ftello(From)) < 0 || (OutOffset = ftello(To)) < 0)
+        return RESULT_FAILURE;
+    if (fflush(To))
+        return RESULT_FAILURE;
+    while (Size > 0LL) {
+        // 使用显式偏移量，不改变文件描述符的位置，失败时流的状态保持不变
+        if ((Copied = copy_file_range(fileno(From), &InOffset, fileno(To), &OutOffset, (size_t)Size, 0U)) <= 0) {
+            if (Copied < 0 && errno == EINTR)
+                continue;
+            return RESULT_FAILURE;
+        }
+        Size -= (int64_t)Copied;
+    }
+    // 重新定位两个流的文件指针，同时丢弃 From 中已过时的预读数据
+    if (fseeko(From, InOffset, SEEK_SET) || fseeko(To, OutOffset, SEEK_SET))
+        return RESULT_FAILURE;
+    return RESULT_SUCCESS;
+#else
+    (void)From, (void)To, (void)Size;
+    return RESULT_FAILURE;
+#endif // __linux__
+}
+
+// 设置当前进程的 I/O 优先级，参数 Priority 为 OSFILE_IOPRIO_BE 或 OSFILE_IOPRIO_IDLE
+// Linux 使用 ioprio_set，WIN平台使用后台处理模式，其他平台不支持
+// 成功返回0，失败返回1
+int OsFileIOPriority(int Priority) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    // 见 linux/ioprio.h：优先级类别在高3位，类别内级别在低13位
+    const int IOPRIO_CLASS_SHIFT = 13, IOPRIO_CLASS_BE = 2, IOPRIO_CLASS_IDLE = 3, IOPRIO_WHO_PROCESS = 1;
+    int Value;
+    if (Priority == OSFILE_IOPRIO_IDLE)
+        Value = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    else if (Priority == OSFILE_IOPRIO_BE)
+        Value = (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 4; // 默认级别4
+    else
+        return RESULT_FAILURE;
+    return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, Value) ? RESULT_FAILURE : RESULT_SUCCESS;
+#elif defined(_WIN32)
+    if (Priority == OSFILE_IOPRIO_IDLE)
+        return SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN) ? RESULT_SUCCESS : RESULT_FAILURE;
+    else if (Priority == OSFILE_IOPRIO_BE)
+        return RESULT_SUCCESS;
+    return RESULT_FAILURE;
+#else
+    return Priority == OSFILE_IOPRIO_BE ? RESULT_SUCCESS : RESULT_FAILURE;
+#endif // __linux__
+}
+
+// 从文件的 Offset 偏移量处读取 Size 字节，不使用也不改变流的文件指针和缓冲区
+// 多个线程可同时对同一个流调用此函数
+// 读满 Size 字节返回0，出错或遇到文件末尾返回1
+int OsFilePRead(FILE *Stream, void *Buffer, size_t Size, int64_t Offset) {
+#ifdef _WIN32
+    HANDLE FileHandle = (HANDLE)_get_osfhandle(_fileno(Stream));
+    OVERLAPPED Overlapped;
+    LARGE_INTEGER Saved;
+    DWORD SizeOnce, ReadOnce;
+    if (SavePosition(FileHandle, &Saved))
+        return RESULT_FAILURE;
+    while (Size > 0) {
+        memset(&Overlapped, 0, sizeof(OVERLAPPED));
+        Overlapped.Offset = (DWORD)((uint64_t)Offset & 0xFFFFFFFFULL);
+        Overlapped.OffsetHigh = (DWORD)((uint64_t)Offset >> 32);
+        SizeOnce = Size > 0x40000000 ? 0x40000000 : (DWORD)Size;
+        if (!ReadFile(FileHandle, Buffer, SizeOnce, &ReadOnce, &Overlapped) || ReadOnce == 0)
+            return RestorePosition(FileHandle, Saved, RESULT_FAILURE);
+        Buffer = (char *)Buffer + ReadOnce;
+        Size -= ReadOnce;
+        Offset += ReadOnce;
+    }
+    return RestorePosition(FileHandle, Saved, RESULT_SUCCESS);
+#else
+    ssize_t ReadOnce;
+    while (Size > 0) {
+        if ((ReadOnce = pread(fileno(Stream), Buffer, Size, (off_t)Offset)) <= 0) {
+            if (ReadOnce < 0 && errno == EINTR)
+                continue;
+            return RESULT_FAILURE;
+        }
+        Buffer = (char *)Buffer + ReadOnce;
+        Size -= (size_t)ReadOnce;
+        Offset += ReadOnce;
+    }
+    return RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 把 Size 字节写入文件的 Offset 偏移量处，不使用也不改变流的文件指针和缓冲区
+// 多个线程可同时对同一个流的不同区域调用此函数，调用前应已 fflush 该流
+// 成功返回0，失败返回1
+int OsFilePWrite(FILE *Stream, const void *Buffer, size_t Size, int64_t Offset) {
+#ifdef _WIN32
+    HANDLE FileHandle = (HANDLE)_get_osfhandle(_fileno(Stream));
+    OVERLAPPED Overlapped;
+    LARGE_INTEGER Saved;
+    DWORD SizeOnce, WrittenOnce;
+    if (SavePosition(FileHandle, &Saved))
+        return RESULT_FAILURE;
+    while (Size > 0) {
+        memset(&Overlapped, 0, sizeof(OVERLAPPED));
+        Overlapped.Offset = (DWORD)((uint64_t)Offset & 0xFFFFFFFFULL);
+        Overlapped.OffsetHigh = (DWORD)((uint64_t)Offset >> 32);
+        SizeOnce = Size > 0x40000000 ? 0x40000000 : (DWORD)Size;
+        if (!WriteFile(FileHandle, Buffer, SizeOnce, &WrittenOnce, &Overlapped) || WrittenOnce == 0)
+            return RestorePosition(FileHandle, Saved, RESULT_FAILURE);
+        Buffer = (const char *)Buffer + WrittenOnce;
+        Size -= WrittenOnce;
+        Offset += WrittenOnce;
+    }
+    return RestorePosition(FileHandle, Saved, RESULT_SUCCESS);
+#else
+    ssize_t WrittenOnce;
+    while (Size > 0) {
+        if ((WrittenOnce = pwrite(fileno(Stream), Buffer, Size, (off_t)Offset)) <= 0) {
+            if (WrittenOnce < 0 && errno == EINTR)
+                continue;
+            return RESULT_FAILURE;
+        }
+        Buffer = (const char *)Buffer + WrittenOnce;
+        Size -= (size_t)WrittenOnce;
+        Offset += WrittenOnce;
+    }
+    return RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 为文件的 Offset 起 Length 字节预先分配磁盘空间，文件不足此长度时扩展文件
+// 文件系统不支持预分配时退回为只扩展文件大小
+// 成功返回0，失败返回1
+int OsFileAllocate(FILE *Stream, int64_t Offset, int64_t Length) {
+    if (fflush(Stream))
+        return RESULT_FAILURE;
+#ifdef _WIN32
+    if (_filelengthi64(_fileno(Stream)) >= Offset + Length)
+        return RESULT_SUCCESS;
+    return _chsize_s(_fileno(Stream), Offset + Length) ? RESULT_FAILURE : RESULT_SUCCESS;
+#else
+    struct stat FileStat;
+#ifdef __linux__
+    if (!posix_fallocate(fileno(Stream), (off_t)Offset, (off_t)Length))
+        return RESULT_SUCCESS;
+#endif // __linux__
+    if (fstat(fileno(Stream), &FileStat))
+        return RESULT_FAILURE;
+    if (FileStat.st_size >= Offset + Length)
+        return RESULT_SUCCESS;
+    return ftruncate(fileno(Stream), (off_t)(Offset + Length)) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 锁定文件 [Offset, Offset + Length) 范围，已被其他写入者锁定时等待
+// 参数 Exclusive 为 true 时加独占锁，否则加共享锁，共享锁之间互不阻塞
+// Linux 使用 OFD 锁，锁属于打开的文件而不是进程，同一进程内分别打开的流也互斥
+// 其他 POSIX 平台使用进程级的记录锁，同一进程内不互斥
+// 成功返回0，失败返回1
+int OsFileLock(FILE *Stream, int64_t Offset, int64_t Length, bool Exclusive) {
+#ifdef _WIN32
+    HANDLE FileHandle = (HANDLE)_get_osfhandle(_fileno(Stream));
+    OVERLAPPED Overlapped;
+    memset(&Overlapped, 0, sizeof(OVERLAPPED));
+    Overlapped.Offset = (DWORD)((uint64_t)Offset & 0xFFFFFFFFULL);
+    Overlapped.OffsetHigh = (DWORD)((uint64_t)Offset >> 32);
+    if (!LockFileEx(FileHandle, Exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, (DWORD)((uint64_t)Length & 0xFFFFFFFFULL), (DWORD)((uint64_t)Length >> 32), &Overlapped))
+        return RESULT_FAILURE;
+    return RESULT_SUCCESS;
+#else
+    struct flock Lock;
+    memset(&Lock, 0, sizeof(struct flock));
+    Lock.l_type = Exclusive ? F_WRLCK : F_RDLCK;
+    Lock.l_whence = SEEK_SET;
+    Lock.l_start = (off_t)Offset;
+    Lock.l_len = (off_t)Length;
+#ifdef F_OFD_SETLKW
+    while (fcntl(fileno(Stream), F_OFD_SETLKW, &Lock)) {
+#else
+    while (fcntl(fileno(Stream), F_SETLKW, &Lock)) {
+#endif // F_OFD_SETLKW
+        if (errno != EINTR)
+            return RESULT_FAILURE;
+    }
+    return RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 解除 OsFileLock 加在文件 [Offset, Offset + Length) 范围的锁
+// 成功返回0，失败返回1
+int OsFileUnlock(FILE *Stream, int64_t Offset, int64_t Length) {
+#ifdef _WIN32
+    HANDLE FileHandle = (HANDLE)_get_osfhandle(_fileno(Stream));
+    OVERLAPPED Overlapped;
+    memset(&Overlapped, 0, sizeof(OVERLAPPED));
+    Overlapped.Offset = (DWORD)((uint64_t)Offset & 0xFFFFFFFFULL);
+    Overlapped.OffsetHigh = (DWORD)((uint64_t)Offset >> 32);
+    return UnlockFileEx(FileHandle, 0, (DWORD)((uint64_t)Length & 0xFFFFFFFFULL), (DWORD)((uint64_t)Length >> 32), &Overlapped) ? RESULT_SUCCESS : RESULT_FAILURE;
+#else
+    struct flock Lock;
+    memset(&Lock, 0, sizeof(struct flock));
+    Lock.l_type = F_UNLCK;
+    Lock.l_whence = SEEK_SET;
+    Lock.l_start = (off_t)Offset;
+    Lock.l_len = (off_t)Length;
+#ifdef F_OFD_SETLK
+    return fcntl(fileno(Stream), F_OFD_SETLK, &Lock) ? RESULT_FAILURE : RESULT_SUCCESS;
+#else
+    return fcntl(fileno(Stream), F_SETLK, &Lock) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // F_OFD_SETLK
+#endif // _WIN32
+}
+
+// 1601年1月1日与1970年1月1日之间相差的100纳秒数，用于 FILETIME 与 Unix 时间的换算
+#define FILETIME_UNIX_EPOCH 116444736000000000LL
+
+#ifdef _WIN32
+// FILETIME 转换为自1970年1月1日 UTC 起的纳秒数
+static int64_t FileTimeToNano(const FILETIME *Time) {
+    return ((int64_t)(((uint64_t)Time->dwHighDateTime << 32) | Time->dwLowDateTime) - FILETIME_UNIX_EPOCH) * 100;
+}
+#else
+// stat 结构中的修改时间转换为自1970年1月1日 UTC 起的纳秒数
+static int64_t StatMtimeNano(const struct stat *FileStat) {
+#ifdef __APPLE__
+    return (int64_t)FileStat->st_mtimespec.tv_sec * 1000000000LL + FileStat->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)FileStat->st_mtim.tv_sec * 1000000000LL + FileStat->st_mtim.tv_nsec;
+#endif // __APPLE__
+}
+#endif // _WIN32
+
+// 获取已打开文件的修改时间，单位为纳秒，自1970年1月1日 UTC 起算
+// 成功返回0，失败返回1
+int OsFileMtime(FILE *Stream, int64_t *pMtime) {
+#ifdef _WIN32
+    HANDLE FileHandle = (HANDLE)_get_osfhandle(_fileno(Stream));
+    FILETIME Modified;
+    if (FileHandle == INVALID_HANDLE_VALUE || !GetFileTime(FileHandle, NULL, NULL, &Modified))
+        return RESULT_FAILURE;
+    *pMtime = FileTimeToNano(&Modified);
+#else
+    struct stat FileStat;
+    if (fstat(fileno(Stream), &FileStat))
+        return RESULT_FAILURE;
+    *pMtime = StatMtimeNano(&FileStat);
+#endif // _WIN32
+    return RESULT_SUCCESS;
+}
+
+// 获取路径指向的普通文件的大小和修改时间(单位同 OsFileMtime)
+// 路径不存在或不是普通文件时失败
+// 成功返回0，失败返回1
+int OsFileStat(const char *Path, int64_t *pSize, int64_t *pMtime) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA Attributes;
+    if (!GetFileAttributesExA(Path, GetFileExInfoStandard, &Attributes) || (Attributes.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE)))
+        return RESULT_FAILURE;
+    *pSize = (int64_t)(((uint64_t)Attributes.nFileSizeHigh << 32) | Attributes.nFileSizeLow);
+    *pMtime = FileTimeToNano(&Attributes.ftLastWriteTime);
+#else
+    struct stat FileStat;
+    if (stat(Path, &FileStat) || !S_ISREG(FileStat.st_mode))
+        return RESULT_FAILURE;
+    *pSize = (int64_t)FileStat.st_size;
+    *pMtime = StatMtimeNano(&FileStat);
+#endif // _WIN32
+    return RESULT_SUCCESS;
+}
+
+// 设置文件的修改时间(单位同 OsFileMtime)，访问时间不变
+// 精度受文件系统限制，WIN平台为100纳秒
+// 成功返回0，失败返回1
+int OsFileSetMtime(const char *Path, int64_t Mtime) {
+#ifdef _WIN32
+    HANDLE FileHandle;
+    FILETIME Modified;
+    uint64_t Ticks = (uint64_t)(Mtime / 100 + FILETIME_UNIX_EPOCH);
+    bool Success;
+    Modified.dwLowDateTime = (DWORD)(Ticks & 0xFFFFFFFFULL);
+    Modified.dwHighDateTime = (DWORD)(Ticks >> 32);
+    FileHandle = CreateFileA(Path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+        return RESULT_FAILURE;
+    Success = SetFileTime(FileHandle, NULL, NULL, &Modified);
+    CloseHandle(FileHandle);
+    return Success ? RESULT_SUCCESS : RESULT_FAILURE;
+#else
+    struct timespec Times[2];
+    Times[0].tv_sec = 0;
+    Times[0].tv_nsec = UTIME_OMIT;
+    Times[1].tv_sec = (time_t)(Mtime / 1000000000LL);
+    Times[1].tv_nsec = (long)(Mtime % 1000000000LL);
+    if (Times[1].tv_nsec < 0) {
+        Times[1].tv_nsec += 1000000000L;
+        --Times[1].tv_sec;
+    }
+    return utimensat(AT_FDCWD, Path, Times, 0) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
@@ -0,0 +1,51 @@
+#ifndef __OSFILE_H
+#define __OSFILE_H
+
+#ifdef _MSC_VER
+#ifndef _CRT_SECURE_NO_WARNINGS // 关闭MSC强制安全警告
+#define _CRT_SECURE_NO_WARNINGS
+#endif // _CRT_SECURE_NO_WARNINGS
+#endif // _MSC_VER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 文件中一段连续的有数据区域
+typedef struct {
+    int64_t offset; // 数据区域在文件中的起始偏移量
+    int64_t length; // 数据区域的字节数
+} EXTENT_T;
+
+#define OSFILE_IOV_MAX 1024 // OsFileWriteV 每次最多接受的内存块数量，不超过常见平台的 IOV_MAX
+
+// OsFileIOPriority 可用的 I/O 优先级
+#define OSFILE_IOPRIO_BE   0 // 尽力而为，系统默认
+#define OSFILE_IOPRIO_IDLE 1 // 只在磁盘空闲时读写
+
+// 向量写入的一个内存块
+typedef struct {
+    const void *base; // 内存块起始地址
+    size_t length;    // 内存块字节数
+} OSIOV_T;
+
+int OsFileDataExtents(FILE *Stream, int64_t Size, EXTENT_T **ppExtents, size_t *pCount);
+int OsFileTruncate(FILE *Stream, int64_t Size);
+int OsFileWriteV(FILE *Stream, const OSIOV_T *Vector, int Count);
+int OsFileWriteback(FILE *Stream, int64_t Offset, int64_t Length);
+int OsFileSyncData(FILE *Stream);
+int OsFileDevice(const char *Path, uint64_t *pDevice);
+int OsFileSyncFS(const char *Path);
+int OsFileCopyRange(FILE *From, FILE *To, int64_t Size);
+int OsFileIOPriority(int Priority);
+int OsFilePRead(FILE *Stream, void *Buffer, size_t Size, int64_t Offset);
+int OsFilePWrite(FILE *Stream, const void *Buffer, size_t Size, int64_t Offset);
+int OsFileAllocate(FILE *Stream, int64_t Offset, int64_t Length);
+int OsFileLock(FILE *Stream, int64_t Offset, int64_t Length, bool Exclusive);
+int OsFileUnlock(FILE *Stream, int64_t Offset, int64_t Length);
+int OsFileMtime(FILE *Stream, int64_t *pMtime);
+int OsFileStat(const char *Path, int64_t *pSize, int64_t *pMtime);
+int OsFileSetMtime(const char *Path, int64_t Mtime);
+
+#endif // __OSFILE_H
@@ -29,13 +29,20 @@
 #define MALLOC_NUM 128
 #define RALLOC_NUM 128
 
-// 最后一次函数执行状态码
-static int OSP_LAST_STATE = STATUS_EXEC_SUCCESS;
+// 线程局部存储，各线程的执行状态码和默认缓冲区互不影响
+#ifdef _MSC_VER
+#define OSP_THREAD_LOCAL __declspec(thread)
+#else
+#define OSP_THREAD_LOCAL _Thread_local
+#endif // _MSC_VER
+
+// 本线程最后一次函数执行状态码
+static OSP_THREAD_LOCAL int OSP_LAST_STATE = STATUS_EXEC_SUCCESS;
 
 // 设置函数的完成状态
 static inline void OsPathSetState(int state) { OSP_LAST_STATE = state; }
 
-// 获取最后一次函数执行的错误代码
+// 获取本线程最后一次函数执行的错误代码
 // 返回0代表没有发生错误
 // 此函数返回值见同名头文件中名称以<STATUS_>开头的宏定义
 int OsPathLastState(void) { return OSP_LAST_STATE; }
@@ -48,6 +55,25 @@ static char *StrToLowercase(char *String) {
     return String;
 }
 
+// 可重入的 strtok：String 为NULL时从 *ppSaved 处继续分割
+// 返回下一个不含分隔符的片段，没有更多片段时返回NULL
+static char *StrSplitToken(char *String, const char *Delimiters, char **ppSaved) {
+    char *Token;
+    if (NULL == String)
+        String = *ppSaved;
+    String += strspn(String, Delimiters);
+    if (!*String) {
+        *ppSaved = String;
+        return NULL;
+    }
+    Token = String;
+    String += strcspn(String, Delimiters);
+    if (*String)
+        *String++ = EMPTY_CHAR;
+    *ppSaved = String;
+    return Token;
+}
+
 // 验证路径是否存在
 bool OsPathExists(const char *Path) {
     OsPathSetState(STATUS_EXEC_SUCCESS);
@@ -97,7 +123,7 @@ bool OsPathIsFile(const char *Path) {
 // 创建多级目录
 // 成功返回0，失败返回1
 int OsPathMakeDIR(const char *DirPath) {
-    static char Buffer[PATH_MAX_SIZE + 12];
+    char Buffer[PATH_MAX_SIZE + 12];
     char *CmdPrefix = "mkdir";
     OsPathSetState(STATUS_EXEC_SUCCESS);
     if (!DirPath || strlen(DirPath) >= PATH_MAX_SIZE) {
@@ -119,10 +145,10 @@ int OsPathMakeDIR(const char *DirPath) {
 // 获取当前工作目录
 // 参数buf是接收路径的缓冲区
 // 参数size是缓冲区大小
-// 如果参数buf为NULL，则应注意，之前引用get_cwd(NULL, 0)返回值
+// 如果参数buf为NULL，则应注意，本线程之前引用get_cwd(NULL, 0)返回值
 // 地址的变量的值都有可能被此次运行改变
 char *OsPathGetCWD(char *Buffer, size_t Size) {
-    static char CWD[PATH_MAX_SIZE];
+    static OSP_THREAD_LOCAL char CWD[PATH_MAX_SIZE];
     OsPathSetState(STATUS_EXEC_SUCCESS);
     if (NULL == Buffer) {
         Buffer = CWD;
@@ -410,6 +436,7 @@ char *OsPathNormcase(char *Path) {
 //    所以，就算path字符串长度为0，也要保证字符串数组path内存空间大于等于2
 // 此函数改变原路径，成功返回缓冲区指针，失败返回NULL
 char *OsPathNormpath(char *Path, size_t Size) {
+    char *SplitSaved; // StrSplitToken 分割的位置
     size_t PathLength, Index = 0, SizeRequired = 0;
     char *FinalResult = Path;
     char *pPath = Path;
@@ -449,7 +476,7 @@ char *OsPathNormpath(char *Path, size_t Size) {
         strcat(Prefix, PATH_NSEPS);
         memmove(Suffix, Suffix + 1, strlen(Suffix));
     }
-    SplitToken = strtok(Suffix, PATH_NSEPS);
+    SplitToken = StrSplitToken(Suffix, PATH_NSEPS, &SplitSaved);
     while (SplitToken) {
         if (strcmp(SplitToken, PATH_CDIRS) == 0)
             goto Next;
@@ -463,7 +490,7 @@ char *OsPathNormpath(char *Path, size_t Size) {
         } else
             ppSplitedPath[Index++] = SplitToken;
     Next:
-        SplitToken = strtok(NULL, PATH_NSEPS);
+        SplitToken = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
     if (!*Prefix && Index == 0) {
         if (Size <= 2) {
@@ -796,7 +823,7 @@ CleanAndReturn:
 // 获取路径的上一级路径
 // 成功返回字符指针，失败返回NULL
 char *OsPathDirName(char Buffer[], size_t BufferSize, const char *Path) {
-    static char DirectoryPath[PATH_MAX_SIZE];
+    static OSP_THREAD_LOCAL char DirectoryPath[PATH_MAX_SIZE];
     if (!Buffer) {
         Buffer = DirectoryPath;
         BufferSize = PATH_MAX_SIZE;
@@ -807,7 +834,7 @@ char *OsPathDirName(char Buffer[], size_t BufferSize, const char *Path) {
 // 获取路径中的文件名
 // 成功返回字符指针，失败返回NULL
 char *OsPathBaseName(char Buffer[], size_t BufferSize, const char *Path) {
-    static char BaseName[PATH_MAX_SIZE];
+    static OSP_THREAD_LOCAL char BaseName[PATH_MAX_SIZE];
     if (!Buffer) {
         Buffer = BaseName;
         BufferSize = PATH_MAX_SIZE;
@@ -819,6 +846,7 @@ char *OsPathBaseName(char Buffer[], size_t BufferSize, const char *Path) {
 // 此相对路径是 Path1 相对于 Path2 的路径
 // 成功返回0，失败返回1
 int OsPathRelativePath(char Buffer[], size_t BufferSize, const char *Path1, const char *Path2) {
+    char *SplitSaved; // StrSplitToken 分割的位置
     int ret_status = RESULT_FAILURE;
     int SizeRequired = 0; // 结果字符数，size要大于此数才能装下结果
     // Path1SplitedCount 和 Path2SplitedCount : 以斜杠分割后的字符串数量；cnt_min：两者中的较小值
@@ -864,15 +892,15 @@ int OsPathRelativePath(char Buffer[], size_t BufferSize, const char *Path1, cons
         OsPathSetState(STATUS_MEMORY_ERROR);
         goto CleanAndReturn;
     }
-    Token = strtok(Path1Absoluted, PATH_NSEPS);
+    Token = StrSplitToken(Path1Absoluted, PATH_NSEPS, &SplitSaved);
     while (Token) {
         Path1SplitedResult[Path1SplitedCount++] = Token;
-        Token = strtok(NULL, PATH_NSEPS);
+        Token = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
-    Token = strtok(Path2Absoluted, PATH_NSEPS);
+    Token = StrSplitToken(Path2Absoluted, PATH_NSEPS, &SplitSaved);
     while (Token) {
         Path2SplitedResult[Path2SplitedCount++] = Token;
-        Token = strtok(NULL, PATH_NSEPS);
+        Token = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
     SplitedMinimum = Path1SplitedCount < Path2SplitedCount ? Path1SplitedCount : Path2SplitedCount;
     for (; SameCountAfterSplited < SplitedMinimum; ++SameCountAfterSplited) {
@@ -983,6 +1011,7 @@ char *OsPathNormcase(char Path[]) {
 //    所以，如果path字符串长度为 0，也要保证字符串数组path空间大于等于2
 // 此函数改变原路径，成功返回缓冲区指针，失败返回NULL
 char *OsPathNormpath(char Path[], size_t Size) {
+    char *SplitSaved; // StrSplitToken 分割的位置
     char initial_slashes[3] = {0};
     char PathBufferTemp[PATH_MAX_SIZE];
     char tmp_split[PATH_MAX_SIZE];
@@ -1013,7 +1042,7 @@ char *OsPathNormpath(char Path[], size_t Size) {
     if (Path[0] == PATH_NSEP && Path[1] == PATH_NSEP && !Path[2] == PATH_NSEP)
         initial_slashes[1] = PATH_NSEP;
     strcpy(tmp_split, Path);
-    SplitToken = strtok(tmp_split, PATH_NSEPS);
+    SplitToken = StrSplitToken(tmp_split, PATH_NSEPS, &SplitSaved);
     while (SplitToken) {
         if (strcmp(SplitToken, PATH_CDIRS) == 0)
             goto Next;
@@ -1022,7 +1051,7 @@ char *OsPathNormpath(char Path[], size_t Size) {
         else if (Index > 0)
             --Index;
     Next:
-        SplitToken = strtok(NULL, PATH_NSEPS);
+        SplitToken = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
     if (Size <= strlen(initial_slashes)) {
         OsPathSetState(STATUS_INSFC_BUFFER);
@@ -1143,6 +1172,7 @@ int OsPathJoinPath(char Buffer[], size_t BufferSize, int NumOfParam, const char
 // 将路径按最后一个路径分隔符(斜杠)分割为两部分
 // 成功返回0，失败返回1
 int OsPathSplitPath(char HeadBuffer[], size_t HeadBufSize, char TailBuffer[], size_t TailBufSize, const char *Path) {
+    char *SplitSaved; // StrSplitToken 分割的位置
     size_t Length, IndexOfLastSepPlus1;
     char head[PATH_MAX_SIZE];
     char PathBufferTemp[PATH_MAX_SIZE];
@@ -1164,7 +1194,7 @@ int OsPathSplitPath(char HeadBuffer[], size_t HeadBufSize, char TailBuffer[], si
         strncpy(head, PathBufferTemp, IndexOfLastSepPlus1);
     head[IndexOfLastSepPlus1] = EMPTY_CHAR;
     strcpy(stk_tmp, head);
-    if (*head && strtok(stk_tmp, PATH_NSEPS)) {
+    if (*head && StrSplitToken(stk_tmp, PATH_NSEPS, &SplitSaved)) {
         for (int i = strlen(head) - 1; i >= 0; --i) {
             if (head[i] == PATH_NSEP)
                 continue;
@@ -1194,7 +1224,7 @@ int OsPathSplitPath(char HeadBuffer[], size_t HeadBufSize, char TailBuffer[], si
 // 获取路径的上一级路径
 // 成功返回字符指针，失败返回NULL
 char *OsPathDirName(char Buffer[], size_t BufferSize, const char *Path) {
-    static char DirPath[PATH_MAX_SIZE];
+    static OSP_THREAD_LOCAL char DirPath[PATH_MAX_SIZE];
     if (!Buffer) {
         BufferSize = PATH_MAX_SIZE;
         Buffer = DirPath;
@@ -1205,7 +1235,7 @@ char *OsPathDirName(char Buffer[], size_t BufferSize, const char *Path) {
 // 获取路径中的文件名
 // 成功返回字符指针，失败返回NULL
 char *OsPathBaseName(char Buffer[], size_t BufferSize, const char *Path) {
-    static char BaseName[PATH_MAX_SIZE];
+    static OSP_THREAD_LOCAL char BaseName[PATH_MAX_SIZE];
     if (!Buffer) {
         BufferSize = PATH_MAX_SIZE;
         Buffer = BaseName;
@@ -1217,6 +1247,7 @@ char *OsPathBaseName(char Buffer[], size_t BufferSize, const char *Path) {
 // 生成的相对路径是_path相对于start的路径
 // 成功返回0，失败返回1
 int OsPathRelativePath(char Buffer[], size_t BufferSize, const char *Path, const char *Path2) {
+    char *SplitSaved; // StrSplitToken 分割的位置
     int FinalReturnCode = RESULT_SUCCESS;
     int SizeRequired = 0; // 结果字符数，size要大于此数才能装下结果
     // cnt_p及cnt_s：以斜杠分割后的字符串数量；cnt_min：两者中的较小值
@@ -1264,15 +1295,15 @@ int OsPathRelativePath(char Buffer[], size_t BufferSize, const char *Path, const
         OsPathSetState(STATUS_MEMORY_ERROR);
         goto CleanAndReturn;
     }
-    Token = strtok(Path1Absoluted, PATH_NSEPS);
+    Token = StrSplitToken(Path1Absoluted, PATH_NSEPS, &SplitSaved);
     while (Token) {
         Path1SplitedResult[Path1SplitedCount++] = Token;
-        Token = strtok(NULL, PATH_NSEPS);
+        Token = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
-    Token = strtok(Path2Absoluted, PATH_NSEPS);
+    Token = StrSplitToken(Path2Absoluted, PATH_NSEPS, &SplitSaved);
     while (Token) {
         Path2SplitedResult[Path2SplitedCount++] = Token;
-        Token = strtok(NULL, PATH_NSEPS);
+        Token = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
     SplitedMinimum = Path1SplitedCount < Path2SplitedCount ? Path1SplitedCount : Path2SplitedCount;
     for (; SameCountAfterSplited < SplitedMinimum; ++SameCountAfterSplited) {
@@ -1453,6 +1484,7 @@ int OsPathSplitExt(char HeadBuffer[], size_t HeadBufSize, char ExtBuffer[], size
 // 功能：重定位路径中的'.'和'..'并把不能重定位的'..'修剪掉
 // 成功返回0，失败返回1
 int OsPathPrunePath(char Buffer[], size_t BufferSize, const char *Path) {
+    char *SplitSaved; // StrSplitToken 分割的位置
     size_t NewPathTotalSize = 0;
     int TokenCount = 0;
     int FinalReturnCode = RESULT_SUCCESS;
@@ -1480,7 +1512,7 @@ int OsPathPrunePath(char Buffer[], size_t BufferSize, const char *Path) {
         FinalReturnCode = RESULT_FAILURE;
         goto ClearAndReturn;
     }
-    Token = strtok(PathBufferTemp1, PATH_NSEPS);
+    Token = StrSplitToken(PathBufferTemp1, PATH_NSEPS, &SplitSaved);
     while (Token) {
         if (TokenCount > PATH_MAX_SIZE) {
             FinalReturnCode = RESULT_FAILURE;
@@ -1490,7 +1522,7 @@ int OsPathPrunePath(char Buffer[], size_t BufferSize, const char *Path) {
         if (strcmp(Token, PATH_PDIRS)) {
             PathSplitedList[TokenCount++] = Token;
         }
-        Token = strtok(NULL, PATH_NSEPS);
+        Token = StrSplitToken(NULL, PATH_NSEPS, &SplitSaved);
     }
     if (NULL != Buffer) {
         PathBufferTemp2[0] = EMPTY_CHAR;
@@ -0,0 +1,485 @@
+#include "osscan.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#define OSS_AFS "*"
+#else
+#include <dirent.h>
+#endif // _MSC_VER
+
+#include "../osthread/osthread.h"
+
+#define EXCLUDE_RECS "$RECYCLE.BIN"
+#define EXCLUDE_SVIS "System Volume Information"
+
+// 各种数组每次扩充的元素数量
+#define ENTRY_STEP   64
+#define DEQUE_STEP   64
+#define FRAME_STEP   16
+#define SCANNER_STEP 128
+
+typedef struct SCANDIR SCANDIR_T;
+
+// 目录中的一项
+typedef struct {
+    char *path;       // 完整路径
+    bool isdir;       // 是否是目录
+    SCANDIR_T *child; // 递归扫描时此子目录的扫描结果，不是目录或不递归时为NULL
+} SCANENTRY_T;
+
+// 一个目录的扫描结果，各项按名称排序
+struct SCANDIR {
+    const char *path;     // 目录路径，指向上级目录中对应项的 path
+    SCANENTRY_T *entries; // 目录中的各项
+    size_t count;         // 项数
+    bool listed;          // 已扫描完，扫描线程置位后各成员不再改变
+};
+
+// 一个线程待扫描的目录，线程自己从末尾取，其他线程从开头窃取
+typedef struct {
+    SCANDIR_T **items; // 待扫描的目录
+    size_t head;       // 第一个待扫描目录的下标
+    size_t tail;       // 最后一个待扫描目录之后的下标
+    size_t slots;      // items 的容量
+    OSMUTEX_T lock;    // 保护以上成员
+} SCANDEQUE_T;
+
+// 各扫描线程共享的状态
+typedef struct {
+    SCANDEQUE_T *deques; // 每个线程一个待扫描目录队列
+    int threads;         // 线程数
+    int recursion;       // 是否递归扫描子目录
+    size_t pending;      // 已加入队列但尚未扫描完的目录数，为0时扫描结束
+    size_t pushed;       // 加入队列的累计次数，空闲线程据此判断是否有新目录
+    size_t buffered;     // 已扫描但尚未被取走的项数
+    size_t limit;        // buffered 达到此数时扫描线程暂停
+    bool waiting;        // 取路径的一方正在等待某个目录扫描完，扫描线程不再暂停
+    bool stop;           // 扫描提前结束，扫描线程尽快退出
+    bool failed;         // 有目录无法打开或内存不足
+    OSMUTEX_T lock;      // 保护以上成员及各目录的 listed
+    OSCOND_T wake;       // 有新目录、缓存有空位或扫描结束时唤醒扫描线程
+    OSCOND_T listed;     // 有目录扫描完时唤醒取路径的一方
+} SCANSHARE_T;
+
+// 一个扫描线程
+typedef struct {
+    SCANSHARE_T *share; // 共享状态
+    int id;             // 线程编号，即自己的队列下标
+    OSTHREAD_T thread;  // 线程句柄
+} SCANWORKER_T;
+
+// 按路径排列目录中的各项，同一目录中各项路径的前缀相同，即按名称排列
+static int CompareEntry(const void *Left, const void *Right) {
+    return strcmp(((const SCANENTRY_T *)Left)->path, ((const SCANENTRY_T *)Right)->path);
+}
+
+// 释放目录的扫描结果及其中所有子目录的扫描结果
+static void FreeScanDir(SCANDIR_T *Dir) {
+    for (size_t i = 0; i < Dir->count; ++i) {
+        if (Dir->entries[i].child)
+            FreeScanDir(Dir->entries[i].child);
+        free(Dir->entries[i].path);
+    }
+    free(Dir->entries);
+    free(Dir);
+}
+
+// 向目录的扫描结果添加一项，得到与 OsPathScanPath 相同的规范化路径
+// 起始目录已规范化，名称中没有路径分隔符，直接拼接即可，无需再调用 OsPathNormpath
+// 内存不足返回 false，路径过长等无法处理的项直接跳过并返回 true
+static bool AddEntry(SCANDIR_T *Dir, size_t *pSlots, const char *Name, int IsDir) {
+    SCANENTRY_T *EntriesTemp;
+    char *FullPath;
+    size_t Size = strlen(Dir->path) + strlen(Name) + 2;
+    if (!strcmp(Name, PATH_CDIRS) || !strcmp(Name, PATH_PDIRS) || !strcmp(Name, EXCLUDE_RECS) || !strcmp(Name, EXCLUDE_SVIS))
+        return true;
+    if (!(FullPath = malloc(Size)))
+        return false;
+    if (OsPathJoinPath(FullPath, Size, 2, Dir->path, Name)) {
+        free(FullPath);
+        return true;
+    }
+#ifndef _MSC_VER
+    // 类型未知(包括符号链接)时按 stat 的结果判断，与 OsPathScanPath 相同
+    struct stat StatBuffer;
+    if (IsDir < 0) {
+        if (stat(FullPath, &StatBuffer)) {
+            free(FullPath);
+            return true;
+        }
+        IsDir = S_ISDIR(StatBuffer.st_mode);
+    }
+#endif // _MSC_VER
+    if (Dir->count >= *pSlots) {
+        if (!(EntriesTemp = realloc(Dir->entries, (*pSlots + ENTRY_STEP) * sizeof(SCANENTRY_T)))) {
+            free(FullPath);
+            return false;
+        }
+        Dir->entries = EntriesTemp;
+        *pSlots += ENTRY_STEP;
+    }
+    Dir->entries[Dir->count].path = FullPath;
+    Dir->entries[Dir->count].isdir = IsDir;
+    Dir->entries[Dir->count++].child = NULL;
+    return true;
+}
+
+// 读取目录中的各项并按名称排序
+// 成功返回0，目录无法打开或内存不足返回1
+static int ListDirectory(SCANDIR_T *Dir) {
+    size_t Slots = 0ULL;
+    int FinalReturnCode = RESULT_SUCCESS;
+#ifdef _MSC_VER
+    char PathToFind[PATH_MAX_SIZE];
+    WIN32_FIND_DATAA FindData;
+    HANDLE FindHandle;
+    if (OsPathJoinPath(PathToFind, PATH_MAX_SIZE, 2, Dir->path, OSS_AFS))
+        return RESULT_FAILURE;
+    if (INVALID_HANDLE_VALUE == (FindHandle = FindFirstFileA(PathToFind, &FindData)))
+        return RESULT_FAILURE;
+    do {
+        if (!AddEntry(Dir, &Slots, FindData.cFileName, !!(FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))) {
+            FinalReturnCode = RESULT_FAILURE;
+            break;
+        }
+    } while (FindNextFileA(FindHandle, &FindData));
+    FindClose(FindHandle);
+#else
+    struct dirent *PathDirent;
+    DIR *OpenedDir;
+    int IsDir;
+    if (!(OpenedDir = opendir(Dir->path)))
+        return RESULT_FAILURE;
+    while (NULL != (PathDirent = readdir(OpenedDir))) {
+        // 有 d_type 时只对类型未知的项调用 stat，MinGW 的 dirent 没有 d_type
+#ifdef DT_DIR
+        IsDir = PathDirent->d_type == DT_DIR ? 1 : (PathDirent->d_type == DT_REG ? 0 : -1);
+#else
+        IsDir = -1;
+#endif // DT_DIR
+        if (!AddEntry(Dir, &Slots, PathDirent->d_name, IsDir)) {
+            FinalReturnCode = RESULT_FAILURE;
+            break;
+        }
+    }
+    closedir(OpenedDir);
+#endif // _MSC_VER
+    if (Dir->count > 1)
+        qsort(Dir->entries, Dir->count, sizeof(SCANENTRY_T), CompareEntry);
+    return FinalReturnCode;
+}
+
+// 把目录加入队列末尾
+static bool PushDir(SCANDEQUE_T *Deque, SCANDIR_T *Dir) {
+    SCANDIR_T **ItemsTemp;
+    bool Success = true;
+    OsMutexLock(&Deque->lock);
+    if (Deque->tail >= Deque->slots) {
+        // 开头已被取走的位置先挪出来
+        if (Deque->head > 0) {
+            memmove(Deque->items, Deque->items + Deque->head, (Deque->tail - Deque->head) * sizeof(SCANDIR_T *));
+            Deque->tail -= Deque->head;
+            Deque->head = 0ULL;
+        }
+        if (Deque->tail >= Deque->slots) {
+            if (ItemsTemp = realloc(Deque->items, (Deque->slots + DEQUE_STEP) * sizeof(SCANDIR_T *))) {
+                Deque->items = ItemsTemp;
+                Deque->slots += DEQUE_STEP;
+            } else
+                Success = false;
+        }
+    }
+    if (Success)
+        Deque->items[Deque->tail++] = Dir;
+    OsMutexUnlock(&Deque->lock);
+    return Success;
+}
+
+// 从队列取出一个目录，Steal 为 true 时从开头窃取，否则从末尾取出，队列为空返回NULL
+static SCANDIR_T *PopDir(SCANDEQUE_T *Deque, bool Steal) {
+    SCANDIR_T *Dir = NULL;
+    OsMutexLock(&Deque->lock);
+    if (Deque->head < Deque->tail)
+        Dir = Steal ? Deque->items[Deque->head++] : Deque->items[--Deque->tail];
+    OsMutexUnlock(&Deque->lock);
+    return Dir;
+}
+
+// 扫描一个目录，递归扫描时把子目录加入自己的队列
+// 置位 listed 之后不再访问 Dir，取路径的一方可能随时释放它
+static void ScanOneDir(SCANWORKER_T *Worker, SCANDIR_T *Dir) {
+    SCANSHARE_T *Share = Worker->share;
+    size_t Pushed = 0ULL;
+    bool Failed = ListDirectory(Dir) != RESULT_SUCCESS;
+    // 倒序加入，使自己从末尾取出时先扫描名称靠前的子目录
+    for (size_t i = Dir->count; !Failed && Share->recursion && i > 0; --i) {
+        if (!Dir->entries[i - 1].isdir)
+            continue;
+        if (!(Dir->entries[i - 1].child = calloc(1, sizeof(SCANDIR_T)))) {
+            Failed = true;
+            break;
+        }
+        Dir->entries[i - 1].child->path = Dir->entries[i - 1].path;
+        // 先计入待扫描数再加入队列，避免其他线程误判扫描已结束
+        OsMutexLock(&Share->lock);
+        ++Share->pending;
+        OsMutexUnlock(&Share->lock);
+        if (!PushDir(&Share->deques[Worker->id], Dir->entries[i - 1].child)) {
+            OsMutexLock(&Share->lock);
+            --Share->pending;
+            OsMutexUnlock(&Share->lock);
+            Failed = true;
+            break;
+        }
+        ++Pushed;
+    }
+    OsMutexLock(&Share->lock);
+    if (Failed)
+        Share->failed = true;
+    Share->pushed += Pushed;
+    Share->buffered += Dir->count;
+    Dir->listed = true;
+    if (--Share->pending == 0ULL || Pushed > 0ULL || Failed)
+        OsCondBroadcast(&Share->wake);
+    OsCondBroadcast(&Share->listed);
+    OsMutexUnlock(&Share->lock);
+}
+
+// 扫描线程函数：先取自己队列末尾的目录，没有时从其他线程的队列开头窃取
+// 缓存的项数达到上限时暂停，所有队列都空且没有正在扫描的目录、出错或提前结束时退出
+static void ScanWorker(void *Argument) {
+    SCANWORKER_T *Worker = Argument;
+    SCANSHARE_T *Share = Worker->share;
+    SCANDIR_T *Dir;
+    size_t PushedBefore;
+    for (;;) {
+        OsMutexLock(&Share->lock);
+        // 取路径的一方在等待时不暂停，否则双方会互相等待
+        while (!Share->stop && !Share->failed && Share->pending > 0ULL && Share->buffered >= Share->limit && !Share->waiting)
+            OsCondWait(&Share->wake, &Share->lock);
+        if (Share->stop || Share->failed || Share->pending == 0ULL) {
+            OsMutexUnlock(&Share->lock);
+            return;
+        }
+        PushedBefore = Share->pushed;
+        OsMutexUnlock(&Share->lock);
+        if (!(Dir = PopDir(&Share->deques[Worker->id], false))) {
+            for (int i = 1; !Dir && i < Share->threads; ++i)
+                Dir = PopDir(&Share->deques[(Worker->id + i) % Share->threads], true);
+        }
+        if (Dir) {
+            ScanOneDir(Worker, Dir);
+            continue;
+        }
+        OsMutexLock(&Share->lock);
+        while (!Share->stop && !Share->failed && Share->pending > 0ULL && Share->pushed == PushedBefore)
+            OsCondWait(&Share->wake, &Share->lock);
+        OsMutexUnlock(&Share->lock);
+    }
+}
+
+// 取路径一方在目录树中的位置
+typedef struct {
+    SCANDIR_T *dir;     // 正在输出的目录
+    SCANENTRY_T *owner; // 上级目录中对应此目录的项，根目录为NULL
+    size_t next;        // 下一个输出的项的下标
+} SCANFRAME_T;
+
+struct OSSCAN {
+    SCANSHARE_T share;      // 扫描线程共享的状态
+    SCANWORKER_T *workers;  // 扫描线程
+    int started;            // 成功创建的扫描线程数
+    int target;             // 输出文件、目录或两者
+    SCANFRAME_T *frames;    // 从根目录到正在输出的目录
+    size_t depth;           // frames 中的层数，为0时已输出完
+    size_t slots;           // frames 的容量
+    char root[PATH_MAX_SIZE]; // 规范化的起始目录
+};
+
+// 功能：在后台用 Threads 个线程扫描给定路径中的文件或目录，由 OsScanNext 逐个取出
+// 参数 Target、Recursion 与 OsPathScanPath 相同
+// 参数 QueueSize：最多缓存的已扫描但尚未取走的项数，为0时使用 OSSCAN_QUEUE_DEFAULT
+// 缓存满时扫描线程暂停，取路径的一方等待尚未扫描的目录时扫描线程不受此限制
+// 成功返回扫描状态，起始路径不是目录或内存不足返回NULL
+OSSCAN_T *OsScanStart(const char *DirPath, int Target, int Recursion, int Threads, size_t QueueSize) {
+    OSSCAN_T *Scan;
+    SCANSHARE_T *Share;
+    SCANDIR_T *Root;
+    if (NULL == DirPath || !OsPathIsDirectory(DirPath) || strlen(DirPath) >= PATH_MAX_SIZE)
+        return NULL;
+    if (Threads < 1)
+        Threads = 1;
+    else if (Threads > OSSCAN_THREAD_MAX)
+        Threads = OSSCAN_THREAD_MAX;
+    if (!(Scan = calloc(1, sizeof(OSSCAN_T))))
+        return NULL;
+    Share = &Scan->share;
+    strcpy(Scan->root, DirPath);
+    Root = calloc(1, sizeof(SCANDIR_T));
+    Scan->frames = malloc(FRAME_STEP * sizeof(SCANFRAME_T));
+    Scan->workers = calloc((size_t)Threads, sizeof(SCANWORKER_T));
+    Share->deques = calloc((size_t)Threads, sizeof(SCANDEQUE_T));
+    if (!Root || !Scan->frames || !Scan->workers || !Share->deques || !OsPathNormpath(Scan->root, PATH_MAX_SIZE)) {
+        free(Root);
+        free(Scan->frames);
+        free(Scan->workers);
+        free(Share->deques);
+        free(Scan);
+        return NULL;
+    }
+    Root->path = Scan->root;
+    Scan->frames[0].dir = Root;
+    Scan->frames[0].owner = NULL;
+    Scan->frames[0].next = 0ULL;
+    Scan->depth = 1ULL;
+    Scan->slots = FRAME_STEP;
+    Scan->target = Target;
+    Share->threads = Threads;
+    Share->recursion = Recursion;
+    Share->pending = 1ULL;
+    Share->limit = QueueSize ? QueueSize : OSSCAN_QUEUE_DEFAULT;
+    OsMutexInit(&Share->lock);
+    OsCondInit(&Share->wake);
+    OsCondInit(&Share->listed);
+    for (int i = 0; i < Threads; ++i) {
+        OsMutexInit(&Share->deques[i].lock);
+        Scan->workers[i].share = Share;
+        Scan->workers[i].id = i;
+    }
+    if (!PushDir(&Share->deques[0], Root))
+        Share->failed = true;
+    // 创建失败的线程不再使用，它的队列仍可被窃取
+    for (Scan->started = 0; Scan->started < Threads; ++Scan->started) {
+        if (OsThreadCreate(&Scan->workers[Scan->started].thread, ScanWorker, &Scan->workers[Scan->started]))
+            break;
+    }
+    return Scan;
+}
+
+// 功能：按先序深度优先取出下一个路径，各目录中的项按名称排序，顺序与线程数和扫描先后无关
+// 下一项所在的目录尚未扫描完时等待
+// 返回的路径在下一次调用 OsScanNext 或 OsScanFinish 前有效
+// 已取完或扫描出错返回NULL，由 OsScanFinish 的返回值区分
+const char *OsScanNext(OSSCAN_T *Scan) {
+    SCANSHARE_T *Share = &Scan->share;
+    SCANFRAME_T *Top, *FramesTemp;
+    SCANENTRY_T *Entry;
+    const char *Path = NULL;
+    OsMutexLock(&Share->lock);
+    while (!Path && !Share->failed && Scan->depth > 0ULL) {
+        Top = &Scan->frames[Scan->depth - 1];
+        if (!Top->dir->listed) {
+            if (Scan->started == 0) {
+                // 没有扫描线程时由调用者自己扫描
+                Share->waiting = true;
+                OsMutexUnlock(&Share->lock);
+                ScanWorker(&Scan->workers[0]);
+                OsMutexLock(&Share->lock);
+                continue;
+            }
+            Share->waiting = true;
+            OsCondBroadcast(&Share->wake);
+            while (!Top->dir->listed && !Share->failed)
+                OsCondWait(&Share->listed, &Share->lock);
+            Share->waiting = false;
+            continue;
+        }
+        if (Top->next >= Top->dir->count) {
+            // 目录的各项及其子目录都已取走
+            if (Top->owner)
+                Top->owner->child = NULL;
+            FreeScanDir(Top->dir);
+            --Scan->depth;
+            continue;
+        }
+        Entry = &Top->dir->entries[Top->next++];
+        if (--Share->buffered + 1ULL == Share->limit)
+            OsCondBroadcast(&Share->wake);
+        if (Entry->child) {
+            if (Scan->depth >= Scan->slots) {
+                if (!(FramesTemp = realloc(Scan->frames, (Scan->slots + FRAME_STEP) * sizeof(SCANFRAME_T)))) {
+                    Share->failed = true;
+                    break;
+                }
+                Scan->frames = FramesTemp;
+                Scan->slots += FRAME_STEP;
+            }
+            Scan->frames[Scan->depth].dir = Entry->child;
+            Scan->frames[Scan->depth].owner = Entry;
+            Scan->frames[Scan->depth++].next = 0ULL;
+        }
+        if (Scan->target & OSPATH_BOTH || Scan->target & (Entry->isdir ? OSPATH_DIR : OSPATH_FILE))
+            Path = Entry->path;
+    }
+    OsMutexUnlock(&Share->lock);
+    return Path;
+}
+
+// 功能：结束扫描并释放扫描状态，尚未取完时扫描线程提前退出
+// 成功返回0，有目录无法打开或内存不足返回1
+int OsScanFinish(OSSCAN_T *Scan) {
+    SCANSHARE_T *Share;
+    int FinalReturnCode;
+    if (NULL == Scan)
+        return RESULT_FAILURE;
+    Share = &Scan->share;
+    OsMutexLock(&Share->lock);
+    Share->stop = true;
+    OsCondBroadcast(&Share->wake);
+    OsMutexUnlock(&Share->lock);
+    for (int i = 0; i < Scan->started; ++i)
+        OsThreadJoin(Scan->workers[i].thread);
+    FinalReturnCode = Share->failed ? RESULT_FAILURE : RESULT_SUCCESS;
+    // 已取完的目录已释放，其余都在根目录之下
+    if (Scan->depth > 0ULL)
+        FreeScanDir(Scan->frames[0].dir);
+    for (int i = 0; i < Share->threads; ++i) {
+        OsMutexDestroy(&Share->deques[i].lock);
+        free(Share->deques[i].items);
+    }
+    OsCondDestroy(&Share->listed);
+    OsCondDestroy(&Share->wake);
+    OsMutexDestroy(&Share->lock);
+    free(Share->deques);
+    free(Scan->workers);
+    free(Scan->frames);
+    free(Scan);
+    return FinalReturnCode;
+}
+
+// 功能：用 Threads 个线程搜索给定路径中的文件或目录，结果追加到 *ppScanner
+// 参数 Target、Recursion 与 OsPathScanPath 相同，顺序与 OsScanNext 相同
+// 成功返回0，目录无法打开或内存不足返回1，此时 *ppScanner 中可能已追加部分路径
+int OsScanPath(const char *DirPath, int Target, int Recursion, int Threads, SCANNER_T **const ppScanner) {
+    SCANNER_T *pScannerTemp;
+    OSSCAN_T *Scan;
+    const char *Path;
+    char *PathCopy;
+    int FinalReturnCode = RESULT_SUCCESS;
+    if (NULL == ppScanner || NULL == *ppScanner)
+        return RESULT_FAILURE;
+    if (!(Scan = OsScanStart(DirPath, Target, Recursion, Threads, 0ULL)))
+        return RESULT_FAILURE;
+    while (FinalReturnCode == RESULT_SUCCESS && (Path = OsScanNext(Scan))) {
+        if ((*ppScanner)->count >= (*ppScanner)->blocks) {
+            if (!(pScannerTemp = realloc(*ppScanner, sizeof(SCANNER_T) + sizeof(char *) * ((*ppScanner)->blocks + SCANNER_STEP)))) {
+                FinalReturnCode = RESULT_FAILURE;
+                break;
+            }
+            *ppScanner = pScannerTemp;
+            (*ppScanner)->blocks += SCANNER_STEP;
+        }
+        if (!(PathCopy = malloc(strlen(Path) + 1))) {
+            FinalReturnCode = RESULT_FAILURE;
+            break;
+        }
+        (*ppScanner)->paths[(*ppScanner)->count++] = strcpy(PathCopy, Path);
+    }
+    if (OsScanFinish(Scan))
+        FinalReturnCode = RESULT_FAILURE;
+    return FinalReturnCode;
+}
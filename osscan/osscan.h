@@ -0,0 +1,25 @@
+#ifndef __OSSCAN_H
+#define __OSSCAN_H
+
+#ifdef _MSC_VER
+#ifndef _CRT_SECURE_NO_WARNINGS // 关闭MSC强制安全警告
+#define _CRT_SECURE_NO_WARNINGS
+#endif // _CRT_SECURE_NO_WARNINGS
+#endif // _MSC_VER
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../ospath/ospath.h"
+
+#define OSSCAN_THREAD_MAX    256   // 扫描最多使用的线程数
+#define OSSCAN_QUEUE_DEFAULT 65536 // 默认最多缓存的已扫描但尚未取走的路径数
+
+typedef struct OSSCAN OSSCAN_T; // 流式扫描，由 OsScanStart 创建，OsScanFinish 释放
+
+OSSCAN_T *OsScanStart(const char *DirPath, int Target, int Recursion, int Threads, size_t QueueSize);
+const char *OsScanNext(OSSCAN_T *Scan);
+int OsScanFinish(OSSCAN_T *Scan);
+int OsScanPath(const char *DirPath, int Target, int Recursion, int Threads, SCANNER_T **const ppScanner);
+
+#endif // __OSSCAN_H
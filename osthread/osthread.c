@@ -0,0 +1,155 @@
+#include "osthread.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif // _WIN32
+
+#include "../ospath/ospath.h"
+
+// 传给平台线程函数的参数，保存真正的线程函数及其参数
+typedef struct {
+    OSTHREAD_ROUTINE routine;
+    void *argument;
+} THREAD_START_T;
+
+// 平台线程函数，调用真正的线程函数后释放参数
+#ifdef _WIN32
+static DWORD WINAPI ThreadStart(LPVOID Parameter)
+#else
+static void *ThreadStart(void *Parameter)
+#endif // _WIN32
+{
+    THREAD_START_T Start = *(THREAD_START_T *)Parameter;
+    free(Parameter);
+    Start.routine(Start.argument);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif // _WIN32
+}
+
+// 创建线程并立即运行 Routine(Argument)
+// 成功返回0，失败返回1
+int OsThreadCreate(OSTHREAD_T *pThread, OSTHREAD_ROUTINE Routine, void *Argument) {
+    THREAD_START_T *Start;
+    if (!(Start = malloc(sizeof(THREAD_START_T))))
+        return RESULT_FAILURE;
+    Start->routine = Routine;
+    Start->argument = Argument;
+#ifdef _WIN32
+    if (!(*pThread = CreateThread(NULL, 0, ThreadStart, Start, 0, NULL))) {
+#else
+    if (pthread_create(pThread, NULL, ThreadStart, Start)) {
+#endif // _WIN32
+        free(Start);
+        return RESULT_FAILURE;
+    }
+    return RESULT_SUCCESS;
+}
+
+// 等待线程结束并释放线程资源
+// 成功返回0，失败返回1
+int OsThreadJoin(OSTHREAD_T Thread) {
+#ifdef _WIN32
+    if (WaitForSingleObject(Thread, INFINITE) != WAIT_OBJECT_0)
+        return RESULT_FAILURE;
+    CloseHandle(Thread);
+    return RESULT_SUCCESS;
+#else
+    return pthread_join(Thread, NULL) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 获取可用的处理器数量，获取失败时返回1
+int OsThreadCPUCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    return SystemInfo.dwNumberOfProcessors > 0 ? (int)SystemInfo.dwNumberOfProcessors : 1;
+#else
+    long Count = sysconf(_SC_NPROCESSORS_ONLN);
+    return Count > 0 ? (int)Count : 1;
+#endif // _WIN32
+}
+
+// 初始化互斥锁，成功返回0，失败返回1
+int OsMutexInit(OSMUTEX_T *Mutex) {
+#ifdef _WIN32
+    InitializeSRWLock(Mutex);
+    return RESULT_SUCCESS;
+#else
+    return pthread_mutex_init(Mutex, NULL) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 销毁互斥锁
+void OsMutexDestroy(OSMUTEX_T *Mutex) {
+#ifndef _WIN32
+    pthread_mutex_destroy(Mutex);
+#endif // _WIN32
+}
+
+// 加锁
+void OsMutexLock(OSMUTEX_T *Mutex) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(Mutex);
+#else
+    pthread_mutex_lock(Mutex);
+#endif // _WIN32
+}
+
+// 解锁
+void OsMutexUnlock(OSMUTEX_T *Mutex) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(Mutex);
+#else
+    pthread_mutex_unlock(Mutex);
+#endif // _WIN32
+}
+
+// 初始化条件变量，成功返回0，失败返回1
+int OsCondInit(OSCOND_T *Cond) {
+#ifdef _WIN32
+    InitializeConditionVariable(Cond);
+    return RESULT_SUCCESS;
+#else
+    return pthread_cond_init(Cond, NULL) ? RESULT_FAILURE : RESULT_SUCCESS;
+#endif // _WIN32
+}
+
+// 销毁条件变量
+void OsCondDestroy(OSCOND_T *Cond) {
+#ifndef _WIN32
+    pthread_cond_destroy(Cond);
+#endif // _WIN32
+}
+
+// 解锁 Mutex 并等待条件变量，被唤醒后重新加锁
+void OsCondWait(OSCOND_T *Cond, OSMUTEX_T *Mutex) {
+#ifdef _WIN32
+    SleepConditionVariableSRW(Cond, Mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(Cond, Mutex);
+#endif // _WIN32
+}
+
+// 唤醒一个等待条件变量的线程
+void OsCondSignal(OSCOND_T *Cond) {
+#ifdef _WIN32
+    WakeConditionVariable(Cond);
+#else
+    pthread_cond_signal(Cond);
+#endif // _WIN32
+}
+
+// 唤醒所有等待条件变量的线程
+void OsCondBroadcast(OSCOND_T *Cond) {
+#ifdef _WIN32
+    WakeAllConditionVariable(Cond);
+#else
+    pthread_cond_broadcast(Cond);
+#endif // _WIN32
+}
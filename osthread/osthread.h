@@ -0,0 +1,47 @@
+#ifndef __OSTHREAD_H
+#define __OSTHREAD_H
+
+#ifdef _MSC_VER
+#ifndef _CRT_SECURE_NO_WARNINGS // 关闭MSC强制安全警告
+#define _CRT_SECURE_NO_WARNINGS
+#endif // _CRT_SECURE_NO_WARNINGS
+#endif // _MSC_VER
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE OSTHREAD_T;            // 线程
+typedef SRWLOCK OSMUTEX_T;            // 互斥锁
+typedef CONDITION_VARIABLE OSCOND_T;  // 条件变量
+#else
+#include <pthread.h>
+typedef pthread_t OSTHREAD_T;         // 线程
+typedef pthread_mutex_t OSMUTEX_T;    // 互斥锁
+typedef pthread_cond_t OSCOND_T;      // 条件变量
+#endif // _WIN32
+
+// 线程局部存储说明符，每个线程有一份独立的变量
+#ifdef _MSC_VER
+#define OSTHREAD_LOCAL __declspec(thread)
+#else
+#define OSTHREAD_LOCAL _Thread_local
+#endif // _MSC_VER
+
+// 线程函数，参数 Argument 为创建线程时传入的参数
+typedef void (*OSTHREAD_ROUTINE)(void *Argument);
+
+int OsThreadCreate(OSTHREAD_T *pThread, OSTHREAD_ROUTINE Routine, void *Argument);
+int OsThreadJoin(OSTHREAD_T Thread);
+int OsThreadCPUCount(void);
+int OsMutexInit(OSMUTEX_T *Mutex);
+void OsMutexDestroy(OSMUTEX_T *Mutex);
+void OsMutexLock(OSMUTEX_T *Mutex);
+void OsMutexUnlock(OSMUTEX_T *Mutex);
+int OsCondInit(OSCOND_T *Cond);
+void OsCondDestroy(OSCOND_T *Cond);
+void OsCondWait(OSCOND_T *Cond, OSMUTEX_T *Mutex);
+void OsCondSignal(OSCOND_T *Cond);
+void OsCondBroadcast(OSCOND_T *Cond);
+
+#endif // __OSTHREAD_H